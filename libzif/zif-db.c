@@ -36,6 +36,11 @@
  *
  * Using the filesystem as a database probably wasn't a great design
  * decision.
+ *
+ * Setting "yumdb_backend" to "sqlite" stores the same keys in a real
+ * database instead, optionally exporting them to the yum directory
+ * layout. Many changes can be written at once using zif_db_begin() and
+ * zif_db_commit().
  */
 
 #ifdef HAVE_CONFIG_H
@@ -43,23 +48,72 @@
 #endif
 
 #include <glib.h>
+#include <sqlite3.h>
 
 #include "zif-config.h"
 #include "zif-db.h"
 #include "zif-object-array.h"
 #include "zif-package-private.h"
 #include "zif-package-remote.h"
+#include "zif-utils-private.h"
 #include "zif-utils.h"
 
 #define ZIF_DB_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ZIF_TYPE_DB, ZifDbPrivate))
 
+typedef enum {
+	ZIF_DB_BACKEND_DIRECTORY,
+	ZIF_DB_BACKEND_SQLITE,
+	ZIF_DB_BACKEND_LAST
+} ZifDbBackend;
+
+typedef enum {
+	ZIF_DB_STMT_GET_STRING,
+	ZIF_DB_STMT_GET_KEYS,
+	ZIF_DB_STMT_SET_STRING,
+	ZIF_DB_STMT_REMOVE,
+	ZIF_DB_STMT_REMOVE_ALL,
+	ZIF_DB_STMT_GET_PACKAGES,
+	ZIF_DB_STMT_LAST
+} ZifDbStmt;
+
+/* this has to be kept in the same order as ZifDbStmt, and the package
+ * is always bound to the first four parameters */
+static const gchar *zif_db_statements[] = {
+	"SELECT value FROM yumdb WHERE pkgid = ?1 AND name = ?2 AND "
+		"version = ?3 AND arch = ?4 AND key = ?5;",
+	"SELECT key FROM yumdb WHERE pkgid = ?1 AND name = ?2 AND "
+		"version = ?3 AND arch = ?4;",
+	"INSERT OR REPLACE INTO yumdb (pkgid, name, version, arch, key, value) "
+		"VALUES (?1, ?2, ?3, ?4, ?5, ?6);",
+	"DELETE FROM yumdb WHERE pkgid = ?1 AND name = ?2 AND "
+		"version = ?3 AND arch = ?4 AND key = ?5;",
+	"DELETE FROM yumdb WHERE pkgid = ?1 AND name = ?2 AND "
+		"version = ?3 AND arch = ?4;",
+	"SELECT DISTINCT pkgid, name, version, arch FROM yumdb;",
+	NULL
+};
+
 struct _ZifDbPrivate
 {
 	gchar			*root;
 	ZifConfig		*config;
 	guint			 monitor_changed_id;
+	ZifDbBackend		 backend;
+	gboolean		 export_directory;
+	gchar			*filename;
+	sqlite3			*sqlite;
+	sqlite3_stmt		*stmts[ZIF_DB_STMT_LAST];
+	gboolean		 in_batch;
+	GHashTable		*batch_dirs;
+	GPtrArray		*batch_export;
 };
 
+typedef struct {
+	ZifPackage		*package;
+	gchar			*key;
+	gchar			*value;
+} ZifDbExport;
+
 G_DEFINE_TYPE (ZifDb, zif_db, G_TYPE_OBJECT)
 static gpointer zif_db_object = NULL;
 
@@ -80,47 +134,54 @@ zif_db_error_quark (void)
 }
 
 /**
- * zif_db_set_root:
- * @db: A #ZifDb
- * @root: A system wide db root, e.g. "/var/lib/yum/yumdb", or %NULL to use the default.
- * @error: A #GError, or %NULL
- *
- * Sets the path to use as the system wide db directory.
- *
- * Return value: %TRUE for success, %FALSE otherwise
- *
- * Since: 0.1.3
+ * zif_db_export_free:
  **/
-gboolean
-zif_db_set_root (ZifDb *db, const gchar *root, GError **error)
+static void
+zif_db_export_free (ZifDbExport *export)
 {
-	gboolean ret = FALSE;
+	g_object_unref (export->package);
+	g_free (export->key);
+	g_free (export->value);
+	g_free (export);
+}
 
-	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
-	g_return_val_if_fail (db->priv->root == NULL, FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+/**
+ * zif_db_add_package:
+ **/
+static gboolean
+zif_db_add_package (GPtrArray *array,
+		    const gchar *pkgid,
+		    const gchar *name,
+		    const gchar *version,
+		    const gchar *arch,
+		    GError **error)
+{
+	gboolean ret;
+	gchar *package_id;
+	ZifPackage *package;
+	ZifString *pkgid_tmp;
 
-	/* get from config if not specified */
-	if (root == NULL) {
-		db->priv->root = zif_config_get_string (db->priv->config,
-							"yumdb", error);
-		if (db->priv->root == NULL)
-			goto out;
-	} else {
-		db->priv->root = g_strdup (root);
-	}
+	/* create package-id */
+	package_id = zif_package_id_build (name,
+					   version,
+					   arch,
+					   "installed");
 
-	/* check file exists */
-	ret = g_file_test (db->priv->root, G_FILE_TEST_IS_DIR);
-	if (!ret) {
-		g_set_error (error,
-			     ZIF_DB_ERROR,
-			     ZIF_DB_ERROR_FAILED,
-			     "db root %s does not exist",
-			     db->priv->root);
+	/* assign package-id */
+	package = zif_package_new ();
+	ret = zif_package_set_id (package, package_id, error);
+	if (!ret)
 		goto out;
-	}
+
+	/* set pkgid */
+	pkgid_tmp = zif_string_new (pkgid);
+	zif_package_set_pkgid (package, pkgid_tmp);
+	zif_string_unref (pkgid_tmp);
+	zif_package_set_installed (package, TRUE);
+	zif_object_array_add (array, package);
 out:
+	g_free (package_id);
+	g_object_unref (package);
 	return ret;
 }
 
@@ -166,38 +227,19 @@ zif_db_get_dir_for_package (ZifDb *db, ZifPackage *package)
 }
 
 /**
- * zif_db_get_string:
- * @db: A #ZifDb
- * @package: A package to use as a reference
- * @key: A key name to retrieve, e.g. "releasever"
- * @error: A #GError, or %NULL
- *
- * Gets a string value from the yumdb 'database'.
- *
- * Return value: An allocated value, or %NULL
- *
- * Since: 0.1.3
+ * zif_db_directory_get_string:
  **/
-gchar *
-zif_db_get_string (ZifDb *db, ZifPackage *package, const gchar *key, GError **error)
+static gchar *
+zif_db_directory_get_string (ZifDb *db,
+			     ZifPackage *package,
+			     const gchar *key,
+			     GError **error)
 {
 	gboolean ret;
 	gchar *filename = NULL;
 	gchar *index_dir = NULL;
 	gchar *value = NULL;
 
-	g_return_val_if_fail (ZIF_IS_DB (db), NULL);
-	g_return_val_if_fail (ZIF_IS_PACKAGE (package), NULL);
-	g_return_val_if_fail (key != NULL, NULL);
-	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-	/* not loaded yet */
-	if (db->priv->root == NULL) {
-		ret = zif_db_set_root (db, NULL, error);
-		if (!ret)
-			goto out;
-	}
-
 	/* get file contents */
 	index_dir = zif_db_get_dir_for_package (db, package);
 	filename = g_build_filename (index_dir, key, NULL);
@@ -224,37 +266,16 @@ out:
 }
 
 /**
- * zif_db_get_keys:
- * @db: A #ZifDb
- * @package: A package to use as a reference
- * @error: A #GError, or %NULL
- *
- * Gets all the keys for a given package.
- *
- * Return value: (element-type utf8) (transfer full): An allocated value, or %NULL
- *
- * Since: 0.1.3
+ * zif_db_directory_get_keys:
  **/
-GPtrArray *
-zif_db_get_keys (ZifDb *db, ZifPackage *package, GError **error)
+static GPtrArray *
+zif_db_directory_get_keys (ZifDb *db, ZifPackage *package, GError **error)
 {
 	const gchar *filename;
-	gboolean ret;
 	gchar *index_dir = NULL;
 	GDir *dir = NULL;
 	GPtrArray *array = NULL;
 
-	g_return_val_if_fail (ZIF_IS_DB (db), NULL);
-	g_return_val_if_fail (ZIF_IS_PACKAGE (package), NULL);
-	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-	/* not loaded yet */
-	if (db->priv->root == NULL) {
-		ret = zif_db_set_root (db, NULL, error);
-		if (!ret)
-			goto out;
-	}
-
 	/* get file contents */
 	index_dir = zif_db_get_dir_for_package (db, package);
 
@@ -278,44 +299,34 @@ out:
 }
 
 /**
- * zif_db_set_string:
- * @db: A #ZifDb
- * @package: A package to use as a reference
- * @key: Key name to save, e.g. "reason"
- * @value: Key data to save, e.g. "dep"
- * @error: A #GError, or %NULL
- *
- * Writes a data value to the yumdb 'database'.
- *
- * Return value: %TRUE for success, %FALSE otherwise
- *
- * Since: 0.1.3
+ * zif_db_directory_set_string:
  **/
-gboolean
-zif_db_set_string (ZifDb *db, ZifPackage *package, const gchar *key, const gchar *value, GError **error)
+static gboolean
+zif_db_directory_set_string (ZifDb *db,
+			     ZifPackage *package,
+			     const gchar *key,
+			     const gchar *value,
+			     GError **error)
 {
 	gboolean ret = TRUE;
 	gchar *index_dir = NULL;
 	gchar *index_file = NULL;
 
-	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
-	g_return_val_if_fail (ZIF_IS_PACKAGE (package), FALSE);
-	g_return_val_if_fail (key != NULL, FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-	/* not loaded yet */
-	if (db->priv->root == NULL) {
-		ret = zif_db_set_root (db, NULL, error);
+	/* create the index directory, unless we've already done it in
+	 * this batch */
+	index_dir = zif_db_get_dir_for_package (db, package);
+	if (!db->priv->in_batch ||
+	    g_hash_table_lookup (db->priv->batch_dirs, index_dir) == NULL) {
+		ret = zif_db_create_dir (index_dir, error);
 		if (!ret)
 			goto out;
+		if (db->priv->in_batch) {
+			g_hash_table_insert (db->priv->batch_dirs,
+					     g_strdup (index_dir),
+					     GINT_TO_POINTER (1));
+		}
 	}
 
-	/* create the index directory */
-	index_dir = zif_db_get_dir_for_package (db, package);
-	ret = zif_db_create_dir (index_dir, error);
-	if (!ret)
-		goto out;
-
 	/* write the value */
 	index_file = g_build_filename (index_dir, key, NULL);
 	g_debug ("writing %s to %s", value, index_file);
@@ -329,23 +340,20 @@ out:
 }
 
 /**
- * zif_db_get_packages_for_filename:
+ * zif_db_directory_get_packages_for_filename:
  **/
 static gboolean
-zif_db_get_packages_for_filename (ZifDb *db,
-				  GPtrArray *array,
-				  const gchar *filename,
-				  GError **error)
+zif_db_directory_get_packages_for_filename (ZifDb *db,
+					    GPtrArray *array,
+					    const gchar *filename,
+					    GError **error)
 {
 	gboolean ret = TRUE;
-	gchar *package_id = NULL;
 	gchar **split = NULL;
 	GString *name = NULL;
 	GString *version = NULL;
 	guint i;
 	guint len;
-	ZifPackage *package = NULL;
-	ZifString *pkgid = NULL;
 
 	/* cut up using a metric. I wish this was a database... */
 	split = g_strsplit (filename, "-", -1);
@@ -365,45 +373,32 @@ zif_db_get_packages_for_filename (ZifDb *db,
 		g_string_append_printf (version, "%s-", split[i]);
 	g_string_set_size (version, version->len - 1);
 
-	/* create package-id */
-	package_id = zif_package_id_build (name->str,
-					   version->str,
-					   split[len-1],
-					   "installed");
-
-	/* assign package-id */
-	package = zif_package_new ();
-	ret = zif_package_set_id (package, package_id, error);
+	/* add package */
+	ret = zif_db_add_package (array,
+				  split[0],
+				  name->str,
+				  version->str,
+				  split[len-1],
+				  error);
 	if (!ret)
 		goto out;
-
-	/* set pkgid */
-	pkgid = zif_string_new (split[0]);
-	zif_package_set_pkgid (package, pkgid);
-	zif_package_set_installed (package, TRUE);
-	zif_object_array_add (array, package);
 out:
 	g_strfreev (split);
-	g_free (package_id);
-	if (package != NULL)
-		g_object_unref (package);
 	if (name != NULL)
 		g_string_free (name, TRUE);
 	if (version != NULL)
 		g_string_free (version, TRUE);
-	if (pkgid != NULL)
-		zif_string_unref (pkgid);
 	return ret;
 }
 
 /**
- * zif_db_get_packages_for_index:
+ * zif_db_directory_get_packages_for_index:
  **/
 static gboolean
-zif_db_get_packages_for_index (ZifDb *db,
-			       GPtrArray *array,
-			       const gchar *path,
-			       GError **error)
+zif_db_directory_get_packages_for_index (ZifDb *db,
+					 GPtrArray *array,
+					 const gchar *path,
+					 GError **error)
 {
 	const gchar *filename;
 	gboolean ret = TRUE;
@@ -419,10 +414,10 @@ zif_db_get_packages_for_index (ZifDb *db,
 	/* get the initial index */
 	filename = g_dir_read_name (dir);
 	while (filename != NULL) {
-		ret = zif_db_get_packages_for_filename (db,
-							array,
-							filename,
-							error);
+		ret = zif_db_directory_get_packages_for_filename (db,
+								  array,
+								  filename,
+								  error);
 		if (!ret)
 			goto out;
 		filename = g_dir_read_name (dir);
@@ -434,18 +429,10 @@ out:
 }
 
 /**
- * zif_db_get_packages:
- * @db: A #ZifDb
- * @error: A #GError, or %NULL
- *
- * Gets all the packages in the yumdb 'database'.
- *
- * Return value: (element-type ZifPackage) (transfer container): An array of #ZifPackage's
- *
- * Since: 0.1.3
+ * zif_db_directory_get_packages:
  **/
-GPtrArray *
-zif_db_get_packages (ZifDb *db, GError **error)
+static GPtrArray *
+zif_db_directory_get_packages (ZifDb *db, GError **error)
 {
 	const gchar *filename;
 	gboolean ret;
@@ -454,16 +441,6 @@ zif_db_get_packages (ZifDb *db, GError **error)
 	GPtrArray *array = NULL;
 	GPtrArray *array_tmp = NULL;
 
-	g_return_val_if_fail (ZIF_IS_DB (db), NULL);
-	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-
-	/* not loaded yet */
-	if (db->priv->root == NULL) {
-		ret = zif_db_set_root (db, NULL, error);
-		if (!ret)
-			goto out;
-	}
-
 	/* search directory */
 	dir = g_dir_open (db->priv->root, 0, error);
 	if (dir == NULL)
@@ -479,10 +456,10 @@ zif_db_get_packages (ZifDb *db, GError **error)
 					 filename,
 					 NULL);
 		if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
-			ret = zif_db_get_packages_for_index (db,
-							     array_tmp,
-							     path,
-							     error);
+			ret = zif_db_directory_get_packages_for_index (db,
+								       array_tmp,
+								       path,
+								       error);
 			g_free (path);
 			if (!ret)
 				goto out;
@@ -503,39 +480,20 @@ out:
 }
 
 /**
- * zif_db_remove:
- * @db: A #ZifDb
- * @package: A package to use as a reference
- * @key: Key name to delete, e.g. "reason"
- * @error: A #GError, or %NULL
- *
- * Removes a data value from the yumdb 'database' for a given package.
- *
- * Return value: %TRUE for success, %FALSE otherwise
- *
- * Since: 0.1.3
+ * zif_db_directory_remove:
  **/
-gboolean
-zif_db_remove (ZifDb *db, ZifPackage *package,
-	       const gchar *key, GError **error)
+static gboolean
+zif_db_directory_remove (ZifDb *db,
+			 ZifPackage *package,
+			 const gchar *key,
+			 GError **error)
 {
-	gboolean ret = TRUE;
+	gboolean ret;
 	gchar *index_dir = NULL;
 	gchar *index_file = NULL;
+	GError *error_local = NULL;
 	GFile *file = NULL;
 
-	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
-	g_return_val_if_fail (ZIF_IS_PACKAGE (package), FALSE);
-	g_return_val_if_fail (key != NULL, FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-	/* not loaded yet */
-	if (db->priv->root == NULL) {
-		ret = zif_db_set_root (db, NULL, error);
-		if (!ret)
-			goto out;
-	}
-
 	/* create the index directory */
 	index_dir = zif_db_get_dir_for_package (db, package);
 
@@ -543,30 +501,36 @@ zif_db_remove (ZifDb *db, ZifPackage *package,
 	g_debug ("deleting %s from %s", key, index_dir);
 	index_file = g_build_filename (index_dir, key, NULL);
 	file = g_file_new_for_path (index_file);
-	ret = g_file_delete (file, NULL, error);
-	if (!ret)
+	ret = g_file_delete (file, NULL, &error_local);
+	if (!ret) {
+		if (g_error_matches (error_local,
+				     G_IO_ERROR,
+				     G_IO_ERROR_NOT_FOUND)) {
+			g_set_error (error,
+				     ZIF_DB_ERROR,
+				     ZIF_DB_ERROR_FAILED,
+				     "%s key not found for %s",
+				     key,
+				     zif_package_get_printable (package));
+			g_error_free (error_local);
+		} else {
+			g_propagate_error (error, error_local);
+		}
 		goto out;
+	}
 out:
 	if (file != NULL)
 		g_object_unref (file);
 	g_free (index_dir);
+	g_free (index_file);
 	return ret;
 }
 
 /**
- * zif_db_remove_all:
- * @db: A #ZifDb
- * @package: A package to use as a reference
- * @error: A #GError, or %NULL
- *
- * Removes a all data value from the yumdb 'database' for a given package.
- *
- * Return value: %TRUE for success, %FALSE otherwise
- *
- * Since: 0.1.3
+ * zif_db_directory_remove_all:
  **/
-gboolean
-zif_db_remove_all (ZifDb *db, ZifPackage *package, GError **error)
+static gboolean
+zif_db_directory_remove_all (ZifDb *db, ZifPackage *package, GError **error)
 {
 	gboolean ret = TRUE;
 	gchar *index_dir = NULL;
@@ -576,19 +540,10 @@ zif_db_remove_all (ZifDb *db, ZifPackage *package, GError **error)
 	GDir *dir = NULL;
 	const gchar *filename;
 
-	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
-	g_return_val_if_fail (ZIF_IS_PACKAGE (package), FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-	/* not loaded yet */
-	if (db->priv->root == NULL) {
-		ret = zif_db_set_root (db, NULL, error);
-		if (!ret)
-			goto out;
-	}
-
 	/* get the folder */
 	index_dir = zif_db_get_dir_for_package (db, package);
+	if (db->priv->in_batch)
+		g_hash_table_remove (db->priv->batch_dirs, index_dir);
 	ret = g_file_test (index_dir, G_FILE_TEST_IS_DIR);
 	if (!ret) {
 		g_debug ("Nothing to delete in %s", index_dir);
@@ -598,8 +553,10 @@ zif_db_remove_all (ZifDb *db, ZifPackage *package, GError **error)
 
 	/* open */
 	dir = g_dir_open (index_dir, 0, error);
-	if (dir == NULL)
+	if (dir == NULL) {
+		ret = FALSE;
 		goto out;
+	}
 
 	/* delete each one */
 	filename = g_dir_read_name (dir);
@@ -623,12 +580,976 @@ zif_db_remove_all (ZifDb *db, ZifPackage *package, GError **error)
 	if (!ret)
 		goto out;
 out:
+	if (dir != NULL)
+		g_dir_close (dir);
 	if (file_directory != NULL)
 		g_object_unref (file_directory);
 	g_free (index_dir);
 	return ret;
 }
 
+/**
+ * zif_db_sqlite_exec:
+ **/
+static gboolean
+zif_db_sqlite_exec (ZifDb *db, const gchar *statement, GError **error)
+{
+	gboolean ret = TRUE;
+	gchar *error_msg = NULL;
+	gint rc;
+
+	rc = sqlite3_exec (db->priv->sqlite,
+			   statement,
+			   NULL, NULL, &error_msg);
+	if (rc != SQLITE_OK) {
+		ret = FALSE;
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "SQL error: %s",
+			     error_msg);
+		sqlite3_free (error_msg);
+	}
+	return ret;
+}
+
+/**
+ * zif_db_sqlite_bind_package:
+ **/
+static void
+zif_db_sqlite_bind_package (sqlite3_stmt *stmt, ZifPackage *package)
+{
+	sqlite3_bind_text (stmt, 1, zif_package_get_pkgid (package), -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, zif_package_get_name (package), -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 3, zif_package_get_version (package), -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 4, zif_package_get_arch (package), -1, SQLITE_STATIC);
+}
+
+/**
+ * zif_db_sqlite_step_done:
+ **/
+static gboolean
+zif_db_sqlite_step_done (ZifDb *db, sqlite3_stmt *stmt, GError **error)
+{
+	gboolean ret = TRUE;
+	gint rc;
+
+	rc = sqlite3_step (stmt);
+	if (rc != SQLITE_DONE) {
+		ret = FALSE;
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db->priv->sqlite));
+	}
+	sqlite3_reset (stmt);
+	sqlite3_clear_bindings (stmt);
+	return ret;
+}
+
+/**
+ * zif_db_sqlite_get_string:
+ **/
+static gchar *
+zif_db_sqlite_get_string (ZifDb *db,
+			  ZifPackage *package,
+			  const gchar *key,
+			  GError **error)
+{
+	gchar *value = NULL;
+	gint rc;
+	sqlite3_stmt *stmt = db->priv->stmts[ZIF_DB_STMT_GET_STRING];
+
+	zif_db_sqlite_bind_package (stmt, package);
+	sqlite3_bind_text (stmt, 5, key, -1, SQLITE_STATIC);
+	rc = sqlite3_step (stmt);
+	if (rc == SQLITE_ROW) {
+		value = g_strdup ((const gchar *) sqlite3_column_text (stmt, 0));
+	} else if (rc == SQLITE_DONE) {
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "%s key not found for %s",
+			     key,
+			     zif_package_get_printable (package));
+	} else {
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db->priv->sqlite));
+	}
+	sqlite3_reset (stmt);
+	sqlite3_clear_bindings (stmt);
+	return value;
+}
+
+/**
+ * zif_db_sqlite_get_keys:
+ **/
+static GPtrArray *
+zif_db_sqlite_get_keys (ZifDb *db, ZifPackage *package, GError **error)
+{
+	gint rc;
+	GPtrArray *array = NULL;
+	GPtrArray *array_tmp;
+	sqlite3_stmt *stmt = db->priv->stmts[ZIF_DB_STMT_GET_KEYS];
+
+	array_tmp = g_ptr_array_new_with_free_func (g_free);
+	zif_db_sqlite_bind_package (stmt, package);
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW)
+		g_ptr_array_add (array_tmp, g_strdup ((const gchar *) sqlite3_column_text (stmt, 0)));
+	if (rc != SQLITE_DONE) {
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db->priv->sqlite));
+		goto out;
+	}
+
+	/* the directory backend fails if nothing was ever set */
+	if (array_tmp->len == 0) {
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "no keys for %s",
+			     zif_package_get_printable (package));
+		goto out;
+	}
+
+	/* success */
+	array = g_ptr_array_ref (array_tmp);
+out:
+	sqlite3_reset (stmt);
+	sqlite3_clear_bindings (stmt);
+	g_ptr_array_unref (array_tmp);
+	return array;
+}
+
+/**
+ * zif_db_sqlite_set_string:
+ **/
+static gboolean
+zif_db_sqlite_set_string (ZifDb *db,
+			  ZifPackage *package,
+			  const gchar *key,
+			  const gchar *value,
+			  GError **error)
+{
+	sqlite3_stmt *stmt = db->priv->stmts[ZIF_DB_STMT_SET_STRING];
+
+	zif_db_sqlite_bind_package (stmt, package);
+	sqlite3_bind_text (stmt, 5, key, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 6, value, -1, SQLITE_STATIC);
+	return zif_db_sqlite_step_done (db, stmt, error);
+}
+
+/**
+ * zif_db_sqlite_get_packages:
+ **/
+static GPtrArray *
+zif_db_sqlite_get_packages (ZifDb *db, GError **error)
+{
+	gboolean ret = TRUE;
+	gint rc;
+	GPtrArray *array = NULL;
+	GPtrArray *array_tmp;
+	sqlite3_stmt *stmt = db->priv->stmts[ZIF_DB_STMT_GET_PACKAGES];
+
+	array_tmp = zif_object_array_new ();
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+		ret = zif_db_add_package (array_tmp,
+					  (const gchar *) sqlite3_column_text (stmt, 0),
+					  (const gchar *) sqlite3_column_text (stmt, 1),
+					  (const gchar *) sqlite3_column_text (stmt, 2),
+					  (const gchar *) sqlite3_column_text (stmt, 3),
+					  error);
+		if (!ret)
+			goto out;
+	}
+	if (rc != SQLITE_DONE) {
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "SQL error: %s",
+			     sqlite3_errmsg (db->priv->sqlite));
+		goto out;
+	}
+
+	/* success */
+	array = g_ptr_array_ref (array_tmp);
+out:
+	sqlite3_reset (stmt);
+	g_ptr_array_unref (array_tmp);
+	return array;
+}
+
+/**
+ * zif_db_sqlite_remove:
+ **/
+static gboolean
+zif_db_sqlite_remove (ZifDb *db,
+		      ZifPackage *package,
+		      const gchar *key,
+		      GError **error)
+{
+	gboolean ret;
+	sqlite3_stmt *stmt = db->priv->stmts[ZIF_DB_STMT_REMOVE];
+
+	zif_db_sqlite_bind_package (stmt, package);
+	sqlite3_bind_text (stmt, 5, key, -1, SQLITE_STATIC);
+	ret = zif_db_sqlite_step_done (db, stmt, error);
+	if (!ret)
+		goto out;
+
+	/* the directory backend fails if the key was never set */
+	if (sqlite3_changes (db->priv->sqlite) == 0) {
+		ret = FALSE;
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "%s key not found for %s",
+			     key,
+			     zif_package_get_printable (package));
+		goto out;
+	}
+out:
+	return ret;
+}
+
+/**
+ * zif_db_sqlite_remove_all:
+ **/
+static gboolean
+zif_db_sqlite_remove_all (ZifDb *db, ZifPackage *package, GError **error)
+{
+	sqlite3_stmt *stmt = db->priv->stmts[ZIF_DB_STMT_REMOVE_ALL];
+
+	zif_db_sqlite_bind_package (stmt, package);
+	return zif_db_sqlite_step_done (db, stmt, error);
+}
+
+/**
+ * zif_db_sqlite_import:
+ *
+ * Copies everything in the yum-compatible directory into the new
+ * database so switching backend does not lose data.
+ **/
+static gboolean
+zif_db_sqlite_import (ZifDb *db, GError **error)
+{
+	const gchar *key;
+	gboolean ret = TRUE;
+	gchar *value;
+	GPtrArray *keys;
+	GPtrArray *packages;
+	guint i, j;
+	ZifPackage *package;
+
+	packages = zif_db_directory_get_packages (db, error);
+	if (packages == NULL) {
+		ret = FALSE;
+		goto out;
+	}
+	g_debug ("importing %i packages from %s",
+		 packages->len, db->priv->root);
+	for (i = 0; i < packages->len; i++) {
+		package = g_ptr_array_index (packages, i);
+		keys = zif_db_directory_get_keys (db, package, NULL);
+		if (keys == NULL)
+			continue;
+		for (j = 0; j < keys->len; j++) {
+			key = g_ptr_array_index (keys, j);
+			value = zif_db_directory_get_string (db, package, key, NULL);
+			if (value == NULL)
+				continue;
+			ret = zif_db_sqlite_set_string (db, package, key, value, error);
+			g_free (value);
+			if (!ret)
+				break;
+		}
+		g_ptr_array_unref (keys);
+		if (!ret)
+			goto out;
+	}
+out:
+	if (packages != NULL)
+		g_ptr_array_unref (packages);
+	return ret;
+}
+
+/**
+ * zif_db_sqlite_close:
+ **/
+static void
+zif_db_sqlite_close (ZifDb *db)
+{
+	guint i;
+
+	for (i = 0; i < ZIF_DB_STMT_LAST; i++) {
+		if (db->priv->stmts[i] != NULL)
+			sqlite3_finalize (db->priv->stmts[i]);
+		db->priv->stmts[i] = NULL;
+	}
+	if (db->priv->sqlite != NULL)
+		sqlite3_close (db->priv->sqlite);
+	db->priv->sqlite = NULL;
+}
+
+/**
+ * zif_db_sqlite_open:
+ **/
+static gboolean
+zif_db_sqlite_open (ZifDb *db, GError **error)
+{
+	gboolean create = FALSE;
+	gboolean ret;
+	gchar *error_msg = NULL;
+	gint rc;
+	guint i;
+
+	/* ensure the basename exists */
+	ret = zif_ensure_parent_dir_exists (db->priv->filename,
+					    NULL,
+					    error);
+	if (!ret)
+		goto out;
+
+	/* open db */
+	g_debug ("trying to open database '%s'", db->priv->filename);
+	rc = sqlite3_open (db->priv->filename, &db->priv->sqlite);
+	if (rc != SQLITE_OK) {
+		ret = FALSE;
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "Can't open yumdb database %s: %s",
+			     db->priv->filename,
+			     sqlite3_errmsg (db->priv->sqlite));
+		goto out;
+	}
+
+	/* sync less often than the default, but still enough that a
+	 * power cut cannot corrupt the database */
+	sqlite3_exec (db->priv->sqlite,
+		      "PRAGMA synchronous=NORMAL",
+		      NULL, NULL, NULL);
+
+	/* check table, creating it and importing any existing data in
+	 * the same transaction so a failed import gets retried */
+	rc = sqlite3_exec (db->priv->sqlite,
+			   "SELECT * FROM yumdb LIMIT 1",
+			   NULL, NULL, &error_msg);
+	if (rc != SQLITE_OK) {
+		g_debug ("creating table to repair: %s", error_msg);
+		sqlite3_free (error_msg);
+		ret = zif_db_sqlite_exec (db, "BEGIN;", error);
+		if (!ret)
+			goto out;
+		create = TRUE;
+		ret = zif_db_sqlite_exec (db,
+					  "CREATE TABLE yumdb ("
+					  "pkgid TEXT,"
+					  "name TEXT,"
+					  "version TEXT,"
+					  "arch TEXT,"
+					  "key TEXT,"
+					  "value TEXT,"
+					  "PRIMARY KEY (pkgid, name, version, arch, key));",
+					  error);
+		if (!ret)
+			goto out;
+	}
+
+	/* compile all the statements we're going to use just once */
+	for (i = 0; i < ZIF_DB_STMT_LAST; i++) {
+		rc = sqlite3_prepare_v2 (db->priv->sqlite,
+					 zif_db_statements[i],
+					 -1,
+					 &db->priv->stmts[i],
+					 NULL);
+		if (rc != SQLITE_OK) {
+			ret = FALSE;
+			g_set_error (error,
+				     ZIF_DB_ERROR,
+				     ZIF_DB_ERROR_FAILED,
+				     "failed to prepare statement: %s",
+				     sqlite3_errmsg (db->priv->sqlite));
+			goto out;
+		}
+	}
+
+	/* new database */
+	if (create) {
+		if (g_file_test (db->priv->root, G_FILE_TEST_IS_DIR)) {
+			ret = zif_db_sqlite_import (db, error);
+			if (!ret)
+				goto out;
+		}
+		ret = zif_db_sqlite_exec (db, "COMMIT;", error);
+		if (!ret)
+			goto out;
+		create = FALSE;
+	}
+out:
+	if (!ret && db->priv->sqlite != NULL) {
+		if (create)
+			sqlite3_exec (db->priv->sqlite, "ROLLBACK;", NULL, NULL, NULL);
+		zif_db_sqlite_close (db);
+	}
+	return ret;
+}
+
+/**
+ * zif_db_set_root:
+ * @db: A #ZifDb
+ * @root: A system wide db root, e.g. "/var/lib/yum/yumdb", or %NULL to use the default.
+ * @error: A #GError, or %NULL
+ *
+ * Sets the path to use as the system wide db directory.
+ *
+ * If the "yumdb_backend" config key is set to "sqlite" then the values
+ * are stored in the database file set by "yumdb_sqlite" instead, and
+ * the directory is only written if "yumdb_export" is set.
+ *
+ * Return value: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.1.3
+ **/
+gboolean
+zif_db_set_root (ZifDb *db, const gchar *root, GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *backend = NULL;
+	gchar *root_tmp = NULL;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
+	g_return_val_if_fail (db->priv->root == NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* get from config if not specified */
+	if (root == NULL) {
+		root_tmp = zif_config_get_string (db->priv->config,
+						  "yumdb", error);
+		if (root_tmp == NULL)
+			goto out;
+	} else {
+		root_tmp = g_strdup (root);
+	}
+
+	/* get the backend, defaulting to the yum-compatible one */
+	backend = zif_config_get_string (db->priv->config,
+					 "yumdb_backend", NULL);
+	if (backend == NULL || g_strcmp0 (backend, "directory") == 0) {
+		db->priv->backend = ZIF_DB_BACKEND_DIRECTORY;
+	} else if (g_strcmp0 (backend, "sqlite") == 0) {
+		db->priv->backend = ZIF_DB_BACKEND_SQLITE;
+		db->priv->export_directory = zif_config_get_boolean (db->priv->config,
+								     "yumdb_export",
+								     NULL);
+		g_free (db->priv->filename);
+		db->priv->filename = zif_config_get_string (db->priv->config,
+							    "yumdb_sqlite",
+							    error);
+		if (db->priv->filename == NULL)
+			goto out;
+	} else {
+		g_set_error (error,
+			     ZIF_DB_ERROR,
+			     ZIF_DB_ERROR_FAILED,
+			     "yumdb backend %s not supported",
+			     backend);
+		goto out;
+	}
+
+	/* check file exists */
+	if (db->priv->backend == ZIF_DB_BACKEND_DIRECTORY ||
+	    db->priv->export_directory) {
+		ret = g_file_test (root_tmp, G_FILE_TEST_IS_DIR);
+		if (!ret) {
+			g_set_error (error,
+				     ZIF_DB_ERROR,
+				     ZIF_DB_ERROR_FAILED,
+				     "db root %s does not exist",
+				     root_tmp);
+			goto out;
+		}
+	}
+	db->priv->root = root_tmp;
+	root_tmp = NULL;
+
+	/* open the database */
+	if (db->priv->backend == ZIF_DB_BACKEND_SQLITE) {
+		ret = zif_db_sqlite_open (db, error);
+		if (!ret) {
+			g_free (db->priv->root);
+			db->priv->root = NULL;
+			goto out;
+		}
+	}
+
+	/* success */
+	ret = TRUE;
+out:
+	g_free (backend);
+	g_free (root_tmp);
+	return ret;
+}
+
+/**
+ * zif_db_export_write:
+ **/
+static void
+zif_db_export_write (ZifDb *db,
+		     ZifPackage *package,
+		     const gchar *key,
+		     const gchar *value)
+{
+	gboolean ret;
+	GError *error_local = NULL;
+
+	/* the database is authoritative, so just warn */
+	if (key == NULL) {
+		ret = zif_db_directory_remove_all (db, package, &error_local);
+	} else if (value == NULL) {
+		ret = zif_db_directory_remove (db, package, key, &error_local);
+	} else {
+		ret = zif_db_directory_set_string (db, package, key, value, &error_local);
+	}
+	if (!ret) {
+		g_warning ("failed to export %s to %s: %s",
+			   zif_package_get_printable (package),
+			   db->priv->root,
+			   error_local->message);
+		g_error_free (error_local);
+	}
+}
+
+/**
+ * zif_db_export_add:
+ **/
+static void
+zif_db_export_add (ZifDb *db,
+		   ZifPackage *package,
+		   const gchar *key,
+		   const gchar *value)
+{
+	ZifDbExport *export;
+
+	/* write these when the batch is committed */
+	if (db->priv->in_batch) {
+		export = g_new0 (ZifDbExport, 1);
+		export->package = g_object_ref (package);
+		export->key = g_strdup (key);
+		export->value = g_strdup (value);
+		g_ptr_array_add (db->priv->batch_export, export);
+		return;
+	}
+	zif_db_export_write (db, package, key, value);
+}
+
+/**
+ * zif_db_get_string:
+ * @db: A #ZifDb
+ * @package: A package to use as a reference
+ * @key: A key name to retrieve, e.g. "releasever"
+ * @error: A #GError, or %NULL
+ *
+ * Gets a string value from the yumdb 'database'.
+ *
+ * Return value: An allocated value, or %NULL
+ *
+ * Since: 0.1.3
+ **/
+gchar *
+zif_db_get_string (ZifDb *db, ZifPackage *package, const gchar *key, GError **error)
+{
+	gboolean ret;
+	gchar *value = NULL;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), NULL);
+	g_return_val_if_fail (ZIF_IS_PACKAGE (package), NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* not loaded yet */
+	if (db->priv->root == NULL) {
+		ret = zif_db_set_root (db, NULL, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* get value */
+	if (db->priv->backend == ZIF_DB_BACKEND_SQLITE)
+		value = zif_db_sqlite_get_string (db, package, key, error);
+	else
+		value = zif_db_directory_get_string (db, package, key, error);
+out:
+	return value;
+}
+
+/**
+ * zif_db_get_keys:
+ * @db: A #ZifDb
+ * @package: A package to use as a reference
+ * @error: A #GError, or %NULL
+ *
+ * Gets all the keys for a given package.
+ *
+ * Return value: (element-type utf8) (transfer full): An allocated value, or %NULL
+ *
+ * Since: 0.1.3
+ **/
+GPtrArray *
+zif_db_get_keys (ZifDb *db, ZifPackage *package, GError **error)
+{
+	gboolean ret;
+	GPtrArray *array = NULL;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), NULL);
+	g_return_val_if_fail (ZIF_IS_PACKAGE (package), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* not loaded yet */
+	if (db->priv->root == NULL) {
+		ret = zif_db_set_root (db, NULL, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* get keys */
+	if (db->priv->backend == ZIF_DB_BACKEND_SQLITE)
+		array = zif_db_sqlite_get_keys (db, package, error);
+	else
+		array = zif_db_directory_get_keys (db, package, error);
+out:
+	return array;
+}
+
+/**
+ * zif_db_set_string:
+ * @db: A #ZifDb
+ * @package: A package to use as a reference
+ * @key: Key name to save, e.g. "reason"
+ * @value: Key data to save, e.g. "dep"
+ * @error: A #GError, or %NULL
+ *
+ * Writes a data value to the yumdb 'database'.
+ *
+ * Return value: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.1.3
+ **/
+gboolean
+zif_db_set_string (ZifDb *db, ZifPackage *package, const gchar *key, const gchar *value, GError **error)
+{
+	gboolean ret = TRUE;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
+	g_return_val_if_fail (ZIF_IS_PACKAGE (package), FALSE);
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (value != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* not loaded yet */
+	if (db->priv->root == NULL) {
+		ret = zif_db_set_root (db, NULL, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* directory */
+	if (db->priv->backend == ZIF_DB_BACKEND_DIRECTORY) {
+		ret = zif_db_directory_set_string (db, package, key, value, error);
+		goto out;
+	}
+
+	/* database */
+	ret = zif_db_sqlite_set_string (db, package, key, value, error);
+	if (!ret)
+		goto out;
+	if (db->priv->export_directory)
+		zif_db_export_add (db, package, key, value);
+out:
+	return ret;
+}
+
+/**
+ * zif_db_get_packages:
+ * @db: A #ZifDb
+ * @error: A #GError, or %NULL
+ *
+ * Gets all the packages in the yumdb 'database'.
+ *
+ * Return value: (element-type ZifPackage) (transfer container): An array of #ZifPackage's
+ *
+ * Since: 0.1.3
+ **/
+GPtrArray *
+zif_db_get_packages (ZifDb *db, GError **error)
+{
+	gboolean ret;
+	GPtrArray *array = NULL;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* not loaded yet */
+	if (db->priv->root == NULL) {
+		ret = zif_db_set_root (db, NULL, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* get packages */
+	if (db->priv->backend == ZIF_DB_BACKEND_SQLITE)
+		array = zif_db_sqlite_get_packages (db, error);
+	else
+		array = zif_db_directory_get_packages (db, error);
+out:
+	return array;
+}
+
+/**
+ * zif_db_remove:
+ * @db: A #ZifDb
+ * @package: A package to use as a reference
+ * @key: Key name to delete, e.g. "reason"
+ * @error: A #GError, or %NULL
+ *
+ * Removes a data value from the yumdb 'database' for a given package.
+ *
+ * Return value: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.1.3
+ **/
+gboolean
+zif_db_remove (ZifDb *db, ZifPackage *package,
+	       const gchar *key, GError **error)
+{
+	gboolean ret = TRUE;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
+	g_return_val_if_fail (ZIF_IS_PACKAGE (package), FALSE);
+	g_return_val_if_fail (key != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* not loaded yet */
+	if (db->priv->root == NULL) {
+		ret = zif_db_set_root (db, NULL, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* directory */
+	if (db->priv->backend == ZIF_DB_BACKEND_DIRECTORY) {
+		ret = zif_db_directory_remove (db, package, key, error);
+		goto out;
+	}
+
+	/* database */
+	ret = zif_db_sqlite_remove (db, package, key, error);
+	if (!ret)
+		goto out;
+	if (db->priv->export_directory)
+		zif_db_export_add (db, package, key, NULL);
+out:
+	return ret;
+}
+
+/**
+ * zif_db_remove_all:
+ * @db: A #ZifDb
+ * @package: A package to use as a reference
+ * @error: A #GError, or %NULL
+ *
+ * Removes a all data value from the yumdb 'database' for a given package.
+ *
+ * Return value: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.1.3
+ **/
+gboolean
+zif_db_remove_all (ZifDb *db, ZifPackage *package, GError **error)
+{
+	gboolean ret = TRUE;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
+	g_return_val_if_fail (ZIF_IS_PACKAGE (package), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* not loaded yet */
+	if (db->priv->root == NULL) {
+		ret = zif_db_set_root (db, NULL, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* directory */
+	if (db->priv->backend == ZIF_DB_BACKEND_DIRECTORY) {
+		ret = zif_db_directory_remove_all (db, package, error);
+		goto out;
+	}
+
+	/* database */
+	ret = zif_db_sqlite_remove_all (db, package, error);
+	if (!ret)
+		goto out;
+	if (db->priv->export_directory)
+		zif_db_export_add (db, package, NULL, NULL);
+out:
+	return ret;
+}
+
+/**
+ * zif_db_batch_clear:
+ **/
+static void
+zif_db_batch_clear (ZifDb *db)
+{
+	db->priv->in_batch = FALSE;
+	g_hash_table_remove_all (db->priv->batch_dirs);
+	g_ptr_array_set_size (db->priv->batch_export, 0);
+}
+
+/**
+ * zif_db_begin:
+ * @db: A #ZifDb
+ * @error: A #GError, or %NULL
+ *
+ * Starts a batch of changes, which is finished using zif_db_commit()
+ * or zif_db_rollback().
+ *
+ * When using the sqlite backend all the changes are written in one
+ * transaction. The directory backend writes each value as it is set
+ * but only creates each package directory once.
+ *
+ * Return value: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_db_begin (ZifDb *db, GError **error)
+{
+	gboolean ret = TRUE;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* not loaded yet */
+	if (db->priv->root == NULL) {
+		ret = zif_db_set_root (db, NULL, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* only one at a time */
+	if (db->priv->in_batch) {
+		ret = FALSE;
+		g_set_error_literal (error,
+				     ZIF_DB_ERROR,
+				     ZIF_DB_ERROR_FAILED,
+				     "already in a batch");
+		goto out;
+	}
+
+	/* start transaction */
+	if (db->priv->backend == ZIF_DB_BACKEND_SQLITE) {
+		ret = zif_db_sqlite_exec (db, "BEGIN;", error);
+		if (!ret)
+			goto out;
+	}
+	db->priv->in_batch = TRUE;
+out:
+	return ret;
+}
+
+/**
+ * zif_db_commit:
+ * @db: A #ZifDb
+ * @error: A #GError, or %NULL
+ *
+ * Finishes a batch of changes started with zif_db_begin(), and then
+ * writes the yum-compatible directory if "yumdb_export" is set.
+ *
+ * Return value: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_db_commit (ZifDb *db, GError **error)
+{
+	gboolean ret = TRUE;
+	guint i;
+	ZifDbExport *export;
+
+	g_return_val_if_fail (ZIF_IS_DB (db), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* not started */
+	if (!db->priv->in_batch) {
+		ret = FALSE;
+		g_set_error_literal (error,
+				     ZIF_DB_ERROR,
+				     ZIF_DB_ERROR_FAILED,
+				     "not in a batch");
+		goto out;
+	}
+
+	/* directory */
+	if (db->priv->backend == ZIF_DB_BACKEND_DIRECTORY) {
+		zif_db_batch_clear (db);
+		goto out;
+	}
+
+	/* finish transaction */
+	ret = zif_db_sqlite_exec (db, "COMMIT;", error);
+	if (!ret) {
+		zif_db_rollback (db);
+		goto out;
+	}
+
+	/* export the changes in the same order, while still in the
+	 * batch so each directory is only created once */
+	for (i = 0; i < db->priv->batch_export->len; i++) {
+		export = g_ptr_array_index (db->priv->batch_export, i);
+		zif_db_export_write (db,
+				     export->package,
+				     export->key,
+				     export->value);
+	}
+	zif_db_batch_clear (db);
+out:
+	return ret;
+}
+
+/**
+ * zif_db_rollback:
+ * @db: A #ZifDb
+ *
+ * Abandons a batch of changes started with zif_db_begin().
+ *
+ * Values already written by the directory backend are not removed.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_db_rollback (ZifDb *db)
+{
+	g_return_if_fail (ZIF_IS_DB (db));
+
+	/* not started */
+	if (!db->priv->in_batch)
+		return;
+
+	/* abandon transaction */
+	if (db->priv->backend == ZIF_DB_BACKEND_SQLITE)
+		sqlite3_exec (db->priv->sqlite, "ROLLBACK;", NULL, NULL, NULL);
+	zif_db_batch_clear (db);
+}
+
 /**
  * zif_db_finalize:
  **/
@@ -639,7 +1560,12 @@ zif_db_finalize (GObject *object)
 	g_return_if_fail (ZIF_IS_DB (object));
 	db = ZIF_DB (object);
 
+	zif_db_rollback (db);
+	zif_db_sqlite_close (db);
 	g_free (db->priv->root);
+	g_free (db->priv->filename);
+	g_hash_table_unref (db->priv->batch_dirs);
+	g_ptr_array_unref (db->priv->batch_export);
 	g_object_unref (db->priv->config);
 
 	G_OBJECT_CLASS (zif_db_parent_class)->finalize (object);
@@ -664,6 +1590,12 @@ zif_db_init (ZifDb *db)
 {
 	db->priv = ZIF_DB_GET_PRIVATE (db);
 	db->priv->config = zif_config_new ();
+	db->priv->backend = ZIF_DB_BACKEND_DIRECTORY;
+	db->priv->batch_dirs = g_hash_table_new_full (g_str_hash,
+						      g_str_equal,
+						      g_free,
+						      NULL);
+	db->priv->batch_export = g_ptr_array_new_with_free_func ((GDestroyNotify) zif_db_export_free);
 }
 
 /**
@@ -94,6 +94,11 @@ gboolean	 zif_db_remove			(ZifDb		*db,
 gboolean	 zif_db_remove_all		(ZifDb		*db,
 						 ZifPackage	*package,
 						 GError		**error);
+gboolean	 zif_db_begin			(ZifDb		*db,
+						 GError		**error);
+gboolean	 zif_db_commit			(ZifDb		*db,
+						 GError		**error);
+void		 zif_db_rollback		(ZifDb		*db);
 
 G_END_DECLS
 
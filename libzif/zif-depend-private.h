@@ -31,9 +31,20 @@
 
 #include "zif-depend.h"
 #include "zif-string.h"
+#include "zif-utils-private.h"
 
 G_BEGIN_DECLS
 
+/* a depend without the GObject overhead, for storing in packages */
+typedef struct {
+	ZifString		*name;		/* interned */
+	guint8			 flag;
+	ZifEvr			*version;	/* interned, or NULL for none */
+} ZifDependEntry;
+
+#define zif_depend_entry_get_name(entry)	(zif_string_get_value ((entry)->name))
+#define zif_depend_entry_get_version(entry)	((entry)->version != NULL ? (entry)->version->value : NULL)
+
 ZifDepend		*zif_depend_new_from_data	(const gchar		**keys,
 							 const gchar		**values);
 ZifDepend		*zif_depend_new_from_data_full	(const gchar		**keys,
@@ -49,6 +60,21 @@ void			 zif_depend_set_name_str	(ZifDepend		*depend,
 							 ZifString		*name);
 void			 zif_depend_set_version_str	(ZifDepend		*depend,
 							 ZifString		*version);
+ZifString		*zif_depend_get_name_str	(ZifDepend		*depend);
+const ZifEvr		*zif_depend_get_evr		(ZifDepend		*depend);
+ZifDepend		*zif_depend_new_from_entry	(const ZifDependEntry	*entry);
+void			 zif_depend_entry_init		(ZifDependEntry		*entry,
+							 const gchar		*name,
+							 ZifDependFlag		 flag,
+							 const gchar		*version);
+void			 zif_depend_entry_init_from_depend (ZifDependEntry	*entry,
+							 ZifDepend		*depend);
+void			 zif_depend_entry_copy		(ZifDependEntry		*dest,
+							 const ZifDependEntry	*src);
+void			 zif_depend_entry_clear		(ZifDependEntry		*entry);
+GArray			*zif_depend_entry_array_new	(guint			 reserved_size);
+gboolean		 zif_depend_entry_satisfies	(const ZifDependEntry	*got,
+							 ZifDepend		*need);
 
 G_END_DECLS
 
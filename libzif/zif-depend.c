@@ -36,6 +36,7 @@
 #include "zif-depend-private.h"
 #include "zif-utils.h"
 #include "zif-string.h"
+#include "zif-string-private.h"
 
 #define ZIF_DEPEND_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ZIF_TYPE_DEPEND, ZifDependPrivate))
 
@@ -46,6 +47,7 @@ struct _ZifDependPrivate
 	ZifString		*version;
 	gchar			*description;
 	gboolean		 description_ok;
+	ZifEvr			*evr;
 };
 
 enum {
@@ -77,127 +79,295 @@ zif_depend_compare (ZifDepend *a, ZifDepend *b)
 	g_return_val_if_fail (b != NULL, G_MAXINT);
 
 	/* fall back to comparing the evr */
-	return zif_compare_evr (zif_depend_get_version (a),
-				zif_depend_get_version (b));
+	return zif_evr_compare (zif_depend_get_evr (a),
+				zif_depend_get_evr (b),
+				ZIF_PACKAGE_COMPARE_MODE_VERSION);
 }
 
 /**
- * zif_depend_satisfies:
- * @got: The #ZifDepend we've got
- * @need: The #ZifDepend we need
- *
- * Returns if the dependency will be satisfied with what we've got.
+ * zif_depend_satisfies_version:
  *
- * Return value: %TRUE if okay, %FALSE otherwise
- *
- * Since: 0.1.3
+ * Checks if the version we've got is good enough, where the names are
+ * already known to match.
  **/
-gboolean
-zif_depend_satisfies (ZifDepend *got, ZifDepend *need)
+static gboolean
+zif_depend_satisfies_version (const gchar *name,
+			      ZifDependFlag flag_got,
+			      const ZifEvr *evr_got,
+			      ZifDependFlag flag_need,
+			      const ZifEvr *evr_need)
 {
-	gboolean ret = FALSE;
-	ZifDependFlag flag_got;
-	ZifDependFlag flag_need;
-	const gchar *name_got = zif_string_get_value (got->priv->name);
-	const gchar *name_need = zif_string_get_value (need->priv->name);
-	const gchar *version_got;
-	const gchar *version_need;
-
-	/* check the first character rather than setting up the SSE2
-	 * version of strcmp which is slow to tear down */
-	if (name_got[0] != name_need[0])
-		goto out;
-
-	/* name does not match */
-	ret = (g_strcmp0 (name_got, name_need) == 0);
-	if (!ret)
-		goto out;
-
-	/* get cached values of the flags */
-	flag_got = got->priv->flag;
-	flag_need = need->priv->flag;
 	g_return_val_if_fail (flag_got != ZIF_DEPEND_FLAG_UNKNOWN, FALSE);
 	g_return_val_if_fail (flag_need != ZIF_DEPEND_FLAG_UNKNOWN, FALSE);
 
 	/* 'Requires: hal' or 'Obsoletes: hal' - not any particular version */
 	if (flag_need == ZIF_DEPEND_FLAG_ANY ||
-	    flag_got == ZIF_DEPEND_FLAG_ANY) {
-		ret = TRUE;
-		goto out;
-	}
-
-	/* get cached values of the versions */
-	version_got = zif_depend_get_version (got);
-	version_need = zif_depend_get_version (need);
+	    flag_got == ZIF_DEPEND_FLAG_ANY)
+		return TRUE;
 
 	/* 'Requires: hal = 0.5.8' - both equal */
 	if (flag_got == ZIF_DEPEND_FLAG_EQUAL &&
-	    flag_need == ZIF_DEPEND_FLAG_EQUAL) {
-		ret = (zif_compare_evr (version_got, version_need) == 0);
-		goto out;
-	}
+	    flag_need == ZIF_DEPEND_FLAG_EQUAL)
+		return zif_evr_compare (evr_got, evr_need, ZIF_PACKAGE_COMPARE_MODE_VERSION) == 0;
 
 	/* 'Requires: hal > 0.5.7' - greater */
-	if (flag_need == ZIF_DEPEND_FLAG_GREATER) {
-		ret = (zif_compare_evr (version_got, version_need) > 0);
-		goto out;
-	}
+	if (flag_need == ZIF_DEPEND_FLAG_GREATER)
+		return zif_evr_compare (evr_got, evr_need, ZIF_PACKAGE_COMPARE_MODE_VERSION) > 0;
 
 	/* 'Requires: hal < 0.5.7' - less */
-	if (flag_need == ZIF_DEPEND_FLAG_LESS) {
-		ret = (zif_compare_evr (version_got, version_need) < 0);
-		goto out;
-	}
+	if (flag_need == ZIF_DEPEND_FLAG_LESS)
+		return zif_evr_compare (evr_got, evr_need, ZIF_PACKAGE_COMPARE_MODE_VERSION) < 0;
 
 	/* 'Requires: hal >= 0.5.7' - greater */
-	if (flag_need == (ZIF_DEPEND_FLAG_GREATER | ZIF_DEPEND_FLAG_EQUAL)) {
-		ret = (zif_compare_evr (version_got, version_need) >= 0);
-		goto out;
-	}
+	if (flag_need == (ZIF_DEPEND_FLAG_GREATER | ZIF_DEPEND_FLAG_EQUAL))
+		return zif_evr_compare (evr_got, evr_need, ZIF_PACKAGE_COMPARE_MODE_VERSION) >= 0;
 
 	/* 'Requires: hal <= 0.5.7' - less */
-	if (flag_need == (ZIF_DEPEND_FLAG_LESS | ZIF_DEPEND_FLAG_EQUAL)) {
-		ret = (zif_compare_evr (version_got, version_need) <= 0);
-		goto out;
-	}
+	if (flag_need == (ZIF_DEPEND_FLAG_LESS | ZIF_DEPEND_FLAG_EQUAL))
+		return zif_evr_compare (evr_got, evr_need, ZIF_PACKAGE_COMPARE_MODE_VERSION) <= 0;
 
 	/* got: bash >= 0.2.0, need: bash = 0.3.0' - only valid when versions are equal */
 	if (flag_got == (ZIF_DEPEND_FLAG_GREATER | ZIF_DEPEND_FLAG_EQUAL) &&
-	    flag_need == ZIF_DEPEND_FLAG_EQUAL) {
-		ret = (zif_compare_evr (version_got, version_need) <= 0);
-		goto out;
-	}
+	    flag_need == ZIF_DEPEND_FLAG_EQUAL)
+		return zif_evr_compare (evr_got, evr_need, ZIF_PACKAGE_COMPARE_MODE_VERSION) <= 0;
 
 	/* got: bash >= 0.2.0, need: bash = 0.3.0' - only valid when versions are equal */
 	if (flag_got == (ZIF_DEPEND_FLAG_LESS | ZIF_DEPEND_FLAG_EQUAL) &&
-	    flag_need == ZIF_DEPEND_FLAG_EQUAL) {
-		ret = (zif_compare_evr (version_got, version_need) >= 0);
-		goto out;
-	}
+	    flag_need == ZIF_DEPEND_FLAG_EQUAL)
+		return zif_evr_compare (evr_got, evr_need, ZIF_PACKAGE_COMPARE_MODE_VERSION) >= 0;
 
 	/* got: bash < 0.2.0, need: bash = 0.3.0' - never valid */
 	if (flag_got == ZIF_DEPEND_FLAG_LESS &&
-	    flag_need == ZIF_DEPEND_FLAG_EQUAL) {
-		ret = FALSE;
-		goto out;
-	}
+	    flag_need == ZIF_DEPEND_FLAG_EQUAL)
+		return FALSE;
 
 	/* got: bash > 0.2.0, need: bash = 0.3.0' - never valid */
 	if (flag_got == ZIF_DEPEND_FLAG_GREATER &&
-	    flag_need == ZIF_DEPEND_FLAG_EQUAL) {
-		ret = FALSE;
-		goto out;
-	}
+	    flag_need == ZIF_DEPEND_FLAG_EQUAL)
+		return FALSE;
 
 	/* not sure */
-	ret = FALSE;
-	g_warning ("not sure how to compare %s and %s for %s:%s",
+	g_warning ("not sure how to compare %s and %s for [%s %s %s]:[%s %s %s]",
 		   zif_depend_flag_to_string (flag_got),
 		   zif_depend_flag_to_string (flag_need),
-		   zif_depend_get_description (got),
-		   zif_depend_get_description (need));
-out:
-	return ret;
+		   name, zif_depend_flag_to_string (flag_got),
+		   evr_got != NULL ? evr_got->value : "",
+		   name, zif_depend_flag_to_string (flag_need),
+		   evr_need != NULL ? evr_need->value : "");
+	return FALSE;
+}
+
+/**
+ * zif_depend_satisfies:
+ * @got: The #ZifDepend we've got
+ * @need: The #ZifDepend we need
+ *
+ * Returns if the dependency will be satisfied with what we've got.
+ *
+ * Return value: %TRUE if okay, %FALSE otherwise
+ *
+ * Since: 0.1.3
+ **/
+gboolean
+zif_depend_satisfies (ZifDepend *got, ZifDepend *need)
+{
+	/* the names are always interned, so they are the same string
+	 * if and only if they have the same pointer */
+	if (got->priv->name != need->priv->name)
+		return FALSE;
+
+	return zif_depend_satisfies_version (zif_string_get_value (got->priv->name),
+					     got->priv->flag,
+					     zif_depend_get_evr (got),
+					     need->priv->flag,
+					     zif_depend_get_evr (need));
+}
+
+/**
+ * zif_depend_entry_init:
+ * @entry: A #ZifDependEntry
+ * @name: The depend name
+ * @flag: The depend flag
+ * @version: The depend version, or %NULL
+ *
+ * Sets up a compact depend. The strings are interned, so the name can
+ * be compared with a single pointer comparison. Free the strings using
+ * zif_depend_entry_clear().
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_depend_entry_init (ZifDependEntry *entry,
+		       const gchar *name,
+		       ZifDependFlag flag,
+		       const gchar *version)
+{
+	entry->name = zif_string_new_intern (name);
+	entry->version = version != NULL ? zif_evr_intern (version) : NULL;
+	entry->flag = flag;
+}
+
+/**
+ * zif_depend_entry_init_from_depend:
+ * @entry: A #ZifDependEntry
+ * @depend: A #ZifDepend
+ *
+ * Sets up a compact depend from a #ZifDepend.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_depend_entry_init_from_depend (ZifDependEntry *entry, ZifDepend *depend)
+{
+	entry->name = zif_string_ref (depend->priv->name);
+	entry->version = NULL;
+	if (zif_depend_get_evr (depend) != NULL)
+		entry->version = zif_evr_ref (depend->priv->evr);
+	entry->flag = depend->priv->flag;
+}
+
+/**
+ * zif_depend_entry_copy:
+ * @dest: An uninitialized #ZifDependEntry
+ * @src: A #ZifDependEntry
+ *
+ * Copies a compact depend, sharing the strings.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_depend_entry_copy (ZifDependEntry *dest, const ZifDependEntry *src)
+{
+	dest->name = zif_string_ref (src->name);
+	dest->version = src->version != NULL ? zif_evr_ref (src->version) : NULL;
+	dest->flag = src->flag;
+}
+
+/**
+ * zif_depend_entry_clear:
+ * @entry: A #ZifDependEntry
+ *
+ * Frees the strings used by a compact depend.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_depend_entry_clear (ZifDependEntry *entry)
+{
+	if (entry->name != NULL)
+		zif_string_unref (entry->name);
+	if (entry->version != NULL)
+		zif_evr_unref (entry->version);
+	entry->name = NULL;
+	entry->version = NULL;
+}
+
+/**
+ * zif_depend_entry_array_new:
+ * @reserved_size: The number of depends to allocate space for
+ *
+ * Creates an array of #ZifDependEntry that frees the strings of each
+ * depend when it is removed.
+ *
+ * Return value: (element-type ZifDependEntry) (transfer full): A new array
+ *
+ * Since: 0.3.7
+ **/
+GArray *
+zif_depend_entry_array_new (guint reserved_size)
+{
+	GArray *array;
+	array = g_array_sized_new (FALSE, FALSE,
+				   sizeof (ZifDependEntry),
+				   reserved_size);
+	g_array_set_clear_func (array, (GDestroyNotify) zif_depend_entry_clear);
+	return array;
+}
+
+/**
+ * zif_depend_entry_satisfies:
+ * @got: The #ZifDependEntry we've got
+ * @need: The #ZifDepend we need
+ *
+ * Returns if the dependency will be satisfied with what we've got.
+ * The caller must have already checked the names are the same.
+ *
+ * Return value: %TRUE if okay, %FALSE otherwise
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_depend_entry_satisfies (const ZifDependEntry *got, ZifDepend *need)
+{
+	return zif_depend_satisfies_version (zif_depend_entry_get_name (got),
+					     got->flag,
+					     got->version,
+					     need->priv->flag,
+					     zif_depend_get_evr (need));
+}
+
+/**
+ * zif_depend_new_from_entry:
+ * @entry: A #ZifDependEntry
+ *
+ * Creates a #ZifDepend for code that needs an object, sharing the
+ * interned name and version of the entry.
+ *
+ * Return value: A new #ZifDepend instance
+ *
+ * Since: 0.3.7
+ **/
+ZifDepend *
+zif_depend_new_from_entry (const ZifDependEntry *entry)
+{
+	ZifDepend *depend;
+
+	depend = zif_depend_new ();
+	depend->priv->flag = entry->flag;
+	depend->priv->name = zif_string_ref (entry->name);
+	if (entry->version != NULL) {
+		depend->priv->version = zif_string_ref (entry->version->string);
+		depend->priv->evr = zif_evr_ref (entry->version);
+	}
+	return depend;
+}
+
+/**
+ * zif_depend_get_name_str:
+ * @depend: A #ZifDepend
+ *
+ * Gets the interned name of the depend, which is the same pointer as
+ * the name of any other depend or #ZifDependEntry with this name.
+ *
+ * Return value: The name, or %NULL if not set
+ *
+ * Since: 0.3.7
+ **/
+ZifString *
+zif_depend_get_name_str (ZifDepend *depend)
+{
+	return depend->priv->name;
+}
+
+/**
+ * zif_depend_get_evr:
+ * @depend: A #ZifDepend
+ *
+ * Gets the split version of the depend, which is only done once as
+ * the same depend is normally checked against many packages.
+ *
+ * Return value: The version, or %NULL if the depend is not versioned
+ *
+ * Since: 0.3.7
+ **/
+const ZifEvr *
+zif_depend_get_evr (ZifDepend *depend)
+{
+	if (depend->priv->evr == NULL && depend->priv->version != NULL) {
+		depend->priv->evr =
+			zif_evr_intern (zif_string_get_value (depend->priv->version));
+	}
+	return depend->priv->evr;
 }
 
 /**
@@ -371,7 +541,8 @@ zif_depend_set_name (ZifDepend *depend, const gchar *name)
 	g_return_if_fail (name != NULL);
 	g_return_if_fail (depend->priv->name == NULL);
 
-	depend->priv->name = zif_string_new (name);
+	/* depend names are repeated in many packages */
+	depend->priv->name = zif_string_new_intern (name);
 	depend->priv->description_ok = FALSE;
 }
 
@@ -380,7 +551,7 @@ zif_depend_set_name (ZifDepend *depend, const gchar *name)
  * @depend: A #ZifDepend
  * @name: The depend name
  *
- * Sets the depend name.
+ * Sets the depend name, interning it if required.
  *
  * Since: 0.1.3
  **/
@@ -391,7 +562,10 @@ zif_depend_set_name_str (ZifDepend *depend, ZifString *name)
 	g_return_if_fail (name != NULL);
 	g_return_if_fail (depend->priv->name == NULL);
 
-	depend->priv->name = zif_string_ref (name);
+	if (zif_string_is_interned (name))
+		depend->priv->name = zif_string_ref (name);
+	else
+		depend->priv->name = zif_string_new_intern (zif_string_get_value (name));
 	depend->priv->description_ok = FALSE;
 }
 
@@ -741,6 +915,8 @@ zif_depend_finalize (GObject *object)
 		zif_string_unref (depend->priv->name);
 	if (depend->priv->version != NULL)
 		zif_string_unref (depend->priv->version);
+	if (depend->priv->evr != NULL)
+		zif_evr_unref (depend->priv->evr);
 	g_free (depend->priv->description);
 
 	G_OBJECT_CLASS (zif_depend_parent_class)->finalize (object);
@@ -57,6 +57,7 @@ struct _ZifDownloadPrivate
 	GPtrArray		*array;
 	SoupSession		*session;
 	ZifConfig		*config;
+	GMutex			 mutex;		/* for array and session */
 };
 
 typedef struct {
@@ -66,7 +67,14 @@ typedef struct {
 	guint			 slow_server_speed;
 	guint			 slow_updates_cnt;
 	goffset			 last_body_length;
+	goffset			 offset;
+	goffset			 received;
+	gboolean		 wrong_range;
 	SoupMessage		*msg;
+	GFile			*file_part;
+	GOutputStream		*stream;
+	GChecksum		*checksum;
+	GError			*error;
 	ZifDownload		*download;
 	ZifState		*state;
 } ZifDownloadFlight;
@@ -130,15 +138,38 @@ zif_download_file_got_chunk_cb (SoupMessage *msg, SoupBuffer *chunk,
 	}
 
 	/* if it's returning "Found" or an error, ignore the percentage */
-	if (msg->status_code != SOUP_STATUS_OK) {
+	if (msg->status_code != SOUP_STATUS_OK &&
+	    msg->status_code != SOUP_STATUS_PARTIAL_CONTENT) {
 		g_debug ("ignoring status code %i (%s)",
 			 msg->status_code, msg->reason_phrase);
 		goto out;
 	}
 
-	/* get data */
-	body_length = msg->response_body->length;
-	header_size = soup_message_headers_get_content_length (msg->response_headers);
+	/* save to disk rather than keeping it all in memory */
+	if (flight->stream != NULL) {
+		ret = g_output_stream_write_all (flight->stream,
+						 chunk->data,
+						 chunk->length,
+						 NULL,
+						 cancellable,
+						 &flight->error);
+		if (!ret) {
+			soup_session_cancel_message (flight->download->priv->session,
+						     msg,
+						     SOUP_STATUS_IO_ERROR);
+			goto out;
+		}
+		if (flight->checksum != NULL) {
+			g_checksum_update (flight->checksum,
+					   (const guchar *) chunk->data,
+					   chunk->length);
+		}
+	}
+	flight->received += chunk->length;
+
+	/* get data, including what we had already */
+	body_length = flight->offset + flight->received;
+	header_size = flight->offset + soup_message_headers_get_content_length (msg->response_headers);
 
 	/* size is not known */
 	if (header_size < body_length)
@@ -188,6 +219,131 @@ out:
 	return;
 }
 
+/**
+ * zif_download_file_open_stream:
+ *
+ * Opens the partial file, either appending to what is already there
+ * or starting again from zero.
+ **/
+static gboolean
+zif_download_file_open_stream (ZifDownloadFlight *flight,
+			       gboolean append,
+			       GCancellable *cancellable,
+			       GError **error)
+{
+	GFileOutputStream *stream;
+
+	if (flight->stream != NULL) {
+		g_object_unref (flight->stream);
+		flight->stream = NULL;
+	}
+	if (append) {
+		stream = g_file_append_to (flight->file_part,
+					   G_FILE_CREATE_NONE,
+					   cancellable,
+					   error);
+	} else {
+		stream = g_file_replace (flight->file_part,
+					 NULL,
+					 FALSE,
+					 G_FILE_CREATE_NONE,
+					 cancellable,
+					 error);
+	}
+	if (stream == NULL)
+		return FALSE;
+	flight->stream = G_OUTPUT_STREAM (stream);
+	return TRUE;
+}
+
+/**
+ * zif_download_file_got_headers_cb:
+ *
+ * If we asked for a range and the server sent the whole file instead
+ * then throw away the partial data and start again. If it sent a
+ * different range then the data cannot be appended, so give up on
+ * this server.
+ **/
+static void
+zif_download_file_got_headers_cb (SoupMessage *msg, ZifDownloadFlight *flight)
+{
+	gboolean ret;
+	goffset end;
+	goffset start;
+	GCancellable *cancellable;
+
+	if (flight->offset == 0)
+		return;
+
+	if (msg->status_code == SOUP_STATUS_PARTIAL_CONTENT) {
+		ret = soup_message_headers_get_content_range (msg->response_headers,
+							      &start, &end, NULL);
+		if (ret && start == flight->offset)
+			return;
+		g_debug ("server sent the wrong range for %s", flight->uri);
+		flight->wrong_range = TRUE;
+		soup_session_cancel_message (flight->download->priv->session,
+					     msg,
+					     SOUP_STATUS_IO_ERROR);
+		return;
+	}
+	if (msg->status_code != SOUP_STATUS_OK)
+		return;
+
+	g_debug ("server ignored range request for %s, restarting",
+		 flight->uri);
+	flight->offset = 0;
+	flight->last_body_length = 0;
+	if (flight->checksum != NULL)
+		g_checksum_reset (flight->checksum);
+	cancellable = zif_state_get_cancellable (flight->state);
+	ret = zif_download_file_open_stream (flight,
+					     FALSE,
+					     cancellable,
+					     &flight->error);
+	if (!ret) {
+		soup_session_cancel_message (flight->download->priv->session,
+					     msg,
+					     SOUP_STATUS_IO_ERROR);
+	}
+}
+
+/**
+ * zif_download_file_seed_checksum:
+ *
+ * Adds the data we already have to the running checksum.
+ **/
+static gboolean
+zif_download_file_seed_checksum (GFile *file,
+				 GChecksum *checksum,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	gboolean ret = FALSE;
+	guchar buffer[32 * 1024];
+	gssize len;
+	GFileInputStream *stream;
+
+	stream = g_file_read (file, cancellable, error);
+	if (stream == NULL)
+		goto out;
+	do {
+		len = g_input_stream_read (G_INPUT_STREAM (stream),
+					   buffer,
+					   sizeof (buffer),
+					   cancellable,
+					   error);
+		if (len < 0)
+			goto out;
+		g_checksum_update (checksum, buffer, len);
+	} while (len > 0);
+	ret = TRUE;
+out:
+	if (stream != NULL)
+		g_object_unref (stream);
+	return ret;
+}
+
 /**
  * zif_download_file_finished_cb:
  **/
@@ -464,69 +620,113 @@ out:
 }
 
 /**
- * zif_download_file:
- * @download: A #ZifDownload
- * @uri: A full remote URI
- * @filename: A local filename to save to
- * @state: A #ZifState to use for progress reporting
- * @error: A #GError, or %NULL
- *
- * Downloads a file either from a remote site, or copying the file
- * from the local filesystem.
+ * zif_download_flight_free:
+ **/
+static void
+zif_download_flight_free (ZifDownloadFlight *flight)
+{
+	g_timer_destroy (flight->timer);
+	g_object_unref (flight->state);
+	g_object_unref (flight->download);
+	if (flight->msg != NULL)
+		g_object_unref (flight->msg);
+	if (flight->stream != NULL)
+		g_object_unref (flight->stream);
+	if (flight->checksum != NULL)
+		g_checksum_free (flight->checksum);
+	if (flight->error != NULL)
+		g_error_free (flight->error);
+	g_free (flight->uri);
+	g_free (flight);
+}
+
+/**
+ * zif_download_set_write_error:
+ **/
+static void
+zif_download_set_write_error (GError **error, const GError *error_local)
+{
+	ZifDownloadError download_error = ZIF_DOWNLOAD_ERROR_FAILED;
+
+	/* some errors are special */
+	if (g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED))
+		download_error = ZIF_DOWNLOAD_ERROR_PERMISSION_DENIED;
+	else if (g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_NO_SPACE))
+		download_error = ZIF_DOWNLOAD_ERROR_NO_SPACE;
+	g_set_error (error, ZIF_DOWNLOAD_ERROR, download_error,
+		     "failed to write file: %s", error_local->message);
+}
+
+/**
+ * zif_download_get_partial_filename:
  *
- * This function will return with an error if the downloaded file
- * has zero size.
+ * The partial file is hidden, but keeps the same extension so that
+ * the content type can be checked before it is moved into place.
+ **/
+static gchar *
+zif_download_get_partial_filename (const gchar *filename)
+{
+	gchar *basename;
+	gchar *dirname;
+	gchar *filename_part;
+	gchar *tmp;
+
+	basename = g_path_get_basename (filename);
+	dirname = g_path_get_dirname (filename);
+	tmp = g_strdup_printf (".%s", basename);
+	filename_part = g_build_filename (dirname, tmp, NULL);
+	g_free (basename);
+	g_free (dirname);
+	g_free (tmp);
+	return filename_part;
+}
+
+/**
+ * zif_download_file_http:
  *
- * Return value: %TRUE for success, %FALSE otherwise
+ * Streams the body to a partial file next to @filename, checksumming
+ * each chunk as it arrives. The file is only renamed into place when
+ * the size, content type and checksum are all correct.
  *
- * Since: 0.1.0
+ * If the transfer fails the partial file is kept, and the next attempt,
+ * from this mirror or any other, asks for just the remaining bytes.
+ * This is only done when the size or checksum is known, as otherwise
+ * data from a file that has since changed could not be detected.
  **/
-gboolean
-zif_download_file (ZifDownload *download,
-		   const gchar *uri,
-		   const gchar *filename,
-		   ZifState *state,
-		   GError **error)
+static gboolean
+zif_download_file_http (ZifDownload *download,
+			const gchar *uri,
+			const gchar *filename,
+			guint64 size,
+			const gchar *content_types,
+			GChecksumType checksum_type,
+			const gchar *checksum,
+			ZifState *state,
+			GError **error)
 {
+	gboolean keep_partial = FALSE;
 	gboolean ret = FALSE;
-	SoupURI *base_uri = NULL;
-	GFile *file = NULL;
+	const gchar *checksum_tmp;
+	gchar *filename_part = NULL;
+	GFileInfo *info;
+	GCancellable *cancellable;
 	GError *error_local = NULL;
+	GFile *file = NULL;
+	GFile *file_part = NULL;
+	SoupURI *base_uri = NULL;
 	ZifDownloadFlight *flight = NULL;
-	ZifDownloadError download_error = ZIF_DOWNLOAD_ERROR_FAILED;
-
-	g_return_val_if_fail (ZIF_IS_DOWNLOAD (download), FALSE);
-	g_return_val_if_fail (zif_state_valid (state), FALSE);
-	g_return_val_if_fail (uri != NULL, FALSE);
-	g_return_val_if_fail (filename != NULL, FALSE);
-	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-	/* local file */
-	if (g_str_has_prefix (uri, "file://")) {
-		ret = zif_download_local_copy (uri + 7, filename, state, error);
-		goto out;
-	}
-	if (g_str_has_prefix (uri, "/")) {
-		ret = zif_download_local_copy (uri, filename, state, error);
-		goto out;
-	}
-
-	/* FTP file */
-	if (g_str_has_prefix (uri, "ftp://")) {
-		ret = zif_download_file_ftp (download,
-					     uri,
-					     filename,
-					     state,
-					     error);
-		goto out;
-	}
 
 	/* create session if it does not exist yet */
+	g_mutex_lock (&download->priv->mutex);
 	if (download->priv->session == NULL) {
 		ret = zif_download_setup_session (download, error);
-		if (!ret)
+		if (!ret) {
+			g_mutex_unlock (&download->priv->mutex);
 			goto out;
+		}
+		ret = FALSE;
 	}
+	g_mutex_unlock (&download->priv->mutex);
 
 	/* save an instance of the state object */
 	flight = g_new0 (ZifDownloadFlight, 1);
@@ -542,7 +742,6 @@ zif_download_file (ZifDownload *download,
 
 	base_uri = soup_uri_new (uri);
 	if (base_uri == NULL) {
-		ret = FALSE;
 		g_set_error (error,
 			     ZIF_DOWNLOAD_ERROR,
 			     ZIF_DOWNLOAD_ERROR_FAILED,
@@ -551,10 +750,57 @@ zif_download_file (ZifDownload *download,
 		goto out;
 	}
 
+	/* write to a partial file that is moved into place when valid */
+	filename_part = zif_download_get_partial_filename (filename);
+	file_part = g_file_new_for_path (filename_part);
+	flight->file_part = file_part;
+	cancellable = zif_state_get_cancellable (state);
+	if (checksum != NULL)
+		flight->checksum = g_checksum_new (checksum_type);
+
+	/* do we have some of this file already that we can verify */
+	if (size > 0 || flight->checksum != NULL) {
+		info = g_file_query_info (file_part,
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NONE,
+					  cancellable,
+					  NULL);
+		if (info != NULL) {
+			flight->offset = g_file_info_get_size (info);
+			g_object_unref (info);
+		}
+	}
+	if (size > 0 && (guint64) flight->offset >= size)
+		flight->offset = 0;
+	if (flight->offset > 0 && flight->checksum != NULL) {
+		ret = zif_download_file_seed_checksum (file_part,
+						       flight->checksum,
+						       cancellable,
+						       &error_local);
+		if (!ret) {
+			g_debug ("cannot resume %s: %s",
+				 filename_part, error_local->message);
+			g_clear_error (&error_local);
+			g_checksum_reset (flight->checksum);
+			flight->offset = 0;
+		}
+		ret = FALSE;
+	}
+	ret = zif_download_file_open_stream (flight,
+					     flight->offset > 0,
+					     cancellable,
+					     &error_local);
+	if (!ret) {
+		zif_download_set_write_error (error, error_local);
+		g_error_free (error_local);
+		goto out;
+	}
+	ret = FALSE;
+	flight->last_body_length = flight->offset;
+
 	/* GET package */
 	flight->msg = soup_message_new_from_uri (SOUP_METHOD_GET, base_uri);
 	if (flight->msg == NULL) {
-		ret = FALSE;
 		g_set_error_literal (error,
 				     ZIF_DOWNLOAD_ERROR,
 				     ZIF_DOWNLOAD_ERROR_FAILED,
@@ -562,10 +808,24 @@ zif_download_file (ZifDownload *download,
 		goto out;
 	}
 
+	/* the chunks are written as they arrive */
+	soup_message_body_set_accumulate (flight->msg->response_body, FALSE);
+
+	/* only ask for what we don't have */
+	if (flight->offset > 0) {
+		g_debug ("resuming %s at %" G_GOFFSET_FORMAT,
+			 flight->uri, flight->offset);
+		soup_message_headers_set_range (flight->msg->request_headers,
+						flight->offset, -1);
+	}
+
 	/* we want progress updates */
 	g_signal_connect (flight->msg, "got-chunk",
 			  G_CALLBACK (zif_download_file_got_chunk_cb),
 			  flight);
+	g_signal_connect (flight->msg, "got-headers",
+			  G_CALLBACK (zif_download_file_got_headers_cb),
+			  flight);
 	g_signal_connect (flight->msg, "finished",
 			  G_CALLBACK (zif_download_file_finished_cb),
 			  flight);
@@ -576,10 +836,39 @@ zif_download_file (ZifDownload *download,
 	/* send sync */
 	soup_session_send_message (download->priv->session, flight->msg);
 
+	/* failed to write a chunk */
+	if (flight->error != NULL) {
+		zif_download_set_write_error (error, flight->error);
+		goto out;
+	}
+
+	/* nothing was written, so another server can resume it */
+	if (flight->wrong_range) {
+		g_set_error (error,
+			     ZIF_DOWNLOAD_ERROR,
+			     ZIF_DOWNLOAD_ERROR_WRONG_STATUS,
+			     "wrong range for %s, expected it to start at %" G_GOFFSET_FORMAT,
+			     uri, flight->offset);
+		keep_partial = TRUE;
+		goto out;
+	}
+
+	/* the partial file is no good to this server */
+	if (flight->msg->status_code == SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE) {
+		g_set_error (error,
+			     ZIF_DOWNLOAD_ERROR,
+			     ZIF_DOWNLOAD_ERROR_WRONG_STATUS,
+			     "cannot resume %s at %" G_GOFFSET_FORMAT,
+			     uri, flight->offset);
+		goto out;
+	}
+
+	/* anything else can be resumed next time */
+	keep_partial = TRUE;
+
 	/* find length */
 	switch (flight->msg->status_code) {
 	case SOUP_STATUS_CANCELLED:
-		ret = FALSE;
 		g_set_error_literal (error,
 				     ZIF_STATE_ERROR,
 				     ZIF_STATE_ERROR_CANCELLED,
@@ -590,7 +879,6 @@ zif_download_file (ZifDownload *download,
 	case SOUP_STATUS_CANT_RESOLVE:
 	case SOUP_STATUS_CANT_RESOLVE_PROXY:
 	case SOUP_STATUS_TRY_AGAIN:
-		ret = FALSE;
 		g_set_error_literal (error,
 				     ZIF_DOWNLOAD_ERROR,
 				     ZIF_DOWNLOAD_ERROR_FAILED,
@@ -600,7 +888,6 @@ zif_download_file (ZifDownload *download,
 		break;
 	}
 	if (!SOUP_STATUS_IS_SUCCESSFUL (flight->msg->status_code)) {
-		ret = FALSE;
 		g_set_error (error,
 			     ZIF_DOWNLOAD_ERROR,
 			     ZIF_DOWNLOAD_ERROR_WRONG_STATUS,
@@ -610,9 +897,11 @@ zif_download_file (ZifDownload *download,
 		goto out;
 	}
 
+	/* the rest of the checks are about what we have */
+	keep_partial = FALSE;
+
 	/* empty file */
-	if (flight->msg->response_body->length == 0) {
-		ret = FALSE;
+	if (flight->offset + flight->received == 0) {
 		g_set_error_literal (error,
 				     ZIF_DOWNLOAD_ERROR,
 				     ZIF_DOWNLOAD_ERROR_WRONG_SIZE,
@@ -620,40 +909,134 @@ zif_download_file (ZifDownload *download,
 		goto out;
 	}
 
-	/* write file */
-	file = g_file_new_for_path (filename);
-	ret = g_file_replace_contents (file,
-				       flight->msg->response_body->data,
-				       flight->msg->response_body->length,
-				       NULL, FALSE,
-				       G_FILE_CREATE_NONE,
-				       NULL, NULL, &error_local);
+	/* flush to disk */
+	ret = g_output_stream_close (flight->stream, cancellable, &error_local);
 	if (!ret) {
-		/* some errors are special */
-		if (error_local->code == G_IO_ERROR_PERMISSION_DENIED)
-			download_error = ZIF_DOWNLOAD_ERROR_PERMISSION_DENIED;
-		else if (error_local->code == G_IO_ERROR_NO_SPACE)
-			download_error = ZIF_DOWNLOAD_ERROR_NO_SPACE;
-		g_set_error (error, ZIF_DOWNLOAD_ERROR, download_error,
-			     "failed to write file: %s",  error_local->message);
+		zif_download_set_write_error (error, error_local);
 		g_error_free (error_local);
 		goto out;
 	}
-out:
-	if (flight != NULL) {
-		g_timer_destroy (flight->timer);
-		g_object_unref (flight->state);
-		g_object_unref (flight->download);
-		if (flight->msg != NULL)
-			g_object_unref (flight->msg);
-		g_free (flight->uri);
-		g_free (flight);
+	ret = FALSE;
+
+	/* verify size */
+	if (size > 0 && (guint64) (flight->offset + flight->received) != size) {
+		g_set_error (error,
+			     ZIF_DOWNLOAD_ERROR,
+			     ZIF_DOWNLOAD_ERROR_WRONG_SIZE,
+			     "incorrect size for %s: got %" G_GUINT64_FORMAT
+			     " but expected %" G_GUINT64_FORMAT,
+			     filename, (guint64) (flight->offset + flight->received), size);
+		goto out;
+	}
+
+	/* verify checksum */
+	if (flight->checksum != NULL) {
+		checksum_tmp = g_checksum_get_string (flight->checksum);
+		if (g_strcmp0 (checksum_tmp, checksum) != 0) {
+			g_set_error (error,
+				     ZIF_DOWNLOAD_ERROR,
+				     ZIF_DOWNLOAD_ERROR_WRONG_CHECKSUM,
+				     "incorrect checksum for %s: got %s but expected %s",
+				     filename, checksum_tmp, checksum);
+			goto out;
+		}
 	}
 
+	/* check content type is what we expect */
+	ret = zif_download_check_content_types (file_part,
+						content_types,
+						error);
+	if (!ret)
+		goto out;
+
+	/* atomically replace the old file */
+	file = g_file_new_for_path (filename);
+	ret = g_file_move (file_part, file,
+			   G_FILE_COPY_OVERWRITE,
+			   cancellable,
+			   NULL, NULL,
+			   &error_local);
+	if (!ret) {
+		zif_download_set_write_error (error, error_local);
+		g_error_free (error_local);
+		goto out;
+	}
+out:
+	if (flight != NULL)
+		zif_download_flight_free (flight);
+	if (!ret && !keep_partial && file_part != NULL)
+		g_file_delete (file_part, NULL, NULL);
 	if (base_uri != NULL)
 		soup_uri_free (base_uri);
 	if (file != NULL)
 		g_object_unref (file);
+	if (file_part != NULL)
+		g_object_unref (file_part);
+	g_free (filename_part);
+	return ret;
+}
+
+/**
+ * zif_download_file:
+ * @download: A #ZifDownload
+ * @uri: A full remote URI
+ * @filename: A local filename to save to
+ * @state: A #ZifState to use for progress reporting
+ * @error: A #GError, or %NULL
+ *
+ * Downloads a file either from a remote site, or copying the file
+ * from the local filesystem.
+ *
+ * This function will return with an error if the downloaded file
+ * has zero size.
+ *
+ * Return value: %TRUE for success, %FALSE otherwise
+ *
+ * Since: 0.1.0
+ **/
+gboolean
+zif_download_file (ZifDownload *download,
+		   const gchar *uri,
+		   const gchar *filename,
+		   ZifState *state,
+		   GError **error)
+{
+	gboolean ret = FALSE;
+
+	g_return_val_if_fail (ZIF_IS_DOWNLOAD (download), FALSE);
+	g_return_val_if_fail (zif_state_valid (state), FALSE);
+	g_return_val_if_fail (uri != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* local file */
+	if (g_str_has_prefix (uri, "file://")) {
+		ret = zif_download_local_copy (uri + 7, filename, state, error);
+		goto out;
+	}
+	if (g_str_has_prefix (uri, "/")) {
+		ret = zif_download_local_copy (uri, filename, state, error);
+		goto out;
+	}
+
+	/* FTP file */
+	if (g_str_has_prefix (uri, "ftp://")) {
+		ret = zif_download_file_ftp (download,
+					     uri,
+					     filename,
+					     state,
+					     error);
+		goto out;
+	}
+
+	/* HTTP file */
+	ret = zif_download_file_http (download,
+				      uri,
+				      filename,
+				      0, NULL, 0, NULL,
+				      state,
+				      error);
+out:
 	return ret;
 }
 
@@ -724,6 +1107,7 @@ zif_download_location_add_uri (ZifDownload *download, const gchar *uri, GError *
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
 	/* already added */
+	g_mutex_lock (&download->priv->mutex);
 	if (zif_download_location_array_get_index (download->priv->array, uri) != G_MAXUINT)
 		goto out;
 
@@ -732,6 +1116,7 @@ zif_download_location_add_uri (ZifDownload *download, const gchar *uri, GError *
 	item->uri = g_strdup (uri);
 	g_ptr_array_add (download->priv->array, item);
 out:
+	g_mutex_unlock (&download->priv->mutex);
 	return TRUE;
 }
 
@@ -845,8 +1230,10 @@ zif_download_location_remove_uri (ZifDownload *download, const gchar *uri, GErro
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
 	/* does not exist */
+	g_mutex_lock (&download->priv->mutex);
 	index = zif_download_location_array_get_index (download->priv->array, uri);
 	if (index == G_MAXUINT) {
+		g_mutex_unlock (&download->priv->mutex);
 		g_set_error (error,
 			     ZIF_DOWNLOAD_ERROR,
 			     ZIF_DOWNLOAD_ERROR_FAILED,
@@ -856,6 +1243,7 @@ zif_download_location_remove_uri (ZifDownload *download, const gchar *uri, GErro
 
 	/* remove from array */
 	g_ptr_array_remove_index (download->priv->array, index);
+	g_mutex_unlock (&download->priv->mutex);
 	return TRUE;
 }
 
@@ -966,6 +1354,9 @@ out:
  * from the local filesystem, and then verifying it against what we are
  * expecting.
  *
+ * If a previous HTTP download of the same file was interrupted then
+ * only the remaining data is requested.
+ *
  * Return value: %TRUE for success, %FALSE otherwise
  *
  * Since: 0.2.1
@@ -1006,6 +1397,21 @@ zif_download_file_full (ZifDownload *download,
 		goto out;
 	}
 
+	/* stream to disk, verifying as we go */
+	if (g_str_has_prefix (uri, "http://") ||
+	    g_str_has_prefix (uri, "https://")) {
+		ret = zif_download_file_http (download,
+					      uri,
+					      filename,
+					      size,
+					      content_types,
+					      checksum_type,
+					      checksum,
+					      state,
+					      error);
+		goto out;
+	}
+
 	/* download */
 	ret = zif_download_file (download,
 				 uri,
@@ -1086,11 +1492,13 @@ zif_download_location_full (ZifDownload *download,
 	gboolean ret = FALSE;
 	gboolean set_error = FALSE;
 	gchar *failovermethod = NULL;
+	gchar *uri_base;
 	gchar *uri_tmp;
 	GError *error_local = NULL;
 	GError *error_last = NULL;
 	GPtrArray *array = NULL;
 	guint index;
+	guint item_retries;
 	guint retries;
 	ZifDownloadItem *item;
 	ZifDownloadPolicy policy = ZIF_DOWNLOAD_POLICY_RANDOM;
@@ -1103,7 +1511,7 @@ zif_download_location_full (ZifDownload *download,
 
 	/* nothing in the pool */
 	array = download->priv->array;
-	if (array->len == 0) {
+	if (zif_download_location_get_size (download) == 0) {
 		g_set_error_literal (error,
 				     ZIF_DOWNLOAD_ERROR,
 				     ZIF_DOWNLOAD_ERROR_NO_LOCATIONS,
@@ -1119,9 +1527,15 @@ zif_download_location_full (ZifDownload *download,
 		policy = ZIF_DOWNLOAD_POLICY_LINEAR;
 
 	/* keep trying until we get success */
-	while (array->len > 0) {
+	while (TRUE) {
 
-		/* get the next mirror according to policy */
+		/* get the next mirror according to policy, copying the URI
+		 * as another download may remove it from the pool */
+		g_mutex_lock (&download->priv->mutex);
+		if (array->len == 0) {
+			g_mutex_unlock (&download->priv->mutex);
+			break;
+		}
 		if (policy == ZIF_DOWNLOAD_POLICY_RANDOM) {
 			if (array->len > 1)
 				index = g_random_int_range (0, array->len - 1);
@@ -1130,10 +1544,12 @@ zif_download_location_full (ZifDownload *download,
 		} else {
 			index = 0;
 		}
+		item = g_ptr_array_index (array, index);
+		uri_base = g_strdup (item->uri);
+		g_mutex_unlock (&download->priv->mutex);
 
 		/* form the full URL */
-		item = g_ptr_array_index (array, index);
-		uri_tmp = g_build_filename (item->uri, location, NULL);
+		uri_tmp = g_build_filename (uri_base, location, NULL);
 
 		g_debug ("attempt to download %s", uri_tmp);
 		zif_state_reset (state);
@@ -1142,68 +1558,69 @@ zif_download_location_full (ZifDownload *download,
 					      state, &error_local);
 		if (!ret) {
 			/* some errors really are fatal */
-			if (error_local->domain == ZIF_DOWNLOAD_ERROR &&
-			    error_local->code == ZIF_DOWNLOAD_ERROR_PERMISSION_DENIED) {
-				g_propagate_error (error, error_local);
-				set_error = TRUE;
-				break;
-			}
-			if (error_local->domain == ZIF_DOWNLOAD_ERROR &&
-			    error_local->code == ZIF_DOWNLOAD_ERROR_NO_SPACE) {
-				g_propagate_error (error, error_local);
-				set_error = TRUE;
-				break;
-			}
-			if (error_local->domain == ZIF_STATE_ERROR &&
-			    error_local->code == ZIF_STATE_ERROR_CANCELLED) {
+			if (g_error_matches (error_local,
+					     ZIF_DOWNLOAD_ERROR,
+					     ZIF_DOWNLOAD_ERROR_PERMISSION_DENIED) ||
+			    g_error_matches (error_local,
+					     ZIF_DOWNLOAD_ERROR,
+					     ZIF_DOWNLOAD_ERROR_NO_SPACE) ||
+			    g_error_matches (error_local,
+					     ZIF_STATE_ERROR,
+					     ZIF_STATE_ERROR_CANCELLED)) {
 				g_propagate_error (error, error_local);
 				set_error = TRUE;
+				g_free (uri_base);
+				g_free (uri_tmp);
 				break;
 			}
 
-			/* increment the download count */
-			item->retries++;
-
 			/* too many retries */
 			retries = zif_config_get_uint (download->priv->config,
 						       "retries", error);
 			if (retries == G_MAXUINT) {
+				g_error_free (error_local);
+				g_free (uri_base);
+				g_free (uri_tmp);
 				ret = FALSE;
 				goto out;
 			}
-			if (item->retries >= retries) {
 
+			/* increment the download count, unless another
+			 * download has already removed the mirror */
+			item_retries = retries;
+			g_mutex_lock (&download->priv->mutex);
+			index = zif_download_location_array_get_index (array, uri_base);
+			if (index != G_MAXUINT) {
+				item = g_ptr_array_index (array, index);
+				item_retries = ++item->retries;
+				if (item_retries >= retries)
+					g_ptr_array_remove_index (array, index);
+			}
+			g_mutex_unlock (&download->priv->mutex);
+			if (item_retries >= retries) {
 				/* just print and remove, not fatal */
 				g_debug ("failed to download %s after try %i: %s, so removing",
-					 item->uri,
-					 item->retries,
+					 uri_base,
+					 item_retries,
 					 error_local->message);
-
-				/* save this for a better global error */
-				_g_propagate_error_replace (&error_last, error_local);
-				error_local = NULL;
-
-				/* remove it (error is NULL as we know it exists, we just used it) */
-				zif_download_location_remove_uri (download,
-								  item->uri,
-								  NULL);
 			} else {
 				/* just print, not fatal */
 				g_debug ("failed to download %s: %s, on retry %i/%i",
-					 item->uri,
+					 uri_base,
 					 error_local->message,
-					 item->retries,
+					 item_retries,
 					 retries);
-
-				/* save this for a better global error */
-				_g_propagate_error_replace (&error_last, error_local);
-				error_local = NULL;
 			}
+
+			/* save this for a better global error */
+			_g_propagate_error_replace (&error_last, error_local);
+			error_local = NULL;
 		} else {
 			g_debug ("downloaded correct content %s into %s",
 				 uri_tmp, filename);
 		}
 
+		g_free (uri_base);
 		g_free (uri_tmp);
 		if (ret)
 			break;
@@ -1264,8 +1681,14 @@ zif_download_location (ZifDownload *download, const gchar *location, const gchar
 guint
 zif_download_location_get_size (ZifDownload *download)
 {
+	guint len;
+
 	g_return_val_if_fail (ZIF_IS_DOWNLOAD (download), 0);
-	return download->priv->array->len;
+
+	g_mutex_lock (&download->priv->mutex);
+	len = download->priv->array->len;
+	g_mutex_unlock (&download->priv->mutex);
+	return len;
 }
 
 /**
@@ -1280,7 +1703,9 @@ void
 zif_download_location_clear (ZifDownload *download)
 {
 	g_return_if_fail (ZIF_IS_DOWNLOAD (download));
+	g_mutex_lock (&download->priv->mutex);
 	g_ptr_array_set_size (download->priv->array, 0);
+	g_mutex_unlock (&download->priv->mutex);
 }
 
 /**
@@ -1299,6 +1724,7 @@ zif_download_finalize (GObject *object)
 		g_object_unref (download->priv->session);
 	g_object_unref (download->priv->config);
 	g_ptr_array_unref (download->priv->array);
+	g_mutex_clear (&download->priv->mutex);
 
 	G_OBJECT_CLASS (zif_download_parent_class)->finalize (object);
 }
@@ -1325,6 +1751,7 @@ zif_download_init (ZifDownload *download)
 	download->priv->session = NULL;
 	download->priv->config = zif_config_new ();
 	download->priv->array = g_ptr_array_new_with_free_func ((GDestroyNotify) zif_download_item_free);
+	g_mutex_init (&download->priv->mutex);
 }
 
 /**
@@ -0,0 +1,56 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined (__ZIF_H_INSIDE__) && !defined (ZIF_COMPILATION)
+#error "Only <zif.h> can be included directly."
+#endif
+
+#ifndef __ZIF_FILE_INDEX_PRIVATE_H
+#define __ZIF_FILE_INDEX_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _ZifFileIndex	ZifFileIndex;
+
+ZifFileIndex	*zif_file_index_new		(void);
+void		 zif_file_index_free		(ZifFileIndex	*index);
+void		 zif_file_index_add		(ZifFileIndex	*index,
+						 const gchar	*key,
+						 const gchar	*filename);
+void		 zif_file_index_build		(ZifFileIndex	*index,
+						 const gchar	*stamp);
+gboolean	 zif_file_index_save		(ZifFileIndex	*index,
+						 const gchar	*filename,
+						 GError		**error);
+gboolean	 zif_file_index_load		(ZifFileIndex	*index,
+						 const gchar	*filename,
+						 const gchar	*stamp,
+						 GError		**error);
+GPtrArray	*zif_file_index_search		(ZifFileIndex	*index,
+						 gchar		**search);
+gchar		*zif_file_index_get_stamp	(const gchar	*filename,
+						 GError		**error);
+
+G_END_DECLS
+
+#endif /* __ZIF_FILE_INDEX_PRIVATE_H */
@@ -0,0 +1,710 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:zif-file-index
+ * @short_description: An on-disk index of file paths
+ *
+ * A #ZifFileIndex maps full file paths to the packages that contain
+ * them, so stores can answer file searches without loading the file
+ * list of every package.
+ *
+ * The index is written once, when the rpmdb or the remote metadata
+ * changes, and is then memory mapped. It consists of a sorted table of
+ * directory names, each pointing at a sorted run of basenames, and
+ * each basename points at a key that identifies the package.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "zif-file-index-private.h"
+
+#define ZIF_FILE_INDEX_MAGIC		"ZIFFIDX1"
+
+/* all the offsets are into the string table, which comes last */
+typedef struct {
+	gchar			 magic[8];
+	guint32			 stamp;
+	guint32			 n_keys;
+	guint32			 n_dirs;
+	guint32			 n_entries;
+	guint32			 strings_size;
+	guint32			 reserved;
+} ZifFileIndexHeader;
+
+typedef struct {
+	guint32			 name;
+	guint32			 first;
+	guint32			 n;
+} ZifFileIndexDir;
+
+typedef struct {
+	guint32			 basename;
+	guint32			 key;
+} ZifFileIndexEntry;
+
+typedef struct {
+	guint32			 name;
+	GArray			*entries;	/* of ZifFileIndexEntry */
+} ZifFileIndexBuildDir;
+
+struct _ZifFileIndex
+{
+	/* when building */
+	GString			*strings;
+	GHashTable		*strings_hash;	/* string -> offset + 1 */
+	GHashTable		*keys_hash;	/* key -> index + 1 */
+	GArray			*keys;		/* of string offsets */
+	GHashTable		*dirs_hash;	/* dirname -> ZifFileIndexBuildDir */
+	/* when searching */
+	GMappedFile		*mapped;
+	gchar			*data_built;
+	const gchar		*data;
+	gsize			 len;
+	const ZifFileIndexHeader *header;
+	const guint32		*index_keys;
+	const ZifFileIndexDir	*index_dirs;
+	const ZifFileIndexEntry	*index_entries;
+	const gchar		*index_strings;
+};
+
+/**
+ * zif_file_index_build_dir_free:
+ **/
+static void
+zif_file_index_build_dir_free (ZifFileIndexBuildDir *dir)
+{
+	g_array_unref (dir->entries);
+	g_free (dir);
+}
+
+/**
+ * zif_file_index_new:
+ *
+ * Creates a new, empty, file index that paths can be added to.
+ *
+ * Return value: A new #ZifFileIndex, free with zif_file_index_free()
+ *
+ * Since: 0.3.7
+ **/
+ZifFileIndex *
+zif_file_index_new (void)
+{
+	ZifFileIndex *index;
+	index = g_new0 (ZifFileIndex, 1);
+	index->strings = g_string_new (NULL);
+	index->strings_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     g_free, NULL);
+	index->keys_hash = g_hash_table_new (g_direct_hash, g_direct_equal);
+	index->keys = g_array_new (FALSE, FALSE, sizeof (guint32));
+	index->dirs_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  g_free, (GDestroyNotify) zif_file_index_build_dir_free);
+	return index;
+}
+
+/**
+ * zif_file_index_clear_build:
+ **/
+static void
+zif_file_index_clear_build (ZifFileIndex *index)
+{
+	if (index->strings != NULL) {
+		g_string_free (index->strings, TRUE);
+		index->strings = NULL;
+	}
+	if (index->strings_hash != NULL) {
+		g_hash_table_unref (index->strings_hash);
+		index->strings_hash = NULL;
+	}
+	if (index->keys_hash != NULL) {
+		g_hash_table_unref (index->keys_hash);
+		index->keys_hash = NULL;
+	}
+	if (index->keys != NULL) {
+		g_array_unref (index->keys);
+		index->keys = NULL;
+	}
+	if (index->dirs_hash != NULL) {
+		g_hash_table_unref (index->dirs_hash);
+		index->dirs_hash = NULL;
+	}
+}
+
+/**
+ * zif_file_index_clear_data:
+ **/
+static void
+zif_file_index_clear_data (ZifFileIndex *index)
+{
+	if (index->mapped != NULL) {
+		g_mapped_file_unref (index->mapped);
+		index->mapped = NULL;
+	}
+	g_free (index->data_built);
+	index->data_built = NULL;
+	index->data = NULL;
+	index->len = 0;
+	index->header = NULL;
+}
+
+/**
+ * zif_file_index_free:
+ * @index: A #ZifFileIndex
+ *
+ * Frees the index, unmapping the file if it was loaded.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_file_index_free (ZifFileIndex *index)
+{
+	if (index == NULL)
+		return;
+	zif_file_index_clear_build (index);
+	zif_file_index_clear_data (index);
+	g_free (index);
+}
+
+/**
+ * zif_file_index_add_string:
+ *
+ * Adds a string to the string table, only storing each value once.
+ **/
+static guint32
+zif_file_index_add_string (ZifFileIndex *index, const gchar *value)
+{
+	gpointer offset;
+	guint32 offset_new;
+
+	offset = g_hash_table_lookup (index->strings_hash, value);
+	if (offset != NULL)
+		return GPOINTER_TO_UINT (offset) - 1;
+	offset_new = index->strings->len;
+	g_string_append_len (index->strings, value, strlen (value) + 1);
+	g_hash_table_insert (index->strings_hash, g_strdup (value),
+			     GUINT_TO_POINTER (offset_new + 1));
+	return offset_new;
+}
+
+/**
+ * zif_file_index_add:
+ * @index: A #ZifFileIndex
+ * @key: The key for the package, e.g. a package-id or pkgId
+ * @filename: The full path of a file in the package
+ *
+ * Adds a file to the index. This can only be used before
+ * zif_file_index_build() is called.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_file_index_add (ZifFileIndex *index, const gchar *key, const gchar *filename)
+{
+	const gchar *basename;
+	gpointer key_idx;
+	gsize dirname_len;
+	gchar *dirname;
+	guint32 key_offset;
+	ZifFileIndexBuildDir *dir;
+	ZifFileIndexEntry entry;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (index->dirs_hash != NULL);
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (filename != NULL);
+
+	/* only full paths to files can be found */
+	basename = strrchr (filename, '/');
+	if (basename == NULL || basename[1] == '\0')
+		return;
+	dirname_len = basename - filename;
+	if (dirname_len == 0)
+		dirname_len = 1;
+	basename++;
+
+	/* get the key */
+	key_offset = zif_file_index_add_string (index, key);
+	key_idx = g_hash_table_lookup (index->keys_hash,
+				       GUINT_TO_POINTER (key_offset));
+	if (key_idx == NULL) {
+		g_array_append_val (index->keys, key_offset);
+		key_idx = GUINT_TO_POINTER (index->keys->len);
+		g_hash_table_insert (index->keys_hash,
+				     GUINT_TO_POINTER (key_offset),
+				     key_idx);
+	}
+
+	/* get the directory */
+	dirname = g_strndup (filename, dirname_len);
+	dir = g_hash_table_lookup (index->dirs_hash, dirname);
+	if (dir == NULL) {
+		dir = g_new0 (ZifFileIndexBuildDir, 1);
+		dir->name = zif_file_index_add_string (index, dirname);
+		dir->entries = g_array_new (FALSE, FALSE, sizeof (ZifFileIndexEntry));
+		g_hash_table_insert (index->dirs_hash, dirname, dir);
+	} else {
+		g_free (dirname);
+	}
+
+	/* add the basename */
+	entry.basename = zif_file_index_add_string (index, basename);
+	entry.key = GPOINTER_TO_UINT (key_idx) - 1;
+	g_array_append_val (dir->entries, entry);
+}
+
+/**
+ * zif_file_index_sort_dir_cb:
+ **/
+static gint
+zif_file_index_sort_dir_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const gchar *strings = user_data;
+	const ZifFileIndexBuildDir *dir_a = *((ZifFileIndexBuildDir **) a);
+	const ZifFileIndexBuildDir *dir_b = *((ZifFileIndexBuildDir **) b);
+	return strcmp (strings + dir_a->name, strings + dir_b->name);
+}
+
+/**
+ * zif_file_index_sort_entry_cb:
+ **/
+static gint
+zif_file_index_sort_entry_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const gchar *strings = user_data;
+	const ZifFileIndexEntry *entry_a = a;
+	const ZifFileIndexEntry *entry_b = b;
+	gint retval;
+	retval = strcmp (strings + entry_a->basename, strings + entry_b->basename);
+	if (retval != 0)
+		return retval;
+	return (gint) entry_a->key - (gint) entry_b->key;
+}
+
+/**
+ * zif_file_index_set_data:
+ *
+ * Points the search tables at the serialized data, checking that
+ * every offset is in range so a corrupt file cannot cause a crash.
+ **/
+static gboolean
+zif_file_index_set_data (ZifFileIndex *index, const gchar *data, gsize len, GError **error)
+{
+	const ZifFileIndexHeader *header = (const ZifFileIndexHeader *) data;
+	guint64 len_expected;
+	guint i;
+
+	/* check the header */
+	if (data == NULL ||
+	    len < sizeof (ZifFileIndexHeader) ||
+	    memcmp (header->magic, ZIF_FILE_INDEX_MAGIC, 8) != 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "file index has an invalid header");
+		return FALSE;
+	}
+	len_expected = sizeof (ZifFileIndexHeader);
+	len_expected += (guint64) header->n_keys * sizeof (guint32);
+	len_expected += (guint64) header->n_dirs * sizeof (ZifFileIndexDir);
+	len_expected += (guint64) header->n_entries * sizeof (ZifFileIndexEntry);
+	len_expected += header->strings_size;
+	if (len_expected != len ||
+	    header->strings_size == 0 ||
+	    data[len - 1] != '\0' ||
+	    header->stamp >= header->strings_size) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "file index is truncated or corrupt");
+		return FALSE;
+	}
+
+	/* get the tables */
+	index->index_keys = (const guint32 *) (data + sizeof (ZifFileIndexHeader));
+	index->index_dirs = (const ZifFileIndexDir *) (index->index_keys + header->n_keys);
+	index->index_entries = (const ZifFileIndexEntry *) (index->index_dirs + header->n_dirs);
+	index->index_strings = (const gchar *) (index->index_entries + header->n_entries);
+
+	/* check the offsets */
+	for (i = 0; i < header->n_keys; i++) {
+		if (index->index_keys[i] >= header->strings_size)
+			goto corrupt;
+	}
+	for (i = 0; i < header->n_dirs; i++) {
+		if (index->index_dirs[i].name >= header->strings_size)
+			goto corrupt;
+		if ((guint64) index->index_dirs[i].first +
+		    index->index_dirs[i].n > header->n_entries)
+			goto corrupt;
+	}
+	for (i = 0; i < header->n_entries; i++) {
+		if (index->index_entries[i].basename >= header->strings_size)
+			goto corrupt;
+		if (index->index_entries[i].key >= header->n_keys)
+			goto corrupt;
+	}
+
+	index->data = data;
+	index->len = len;
+	index->header = header;
+	return TRUE;
+corrupt:
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "file index has an invalid offset");
+	return FALSE;
+}
+
+/**
+ * zif_file_index_build:
+ * @index: A #ZifFileIndex
+ * @stamp: A string that identifies the data the index was built from
+ *
+ * Sorts the files that have been added so that the index can be
+ * searched or saved. No more files can be added after this.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_file_index_build (ZifFileIndex *index, const gchar *stamp)
+{
+	GHashTableIter iter;
+	GPtrArray *dirs;
+	gchar *data;
+	gsize len;
+	guint32 first = 0;
+	guint i;
+	ZifFileIndexBuildDir *dir;
+	ZifFileIndexDir *dirs_out;
+	ZifFileIndexEntry *entries_out;
+	ZifFileIndexHeader *header;
+	guint n_entries = 0;
+
+	g_return_if_fail (index != NULL);
+	g_return_if_fail (index->dirs_hash != NULL);
+	g_return_if_fail (stamp != NULL);
+
+	/* sort the directories, and the basenames in each one */
+	dirs = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, index->dirs_hash);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &dir)) {
+		g_array_sort_with_data (dir->entries,
+					zif_file_index_sort_entry_cb,
+					index->strings->str);
+		n_entries += dir->entries->len;
+		g_ptr_array_add (dirs, dir);
+	}
+	g_ptr_array_sort_with_data (dirs,
+				    zif_file_index_sort_dir_cb,
+				    index->strings->str);
+
+	/* write out the tables in one allocation */
+	len = sizeof (ZifFileIndexHeader) +
+	      index->keys->len * sizeof (guint32) +
+	      dirs->len * sizeof (ZifFileIndexDir) +
+	      n_entries * sizeof (ZifFileIndexEntry);
+	header = (ZifFileIndexHeader *) g_malloc0 (len + index->strings->len +
+						   strlen (stamp) + 1);
+	data = (gchar *) header;
+	memcpy (header->magic, ZIF_FILE_INDEX_MAGIC, 8);
+	header->n_keys = index->keys->len;
+	header->n_dirs = dirs->len;
+	header->n_entries = n_entries;
+	memcpy (data + sizeof (ZifFileIndexHeader),
+		index->keys->data,
+		index->keys->len * sizeof (guint32));
+	dirs_out = (ZifFileIndexDir *) (data + sizeof (ZifFileIndexHeader) +
+					index->keys->len * sizeof (guint32));
+	entries_out = (ZifFileIndexEntry *) (dirs_out + dirs->len);
+	for (i = 0; i < dirs->len; i++) {
+		dir = g_ptr_array_index (dirs, i);
+		dirs_out[i].name = dir->name;
+		dirs_out[i].first = first;
+		dirs_out[i].n = dir->entries->len;
+		memcpy (entries_out + first,
+			dir->entries->data,
+			dir->entries->len * sizeof (ZifFileIndexEntry));
+		first += dir->entries->len;
+	}
+
+	/* the stamp goes at the end of the string table */
+	memcpy (data + len, index->strings->str, index->strings->len);
+	header->stamp = index->strings->len;
+	memcpy (data + len + index->strings->len, stamp, strlen (stamp) + 1);
+	header->strings_size = index->strings->len + strlen (stamp) + 1;
+	len += header->strings_size;
+	g_debug ("built file index of %i files in %i directories",
+		 n_entries, dirs->len);
+
+	/* the build data is no longer needed */
+	g_ptr_array_unref (dirs);
+	zif_file_index_clear_build (index);
+	zif_file_index_clear_data (index);
+	index->data_built = data;
+	zif_file_index_set_data (index, data, len, NULL);
+}
+
+/**
+ * zif_file_index_save:
+ * @index: A #ZifFileIndex
+ * @filename: The file to write, e.g. "/var/cache/zif/fedora/files.idx"
+ * @error: A #GError, or %NULL
+ *
+ * Saves a built index to disk.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_file_index_save (ZifFileIndex *index, const gchar *filename, GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *dirname;
+	gint rc;
+
+	g_return_val_if_fail (index != NULL, FALSE);
+	g_return_val_if_fail (index->header != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	/* ensure the cache directory exists */
+	dirname = g_path_get_dirname (filename);
+	rc = g_mkdir_with_parents (dirname, 0755);
+	if (rc < 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			     "failed to create %s", dirname);
+		goto out;
+	}
+
+	/* this is atomic, so readers never see a partial index */
+	ret = g_file_set_contents (filename, index->data, index->len, error);
+out:
+	g_free (dirname);
+	return ret;
+}
+
+/**
+ * zif_file_index_load:
+ * @index: A #ZifFileIndex
+ * @filename: The file to map, e.g. "/var/cache/zif/fedora/files.idx"
+ * @stamp: The stamp the index must have been built with
+ * @error: A #GError, or %NULL
+ *
+ * Maps an index that was previously saved. If the index was built
+ * from different data to @stamp it is rejected, and the error is set
+ * to %G_IO_ERROR_INVALID_DATA.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_file_index_load (ZifFileIndex *index,
+		     const gchar *filename,
+		     const gchar *stamp,
+		     GError **error)
+{
+	gboolean ret;
+	GMappedFile *mapped;
+
+	g_return_val_if_fail (index != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (stamp != NULL, FALSE);
+
+	/* map the file */
+	zif_file_index_clear_data (index);
+	mapped = g_mapped_file_new (filename, FALSE, error);
+	if (mapped == NULL)
+		return FALSE;
+	ret = zif_file_index_set_data (index,
+				       g_mapped_file_get_contents (mapped),
+				       g_mapped_file_get_length (mapped),
+				       error);
+	if (!ret) {
+		g_mapped_file_unref (mapped);
+		return FALSE;
+	}
+
+	/* built from something else */
+	if (g_strcmp0 (index->index_strings + index->header->stamp, stamp) != 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "file index %s is out of date", filename);
+		zif_file_index_clear_data (index);
+		g_mapped_file_unref (mapped);
+		return FALSE;
+	}
+
+	/* the build data is no longer needed */
+	zif_file_index_clear_build (index);
+	index->mapped = mapped;
+	return TRUE;
+}
+
+/**
+ * zif_file_index_find_dir:
+ *
+ * Finds the directory that has the same name as the first @len
+ * characters of @dirname, using a binary search.
+ **/
+static const ZifFileIndexDir *
+zif_file_index_find_dir (ZifFileIndex *index, const gchar *dirname, gsize len)
+{
+	const gchar *name;
+	gint retval;
+	guint lower = 0;
+	guint mid;
+	guint upper = index->header->n_dirs;
+
+	while (lower < upper) {
+		mid = lower + (upper - lower) / 2;
+		name = index->index_strings + index->index_dirs[mid].name;
+		retval = strncmp (dirname, name, len);
+		if (retval == 0 && name[len] != '\0')
+			retval = -1;
+		if (retval == 0)
+			return &index->index_dirs[mid];
+		if (retval < 0)
+			upper = mid;
+		else
+			lower = mid + 1;
+	}
+	return NULL;
+}
+
+/**
+ * zif_file_index_search:
+ * @index: A #ZifFileIndex
+ * @search: The full paths to search for, e.g. "/usr/bin/zif"
+ *
+ * Finds the keys of all the packages that contain any of the files.
+ *
+ * Return value: (element-type utf8) (transfer container): The keys,
+ * which are owned by the index and are only listed once.
+ *
+ * Since: 0.3.7
+ **/
+GPtrArray *
+zif_file_index_search (ZifFileIndex *index, gchar **search)
+{
+	const gchar *basename;
+	const ZifFileIndexDir *dir;
+	const ZifFileIndexEntry *entry;
+	GHashTable *hash_seen;
+	GPtrArray *array;
+	gint retval;
+	gsize dirname_len;
+	guint i;
+	guint lower;
+	guint mid;
+	guint upper;
+
+	g_return_val_if_fail (index != NULL, NULL);
+	g_return_val_if_fail (index->header != NULL, NULL);
+	g_return_val_if_fail (search != NULL, NULL);
+
+	array = g_ptr_array_new ();
+	hash_seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; search[i] != NULL; i++) {
+
+		/* split into directory and basename */
+		basename = strrchr (search[i], '/');
+		if (basename == NULL || basename[1] == '\0')
+			continue;
+		dirname_len = basename - search[i];
+		if (dirname_len == 0)
+			dirname_len = 1;
+		basename++;
+		dir = zif_file_index_find_dir (index, search[i], dirname_len);
+		if (dir == NULL)
+			continue;
+
+		/* find the first entry with this basename */
+		lower = dir->first;
+		upper = dir->first + dir->n;
+		while (lower < upper) {
+			mid = lower + (upper - lower) / 2;
+			entry = &index->index_entries[mid];
+			retval = strcmp (index->index_strings + entry->basename, basename);
+			if (retval < 0)
+				lower = mid + 1;
+			else
+				upper = mid;
+		}
+
+		/* add all the packages that have it */
+		for (; lower < dir->first + dir->n; lower++) {
+			entry = &index->index_entries[lower];
+			if (strcmp (index->index_strings + entry->basename, basename) != 0)
+				break;
+			if (g_hash_table_lookup (hash_seen, GUINT_TO_POINTER (entry->key + 1)) != NULL)
+				continue;
+			g_hash_table_insert (hash_seen,
+					     GUINT_TO_POINTER (entry->key + 1),
+					     GUINT_TO_POINTER (1));
+			g_ptr_array_add (array, (gpointer) (index->index_strings +
+							    index->index_keys[entry->key]));
+		}
+	}
+	g_hash_table_unref (hash_seen);
+	return array;
+}
+
+/**
+ * zif_file_index_get_stamp:
+ * @filename: The file the index is built from, e.g. "/var/lib/rpm/Packages"
+ * @error: A #GError, or %NULL
+ *
+ * Gets a stamp for a file that changes whenever the file is replaced
+ * or modified, so an index built from an older copy is not used.
+ *
+ * Return value: The stamp, or %NULL if the file does not exist
+ *
+ * Since: 0.3.7
+ **/
+gchar *
+zif_file_index_get_stamp (const gchar *filename, GError **error)
+{
+	gint64 mtime_nsec = 0;
+	gint rc;
+	GStatBuf buf;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	rc = g_stat (filename, &buf);
+	if (rc < 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+			     "failed to stat %s", filename);
+		return NULL;
+	}
+
+	/* the rpmdb can be changed twice in the same second */
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	mtime_nsec = buf.st_mtim.tv_nsec;
+#endif
+	return g_strdup_printf ("%s:%" G_GINT64_FORMAT ".%09" G_GINT64_FORMAT
+				":%" G_GINT64_FORMAT,
+				filename,
+				(gint64) buf.st_mtime,
+				mtime_nsec,
+				(gint64) buf.st_size);
+}
@@ -24,6 +24,12 @@
  * @short_description: Lock the package system
  *
  * This object works with the generic lock file.
+ *
+ * Process locks are held using fcntl() on the lock file, so they are
+ * dropped by the kernel if the process exits without releasing them.
+ * Locks can be taken for exclusive access, e.g. when refreshing the
+ * metadata, or for shared access, e.g. when just reading it. Many
+ * shared holders are allowed at once, in this process or in others.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -31,6 +37,10 @@
 #endif
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -41,6 +51,18 @@
 
 #define ZIF_LOCK_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ZIF_TYPE_LOCK, ZifLockPrivate))
 
+/* other processes cannot wake us, so check the lock file this often */
+#define ZIF_LOCK_POLL_INTERVAL	(G_USEC_PER_SEC / 20)
+
+/* in compat mode every type uses the same lock file, and closing any
+ * fd for it would drop all our fcntl() locks, so the types share it */
+typedef struct {
+	gchar			*filename;
+	gint			 fd;
+	guint			 refcount;
+	guint			 exclusive;
+} ZifLockFile;
+
 /**
  * ZifLockPrivate:
  *
@@ -49,14 +71,17 @@
 struct _ZifLockPrivate
 {
 	GMutex			 mutex;
+	GCond			 cond;
 	ZifConfig		*config;
 	GPtrArray		*item_array;
+	ZifLockFile		*files[ZIF_LOCK_TYPE_LAST];
 };
 
 typedef struct {
 	gpointer		 owner;
 	guint			 id;
 	guint			 refcount;
+	ZifLockAccess		 access;
 	ZifLockMode		 mode;
 	ZifLockType		 type;
 } ZifLockItem;
@@ -129,12 +154,31 @@ zif_lock_type_to_string (ZifLockType lock_type)
 }
 
 /**
- * zif_lock_get_item_by_type_mode:
+ * zif_lock_access_to_string:
+ *
+ * Return value: The string representation of the access
+ *
+ * Since: 0.3.7
+ **/
+const gchar *
+zif_lock_access_to_string (ZifLockAccess access)
+{
+	if (access == ZIF_LOCK_ACCESS_EXCLUSIVE)
+		return "exclusive";
+	if (access == ZIF_LOCK_ACCESS_SHARED)
+		return "shared";
+	return "unknown";
+}
+
+/**
+ * zif_lock_get_item_for_thread:
+ *
+ * Finds the lock of this type already held by this thread.
  **/
 static ZifLockItem *
-zif_lock_get_item_by_type_mode (ZifLock *lock,
-				ZifLockType type,
-				ZifLockMode mode)
+zif_lock_get_item_for_thread (ZifLock *lock,
+			      ZifLockType type,
+			      ZifLockMode mode)
 {
 	ZifLockItem *item;
 	guint i;
@@ -142,12 +186,63 @@ zif_lock_get_item_by_type_mode (ZifLock *lock,
 	/* search for the item that matches type */
 	for (i = 0; i < lock->priv->item_array->len; i++) {
 		item = g_ptr_array_index (lock->priv->item_array, i);
-		if (item->type == type && item->mode == mode)
+		if (item->type == type &&
+		    item->mode == mode &&
+		    item->owner == g_thread_self ())
 			return item;
 	}
 	return NULL;
 }
 
+/**
+ * zif_lock_get_item_conflict:
+ *
+ * Finds a lock held by another thread that stops us taking this one.
+ * Shared locks only conflict with exclusive locks.
+ **/
+static ZifLockItem *
+zif_lock_get_item_conflict (ZifLock *lock,
+			    ZifLockType type,
+			    ZifLockMode mode,
+			    ZifLockAccess access)
+{
+	ZifLockItem *item;
+	guint i;
+
+	for (i = 0; i < lock->priv->item_array->len; i++) {
+		item = g_ptr_array_index (lock->priv->item_array, i);
+		if (item->type != type)
+			continue;
+		if (item->owner == g_thread_self ())
+			continue;
+		if (item->mode != mode &&
+		    !(mode == ZIF_LOCK_MODE_THREAD &&
+		      item->mode == ZIF_LOCK_MODE_PROCESS))
+			continue;
+		if (item->access == ZIF_LOCK_ACCESS_EXCLUSIVE ||
+		    access == ZIF_LOCK_ACCESS_EXCLUSIVE)
+			return item;
+	}
+	return NULL;
+}
+
+/**
+ * zif_lock_has_process_item:
+ **/
+static gboolean
+zif_lock_has_process_item (ZifLock *lock, ZifLockType type)
+{
+	ZifLockItem *item;
+	guint i;
+
+	for (i = 0; i < lock->priv->item_array->len; i++) {
+		item = g_ptr_array_index (lock->priv->item_array, i);
+		if (item->type == type && item->mode == ZIF_LOCK_MODE_PROCESS)
+			return TRUE;
+	}
+	return FALSE;
+}
+
 /**
  * zif_lock_get_item_by_id:
  **/
@@ -170,7 +265,10 @@ zif_lock_get_item_by_id (ZifLock *lock, guint id)
  * zif_lock_create_item:
  **/
 static ZifLockItem *
-zif_lock_create_item (ZifLock *lock, ZifLockType type, ZifLockMode mode)
+zif_lock_create_item (ZifLock *lock,
+		      ZifLockType type,
+		      ZifLockMode mode,
+		      ZifLockAccess access)
 {
 	static guint id = 1;
 	ZifLockItem *item;
@@ -180,6 +278,7 @@ zif_lock_create_item (ZifLock *lock, ZifLockType type, ZifLockMode mode)
 	item->type = type;
 	item->owner = g_thread_self ();
 	item->refcount = 1;
+	item->access = access;
 	item->mode = mode;
 	g_ptr_array_add (lock->priv->item_array, item);
 	return item;
@@ -187,39 +286,31 @@ zif_lock_create_item (ZifLock *lock, ZifLockType type, ZifLockMode mode)
 
 /**
  * zif_lock_get_pid:
+ *
+ * Reads the pid using the lock file we already have open, as opening
+ * and closing the file again would drop our fcntl() locks on it.
  **/
 static guint
-zif_lock_get_pid (ZifLock *lock, const gchar *filename, GError **error)
+zif_lock_get_pid (ZifLock *lock, gint fd, GError **error)
 {
-	gboolean ret;
-	GError *error_local = NULL;
-	guint64 pid = 0;
-	gchar *contents = NULL;
+	gchar contents[32];
 	gchar *endptr = NULL;
+	gssize len;
+	guint64 pid = 0;
 
 	g_return_val_if_fail (ZIF_IS_LOCK (lock), FALSE);
 
-	/* file doesn't exists */
-	ret = g_file_test (filename, G_FILE_TEST_EXISTS);
-	if (!ret) {
-		g_set_error_literal (error,
-				     ZIF_LOCK_ERROR,
-				     ZIF_LOCK_ERROR_FAILED,
-				     "lock file not present");
-		goto out;
-	}
-
 	/* get contents */
-	ret = g_file_get_contents (filename, &contents, NULL, &error_local);
-	if (!ret) {
+	len = pread (fd, contents, sizeof (contents) - 1, 0);
+	if (len < 0) {
 		g_set_error (error,
 			     ZIF_LOCK_ERROR,
 			     ZIF_LOCK_ERROR_FAILED,
 			     "lock file not set: %s",
-			     error_local->message);
-		g_error_free (error_local);
+			     g_strerror (errno));
 		goto out;
 	}
+	contents[len] = '\0';
 
 	/* convert to int */
 	pid = g_ascii_strtoull (contents, &endptr, 10);
@@ -240,10 +331,30 @@ zif_lock_get_pid (ZifLock *lock, const gchar *filename, GError **error)
 		goto out;
 	}
 out:
-	g_free (contents);
 	return (guint) pid;
 }
 
+/**
+ * zif_lock_get_fcntl_pid:
+ *
+ * Gets the pid of another process that holds a fcntl() lock on the
+ * file, or 0 if there is none. Our own locks are never returned.
+ **/
+static guint
+zif_lock_get_fcntl_pid (gint fd)
+{
+	struct flock fl;
+
+	memset (&fl, 0, sizeof (fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	if (fcntl (fd, F_GETLK, &fl) < 0)
+		return 0;
+	if (fl.l_type == F_UNLCK)
+		return 0;
+	return (guint) fl.l_pid;
+}
+
 /**
  * zif_lock_get_filename_for_type:
  **/
@@ -323,7 +434,7 @@ zif_lock_get_state (ZifLock *lock)
 
 	for (i = 0; i < lock->priv->item_array->len; i++) {
 		item = g_ptr_array_index (lock->priv->item_array, i);
-		bitfield += 1 << item->type;
+		bitfield |= 1 << item->type;
 	}
 	return bitfield;
 }
@@ -339,6 +450,317 @@ zif_lock_emit_state (ZifLock *lock)
 	g_signal_emit (lock, signals [SIGNAL_STATE_CHANGED], 0, bitfield);
 }
 
+/**
+ * zif_lock_get_holder:
+ *
+ * Gets a description of the process that holds the lock file.
+ **/
+static gchar *
+zif_lock_get_holder (ZifLock *lock, gint fd)
+{
+	guint pid;
+
+	pid = zif_lock_get_pid (lock, fd, NULL);
+	if (pid == 0)
+		pid = zif_lock_get_fcntl_pid (fd);
+	if (pid == 0)
+		return g_strdup ("another process");
+	return zif_lock_get_cmdline_for_pid (pid);
+}
+
+/**
+ * zif_lock_find_file:
+ *
+ * Finds the lock file if another type already holds it open.
+ **/
+static ZifLockFile *
+zif_lock_find_file (ZifLock *lock, const gchar *filename)
+{
+	guint i;
+
+	for (i = 0; i < ZIF_LOCK_TYPE_LAST; i++) {
+		if (lock->priv->files[i] == NULL)
+			continue;
+		if (g_strcmp0 (lock->priv->files[i]->filename, filename) == 0)
+			return lock->priv->files[i];
+	}
+	return NULL;
+}
+
+/**
+ * zif_lock_set_fd_access:
+ *
+ * Locks the whole file using fcntl() without waiting.
+ **/
+static gboolean
+zif_lock_set_fd_access (ZifLock *lock,
+			gint fd,
+			const gchar *filename,
+			ZifLockAccess access,
+			GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *cmdline = NULL;
+	gint errsv;
+	struct flock fl;
+
+	memset (&fl, 0, sizeof (fl));
+	fl.l_type = access == ZIF_LOCK_ACCESS_SHARED ? F_RDLCK : F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	if (fcntl (fd, F_SETLK, &fl) == 0) {
+		ret = TRUE;
+		goto out;
+	}
+	errsv = errno;
+	if (errsv == EACCES || errsv == EAGAIN) {
+		cmdline = zif_lock_get_holder (lock, fd);
+		g_set_error (error,
+			     ZIF_LOCK_ERROR,
+			     ZIF_LOCK_ERROR_ALREADY_LOCKED,
+			     "already locked by %s",
+			     cmdline);
+		goto out;
+	}
+	g_set_error (error,
+		     ZIF_LOCK_ERROR,
+		     ZIF_LOCK_ERROR_FAILED,
+		     "failed to lock %s: %s",
+		     filename,
+		     g_strerror (errsv));
+out:
+	g_free (cmdline);
+	return ret;
+}
+
+/**
+ * zif_lock_write_pid:
+ *
+ * Writes a pid into the lock file, so that tools that only look at
+ * the pid file see the lock.
+ **/
+static gboolean
+zif_lock_write_pid (ZifLock *lock,
+		    ZifLockType type,
+		    gint fd,
+		    guint pid,
+		    GError **error)
+{
+	gboolean ret = TRUE;
+	gchar *pid_text;
+
+	pid_text = g_strdup_printf ("%i", pid);
+	if (ftruncate (fd, 0) < 0 ||
+	    pwrite (fd, pid_text, strlen (pid_text), 0) < 0) {
+		g_set_error (error,
+			     ZIF_LOCK_ERROR,
+			     ZIF_LOCK_ERROR_PERMISSION,
+			     "failed to obtain lock '%s': %s",
+			     zif_lock_type_to_string (type),
+			     g_strerror (errno));
+		ret = FALSE;
+	}
+	g_free (pid_text);
+	return ret;
+}
+
+/**
+ * zif_lock_take_file:
+ *
+ * Locks the lock file for this type using fcntl() without waiting.
+ * Exclusive holders write their pid into the file, and so does the
+ * first shared holder, so the file is never empty while it is held.
+ *
+ * If another type already holds the same file then its fd is reused,
+ * upgrading the lock if this type needs exclusive access.
+ **/
+static gboolean
+zif_lock_take_file (ZifLock *lock,
+		    ZifLockType type,
+		    ZifLockAccess access,
+		    GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *cmdline = NULL;
+	gchar *filename = NULL;
+	gchar *pid_filename = NULL;
+	gint fd = -1;
+	guint pid;
+	guint pid_shared;
+	struct flock fl;
+	struct stat buf_fd;
+	struct stat buf_path;
+	ZifLockFile *file;
+
+	/* get the lock filename */
+	filename = zif_lock_get_filename_for_type (lock, type, error);
+	if (filename == NULL)
+		goto out;
+
+	/* in compat mode another type may already hold this file */
+	file = zif_lock_find_file (lock, filename);
+	if (file != NULL) {
+		if (access == ZIF_LOCK_ACCESS_EXCLUSIVE &&
+		    file->exclusive == 0) {
+			if (!zif_lock_set_fd_access (lock, file->fd, filename,
+						     access, error))
+				goto out;
+			if (!zif_lock_write_pid (lock, type, file->fd,
+						 getpid (), error)) {
+				memset (&fl, 0, sizeof (fl));
+				fl.l_type = F_RDLCK;
+				fl.l_whence = SEEK_SET;
+				fcntl (file->fd, F_SETLK, &fl);
+				goto out;
+			}
+		}
+		goto success;
+	}
+
+	while (TRUE) {
+		fd = g_open (filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			g_set_error (error,
+				     ZIF_LOCK_ERROR,
+				     ZIF_LOCK_ERROR_PERMISSION,
+				     "failed to obtain lock '%s': %s",
+				     zif_lock_type_to_string (type),
+				     g_strerror (errno));
+			goto out;
+		}
+
+		/* try to lock the whole file */
+		if (!zif_lock_set_fd_access (lock, fd, filename, access, error))
+			goto out;
+
+		/* the last holder may have deleted the file before we
+		 * got the lock, in which case lock the new file */
+		if (fstat (fd, &buf_fd) == 0 &&
+		    g_stat (filename, &buf_path) == 0 &&
+		    buf_fd.st_dev == buf_path.st_dev &&
+		    buf_fd.st_ino == buf_path.st_ino)
+			break;
+		close (fd);
+		fd = -1;
+	}
+
+	/* check the pid is not still running, as the file may have
+	 * been written by something that does not use fcntl(), unless
+	 * it is another shared holder that we are sharing with */
+	pid = zif_lock_get_pid (lock, fd, NULL);
+	pid_shared = zif_lock_get_fcntl_pid (fd);
+	if (pid_shared != 0) {
+		g_debug ("sharing lock with %i", pid_shared);
+	} else if (pid != 0 && pid != (guint) getpid ()) {
+		pid_filename = g_strdup_printf ("/proc/%i/cmdline", pid);
+		if (g_file_test (pid_filename, G_FILE_TEST_EXISTS)) {
+			cmdline = zif_lock_get_cmdline_for_pid (pid);
+			g_set_error (error,
+				     ZIF_LOCK_ERROR,
+				     ZIF_LOCK_ERROR_ALREADY_LOCKED,
+				     "already locked by %s",
+				     cmdline);
+			goto out;
+		}
+	}
+
+	/* write our process ID, leaving the pid of a shared holder
+	 * that is already there */
+	if ((access == ZIF_LOCK_ACCESS_EXCLUSIVE || pid_shared == 0) &&
+	    !zif_lock_write_pid (lock, type, fd, getpid (), error))
+		goto out;
+
+	file = g_new0 (ZifLockFile, 1);
+	file->filename = g_strdup (filename);
+	file->fd = fd;
+	fd = -1;
+success:
+	file->refcount++;
+	if (access == ZIF_LOCK_ACCESS_EXCLUSIVE)
+		file->exclusive |= 1 << type;
+	lock->priv->files[type] = file;
+	ret = TRUE;
+out:
+	if (fd >= 0)
+		close (fd);
+	g_free (pid_filename);
+	g_free (filename);
+	g_free (cmdline);
+	return ret;
+}
+
+/**
+ * zif_lock_release_file:
+ *
+ * Drops the hold this type has on the lock file. When no other type
+ * holds it the file is unlocked, and deleted if no other process has
+ * it open.
+ **/
+static gboolean
+zif_lock_release_file (ZifLock *lock, ZifLockType type, GError **error)
+{
+	gboolean ret = TRUE;
+	gint rc;
+	guint pid;
+	struct flock fl;
+	ZifLockFile *file;
+
+	file = lock->priv->files[type];
+	lock->priv->files[type] = NULL;
+	file->refcount--;
+
+	/* other types still hold the file, so just go back to shared
+	 * access if this was the last exclusive holder, keeping our
+	 * pid in the file */
+	if (file->refcount > 0) {
+		if (file->exclusive == (1u << type)) {
+			memset (&fl, 0, sizeof (fl));
+			fl.l_type = F_RDLCK;
+			fl.l_whence = SEEK_SET;
+			if (fcntl (file->fd, F_SETLK, &fl) < 0) {
+				g_set_error (error,
+					     ZIF_LOCK_ERROR,
+					     ZIF_LOCK_ERROR_FAILED,
+					     "failed to unlock %s: %s",
+					     file->filename,
+					     g_strerror (errno));
+				ret = FALSE;
+			}
+		}
+		file->exclusive &= ~(1u << type);
+		goto out;
+	}
+
+	/* we can only get an exclusive lock if there are no other
+	 * shared holders, and then it is safe to delete */
+	memset (&fl, 0, sizeof (fl));
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	if (fcntl (file->fd, F_SETLK, &fl) == 0) {
+		rc = g_unlink (file->filename);
+		if (rc < 0 && errno != ENOENT) {
+			g_set_error (error,
+				     ZIF_LOCK_ERROR,
+				     ZIF_LOCK_ERROR_PERMISSION,
+				     "failed to write: %s",
+				     g_strerror (errno));
+			ret = FALSE;
+		}
+	} else if (zif_lock_get_pid (lock, file->fd, NULL) == (guint) getpid ()) {
+		/* hand the pid over to a shared holder that is still
+		 * running, as we are dropping our lock */
+		pid = zif_lock_get_fcntl_pid (file->fd);
+		if (pid != 0)
+			ret = zif_lock_write_pid (lock, type, file->fd, pid, error);
+	}
+
+	/* this drops the fcntl lock */
+	close (file->fd);
+	g_free (file->filename);
+	g_free (file);
+out:
+	return ret;
+}
+
 /**
  * zif_lock_take:
  * @lock: A #ZifLock
@@ -346,7 +768,8 @@ zif_lock_emit_state (ZifLock *lock)
  * @mode: A #ZifLockMode, e.g. %ZIF_LOCK_MODE_PROCESS
  * @error: A #GError, or %NULL
  *
- * Tries to take a lock for the packaging system.
+ * Tries to take an exclusive lock for the packaging system, failing
+ * at once if the lock is already held.
  *
  * Return value: A lock ID greater than 0, or 0 for an error.
  *
@@ -357,119 +780,148 @@ zif_lock_take (ZifLock *lock,
 	       ZifLockType type,
 	       ZifLockMode mode,
 	       GError **error)
+{
+	return zif_lock_take_full (lock,
+				   type,
+				   mode,
+				   ZIF_LOCK_ACCESS_EXCLUSIVE,
+				   0,
+				   error);
+}
+
+/**
+ * zif_lock_take_full:
+ * @lock: A #ZifLock
+ * @type: A #ZifLockType, e.g. %ZIF_LOCK_TYPE_RPMDB
+ * @mode: A #ZifLockMode, e.g. %ZIF_LOCK_MODE_PROCESS
+ * @access: A #ZifLockAccess, e.g. %ZIF_LOCK_ACCESS_SHARED
+ * @timeout: The time to wait for the lock in ms, 0 to not wait, or
+ * %G_MAXUINT to wait for ever
+ * @error: A #GError, or %NULL
+ *
+ * Tries to take a lock for the packaging system, waiting for other
+ * threads and processes to release it if required.
+ *
+ * A thread that already holds an exclusive lock can also take a shared
+ * lock of the same type, but a shared lock cannot be upgraded.
+ *
+ * Return value: A lock ID greater than 0, or 0 for an error.
+ *
+ * Since: 0.3.7
+ **/
+guint
+zif_lock_take_full (ZifLock *lock,
+		    ZifLockType type,
+		    ZifLockMode mode,
+		    ZifLockAccess access,
+		    guint timeout,
+		    GError **error)
 {
 	gboolean ret;
-	gchar *cmdline = NULL;
-	gchar *filename = NULL;
-	gchar *pid_filename = NULL;
-	gchar *pid_text = NULL;
 	GError *error_local = NULL;
+	gint64 end_time = G_MAXINT64;
+	gint64 now;
 	guint id = 0;
-	guint pid;
 	ZifLockItem *item;
 
 	g_return_val_if_fail (ZIF_IS_LOCK (lock), FALSE);
+	g_return_val_if_fail (type < ZIF_LOCK_TYPE_LAST, FALSE);
+	g_return_val_if_fail (access < ZIF_LOCK_ACCESS_LAST, FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+	/* get the deadline */
+	if (timeout != G_MAXUINT)
+		end_time = g_get_monotonic_time () + (gint64) timeout * 1000;
+
 	/* lock other threads */
 	g_mutex_lock (&lock->priv->mutex);
 
-	/* find the lock type, and ensure we find a process lock for
-	 * a thread lock */
-	item = zif_lock_get_item_by_type_mode (lock, type, mode);
-	if (item == NULL && mode == ZIF_LOCK_MODE_THREAD) {
-		item = zif_lock_get_item_by_type_mode (lock,
-						       type,
-						       ZIF_LOCK_MODE_PROCESS);
-	}
+	while (TRUE) {
 
-	/* create a lock file for process locks */
-	if (item == NULL && mode == ZIF_LOCK_MODE_PROCESS) {
+		/* find the lock type, and ensure we find a process lock
+		 * for a thread lock */
+		item = zif_lock_get_item_for_thread (lock, type, mode);
+		if (item == NULL && mode == ZIF_LOCK_MODE_THREAD) {
+			item = zif_lock_get_item_for_thread (lock,
+							     type,
+							     ZIF_LOCK_MODE_PROCESS);
+		}
+		if (item != NULL) {
+			if (item->access == ZIF_LOCK_ACCESS_SHARED &&
+			    access == ZIF_LOCK_ACCESS_EXCLUSIVE) {
+				g_set_error (error,
+					     ZIF_LOCK_ERROR,
+					     ZIF_LOCK_ERROR_FAILED,
+					     "cannot upgrade shared lock '%s' to exclusive",
+					     zif_lock_type_to_string (type));
+				goto out;
+			}
 
-		/* get the lock filename */
-		filename = zif_lock_get_filename_for_type (lock,
-							   type,
-							   error);
-		if (filename == NULL)
-			goto out;
+			/* increment ref count */
+			item->refcount++;
 
-		/* does file already exists? */
-		if (g_file_test (filename, G_FILE_TEST_EXISTS)) {
+			/* emit the new locking bitfield */
+			zif_lock_emit_state (lock);
 
-			/* check the pid is still valid */
-			pid = zif_lock_get_pid (lock, filename, error);
-			if (pid == 0)
-				goto out;
+			/* success */
+			id = item->id;
+			goto out;
+		}
 
-			/* pid is not still running? */
-			pid_filename = g_strdup_printf ("/proc/%i/cmdline",
-							pid);
-			ret = g_file_test (pid_filename, G_FILE_TEST_EXISTS);
-			if (ret) {
-				cmdline = zif_lock_get_cmdline_for_pid (pid);
+		/* we're trying to lock something that's already locked
+		 * in another thread */
+		item = zif_lock_get_item_conflict (lock, type, mode, access);
+		if (item != NULL) {
+			if (g_get_monotonic_time () >= end_time) {
 				g_set_error (error,
 					     ZIF_LOCK_ERROR,
-					     ZIF_LOCK_ERROR_ALREADY_LOCKED,
-					     "already locked by %s",
-					     cmdline);
+					     ZIF_LOCK_ERROR_FAILED,
+					     "failed to obtain lock '%s' already taken by thread %p",
+					     zif_lock_type_to_string (type),
+					     item->owner);
 				goto out;
 			}
+			if (end_time == G_MAXINT64)
+				g_cond_wait (&lock->priv->cond, &lock->priv->mutex);
+			else
+				g_cond_wait_until (&lock->priv->cond, &lock->priv->mutex, end_time);
+			continue;
 		}
 
-		/* create file with our process ID */
-		pid_text = g_strdup_printf ("%i", getpid ());
-		ret = g_file_set_contents (filename,
-					   pid_text,
-					   -1,
-					   &error_local);
-		if (!ret) {
-			g_set_error (error,
-				     ZIF_LOCK_ERROR,
-				     ZIF_LOCK_ERROR_PERMISSION,
-				     "failed to obtain lock '%s': %s",
-				     zif_lock_type_to_string (type),
-				     error_local->message);
-			g_error_free (error_local);
-			goto out;
+		/* lock the file for process locks, unless another thread
+		 * in this process already holds it shared */
+		if (mode == ZIF_LOCK_MODE_PROCESS &&
+		    lock->priv->files[type] == NULL) {
+			ret = zif_lock_take_file (lock, type, access, &error_local);
+			if (!ret) {
+				now = g_get_monotonic_time ();
+				if (now >= end_time ||
+				    !g_error_matches (error_local,
+						      ZIF_LOCK_ERROR,
+						      ZIF_LOCK_ERROR_ALREADY_LOCKED)) {
+					g_propagate_error (error, error_local);
+					goto out;
+				}
+				g_debug ("waiting for lock: %s", error_local->message);
+				g_clear_error (&error_local);
+
+				/* let other threads release locks while we sleep */
+				g_mutex_unlock (&lock->priv->mutex);
+				g_usleep (MIN (ZIF_LOCK_POLL_INTERVAL, end_time - now));
+				g_mutex_lock (&lock->priv->mutex);
+				continue;
+			}
 		}
-	}
 
-	/* create new lock */
-	if (item == NULL) {
-		item = zif_lock_create_item (lock, type, mode);
+		/* create new lock */
+		item = zif_lock_create_item (lock, type, mode, access);
 		id = item->id;
 		zif_lock_emit_state (lock);
-		goto out;
+		break;
 	}
-
-	/* we're trying to lock something that's already locked
-	 * in another thread */
-	if (item->owner != g_thread_self ()) {
-		g_set_error (error,
-			     ZIF_LOCK_ERROR,
-			     ZIF_LOCK_ERROR_FAILED,
-			     "failed to obtain lock '%s' already taken by thread %p",
-			     zif_lock_type_to_string (type),
-			     item->owner);
-		goto out;
-	}
-
-	/* increment ref count */
-	item->refcount++;
-
-	/* emit the new locking bitfield */
-	zif_lock_emit_state (lock);
-
-	/* success */
-	id = item->id;
 out:
 	/* unlock other threads */
 	g_mutex_unlock (&lock->priv->mutex);
-
-	g_free (pid_text);
-	g_free (pid_filename);
-	g_free (filename);
-	g_free (cmdline);
 	return id;
 }
 
@@ -489,10 +941,8 @@ gboolean
 zif_lock_release (ZifLock *lock, guint id, GError **error)
 {
 	gboolean ret = FALSE;
-	gchar *filename = NULL;
-	GError *error_local = NULL;
-	GFile *file = NULL;
 	ZifLockItem *item;
+	ZifLockType type;
 
 	g_return_val_if_fail (ZIF_IS_LOCK (lock), FALSE);
 	g_return_val_if_fail (id != 0, FALSE);
@@ -524,34 +974,22 @@ zif_lock_release (ZifLock *lock, guint id, GError **error)
 	/* idecrement ref count */
 	item->refcount--;
 
-	/* delete file for process locks */
-	if (item->refcount == 0 &&
-	    item->mode == ZIF_LOCK_MODE_PROCESS) {
-
-		/* get the lock filename */
-		filename = zif_lock_get_filename_for_type (lock,
-							   item->type,
-							   error);
-		if (filename == NULL)
-			goto out;
+	/* no thread now owns this lock */
+	if (item->refcount == 0) {
+		type = item->type;
+		g_ptr_array_remove (lock->priv->item_array, item);
 
-		/* unlink */
-		file = g_file_new_for_path (filename);
-		ret = g_file_delete (file, NULL, &error_local);
-		if (!ret) {
-			g_set_error (error,
-				     ZIF_LOCK_ERROR,
-				     ZIF_LOCK_ERROR_PERMISSION,
-				     "failed to write: %s",
-				     error_local->message);
-			g_error_free (error_local);
-			goto out;
+		/* unlock the file when the last process lock has gone */
+		if (lock->priv->files[type] != NULL &&
+		    !zif_lock_has_process_item (lock, type)) {
+			ret = zif_lock_release_file (lock, type, error);
+			if (!ret)
+				goto out;
 		}
-	}
 
-	/* no thread now owns this lock */
-	if (item->refcount == 0)
-		g_ptr_array_remove (lock->priv->item_array, item);
+		/* wake up any threads waiting for this */
+		g_cond_broadcast (&lock->priv->cond);
+	}
 
 	/* emit the new locking bitfield */
 	zif_lock_emit_state (lock);
@@ -561,9 +999,6 @@ zif_lock_release (ZifLock *lock, guint id, GError **error)
 out:
 	/* unlock other threads */
 	g_mutex_unlock (&lock->priv->mutex);
-	if (file != NULL)
-		g_object_unref (file);
-	g_free (filename);
 	return ret;
 }
 
@@ -609,12 +1044,16 @@ zif_lock_finalize (GObject *object)
 		if (item->refcount > 0) {
 			g_warning ("held lock %s at shutdown",
 				   zif_lock_type_to_string (item->type));
-			zif_lock_release (lock, item->type, NULL);
 		}
 	}
+	for (i = 0; i < ZIF_LOCK_TYPE_LAST; i++) {
+		if (lock->priv->files[i] != NULL)
+			zif_lock_release_file (lock, i, NULL);
+	}
 
 	g_object_unref (lock->priv->config);
 	g_ptr_array_unref (lock->priv->item_array);
+	g_cond_clear (&lock->priv->cond);
 
 	G_OBJECT_CLASS (zif_lock_parent_class)->finalize (object);
 }
@@ -647,6 +1086,7 @@ zif_lock_init (ZifLock *lock)
 	lock->priv = ZIF_LOCK_GET_PRIVATE (lock);
 	lock->priv->config = zif_config_new ();
 	lock->priv->item_array = g_ptr_array_new_with_free_func (g_free);
+	g_cond_init (&lock->priv->cond);
 }
 
 /**
@@ -86,6 +86,12 @@ typedef enum {
 	ZIF_LOCK_MODE_LAST
 } ZifLockMode;
 
+typedef enum {
+	ZIF_LOCK_ACCESS_EXCLUSIVE,
+	ZIF_LOCK_ACCESS_SHARED,
+	ZIF_LOCK_ACCESS_LAST
+} ZifLockAccess;
+
 GType		 zif_lock_get_type		(void);
 GQuark		 zif_lock_error_quark		(void);
 ZifLock		*zif_lock_new			(void);
@@ -95,12 +101,19 @@ guint		 zif_lock_take			(ZifLock	*lock,
 						 ZifLockType	 type,
 						 ZifLockMode	 mode,
 						 GError		**error);
+guint		 zif_lock_take_full		(ZifLock	*lock,
+						 ZifLockType	 type,
+						 ZifLockMode	 mode,
+						 ZifLockAccess	 access,
+						 guint		 timeout,
+						 GError		**error);
 gboolean	 zif_lock_release		(ZifLock	*lock,
 						 guint		 id,
 						 GError		**error);
 void		 zif_lock_release_noerror	(ZifLock	*lock,
 						 guint		 id);
 const gchar	*zif_lock_type_to_string	(ZifLockType	 lock_type);
+const gchar	*zif_lock_access_to_string	(ZifLockAccess	 access);
 guint		 zif_lock_get_state		(ZifLock	*lock);
 
 G_END_DECLS
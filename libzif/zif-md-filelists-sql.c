@@ -44,6 +44,33 @@
 
 #define ZIF_MD_FILELISTS_SQL_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ZIF_TYPE_MD_FILELISTS_SQL, ZifMdFilelistsSqlPrivate))
 
+typedef enum {
+	ZIF_MD_FILELISTS_SQL_STMT_FILES_ADD,
+	ZIF_MD_FILELISTS_SQL_STMT_FILES_CLEAR,
+	ZIF_MD_FILELISTS_SQL_STMT_SEARCH_FILE,
+	ZIF_MD_FILELISTS_SQL_STMT_GET_FILES,
+	ZIF_MD_FILELISTS_SQL_STMT_ALL_FILES,
+	ZIF_MD_FILELISTS_SQL_STMT_LAST
+} ZifMdFilelistsSqlStmt;
+
+/* this has to be kept in the same order as ZifMdFilelistsSqlStmt */
+static const gchar *zif_md_filelists_sql_statements[] = {
+	"INSERT OR IGNORE INTO zif_files (dirname, basename) VALUES (?1, ?2);",
+	"DELETE FROM zif_files;",
+	/* the filenames are stored with a / to separate them, so the
+	 * basename is matched with its separators on both sides, and the
+	 * join order is fixed so the dirname index is always used */
+	"SELECT DISTINCT p.pkgId FROM zif_files t CROSS JOIN filelist f "
+		"CROSS JOIN packages p WHERE f.dirname = t.dirname AND "
+		"p.pkgKey = f.pkgKey AND "
+		"instr('/'||f.filenames||'/', '/'||t.basename||'/') > 0;",
+	"SELECT dirname, filenames FROM packages p, filelist f WHERE "
+		"p.pkgKey = f.pkgKey AND p.pkgId = ?1;",
+	"SELECT p.pkgId, f.dirname, f.filenames FROM packages p, filelist f "
+		"WHERE p.pkgKey = f.pkgKey;",
+	NULL
+};
+
 /**
  * ZifMdFilelistsSqlPrivate:
  *
@@ -53,13 +80,9 @@ struct _ZifMdFilelistsSqlPrivate
 {
 	gboolean		 loaded;
 	sqlite3			*db;
+	sqlite3_stmt		*stmts[ZIF_MD_FILELISTS_SQL_STMT_LAST];
 };
 
-typedef struct {
-	gchar			*filename;
-	GPtrArray		*array;
-} ZifMdFilelistsSqlData;
-
 G_DEFINE_TYPE (ZifMdFilelistsSql, zif_md_filelists_sql, ZIF_TYPE_MD)
 
 /**
@@ -79,7 +102,9 @@ static gboolean
 zif_md_filelists_sql_load (ZifMd *md, ZifState *state, GError **error)
 {
 	const gchar *filename;
+	gchar *error_msg = NULL;
 	gint rc;
+	guint i;
 	ZifMdFilelistsSql *filelists = ZIF_MD_FILELISTS_SQL (md);
 
 	g_return_val_if_fail (ZIF_IS_MD_FILELISTS_SQL (md), FALSE);
@@ -110,98 +135,52 @@ zif_md_filelists_sql_load (ZifMd *md, ZifState *state, GError **error)
 
 	/* we don't need to keep syncing */
 	sqlite3_exec (filelists->priv->db, "PRAGMA synchronous=OFF", NULL, NULL, NULL);
-	filelists->priv->loaded = TRUE;
-out:
-	return filelists->priv->loaded;
-}
 
-/**
- * zif_md_filelists_sql_sqlite_get_id_cb:
- **/
-static gint
-zif_md_filelists_sql_sqlite_get_id_cb (void *data, gint argc, gchar **argv, gchar **col_name)
-{
-	gchar **pkgid = (gchar **) data;
-	*pkgid = g_strdup (argv[0]);
-	return 0;
-}
-
-/**
- * zif_md_filelists_sql_sqlite_get_pkgkey_cb:
- **/
-static gint
-zif_md_filelists_sql_sqlite_get_pkgkey_cb (void *data, gint argc, gchar **argv, gchar **col_name)
-{
-	gint i;
-	gchar **filenames = NULL;
-	gchar **filenames_r = NULL;
-	gchar **id_r = NULL;
-	ZifMdFilelistsSqlData *fldata = (ZifMdFilelistsSqlData *) data;
-
-	/* get pointers to the arguments */
-	for (i = 0; i < argc; i++) {
-		if (g_strcmp0 (col_name[i], "pkgKey") == 0)
-			id_r = &argv[i];
-		else if (g_strcmp0 (col_name[i], "filenames") == 0)
-			filenames_r = &argv[i];
-	}
-
-	/* either is undereferencable */
-	if (filenames_r == NULL || id_r == NULL) {
-		g_warning ("no file data");
+	/* the files to search for are added here for each query */
+	sqlite3_exec (filelists->priv->db, "PRAGMA temp_store=MEMORY", NULL, NULL, NULL);
+	rc = sqlite3_exec (filelists->priv->db,
+			   "CREATE TEMP TABLE zif_files (dirname TEXT, basename TEXT, "
+			   "PRIMARY KEY (dirname, basename));",
+			   NULL, NULL, &error_msg);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+			     "SQL error: %s", error_msg);
+		sqlite3_free (error_msg);
 		goto out;
 	}
 
-	/* split the filenames */
-	filenames = g_strsplit (*filenames_r, "/", -1);
-	for (i = 0; filenames[i] != NULL ; i++) {
-		/* do we match */
-		if (g_strcmp0 (fldata->filename, filenames[i]) == 0) {
-			g_debug ("found %s for %s", filenames[i], *id_r);
-			g_ptr_array_add (fldata->array, GUINT_TO_POINTER (atoi (*id_r)));
+	/* compile all the statements we're going to use just once */
+	for (i = 0; i < ZIF_MD_FILELISTS_SQL_STMT_LAST; i++) {
+		rc = sqlite3_prepare_v2 (filelists->priv->db,
+					 zif_md_filelists_sql_statements[i],
+					 -1,
+					 &filelists->priv->stmts[i],
+					 NULL);
+		if (rc != SQLITE_OK) {
+			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+				     "failed to prepare statement: %s",
+				     sqlite3_errmsg (filelists->priv->db));
+			goto out;
 		}
 	}
+
+	filelists->priv->loaded = TRUE;
 out:
-	g_strfreev (filenames);
-	return 0;
+	return filelists->priv->loaded;
 }
 
 /**
- * zif_md_filelists_sql_sqlite_get_files_cb:
+ * zif_md_filelists_sql_debug_stmt:
  **/
-static gint
-zif_md_filelists_sql_sqlite_get_files_cb (void *data, gint argc, gchar **argv, gchar **col_name)
+static void
+zif_md_filelists_sql_debug_stmt (ZifMd *md, sqlite3_stmt *stmt)
 {
-	gchar **dirname = NULL;
-	gchar **filename = NULL;
-	gchar **split;
-	gint i;
-	GPtrArray **array = (GPtrArray **) data;
-
-	/* get pointers to the arguments */
-	for (i = 0; i < argc; i++) {
-		if (g_strcmp0 (col_name[i], "filenames") == 0)
-			filename = &argv[i];
-		else if (g_strcmp0 (col_name[i], "dirname") == 0)
-			dirname = &argv[i];
-	}
-
-	/* check for invalid entries */
-	if (filename == NULL || dirname == NULL) {
-		g_warning ("failed on %p, %p", filename, dirname);
-		return 0;
-	}
-
-	/* the repomd is encoded with a / to separate files... urgh */
-	split = g_strsplit (*filename, "/", -1);
-	for (i = 0; split[i] != NULL; i++) {
-		g_ptr_array_add (*array,
-				 g_build_filename (*dirname,
-						   split[i],
-						   NULL));
+	/* print the statement, without the bound values */
+	if (g_getenv ("ZIF_SQL_DEBUG") != NULL) {
+		g_debug ("On %s\n%s",
+			 zif_md_get_filename_uncompressed (md),
+			 sqlite3_sql (stmt));
 	}
-	g_strfreev (split);
-	return 0;
 }
 
 /**
@@ -211,14 +190,16 @@ static GPtrArray *
 zif_md_filelists_sql_get_files (ZifMd *md, ZifPackage *package,
 				ZifState *state, GError **error)
 {
-	gchar *statement = NULL;
-	gint rc;
-	gboolean ret;
+	const gchar *dirname;
 	const gchar *pkgid;
+	gboolean ret;
+	gchar **split;
+	gint rc;
+	guint i;
 	GError *error_local = NULL;
-	gchar *error_msg = NULL;
 	GPtrArray *array = NULL;
 	GPtrArray *files = NULL;
+	sqlite3_stmt *stmt;
 	ZifMdFilelistsSql *md_filelists_sql = ZIF_MD_FILELISTS_SQL (md);
 
 	g_return_val_if_fail (zif_state_valid (state), NULL);
@@ -234,25 +215,27 @@ zif_md_filelists_sql_get_files (ZifMd *md, ZifPackage *package,
 		}
 	}
 
-	/* get pkgkey from pkgid */
+	/* get files for pkgid */
 	pkgid = zif_package_get_pkgid (package);
-
-	/* get files for pkgkey */
+	stmt = md_filelists_sql->priv->stmts[ZIF_MD_FILELISTS_SQL_STMT_GET_FILES];
+	zif_md_filelists_sql_debug_stmt (md, stmt);
+	sqlite3_bind_text (stmt, 1, pkgid, -1, SQLITE_STATIC);
 	files = g_ptr_array_new_with_free_func (g_free);
-	statement = g_strdup_printf ("SELECT dirname, filenames FROM packages p, filelist f WHERE "
-				     "p.pkgKey = f.pkgKey AND "
-				     "p.pkgId = '%s'", pkgid);
-	if (g_getenv ("ZIF_SQL_DEBUG") != NULL) {
-		g_debug ("On %s\n%s",
-			 zif_md_get_filename_uncompressed (md),
-			 statement);
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+		dirname = (const gchar *) sqlite3_column_text (stmt, 0);
+
+		/* the repomd is encoded with a / to separate files... urgh */
+		split = g_strsplit ((const gchar *) sqlite3_column_text (stmt, 1), "/", -1);
+		for (i = 0; split[i] != NULL; i++)
+			g_ptr_array_add (files, g_build_filename (dirname, split[i], NULL));
+		g_strfreev (split);
 	}
-	rc = sqlite3_exec (md_filelists_sql->priv->db, statement, zif_md_filelists_sql_sqlite_get_files_cb, &files, &error_msg);
-	g_free (statement);
-	if (rc != SQLITE_OK) {
+	sqlite3_reset (stmt);
+	sqlite3_clear_bindings (stmt);
+	if (rc != SQLITE_DONE) {
 		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
-			     "SQL error (failed to get packages): %s", error_msg);
-		sqlite3_free (error_msg);
+			     "SQL error (failed to get packages): %s",
+			     sqlite3_errmsg (md_filelists_sql->priv->db));
 		goto out;
 	}
 
@@ -264,8 +247,102 @@ out:
 	return array;
 }
 
+/**
+ * zif_md_filelists_sql_foreach_file:
+ **/
+static gboolean
+zif_md_filelists_sql_foreach_file (ZifMd *md, ZifMdFileFunc func,
+				   gpointer user_data, ZifState *state,
+				   GError **error)
+{
+	const gchar *dirname;
+	const gchar *pkgid;
+	gboolean ret;
+	gchar **split;
+	gchar *filename;
+	gint rc;
+	guint i;
+	GError *error_local = NULL;
+	sqlite3_stmt *stmt;
+	ZifMdFilelistsSql *md_filelists_sql = ZIF_MD_FILELISTS_SQL (md);
+
+	g_return_val_if_fail (zif_state_valid (state), FALSE);
+
+	/* if not already loaded, load */
+	if (!md_filelists_sql->priv->loaded) {
+		ret = zif_md_load (md, state, &error_local);
+		if (!ret) {
+			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_FAILED_TO_LOAD,
+				     "failed to load store file: %s", error_local->message);
+			g_error_free (error_local);
+			goto out;
+		}
+	}
+
+	/* walk every directory of every package */
+	stmt = md_filelists_sql->priv->stmts[ZIF_MD_FILELISTS_SQL_STMT_ALL_FILES];
+	zif_md_filelists_sql_debug_stmt (md, stmt);
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+		pkgid = (const gchar *) sqlite3_column_text (stmt, 0);
+		dirname = (const gchar *) sqlite3_column_text (stmt, 1);
+		split = g_strsplit ((const gchar *) sqlite3_column_text (stmt, 2), "/", -1);
+		for (i = 0; split[i] != NULL; i++) {
+			filename = g_build_filename (dirname, split[i], NULL);
+			func (pkgid, filename, user_data);
+			g_free (filename);
+		}
+		g_strfreev (split);
+	}
+	sqlite3_reset (stmt);
+	ret = (rc == SQLITE_DONE);
+	if (!ret) {
+		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+			     "SQL error (failed to get files): %s",
+			     sqlite3_errmsg (md_filelists_sql->priv->db));
+		goto out;
+	}
+out:
+	return ret;
+}
+
+/**
+ * zif_md_filelists_sql_add_file:
+ **/
+static gboolean
+zif_md_filelists_sql_add_file (ZifMdFilelistsSql *md,
+			       const gchar *filename,
+			       GError **error)
+{
+	gboolean ret = TRUE;
+	gchar *basename;
+	gchar *dirname;
+	gint rc;
+	sqlite3_stmt *stmt = md->priv->stmts[ZIF_MD_FILELISTS_SQL_STMT_FILES_ADD];
+
+	/* split the search term into directory and filename */
+	dirname = g_path_get_dirname (filename);
+	basename = g_path_get_basename (filename);
+	sqlite3_bind_text (stmt, 1, dirname, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, basename, -1, SQLITE_STATIC);
+	rc = sqlite3_step (stmt);
+	if (rc != SQLITE_DONE) {
+		ret = FALSE;
+		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+			     "SQL error (failed to add %s): %s",
+			     filename, sqlite3_errmsg (md->priv->db));
+	}
+	sqlite3_reset (stmt);
+	sqlite3_clear_bindings (stmt);
+	g_free (dirname);
+	g_free (basename);
+	return ret;
+}
+
 /**
  * zif_md_filelists_sql_search_file:
+ *
+ * Finds the pkgId's of the packages that contain any of the files,
+ * using a single query for all of them.
  **/
 static GPtrArray *
 zif_md_filelists_sql_search_file (ZifMd *md, gchar **search,
@@ -273,18 +350,13 @@ zif_md_filelists_sql_search_file (ZifMd *md, gchar **search,
 {
 	GPtrArray *array = NULL;
 	GPtrArray *array_tmp = NULL;
-	GPtrArray *pkgkey_array = NULL;
-	gchar *statement = NULL;
-	gchar *error_msg = NULL;
 	gint rc;
 	gboolean ret;
-	guint i, j;
+	guint i;
 	GError *error_local = NULL;
-	gchar *filename = NULL;
-	gchar *dirname = NULL;
+	sqlite3_stmt *stmt;
 	ZifState *state_local;
 	ZifMdFilelistsSql *md_filelists_sql = ZIF_MD_FILELISTS_SQL (md);
-	ZifMdFilelistsSqlData *data = NULL;
 
 	g_return_val_if_fail (ZIF_IS_MD_FILELISTS_SQL (md), NULL);
 	g_return_val_if_fail (zif_state_valid (state), NULL);
@@ -294,15 +366,15 @@ zif_md_filelists_sql_search_file (ZifMd *md, gchar **search,
 	if (md_filelists_sql->priv->loaded) {
 		ret = zif_state_set_steps (state,
 					   error,
+					   2, /* add files */
 					   98, /* search */
-					   2, /* convert pkgkey */
 					   -1);
 	} else {
 		ret = zif_state_set_steps (state,
 					   error,
 					   50, /* load */
-					   25, /* search */
-					   25, /* convert pkgkey */
+					   1, /* add files */
+					   49, /* search */
 					   -1);
 	}
 	if (!ret)
@@ -325,44 +397,11 @@ zif_md_filelists_sql_search_file (ZifMd *md, gchar **search,
 			goto out;
 	}
 
-	/* search each part of the array */
-	state_local = zif_state_get_child (state);
-	zif_state_set_number_steps (state_local, g_strv_length (search));
-	pkgkey_array = g_ptr_array_new ();
-	for (j = 0; search[j] != NULL; j++) {
-
-		/* split the search term into directory and filename */
-		dirname = g_path_get_dirname (search[j]);
-		filename = g_path_get_basename (search[j]);
-		g_debug ("find in %s dirname=%s, filename=%s", zif_md_get_id (md), dirname, filename);
-
-		/* create data struct we can pass to the callback */
-		data = g_new0 (ZifMdFilelistsSqlData, 1);
-		data->filename = g_path_get_basename (search[j]);
-		data->array = pkgkey_array;
-
-		/* populate _array with guint pkgKey */
-		statement = g_strdup_printf ("SELECT filenames, pkgKey FROM filelist WHERE dirname = '%s'", dirname);
-		if (g_getenv ("ZIF_SQL_DEBUG") != NULL) {
-			g_debug ("On %s\n%s",
-				 zif_md_get_filename_uncompressed (md),
-				 statement);
-		}
-		rc = sqlite3_exec (md_filelists_sql->priv->db, statement, zif_md_filelists_sql_sqlite_get_pkgkey_cb, data, &error_msg);
-		g_free (statement);
-		g_free (dirname);
-		g_free (filename);
-		g_free (data->filename);
-		g_free (data);
-		if (rc != SQLITE_OK) {
-			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
-				     "SQL error (failed to get keys for %s): %s\n", search[j], error_msg);
-			sqlite3_free (error_msg);
-			goto out;
-		}
-
-		/* done */
-		ret = zif_state_done (state_local, error);
+	/* add all the files in one transaction */
+	sqlite3_exec (md_filelists_sql->priv->db, "BEGIN;", NULL, NULL, NULL);
+	for (i = 0; search[i] != NULL; i++) {
+		g_debug ("find in %s: %s", zif_md_get_id (md), search[i]);
+		ret = zif_md_filelists_sql_add_file (md_filelists_sql, search[i], error);
 		if (!ret)
 			goto out;
 	}
@@ -372,38 +411,19 @@ zif_md_filelists_sql_search_file (ZifMd *md, gchar **search,
 	if (!ret)
 		goto out;
 
-	/* convert each pkgKey */
+	/* get the pkgId of every package with a matching file */
+	zif_state_set_allow_cancel (state, FALSE);
+	stmt = md_filelists_sql->priv->stmts[ZIF_MD_FILELISTS_SQL_STMT_SEARCH_FILE];
+	zif_md_filelists_sql_debug_stmt (md, stmt);
 	array_tmp = g_ptr_array_new_with_free_func ((GDestroyNotify) g_free);
-	for (i = 0; i < pkgkey_array->len; i++) {
-		guint key;
-		gchar *pkgid = NULL;
-
-		/* convert the pkgKey to a pkgId */
-		key = GPOINTER_TO_UINT (g_ptr_array_index (pkgkey_array, i));
-		statement = g_strdup_printf ("SELECT pkgId FROM packages WHERE pkgKey = %i LIMIT 1", key);
-		if (g_getenv ("ZIF_SQL_DEBUG") != NULL) {
-			g_debug ("On %s\n%s",
-				 zif_md_get_filename_uncompressed (md),
-				 statement);
-		}
-		rc = sqlite3_exec (md_filelists_sql->priv->db, statement, zif_md_filelists_sql_sqlite_get_id_cb, &pkgid, &error_msg);
-		g_free (statement);
-		if (rc != SQLITE_OK) {
-			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
-				     "SQL error (failed to get packages): %s", error_msg);
-			sqlite3_free (error_msg);
-			goto out;
-		}
-
-		/* we failed to get any results */
-		if (pkgid == NULL) {
-			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
-				     "failed to resolve pkgKey: %i", key);
-			goto out;
-		}
-
-		/* added to tracked array, so no need to free pkgid */
-		g_ptr_array_add (array_tmp, pkgid);
+	while ((rc = sqlite3_step (stmt)) == SQLITE_ROW)
+		g_ptr_array_add (array_tmp, g_strdup ((const gchar *) sqlite3_column_text (stmt, 0)));
+	sqlite3_reset (stmt);
+	if (rc != SQLITE_DONE) {
+		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+			     "SQL error (failed to search for files): %s",
+			     sqlite3_errmsg (md_filelists_sql->priv->db));
+		goto out;
 	}
 
 	/* done */
@@ -414,8 +434,12 @@ zif_md_filelists_sql_search_file (ZifMd *md, gchar **search,
 	/* success */
 	array = g_ptr_array_ref (array_tmp);
 out:
-	if (pkgkey_array != NULL)
-		g_ptr_array_unref (pkgkey_array);
+	if (md_filelists_sql->priv->loaded) {
+		stmt = md_filelists_sql->priv->stmts[ZIF_MD_FILELISTS_SQL_STMT_FILES_CLEAR];
+		sqlite3_step (stmt);
+		sqlite3_reset (stmt);
+		sqlite3_exec (md_filelists_sql->priv->db, "END;", NULL, NULL, NULL);
+	}
 	if (array_tmp != NULL)
 		g_ptr_array_unref (array_tmp);
 	return array;
@@ -427,12 +451,17 @@ out:
 static void
 zif_md_filelists_sql_finalize (GObject *object)
 {
+	guint i;
 	ZifMdFilelistsSql *md;
 
 	g_return_if_fail (object != NULL);
 	g_return_if_fail (ZIF_IS_MD_FILELISTS_SQL (object));
 	md = ZIF_MD_FILELISTS_SQL (object);
 
+	for (i = 0; i < ZIF_MD_FILELISTS_SQL_STMT_LAST; i++) {
+		if (md->priv->stmts[i] != NULL)
+			sqlite3_finalize (md->priv->stmts[i]);
+	}
 	sqlite3_close (md->priv->db);
 
 	G_OBJECT_CLASS (zif_md_filelists_sql_parent_class)->finalize (object);
@@ -453,6 +482,7 @@ zif_md_filelists_sql_class_init (ZifMdFilelistsSqlClass *klass)
 	md_class->unload = zif_md_filelists_sql_unload;
 	md_class->search_file = zif_md_filelists_sql_search_file;
 	md_class->get_files = zif_md_filelists_sql_get_files;
+	md_class->foreach_file = zif_md_filelists_sql_foreach_file;
 	g_type_class_add_private (klass, sizeof (ZifMdFilelistsSqlPrivate));
 }
 
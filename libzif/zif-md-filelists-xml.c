@@ -544,6 +544,79 @@ out:
 	return array;
 }
 
+/**
+ * zif_md_filelists_xml_foreach_file:
+ **/
+static gboolean
+zif_md_filelists_xml_foreach_file (ZifMd *md, ZifMdFileFunc func,
+				   gpointer user_data, ZifState *state,
+				   GError **error)
+{
+	const gchar *pkgid;
+	gboolean ret = TRUE;
+	GError *error_local = NULL;
+	GPtrArray *files;
+	guint i, j;
+	ZifPackage *package;
+	ZifState *state_local;
+	ZifMdFilelistsXml *md_filelists = ZIF_MD_FILELISTS_XML (md);
+
+	g_return_val_if_fail (ZIF_IS_MD_FILELISTS_XML (md), FALSE);
+	g_return_val_if_fail (zif_state_valid (state), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* setup state */
+	if (md_filelists->priv->loaded) {
+		zif_state_set_number_steps (state, 1);
+	} else {
+		ret = zif_state_set_steps (state,
+					   error,
+					   80, /* load */
+					   20, /* walk files */
+					   -1);
+		if (!ret)
+			goto out;
+	}
+
+	/* if not already loaded, load */
+	if (!md_filelists->priv->loaded) {
+		state_local = zif_state_get_child (state);
+		ret = zif_md_load (ZIF_MD (md), state_local, &error_local);
+		if (!ret) {
+			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_FAILED_TO_LOAD,
+				     "failed to load md_filelists_xml file: %s", error_local->message);
+			g_error_free (error_local);
+			goto out;
+		}
+
+		/* this section done */
+		ret = zif_state_done (state, error);
+		if (!ret)
+			goto out;
+	}
+
+	/* the files were all parsed when loading */
+	state_local = zif_state_get_child (state);
+	for (i = 0; i < md_filelists->priv->array->len; i++) {
+		package = g_ptr_array_index (md_filelists->priv->array, i);
+		pkgid = zif_package_get_pkgid (package);
+		files = zif_package_get_files (package, state_local, NULL);
+		if (files == NULL)
+			continue;
+		for (j = 0; j < files->len; j++)
+			func (pkgid, g_ptr_array_index (files, j), user_data);
+		g_ptr_array_unref (files);
+		zif_state_reset (state_local);
+	}
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+out:
+	return ret;
+}
+
 /**
  * zif_md_filelists_xml_finalize:
  **/
@@ -577,6 +650,7 @@ zif_md_filelists_xml_class_init (ZifMdFilelistsXmlClass *klass)
 	md_class->unload = zif_md_filelists_xml_unload;
 	md_class->search_file = zif_md_filelists_xml_search_file;
 	md_class->get_files = zif_md_filelists_xml_get_files;
+	md_class->foreach_file = zif_md_filelists_xml_foreach_file;
 
 	g_type_class_add_private (klass, sizeof (ZifMdFilelistsXmlPrivate));
 }
@@ -48,8 +48,110 @@
 
 #define ZIF_MD_PRIMARY_SQL_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ZIF_TYPE_MD_PRIMARY_SQL, ZifMdPrimarySqlPrivate))
 
-/* sqlite has a maximum of about 1000, but optimum seems about 300 */
-#define ZIF_MD_PRIMARY_SQL_MAX_EXPRESSION_DEPTH 300
+#define ZIF_MD_PRIMARY_SQL_HEADER "SELECT p.pkgId, p.name, p.arch, p.version, " \
+				  "p.epoch, p.release, p.summary, p.description, p.url, " \
+				  "p.rpm_license, p.rpm_group, p.size_package, " \
+				  "p.location_href, p.rpm_sourcerpm, "\
+				  "p.time_file, p.pkgKey FROM packages p"
+
+#define ZIF_MD_PRIMARY_SQL_DEPEND_HEADER "SELECT depend.name, depend.flags, " \
+					 "depend.epoch, depend.version, " \
+					 "depend.release FROM packages p, "
+
+#define ZIF_MD_PRIMARY_SQL_DEPEND_FOOTER " depend WHERE p.pkgKey = depend.pkgKey AND " \
+					 "p.name = ?1 AND p.epoch = ?2 AND " \
+					 "p.version = ?3 AND p.release = ?4 AND " \
+					 "p.arch = ?5;"
+
+/* the search terms are bound into this table rather than being spliced
+ * into the statement, so each statement only has to be compiled once */
+#define ZIF_MD_PRIMARY_SQL_TERMS "(SELECT term FROM zif_terms)"
+
+typedef enum {
+	ZIF_MD_PRIMARY_SQL_STMT_TERMS_ADD,
+	ZIF_MD_PRIMARY_SQL_STMT_TERMS_CLEAR,
+	ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME,
+	ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_GLOB,
+	ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_ARCH,
+	ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_ARCH_GLOB,
+	ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_VERSION,
+	ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_VERSION_GLOB,
+	ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_VERSION_ARCH,
+	ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_VERSION_ARCH_GLOB,
+	ZIF_MD_PRIMARY_SQL_STMT_SEARCH_NAME,
+	ZIF_MD_PRIMARY_SQL_STMT_SEARCH_DETAILS,
+	ZIF_MD_PRIMARY_SQL_STMT_SEARCH_GROUP,
+	ZIF_MD_PRIMARY_SQL_STMT_SEARCH_PKGID,
+	ZIF_MD_PRIMARY_SQL_STMT_WHAT_PROVIDES,
+	ZIF_MD_PRIMARY_SQL_STMT_WHAT_REQUIRES,
+	ZIF_MD_PRIMARY_SQL_STMT_WHAT_OBSOLETES,
+	ZIF_MD_PRIMARY_SQL_STMT_WHAT_CONFLICTS,
+	ZIF_MD_PRIMARY_SQL_STMT_GET_PROVIDES,
+	ZIF_MD_PRIMARY_SQL_STMT_GET_REQUIRES,
+	ZIF_MD_PRIMARY_SQL_STMT_GET_OBSOLETES,
+	ZIF_MD_PRIMARY_SQL_STMT_GET_CONFLICTS,
+	ZIF_MD_PRIMARY_SQL_STMT_FIND_PACKAGE,
+	ZIF_MD_PRIMARY_SQL_STMT_GET_PACKAGES,
+	ZIF_MD_PRIMARY_SQL_STMT_LAST
+} ZifMdPrimarySqlStmt;
+
+/* this has to be kept in the same order as ZifMdPrimarySqlStmt */
+static const gchar *zif_md_primary_sql_statements[] = {
+	"INSERT OR IGNORE INTO zif_terms (term, noarch, prefix, prefix_end) "
+		"VALUES (?1, ?2, ?3, ?4);",
+	"DELETE FROM zif_terms;",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.name IN " ZIF_MD_PRIMARY_SQL_TERMS ";",
+	/* the literal prefix of the glob is used as a range on the name index */
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.pkgKey IN (SELECT p2.pkgKey FROM "
+		"zif_terms t, packages p2 WHERE p2.name >= t.prefix AND "
+		"p2.name < t.prefix_end AND p2.name GLOB t.term);",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.name||'.'||p.arch IN " ZIF_MD_PRIMARY_SQL_TERMS
+		" OR (p.arch = 'noarch' AND p.name IN (SELECT noarch FROM zif_terms));",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE EXISTS (SELECT 1 FROM zif_terms t "
+		"WHERE p.name||'.'||p.arch GLOB t.term OR "
+		"(p.name GLOB t.noarch AND p.arch GLOB 'noarch'));",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.name||'-'||p.version||'-'||p.release IN "
+		ZIF_MD_PRIMARY_SQL_TERMS ";",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE EXISTS (SELECT 1 FROM zif_terms t "
+		"WHERE p.name||'-'||p.version||'-'||p.release GLOB t.term);",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.name||'-'||p.version||'-'||p.release||'.'||p.arch IN "
+		ZIF_MD_PRIMARY_SQL_TERMS ";",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE EXISTS (SELECT 1 FROM zif_terms t "
+		"WHERE p.name||'-'||p.version||'-'||p.release||'.'||p.arch GLOB t.term);",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE EXISTS (SELECT 1 FROM zif_terms t "
+		"WHERE p.name LIKE '%'||t.term||'%');",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE EXISTS (SELECT 1 FROM zif_terms t "
+		"WHERE p.name LIKE '%'||t.term||'%' OR "
+		"p.summary LIKE '%'||t.term||'%' OR "
+		"p.description LIKE '%'||t.term||'%');",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.rpm_group IN " ZIF_MD_PRIMARY_SQL_TERMS ";",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.pkgid IN " ZIF_MD_PRIMARY_SQL_TERMS ";",
+	/* a package always provides itself, even without an explicit provide */
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.pkgKey IN (SELECT depend.pkgKey FROM "
+		"provides depend WHERE depend.name IN " ZIF_MD_PRIMARY_SQL_TERMS ") "
+		"OR p.name IN " ZIF_MD_PRIMARY_SQL_TERMS ";",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.pkgKey IN (SELECT depend.pkgKey FROM "
+		"requires depend WHERE depend.name IN " ZIF_MD_PRIMARY_SQL_TERMS ");",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.pkgKey IN (SELECT depend.pkgKey FROM "
+		"obsoletes depend WHERE depend.name IN " ZIF_MD_PRIMARY_SQL_TERMS ");",
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.pkgKey IN (SELECT depend.pkgKey FROM "
+		"conflicts depend WHERE depend.name IN " ZIF_MD_PRIMARY_SQL_TERMS ");",
+	ZIF_MD_PRIMARY_SQL_DEPEND_HEADER "provides" ZIF_MD_PRIMARY_SQL_DEPEND_FOOTER,
+	ZIF_MD_PRIMARY_SQL_DEPEND_HEADER "requires" ZIF_MD_PRIMARY_SQL_DEPEND_FOOTER,
+	ZIF_MD_PRIMARY_SQL_DEPEND_HEADER "obsoletes" ZIF_MD_PRIMARY_SQL_DEPEND_FOOTER,
+	ZIF_MD_PRIMARY_SQL_DEPEND_HEADER "conflicts" ZIF_MD_PRIMARY_SQL_DEPEND_FOOTER,
+	ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.name = ?1 AND p.epoch = ?2 AND "
+		"p.version = ?3 AND p.release = ?4 AND p.arch = ?5;",
+	ZIF_MD_PRIMARY_SQL_HEADER ";",
+	NULL };
+
+/* the package cache is shared with each of the items, as a package
+ * can be finalized in another thread after the md has gone */
+typedef struct {
+	GMutex			 mutex;		/* protects hash and refcount */
+	GHashTable		*hash;
+	guint			 refcount;
+} ZifMdPrimarySqlCache;
 
 /**
  * ZifMdPrimarySqlPrivate:
@@ -59,10 +161,13 @@
 struct _ZifMdPrimarySqlPrivate
 {
 	gboolean		 loaded;
+	GRecMutex		 mutex;		/* protects db and stmts */
 	sqlite3			*db;
+	sqlite3_stmt		*stmts[ZIF_MD_PRIMARY_SQL_STMT_LAST];
 	ZifConfig		*config;
 	GHashTable		*conflicts_name;
 	GHashTable		*obsoletes_name;
+	ZifMdPrimarySqlCache	*package_cache;
 };
 
 typedef struct {
@@ -70,8 +175,17 @@ typedef struct {
 	GPtrArray		*packages;
 	ZifMdPrimarySql		*md;
 	ZifPackageCompareMode	 compare_mode;
+	guint			 cache_hits;
+	guint			 cache_misses;
 } ZifMdPrimarySqlData;
 
+typedef struct {
+	ZifMdPrimarySqlCache	*cache;
+	GWeakRef		 package;
+	gint			 pkgkey;
+	ZifPackageCompareMode	 compare_mode;
+} ZifMdPrimarySqlCacheItem;
+
 G_DEFINE_TYPE (ZifMdPrimarySql, zif_md_primary_sql, ZIF_TYPE_MD)
 
 /**
@@ -100,6 +214,15 @@ zif_md_primary_sql_sqlite_name_depends_cb (void *data,
 	return 0;
 }
 
+/**
+ * zif_md_primary_sql_exec_unchecked:
+ **/
+static void
+zif_md_primary_sql_exec_unchecked (ZifMdPrimarySql *md, const gchar *statement)
+{
+	sqlite3_exec (md->priv->db, statement, NULL, NULL, NULL);
+}
+
 /**
  * zif_md_primary_sql_load:
  **/
@@ -110,12 +233,14 @@ zif_md_primary_sql_load (ZifMd *md, ZifState *state, GError **error)
 	const gchar *statement;
 	gchar *error_msg = NULL;
 	gint rc;
+	guint i;
 	ZifMdPrimarySql *primary_sql = ZIF_MD_PRIMARY_SQL (md);
 
 	g_return_val_if_fail (ZIF_IS_MD_PRIMARY_SQL (md), FALSE);
 	g_return_val_if_fail (zif_state_valid (state), FALSE);
 
 	/* already loaded */
+	g_rec_mutex_lock (&primary_sql->priv->mutex);
 	if (primary_sql->priv->loaded)
 		goto out;
 
@@ -127,10 +252,15 @@ zif_md_primary_sql_load (ZifMd *md, ZifState *state, GError **error)
 		goto out;
 	}
 
-	/* open database */
+	/* open database, allowing it to be used from any thread */
 	zif_state_set_allow_cancel (state, FALSE);
 	g_debug ("filename = %s", filename);
-	rc = sqlite3_open (filename, &primary_sql->priv->db);
+	rc = sqlite3_open_v2 (filename,
+			      &primary_sql->priv->db,
+			      SQLITE_OPEN_READWRITE |
+			      SQLITE_OPEN_CREATE |
+			      SQLITE_OPEN_FULLMUTEX,
+			      NULL);
 	if (rc != 0) {
 		g_warning ("Can't open database: %s\n", sqlite3_errmsg (primary_sql->priv->db));
 		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
@@ -139,7 +269,7 @@ zif_md_primary_sql_load (ZifMd *md, ZifState *state, GError **error)
 	}
 
 	/* we don't need to keep syncing */
-	sqlite3_exec (primary_sql->priv->db, "PRAGMA synchronous=OFF;", NULL, NULL, NULL);
+	zif_md_primary_sql_exec_unchecked (primary_sql, "PRAGMA synchronous=OFF;");
 
 	/* populate the obsoletes name cache */
 	statement = "SELECT name FROM obsoletes;";
@@ -167,11 +297,141 @@ zif_md_primary_sql_load (ZifMd *md, ZifState *state, GError **error)
 		goto out;
 	}
 
+	/* the search terms are added here for each query */
+	zif_md_primary_sql_exec_unchecked (primary_sql, "PRAGMA temp_store=MEMORY;");
+	statement = "CREATE TEMP TABLE zif_terms (term TEXT PRIMARY KEY, noarch TEXT, "
+		    "prefix TEXT, prefix_end);";
+	rc = sqlite3_exec (primary_sql->priv->db, statement,
+			   NULL, NULL, &error_msg);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+			     "SQL error: %s", error_msg);
+		sqlite3_free (error_msg);
+		goto out;
+	}
+
+	/* compile all the statements we're going to use just once */
+	for (i = 0; i < ZIF_MD_PRIMARY_SQL_STMT_LAST; i++) {
+		rc = sqlite3_prepare_v2 (primary_sql->priv->db,
+					 zif_md_primary_sql_statements[i],
+					 -1,
+					 &primary_sql->priv->stmts[i],
+					 NULL);
+		if (rc != SQLITE_OK) {
+			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+				     "failed to prepare statement: %s",
+				     sqlite3_errmsg (primary_sql->priv->db));
+			goto out;
+		}
+	}
+
 	primary_sql->priv->loaded = TRUE;
 out:
+	g_rec_mutex_unlock (&primary_sql->priv->mutex);
 	return primary_sql->priv->loaded;
 }
 
+/**
+ * zif_md_primary_sql_package_cache_unref_unlock:
+ *
+ * Drops a reference to the cache, which must be locked, and frees it
+ * when the md and all the items have gone.
+ **/
+static void
+zif_md_primary_sql_package_cache_unref_unlock (ZifMdPrimarySqlCache *cache)
+{
+	cache->refcount--;
+	if (cache->refcount > 0) {
+		g_mutex_unlock (&cache->mutex);
+		return;
+	}
+	g_mutex_unlock (&cache->mutex);
+	g_hash_table_unref (cache->hash);
+	g_mutex_clear (&cache->mutex);
+	g_free (cache);
+}
+
+/**
+ * zif_md_primary_sql_package_cache_notify_cb:
+ *
+ * This is called in whichever thread dropped the last reference, and
+ * the row may already have been given a new item by another thread.
+ * The md may also have been finalized, but the cache is kept alive
+ * by the item.
+ **/
+static void
+zif_md_primary_sql_package_cache_notify_cb (gpointer data, GObject *where_the_object_was)
+{
+	ZifMdPrimarySqlCacheItem *item = (ZifMdPrimarySqlCacheItem *) data;
+	ZifMdPrimarySqlCache *cache = item->cache;
+
+	g_mutex_lock (&cache->mutex);
+	if (g_hash_table_lookup (cache->hash,
+				 GINT_TO_POINTER (item->pkgkey)) == item) {
+		g_hash_table_remove (cache->hash,
+				     GINT_TO_POINTER (item->pkgkey));
+	}
+	zif_md_primary_sql_package_cache_unref_unlock (cache);
+	g_weak_ref_clear (&item->package);
+	g_free (item);
+}
+
+/**
+ * zif_md_primary_sql_package_cache_get:
+ *
+ * Gets the package for a row, unless it was never created, it is
+ * being finalized in another thread right now, or it was created with
+ * a different compare mode. The package is shared, so the compare
+ * mode is never changed after it has been created.
+ **/
+static ZifPackage *
+zif_md_primary_sql_package_cache_get (ZifMdPrimarySql *md,
+				      gint pkgkey,
+				      ZifPackageCompareMode compare_mode)
+{
+	ZifMdPrimarySqlCache *cache = md->priv->package_cache;
+	ZifMdPrimarySqlCacheItem *item;
+	ZifPackage *package = NULL;
+
+	g_mutex_lock (&cache->mutex);
+	item = g_hash_table_lookup (cache->hash, GINT_TO_POINTER (pkgkey));
+	if (item != NULL && item->compare_mode == compare_mode)
+		package = g_weak_ref_get (&item->package);
+	g_mutex_unlock (&cache->mutex);
+	return package;
+}
+
+/**
+ * zif_md_primary_sql_package_cache_add:
+ *
+ * The cache only holds weak references, so a package is dropped from
+ * it as soon as the last caller unrefs it.
+ **/
+static void
+zif_md_primary_sql_package_cache_add (ZifMdPrimarySql *md,
+				      gint pkgkey,
+				      ZifPackageCompareMode compare_mode,
+				      ZifPackage *package)
+{
+	ZifMdPrimarySqlCache *cache = md->priv->package_cache;
+	ZifMdPrimarySqlCacheItem *item;
+
+	item = g_new0 (ZifMdPrimarySqlCacheItem, 1);
+	item->cache = cache;
+	item->pkgkey = pkgkey;
+	item->compare_mode = compare_mode;
+	g_weak_ref_init (&item->package, package);
+	g_mutex_lock (&cache->mutex);
+	cache->refcount++;
+	g_object_weak_ref (G_OBJECT (package),
+			   zif_md_primary_sql_package_cache_notify_cb,
+			   item);
+	g_hash_table_insert (cache->hash,
+			     GINT_TO_POINTER (pkgkey),
+			     item);
+	g_mutex_unlock (&cache->mutex);
+}
+
 /**
  * zif_md_primary_sql_sqlite_create_package_cb:
  **/
@@ -182,6 +442,22 @@ zif_md_primary_sql_sqlite_create_package_cb (void *data, gint argc, gchar **argv
 	ZifPackage *package;
 	ZifStoreRemote *store_remote;
 	gboolean ret;
+	gint pkgkey;
+
+	/* the pkgKey is always the last column, and is not package data */
+	pkgkey = atoi (argv[argc - 1]);
+	argc--;
+
+	/* we've already got an object for this row */
+	package = zif_md_primary_sql_package_cache_get (fldata->md,
+							pkgkey,
+							fldata->compare_mode);
+	if (package != NULL) {
+		fldata->cache_hits++;
+		g_ptr_array_add (fldata->packages, package);
+		goto out;
+	}
+	fldata->cache_misses++;
 
 	package = zif_package_remote_new ();
 	store_remote = ZIF_STORE_REMOTE (zif_md_get_store (ZIF_MD (fldata->md)));
@@ -203,51 +479,120 @@ zif_md_primary_sql_sqlite_create_package_cb (void *data, gint argc, gchar **argv
 						fldata->id,
 						NULL);
 	if (ret) {
+		zif_md_primary_sql_package_cache_add (fldata->md,
+						      pkgkey,
+						      fldata->compare_mode,
+						      package);
 		g_ptr_array_add (fldata->packages, package);
 	} else {
 		g_warning ("failed to add: %s", argv[1]);
 		g_object_unref (package);
 	}
-
+out:
 	return 0;
 }
 
-#define ZIF_MD_PRIMARY_SQL_HEADER "SELECT p.pkgId, p.name, p.arch, p.version, " \
-				  "p.epoch, p.release, p.summary, p.description, p.url, " \
-				  "p.rpm_license, p.rpm_group, p.size_package, " \
-				  "p.location_href, p.rpm_sourcerpm, "\
-				  "p.time_file FROM packages p"
+/**
+ * zif_md_primary_sql_ensure_loaded:
+ **/
+static gboolean
+zif_md_primary_sql_ensure_loaded (ZifMdPrimarySql *md,
+				  ZifState *state,
+				  GError **error)
+{
+	gboolean ret = TRUE;
+	GError *error_local = NULL;
+
+	/* if not already loaded, load */
+	if (md->priv->loaded)
+		goto out;
+	ret = zif_md_load (ZIF_MD (md), state, &error_local);
+	if (!ret) {
+		g_set_error (error,
+			     ZIF_MD_ERROR,
+			     ZIF_MD_ERROR_FAILED_TO_LOAD,
+			     "failed to load md_primary_sql file: %s",
+			     error_local->message);
+		g_error_free (error_local);
+		goto out;
+	}
+out:
+	return ret;
+}
+
+/**
+ * zif_md_primary_sql_step:
+ *
+ * Runs a prepared statement, calling @callback for each row in the
+ * same way as sqlite3_exec() would do. The statement is reset so it
+ * can be reused for the next query.
+ **/
+static gboolean
+zif_md_primary_sql_step (ZifMdPrimarySql *md,
+			 sqlite3_stmt *stmt,
+			 sqlite3_callback callback,
+			 gpointer user_data,
+			 GError **error)
+{
+	gboolean ret = TRUE;
+	gchar **argv;
+	gchar **col_name;
+	gint argc;
+	gint i;
+	gint rc;
+
+	/* print the statement, without the bound values */
+	if (g_getenv ("ZIF_SQL_DEBUG") != NULL) {
+		g_debug ("On %s\n%s",
+			 zif_md_get_filename_uncompressed (ZIF_MD (md)),
+			 sqlite3_sql (stmt));
+	}
+
+	/* the column names do not change between rows */
+	argc = sqlite3_column_count (stmt);
+	argv = g_new0 (gchar *, argc + 1);
+	col_name = g_new0 (gchar *, argc + 1);
+	for (i = 0; i < argc; i++)
+		col_name[i] = (gchar *) sqlite3_column_name (stmt, i);
+
+	/* get each row */
+	while (TRUE) {
+		rc = sqlite3_step (stmt);
+		if (rc == SQLITE_DONE)
+			break;
+		if (rc != SQLITE_ROW) {
+			ret = FALSE;
+			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+				     "SQL error: %s",
+				     sqlite3_errmsg (md->priv->db));
+			break;
+		}
+		for (i = 0; i < argc; i++)
+			argv[i] = (gchar *) sqlite3_column_text (stmt, i);
+		callback (user_data, argc, argv, col_name);
+	}
+	sqlite3_reset (stmt);
+	sqlite3_clear_bindings (stmt);
+	g_free (argv);
+	g_free (col_name);
+	return ret;
+}
 
 /**
  * zif_md_primary_sql_search:
  **/
 static GPtrArray *
-zif_md_primary_sql_search (ZifMdPrimarySql *md, const gchar *statement,
-			   ZifState *state, GError **error)
+zif_md_primary_sql_search (ZifMdPrimarySql *md,
+			   sqlite3_stmt *stmt,
+			   ZifState *state,
+			   GError **error)
 {
-	gchar *error_msg = NULL;
-	gint rc;
 	gboolean ret;
-	GError *error_local = NULL;
 	ZifMdPrimarySqlData *data = NULL;
 	GPtrArray *array = NULL;
 
 	g_return_val_if_fail (zif_state_valid (state), NULL);
 
-	/* if not already loaded, load */
-	if (!md->priv->loaded) {
-		ret = zif_md_load (ZIF_MD (md), state, &error_local);
-		if (!ret) {
-			g_set_error (error,
-				     ZIF_MD_ERROR,
-				     ZIF_MD_ERROR_FAILED_TO_LOAD,
-				     "failed to load md_primary_sql file: %s",
-				     error_local->message);
-			g_error_free (error_local);
-			goto out;
-		}
-	}
-
 	/* create data struct we can pass to the callback */
 	zif_state_set_allow_cancel (state, FALSE);
 	data = g_new0 (ZifMdPrimarySqlData, 1);
@@ -259,25 +604,26 @@ zif_md_primary_sql_search (ZifMdPrimarySql *md, const gchar *statement,
 						  "pkg_compare_mode",
 						  zif_package_compare_mode_from_string,
 						  error);
-	if (data->compare_mode == G_MAXUINT)
+	if (data->compare_mode == G_MAXUINT) {
+		sqlite3_reset (stmt);
+		sqlite3_clear_bindings (stmt);
 		goto out;
+	}
 
 	data->packages = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-	if (g_getenv ("ZIF_SQL_DEBUG") != NULL) {
-		g_debug ("On %s\n%s",
-			 zif_md_get_filename_uncompressed (ZIF_MD (md)),
-			 statement);
-	}
-	rc = sqlite3_exec (md->priv->db, statement,
-			   zif_md_primary_sql_sqlite_create_package_cb,
-			   data, &error_msg);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
-			     "SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+	ret = zif_md_primary_sql_step (md,
+				       stmt,
+				       zif_md_primary_sql_sqlite_create_package_cb,
+				       data,
+				       error);
+	if (!ret) {
 		g_ptr_array_unref (data->packages);
 		goto out;
 	}
+	if (data->cache_hits > 0)
+		g_debug ("package cache: %i hits, %i misses",
+			 data->cache_hits, data->cache_misses);
+
 	/* list of packages */
 	array = data->packages;
 out:
@@ -286,74 +632,124 @@ out:
 }
 
 /**
- * zif_md_primary_sql_get_statement_for_pred:
+ * zif_md_primary_sql_get_prefix_end:
+ *
+ * Gets the first string that sorts after every string starting with
+ * @prefix, or %NULL if there is no such string.
  **/
 static gchar *
-zif_md_primary_sql_get_statement_for_pred (const gchar *pred,
-					   gchar **search,
-					   gboolean use_glob)
+zif_md_primary_sql_get_prefix_end (const gchar *prefix)
 {
-	const guint max_items = 20;
-	gchar **search_noarch = NULL;
-	gchar *tmp;
-	GString *pred_glob;
-	GString *statement;
-	GString *temp;
-	guint i;
+	gchar *prefix_end;
+	gsize len;
 
-	/* use stripped arch? */
-	if (g_strstr_len (pred, -1, "$NOARCH") != NULL) {
-		search_noarch = g_strdupv (search);
-		for (i = 0; search[i] != NULL; i++) {
-			tmp = strrchr (search_noarch[i], '.');
-			if (tmp != NULL)
-				*tmp = '\0';
-		}
+	prefix_end = g_strdup (prefix);
+	for (len = strlen (prefix_end); len > 0; len--) {
+		if ((guchar) prefix_end[len - 1] == 0xff)
+			continue;
+		prefix_end[len - 1]++;
+		prefix_end[len] = '\0';
+		return prefix_end;
 	}
+	g_free (prefix_end);
+	return NULL;
+}
 
-	/* glob? */
-	pred_glob = g_string_new (pred);
-	if (use_glob) {
-		zif_string_replace (pred_glob,
-				    "$MATCH",
-				    "GLOB");
+/**
+ * zif_md_primary_sql_add_term:
+ **/
+static gboolean
+zif_md_primary_sql_add_term (ZifMdPrimarySql *md,
+			     const gchar *term,
+			     GError **error)
+{
+	const gchar *prefix;
+	const gchar *tmp;
+	gboolean ret = TRUE;
+	gchar *prefix_end;
+	gint rc;
+	sqlite3_stmt *stmt = md->priv->stmts[ZIF_MD_PRIMARY_SQL_STMT_TERMS_ADD];
+	ZifStrMatcher *matcher;
+
+	/* also add the term with any arch suffix stripped */
+	sqlite3_bind_text (stmt, 1, term, -1, SQLITE_STATIC);
+	tmp = strrchr (term, '.');
+	if (tmp != NULL) {
+		sqlite3_bind_text (stmt, 2, term, tmp - term, SQLITE_STATIC);
 	} else {
-		zif_string_replace (pred_glob,
-				    "$MATCH",
-				    "=");
+		sqlite3_bind_text (stmt, 2, term, -1, SQLITE_STATIC);
 	}
 
-	/* search with predicate */
-	statement = g_string_new ("BEGIN;\n");
+	/* the range of names a glob can match, where a blob sorts after
+	 * any text value */
+	matcher = zif_str_matcher_new (term, ZIF_STR_MATCHER_KIND_GLOB, NULL);
+	prefix = zif_str_matcher_get_prefix (matcher);
+	prefix_end = zif_md_primary_sql_get_prefix_end (prefix);
+	sqlite3_bind_text (stmt, 3, prefix, -1, SQLITE_TRANSIENT);
+	if (prefix_end != NULL)
+		sqlite3_bind_text (stmt, 4, prefix_end, -1, SQLITE_TRANSIENT);
+	else
+		sqlite3_bind_blob (stmt, 4, "\xff", 1, SQLITE_STATIC);
+	g_free (prefix_end);
+	zif_str_matcher_free (matcher);
+	rc = sqlite3_step (stmt);
+	if (rc != SQLITE_DONE) {
+		ret = FALSE;
+		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
+			     "failed to add search term: %s",
+			     sqlite3_errmsg (md->priv->db));
+	}
+	sqlite3_reset (stmt);
+	sqlite3_clear_bindings (stmt);
+	return ret;
+}
+
+/**
+ * zif_md_primary_sql_search_terms:
+ *
+ * Runs one of the precompiled statements that matches against all the
+ * search terms at the same time.
+ **/
+static GPtrArray *
+zif_md_primary_sql_search_terms (ZifMdPrimarySql *md,
+				 ZifMdPrimarySqlStmt stmt_id,
+				 gchar **search,
+				 ZifState *state,
+				 GError **error)
+{
+	gboolean ret;
+	GPtrArray *array = NULL;
+	guint i;
+
+	/* the terms table is shared by every query on this connection */
+	g_rec_mutex_lock (&md->priv->mutex);
+
+	/* if not already loaded, load */
+	ret = zif_md_primary_sql_ensure_loaded (md, state, error);
+	if (!ret)
+		goto out;
+
+	/* add all the search terms in one transaction */
+	zif_md_primary_sql_exec_unchecked (md, "BEGIN;");
 	for (i = 0; search[i] != NULL; i++) {
-		if (i % max_items == 0)
-			g_string_append (statement, ZIF_MD_PRIMARY_SQL_HEADER " WHERE ");
-		temp = g_string_new (pred_glob->str);
-		zif_string_replace (temp,
-				    "$SEARCH",
-				    search[i]);
-		if (search_noarch != NULL) {
-			zif_string_replace (temp,
-					    "$NOARCH",
-					    search_noarch[i]);
-		}
-		g_string_append (statement, temp->str);
-		if (i % max_items == max_items - 1)
-			g_string_append (statement, ";\n");
-		else
-			g_string_append (statement, " OR ");
-		g_string_free (temp, TRUE);
+		ret = zif_md_primary_sql_add_term (md, search[i], error);
+		if (!ret)
+			goto out;
 	}
 
-	/* remove trailing OR entry */
-	if (g_str_has_suffix (statement->str, " OR ")) {
-		g_string_set_size (statement, statement->len - 4);
-		g_string_append (statement, ";\n");
+	/* get the packages that match any of the terms */
+	array = zif_md_primary_sql_search (md,
+					   md->priv->stmts[stmt_id],
+					   state,
+					   error);
+out:
+	if (md->priv->loaded) {
+		sqlite3_step (md->priv->stmts[ZIF_MD_PRIMARY_SQL_STMT_TERMS_CLEAR]);
+		sqlite3_reset (md->priv->stmts[ZIF_MD_PRIMARY_SQL_STMT_TERMS_CLEAR]);
+		zif_md_primary_sql_exec_unchecked (md, "END;");
 	}
-	g_string_append (statement, "END;");
-	g_string_free (pred_glob, TRUE);
-	g_strfreev (search_noarch);
-	return g_string_free (statement, FALSE);
+	g_rec_mutex_unlock (&md->priv->mutex);
+	return array;
 }
 
 /**
@@ -368,14 +764,31 @@ zif_md_primary_sql_resolve (ZifMd *md,
 {
 	gboolean use_glob = FALSE;
 	gboolean ret;
-	gchar *statement;
 	GPtrArray *array = NULL;
 	GPtrArray *array_tmp = NULL;
 	GPtrArray *tmp;
 	guint cnt = 0;
-	guint i;
+	guint i, j;
 	ZifState *state_local;
 	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
+	const struct {
+		ZifStoreResolveFlags	flag;
+		ZifMdPrimarySqlStmt	stmt_id;
+		ZifMdPrimarySqlStmt	stmt_id_glob;
+	} resolve_stmts[] = {
+		{ ZIF_STORE_RESOLVE_FLAG_USE_NAME,
+		  ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME,
+		  ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_GLOB },
+		{ ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH,
+		  ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_ARCH,
+		  ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_ARCH_GLOB },
+		{ ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION,
+		  ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_VERSION,
+		  ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_VERSION_GLOB },
+		{ ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION_ARCH,
+		  ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_VERSION_ARCH,
+		  ZIF_MD_PRIMARY_SQL_STMT_RESOLVE_NAME_VERSION_ARCH_GLOB },
+		{ 0, 0, 0 } };
 
 	g_return_val_if_fail (ZIF_IS_MD_PRIMARY_SQL (md), NULL);
 	g_return_val_if_fail (flags != 0, NULL);
@@ -404,95 +817,17 @@ zif_md_primary_sql_resolve (ZifMd *md,
 
 	array_tmp = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 
-	/* name */
-	if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME) > 0) {
-		statement = zif_md_primary_sql_get_statement_for_pred ("p.name $MATCH '$SEARCH'",
-								       search,
-								       use_glob);
-		state_local = zif_state_get_child (state);
-		tmp = zif_md_primary_sql_search (md_primary_sql,
-						 statement,
-						 state_local,
-						 error);
-		g_free (statement);
-		if (tmp == NULL)
-			goto out;
-		for (i = 0; i < tmp->len; i++)
-			g_ptr_array_add (array_tmp, g_object_ref (g_ptr_array_index (tmp, i)));
-		g_ptr_array_unref (tmp);
-
-		/* this section done */
-		ret = zif_state_done (state, error);
-		if (!ret)
-			goto out;
-	}
-
-	/* name.arch */
-	if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH) > 0) {
-		statement = zif_md_primary_sql_get_statement_for_pred ("(p.name||'.'||"
-								       "p.arch $MATCH '$SEARCH')"
-								       " OR "
-								       "(p.name $MATCH '$NOARCH' AND "
-								       "p.arch $MATCH 'noarch')",
-								       search,
-								       use_glob);
-		state_local = zif_state_get_child (state);
-		tmp = zif_md_primary_sql_search (md_primary_sql,
-						 statement,
-						 state_local,
-						 error);
-		g_free (statement);
-		if (tmp == NULL)
-			goto out;
-		for (i = 0; i < tmp->len; i++)
-			g_ptr_array_add (array_tmp, g_object_ref (g_ptr_array_index (tmp, i)));
-		g_ptr_array_unref (tmp);
-
-		/* this section done */
-		ret = zif_state_done (state, error);
-		if (!ret)
-			goto out;
-	}
-
-	/* name-version */
-	if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION) > 0) {
-		statement = zif_md_primary_sql_get_statement_for_pred ("p.name||'-'||"
-								       "p.version||'-'||"
-								       "p.release $MATCH '$SEARCH'",
-								       search,
-								       use_glob);
-		state_local = zif_state_get_child (state);
-		tmp = zif_md_primary_sql_search (md_primary_sql,
-						 statement,
-						 state_local,
-						 error);
-		g_free (statement);
-		if (tmp == NULL)
-			goto out;
-		for (i = 0; i < tmp->len; i++)
-			g_ptr_array_add (array_tmp, g_object_ref (g_ptr_array_index (tmp, i)));
-		g_ptr_array_unref (tmp);
-
-		/* this section done */
-		ret = zif_state_done (state, error);
-		if (!ret)
-			goto out;
-	}
-
-	/* name-version.arch */
-	if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION_ARCH) > 0) {
-		statement = zif_md_primary_sql_get_statement_for_pred ("p.name||'-'||"
-								       "p.version||'-'||"
-								       "p.release||'.'||"
-								       "p.arch $MATCH '$SEARCH'",
-								       search,
-								       use_glob);
+	/* name, name.arch, name-version and name-version.arch */
+	for (j = 0; resolve_stmts[j].flag != 0; j++) {
+		if ((flags & resolve_stmts[j].flag) == 0)
+			continue;
 		state_local = zif_state_get_child (state);
-		tmp = zif_md_primary_sql_search (md_primary_sql,
-						 statement,
-						 state_local,
-						 error);
-		g_free (statement);
+		tmp = zif_md_primary_sql_search_terms (md_primary_sql,
+						       use_glob ? resolve_stmts[j].stmt_id_glob :
+								  resolve_stmts[j].stmt_id,
+						       search,
+						       state_local,
+						       error);
 		if (tmp == NULL)
 			goto out;
 		for (i = 0; i < tmp->len; i++)
@@ -519,22 +854,14 @@ out:
 static GPtrArray *
 zif_md_primary_sql_search_name (ZifMd *md, gchar **search, ZifState *state, GError **error)
 {
-	gchar *statement;
-	GPtrArray *array;
-	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
-
 	g_return_val_if_fail (ZIF_IS_MD_PRIMARY_SQL (md), NULL);
 	g_return_val_if_fail (zif_state_valid (state), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
 	/* fuzzy name match */
-	statement = zif_md_primary_sql_get_statement_for_pred ("p.name LIKE '%%$SEARCH%%'",
-							       search,
-							       FALSE);
-	array = zif_md_primary_sql_search (md_primary_sql, statement, state, error);
-	g_free (statement);
-
-	return array;
+	return zif_md_primary_sql_search_terms (ZIF_MD_PRIMARY_SQL (md),
+						ZIF_MD_PRIMARY_SQL_STMT_SEARCH_NAME,
+						search, state, error);
 }
 
 /**
@@ -543,24 +870,14 @@ zif_md_primary_sql_search_name (ZifMd *md, gchar **search, ZifState *state, GErr
 static GPtrArray *
 zif_md_primary_sql_search_details (ZifMd *md, gchar **search, ZifState *state, GError **error)
 {
-	gchar *statement;
-	GPtrArray *array;
-	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
-
 	g_return_val_if_fail (ZIF_IS_MD_PRIMARY_SQL (md), NULL);
 	g_return_val_if_fail (zif_state_valid (state), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
 	/* fuzzy details match */
-	statement = zif_md_primary_sql_get_statement_for_pred ("p.name LIKE '%%$SEARCH%%' OR "
-							       "p.summary LIKE '%%$SEARCH%%' OR "
-							       "p.description LIKE '%%$SEARCH%%'",
-							       search,
-							       FALSE);
-	array = zif_md_primary_sql_search (md_primary_sql, statement, state, error);
-	g_free (statement);
-
-	return array;
+	return zif_md_primary_sql_search_terms (ZIF_MD_PRIMARY_SQL (md),
+						ZIF_MD_PRIMARY_SQL_STMT_SEARCH_DETAILS,
+						search, state, error);
 }
 
 /**
@@ -569,22 +886,14 @@ zif_md_primary_sql_search_details (ZifMd *md, gchar **search, ZifState *state, G
 static GPtrArray *
 zif_md_primary_sql_search_group (ZifMd *md, gchar **search, ZifState *state, GError **error)
 {
-	gchar *statement;
-	GPtrArray *array;
-	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
-
 	g_return_val_if_fail (ZIF_IS_MD_PRIMARY_SQL (md), NULL);
 	g_return_val_if_fail (zif_state_valid (state), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
 	/* simple group match */
-	statement = zif_md_primary_sql_get_statement_for_pred ("p.rpm_group = '$SEARCH'",
-							       search,
-							       FALSE);
-	array = zif_md_primary_sql_search (md_primary_sql, statement, state, error);
-	g_free (statement);
-
-	return array;
+	return zif_md_primary_sql_search_terms (ZIF_MD_PRIMARY_SQL (md),
+						ZIF_MD_PRIMARY_SQL_STMT_SEARCH_GROUP,
+						search, state, error);
 }
 
 /**
@@ -593,22 +902,14 @@ zif_md_primary_sql_search_group (ZifMd *md, gchar **search, ZifState *state, GEr
 static GPtrArray *
 zif_md_primary_sql_search_pkgid (ZifMd *md, gchar **search, ZifState *state, GError **error)
 {
-	gchar *statement;
-	GPtrArray *array;
-	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
-
 	g_return_val_if_fail (ZIF_IS_MD_PRIMARY_SQL (md), NULL);
 	g_return_val_if_fail (zif_state_valid (state), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
 	/* simple pkgid match */
-	statement = zif_md_primary_sql_get_statement_for_pred ("p.pkgid = '$SEARCH'",
-							       search,
-							       FALSE);
-	array = zif_md_primary_sql_search (md_primary_sql, statement, state, error);
-	g_free (statement);
-
-	return array;
+	return zif_md_primary_sql_search_terms (ZIF_MD_PRIMARY_SQL (md),
+						ZIF_MD_PRIMARY_SQL_STMT_SEARCH_PKGID,
+						search, state, error);
 }
 
 /**
@@ -632,24 +933,21 @@ zif_md_primary_sql_sqlite_depend_cb (void *data, gint argc, gchar **argv, gchar
  **/
 static GPtrArray *
 zif_md_primary_sql_what_depends (ZifMd *md,
-				 const gchar *table_name,
+				 ZifPackageEnsureType ensure_type,
 				 GPtrArray *depends,
 				 ZifState *state,
 				 GError **error)
 {
 	gboolean ret;
-	gchar *error_msg = NULL;
-	GError *error_local = NULL;
 	GHashTable *hash_tmp = NULL;
-	gint rc;
 	GPtrArray *array = NULL;
+	GPtrArray *array_tmp = NULL;
 	GPtrArray *depends2 = NULL;
-	GString *statement = NULL;
-	guint i, j;
+	GPtrArray *search = NULL;
+	guint i;
 	ZifDepend *depend_tmp;
-	ZifMdPrimarySqlData *data = NULL;
 	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
-	ZifPackageEnsureType ensure_type = ZIF_PACKAGE_ENSURE_TYPE_LAST;
+	ZifMdPrimarySqlStmt stmt_id = ZIF_MD_PRIMARY_SQL_STMT_LAST;
 	ZifState *state_local;
 
 	g_return_val_if_fail (zif_state_valid (state), NULL);
@@ -675,13 +973,11 @@ zif_md_primary_sql_what_depends (ZifMd *md,
 	/* if not already loaded, load */
 	if (!md_primary_sql->priv->loaded) {
 		state_local = zif_state_get_child (state);
-		ret = zif_md_load (md, state_local, &error_local);
-		if (!ret) {
-			g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_FAILED_TO_LOAD,
-				     "failed to load md_primary_sql file: %s", error_local->message);
-			g_error_free (error_local);
+		ret = zif_md_primary_sql_ensure_loaded (md_primary_sql,
+							state_local,
+							error);
+		if (!ret)
 			goto out;
-		}
 
 		/* this section done */
 		ret = zif_state_done (state, error);
@@ -689,30 +985,25 @@ zif_md_primary_sql_what_depends (ZifMd *md,
 			goto out;
 	}
 
-	/* a struct to return results */
-	data = g_new0 (ZifMdPrimarySqlData, 1);
-	data->md = md_primary_sql;
-	data->id = zif_md_get_id (ZIF_MD (md));
-	data->packages = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-
-	/* convert to enum type */
-	if (g_strcmp0 (table_name, "requires") == 0) {
-		ensure_type = ZIF_PACKAGE_ENSURE_TYPE_REQUIRES;
-	} else if (g_strcmp0 (table_name, "provides") == 0) {
-		ensure_type = ZIF_PACKAGE_ENSURE_TYPE_PROVIDES;
-	} else if (g_strcmp0 (table_name, "conflicts") == 0) {
-		ensure_type = ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS;
+	/* convert to statement */
+	if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_REQUIRES) {
+		stmt_id = ZIF_MD_PRIMARY_SQL_STMT_WHAT_REQUIRES;
+	} else if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_PROVIDES) {
+		stmt_id = ZIF_MD_PRIMARY_SQL_STMT_WHAT_PROVIDES;
+	} else if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS) {
+		stmt_id = ZIF_MD_PRIMARY_SQL_STMT_WHAT_CONFLICTS;
 		hash_tmp = md_primary_sql->priv->conflicts_name;
-	} else if (g_strcmp0 (table_name, "obsoletes") == 0) {
-		ensure_type = ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES;
+	} else if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES) {
+		stmt_id = ZIF_MD_PRIMARY_SQL_STMT_WHAT_OBSOLETES;
 		hash_tmp = md_primary_sql->priv->obsoletes_name;
 	} else {
 		g_assert_not_reached ();
 	}
 
-	/* can we limit the size of the SQL statement by removing
-	 * queries with names that we know are not in the table */
+	/* can we limit the number of search terms by removing
+	 * names that we know are not in the table */
 	depends2 = g_ptr_array_new ();
+	search = g_ptr_array_new ();
 	for (i = 0; i < depends->len; i++) {
 		depend_tmp = g_ptr_array_index (depends, i);
 		if (hash_tmp != NULL &&
@@ -721,66 +1012,25 @@ zif_md_primary_sql_what_depends (ZifMd *md,
 			continue;
 		}
 		g_ptr_array_add (depends2, depend_tmp);
+		g_ptr_array_add (search, (gpointer) zif_depend_get_name (depend_tmp));
 	}
+	g_ptr_array_add (search, NULL);
 
-	/* create one super huge statement with 'ORs' rather than doing
-	 * thousands of indervidual queries */
-	statement = g_string_new ("");
-	g_string_append (statement, "BEGIN;\n");
-
-	for (j = 0; j < depends2->len; j += ZIF_MD_PRIMARY_SQL_MAX_EXPRESSION_DEPTH) {
-		g_string_append_printf (statement, ZIF_MD_PRIMARY_SQL_HEADER ", %s depend WHERE "
-					"p.pkgKey = depend.pkgKey AND (",
-					table_name);
-
-		for (i = j; i < depends2->len && (i-j) < ZIF_MD_PRIMARY_SQL_MAX_EXPRESSION_DEPTH; i++) {
-			depend_tmp = g_ptr_array_index (depends2, i);
-			g_string_append_printf (statement, "depend.name = '%s' OR ",
-						zif_depend_get_name (depend_tmp));
-		}
-		/* remove trailing OR */
-		g_string_set_size (statement, statement->len - 4);
-		g_string_append (statement, ");\n");
-	}
-
-	/* a package always provides itself, even without an explicit provide */
-	if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_PROVIDES) {
-		for (j = 0; j < depends2->len; j+= ZIF_MD_PRIMARY_SQL_MAX_EXPRESSION_DEPTH) {
-			g_string_append (statement, ZIF_MD_PRIMARY_SQL_HEADER " WHERE ");
-
-			for (i=j; i < depends2->len && (i-j)<ZIF_MD_PRIMARY_SQL_MAX_EXPRESSION_DEPTH; i++) {
-				depend_tmp = g_ptr_array_index (depends2, i);
-				g_string_append_printf (statement, "p.name = '%s' OR ",
-							zif_depend_get_name (depend_tmp));
-			}
-			/* remove trailing OR */
-			g_string_set_size (statement, statement->len - 4);
-			g_string_append (statement, ";\n");
-		}
-	}
-
-	g_string_append (statement, "END;\n");
-
-	/* execute the query */
-	if (g_getenv ("ZIF_SQL_DEBUG") != NULL) {
-		g_debug ("On %s\n%s",
-			 zif_md_get_filename_uncompressed (md),
-			 statement->str);
-	}
-	rc = sqlite3_exec (md_primary_sql->priv->db,
-			   statement->str,
-			   zif_md_primary_sql_sqlite_create_package_cb,
-			   data,
-			   &error_msg);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
-			     "SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
-		goto out;
+	/* do all the names in one query rather than doing
+	 * thousands of individual queries */
+	if (depends2->len > 0) {
+		state_local = zif_state_get_child (state);
+		array_tmp = zif_md_primary_sql_search_terms (md_primary_sql,
+							     stmt_id,
+							     (gchar **) search->pdata,
+							     state_local,
+							     error);
+		if (array_tmp == NULL)
+			goto out;
+	} else {
+		array_tmp = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	}
 
-	sqlite3_exec (md_primary_sql->priv->db, "END;", NULL, NULL, NULL);
-
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
@@ -789,22 +1039,22 @@ zif_md_primary_sql_what_depends (ZifMd *md,
 	/* filter results */
 	state_local = zif_state_get_child (state);
 	if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_PROVIDES) {
-		ret = zif_package_array_filter_provide (data->packages,
+		ret = zif_package_array_filter_provide (array_tmp,
 							depends2,
 							state_local,
 							error);
 	} else if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_REQUIRES) {
-		ret = zif_package_array_filter_require (data->packages,
+		ret = zif_package_array_filter_require (array_tmp,
 							depends2,
 							state_local,
 							error);
 	} else if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES) {
-		ret = zif_package_array_filter_obsolete (data->packages,
+		ret = zif_package_array_filter_obsolete (array_tmp,
 							 depends2,
 							 state_local,
 							 error);
 	} else if (ensure_type == ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS) {
-		ret = zif_package_array_filter_conflict (data->packages,
+		ret = zif_package_array_filter_conflict (array_tmp,
 							 depends2,
 							 state_local,
 							 error);
@@ -820,16 +1070,14 @@ zif_md_primary_sql_what_depends (ZifMd *md,
 		goto out;
 
 	/* success */
-	array = g_ptr_array_ref (data->packages);
+	array = g_ptr_array_ref (array_tmp);
 out:
-	if (data != NULL) {
-		g_ptr_array_unref (data->packages);
-		g_free (data);
-	}
+	if (array_tmp != NULL)
+		g_ptr_array_unref (array_tmp);
 	if (depends2 != NULL)
 		g_ptr_array_unref (depends2);
-	if (statement != NULL)
-		g_string_free (statement, TRUE);
+	if (search != NULL)
+		g_ptr_array_unref (search);
 	return array;
 }
 
@@ -840,7 +1088,9 @@ static GPtrArray *
 zif_md_primary_sql_what_provides (ZifMd *md, GPtrArray *depends,
 				  ZifState *state, GError **error)
 {
-	return zif_md_primary_sql_what_depends (md, "provides", depends, state, error);
+	return zif_md_primary_sql_what_depends (md,
+						ZIF_PACKAGE_ENSURE_TYPE_PROVIDES,
+						depends, state, error);
 }
 
 /**
@@ -850,7 +1100,9 @@ static GPtrArray *
 zif_md_primary_sql_what_requires (ZifMd *md, GPtrArray *depends,
 				  ZifState *state, GError **error)
 {
-	return zif_md_primary_sql_what_depends (md, "requires", depends, state, error);
+	return zif_md_primary_sql_what_depends (md,
+						ZIF_PACKAGE_ENSURE_TYPE_REQUIRES,
+						depends, state, error);
 }
 
 /**
@@ -860,7 +1112,9 @@ static GPtrArray *
 zif_md_primary_sql_what_obsoletes (ZifMd *md, GPtrArray *depends,
 				   ZifState *state, GError **error)
 {
-	return zif_md_primary_sql_what_depends (md, "obsoletes", depends, state, error);
+	return zif_md_primary_sql_what_depends (md,
+						ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES,
+						depends, state, error);
 }
 
 /**
@@ -870,7 +1124,27 @@ static GPtrArray *
 zif_md_primary_sql_what_conflicts (ZifMd *md, GPtrArray *depends,
 				   ZifState *state, GError **error)
 {
-	return zif_md_primary_sql_what_depends (md, "conflicts", depends, state, error);
+	return zif_md_primary_sql_what_depends (md,
+						ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS,
+						depends, state, error);
+}
+
+/**
+ * zif_md_primary_sql_bind_nevra:
+ **/
+static void
+zif_md_primary_sql_bind_nevra (sqlite3_stmt *stmt,
+			       const gchar *name,
+			       const gchar *epoch,
+			       const gchar *version,
+			       const gchar *release,
+			       const gchar *arch)
+{
+	sqlite3_bind_text (stmt, 1, name, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, epoch, -1, SQLITE_TRANSIENT);
+	sqlite3_bind_text (stmt, 3, version, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 4, release, -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 5, arch, -1, SQLITE_STATIC);
 }
 
 /**
@@ -878,7 +1152,7 @@ zif_md_primary_sql_what_conflicts (ZifMd *md, GPtrArray *depends,
  **/
 static GPtrArray *
 zif_md_primary_sql_get_depends (ZifMd *md,
-				const gchar *type,
+				ZifMdPrimarySqlStmt stmt_id,
 				ZifPackage *package,
 				ZifState *state,
 				GError **error)
@@ -886,10 +1160,8 @@ zif_md_primary_sql_get_depends (ZifMd *md,
 	const gchar *epoch = NULL;
 	const gchar *release = NULL;
 	const gchar *version = NULL;
-	gchar *error_msg = NULL;
+	gboolean ret;
 	gchar *evr;
-	gchar *statement = NULL;
-	gint rc;
 	GPtrArray *array = NULL;
 	GPtrArray *array_tmp = NULL;
 	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
@@ -897,45 +1169,34 @@ zif_md_primary_sql_get_depends (ZifMd *md,
 	evr = g_strdup (zif_package_get_version (package));
 	zif_package_convert_evr (evr, &epoch, &version, &release);
 
+	/* if not already loaded, load */
+	ret = zif_md_primary_sql_ensure_loaded (md_primary_sql, state, error);
+	if (!ret)
+		goto out;
+
 	/* get depend array for the package */
 	array_tmp = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-	statement = g_strdup_printf ("SELECT depend.name, depend.flags, depend.epoch, "
-				     "depend.version, depend.release FROM %s depend, packages WHERE "
-				     "packages.pkgKey = depend.pkgKey AND "
-				     "packages.name = '%s' AND "
-				     "packages.epoch = '%s' AND "
-				     "packages.version = '%s' AND "
-				     "packages.release = '%s' AND "
-				     "packages.arch = '%s';",
-				     type,
-				     zif_package_get_name (package),
-				     epoch != NULL ? epoch : "0",
-				     version,
-				     release,
-				     zif_package_get_arch (package));
-	if (g_getenv ("ZIF_SQL_DEBUG") != NULL) {
-		g_debug ("On %s\n%s",
-			 zif_md_get_filename_uncompressed (md),
-			 statement);
-	}
-	rc = sqlite3_exec (md_primary_sql->priv->db,
-			   statement,
-			   zif_md_primary_sql_sqlite_depend_cb,
-			   array_tmp,
-			   &error_msg);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_BAD_SQL,
-			     "SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+	g_rec_mutex_lock (&md_primary_sql->priv->mutex);
+	zif_md_primary_sql_bind_nevra (md_primary_sql->priv->stmts[stmt_id],
+				       zif_package_get_name (package),
+				       epoch != NULL ? epoch : "0",
+				       version,
+				       release,
+				       zif_package_get_arch (package));
+	ret = zif_md_primary_sql_step (md_primary_sql,
+				       md_primary_sql->priv->stmts[stmt_id],
+				       zif_md_primary_sql_sqlite_depend_cb,
+				       array_tmp,
+				       error);
+	g_rec_mutex_unlock (&md_primary_sql->priv->mutex);
+	if (!ret)
 		goto out;
-	}
 
 	/* success */
 	array = g_ptr_array_ref (array_tmp);
 out:
 	if (array_tmp != NULL)
 		g_ptr_array_unref (array_tmp);
-	g_free (statement);
 	g_free (evr);
 	return array;
 }
@@ -947,7 +1208,9 @@ static GPtrArray *
 zif_md_primary_sql_get_provides (ZifMd *md, ZifPackage *package,
 				 ZifState *state, GError **error)
 {
-	return zif_md_primary_sql_get_depends (md, "provides", package, state, error);
+	return zif_md_primary_sql_get_depends (md,
+					       ZIF_MD_PRIMARY_SQL_STMT_GET_PROVIDES,
+					       package, state, error);
 }
 
 /**
@@ -957,7 +1220,9 @@ static GPtrArray *
 zif_md_primary_sql_get_requires (ZifMd *md, ZifPackage *package,
 				 ZifState *state, GError **error)
 {
-	return zif_md_primary_sql_get_depends (md, "requires", package, state, error);
+	return zif_md_primary_sql_get_depends (md,
+					       ZIF_MD_PRIMARY_SQL_STMT_GET_REQUIRES,
+					       package, state, error);
 }
 
 /**
@@ -967,7 +1232,9 @@ static GPtrArray *
 zif_md_primary_sql_get_obsoletes (ZifMd *md, ZifPackage *package,
 				  ZifState *state, GError **error)
 {
-	return zif_md_primary_sql_get_depends (md, "obsoletes", package, state, error);
+	return zif_md_primary_sql_get_depends (md,
+					       ZIF_MD_PRIMARY_SQL_STMT_GET_OBSOLETES,
+					       package, state, error);
 }
 
 /**
@@ -977,7 +1244,9 @@ static GPtrArray *
 zif_md_primary_sql_get_conflicts (ZifMd *md, ZifPackage *package,
 				  ZifState *state, GError **error)
 {
-	return zif_md_primary_sql_get_depends (md, "conflicts", package, state, error);
+	return zif_md_primary_sql_get_depends (md,
+					       ZIF_MD_PRIMARY_SQL_STMT_GET_CONFLICTS,
+					       package, state, error);
 }
 
 /**
@@ -988,12 +1257,13 @@ zif_md_primary_sql_find_package (ZifMd *md, const gchar *package_id, ZifState *s
 {
 	gboolean ret;
 	gchar *arch = NULL;
+	gchar *epoch_str = NULL;
 	gchar *name = NULL;
 	gchar *release = NULL;
-	gchar *statement = NULL;
 	gchar *version = NULL;
 	GPtrArray *array = NULL;
 	guint epoch;
+	sqlite3_stmt *stmt;
 
 	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
 
@@ -1014,16 +1284,20 @@ zif_md_primary_sql_find_package (ZifMd *md, const gchar *package_id, ZifState *s
 		goto out;
 	}
 
+	/* if not already loaded, load */
+	ret = zif_md_primary_sql_ensure_loaded (md_primary_sql, state, error);
+	if (!ret)
+		goto out;
+
 	/* search with predicate */
-	statement = g_strdup_printf (ZIF_MD_PRIMARY_SQL_HEADER " WHERE p.name = '%s'"
-				     " AND p.epoch = '%i'"
-				     " AND p.version = '%s'"
-				     " AND p.release = '%s'"
-				     " AND p.arch = '%s'",
-				     name, epoch, version, release, arch);
-	array = zif_md_primary_sql_search (md_primary_sql, statement, state, error);
+	epoch_str = g_strdup_printf ("%i", epoch);
+	stmt = md_primary_sql->priv->stmts[ZIF_MD_PRIMARY_SQL_STMT_FIND_PACKAGE];
+	g_rec_mutex_lock (&md_primary_sql->priv->mutex);
+	zif_md_primary_sql_bind_nevra (stmt, name, epoch_str, version, release, arch);
+	array = zif_md_primary_sql_search (md_primary_sql, stmt, state, error);
+	g_rec_mutex_unlock (&md_primary_sql->priv->mutex);
 out:
-	g_free (statement);
+	g_free (epoch_str);
 	g_free (name);
 	g_free (version);
 	g_free (release);
@@ -1037,6 +1311,7 @@ out:
 static GPtrArray *
 zif_md_primary_sql_get_packages (ZifMd *md, ZifState *state, GError **error)
 {
+	gboolean ret;
 	GPtrArray *array;
 	ZifMdPrimarySql *md_primary_sql = ZIF_MD_PRIMARY_SQL (md);
 
@@ -1044,8 +1319,18 @@ zif_md_primary_sql_get_packages (ZifMd *md, ZifState *state, GError **error)
 	g_return_val_if_fail (zif_state_valid (state), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-	/* search with predicate */
-	array = zif_md_primary_sql_search (md_primary_sql, ZIF_MD_PRIMARY_SQL_HEADER, state, error);
+	/* if not already loaded, load */
+	ret = zif_md_primary_sql_ensure_loaded (md_primary_sql, state, error);
+	if (!ret)
+		return NULL;
+
+	/* no predicate */
+	g_rec_mutex_lock (&md_primary_sql->priv->mutex);
+	array = zif_md_primary_sql_search (md_primary_sql,
+					   md_primary_sql->priv->stmts[ZIF_MD_PRIMARY_SQL_STMT_GET_PACKAGES],
+					   state,
+					   error);
+	g_rec_mutex_unlock (&md_primary_sql->priv->mutex);
 	return array;
 }
 
@@ -1055,16 +1340,50 @@ zif_md_primary_sql_get_packages (ZifMd *md, ZifState *state, GError **error)
 static void
 zif_md_primary_sql_finalize (GObject *object)
 {
+	GHashTableIter iter;
+	GPtrArray *packages;
+	guint i;
 	ZifMdPrimarySql *md;
+	ZifMdPrimarySqlCache *cache;
+	ZifMdPrimarySqlCacheItem *item;
+	ZifPackage *package;
 
 	g_return_if_fail (object != NULL);
 	g_return_if_fail (ZIF_IS_MD_PRIMARY_SQL (object));
 	md = ZIF_MD_PRIMARY_SQL (object);
 
+	/* the packages may outlive us, so stop watching them; any that
+	 * are being finalized right now free their own item and keep the
+	 * cache alive until they have done so */
+	cache = md->priv->package_cache;
+	packages = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_mutex_lock (&cache->mutex);
+	g_hash_table_iter_init (&iter, cache->hash);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &item)) {
+		package = g_weak_ref_get (&item->package);
+		if (package == NULL)
+			continue;
+		g_object_weak_unref (G_OBJECT (package),
+				     zif_md_primary_sql_package_cache_notify_cb,
+				     item);
+		g_ptr_array_add (packages, package);
+		g_hash_table_iter_remove (&iter);
+		g_weak_ref_clear (&item->package);
+		g_free (item);
+		cache->refcount--;
+	}
+	zif_md_primary_sql_package_cache_unref_unlock (cache);
+	g_ptr_array_unref (packages);
+
+	for (i = 0; i < ZIF_MD_PRIMARY_SQL_STMT_LAST; i++) {
+		if (md->priv->stmts[i] != NULL)
+			sqlite3_finalize (md->priv->stmts[i]);
+	}
 	sqlite3_close (md->priv->db);
 	g_object_unref (md->priv->config);
 	g_hash_table_unref (md->priv->conflicts_name);
 	g_hash_table_unref (md->priv->obsoletes_name);
+	g_rec_mutex_clear (&md->priv->mutex);
 
 	G_OBJECT_CLASS (zif_md_primary_sql_parent_class)->finalize (object);
 }
@@ -1120,6 +1439,11 @@ zif_md_primary_sql_init (ZifMdPrimarySql *md)
 				       g_str_equal,
 				       g_free,
 				       NULL);
+	md->priv->package_cache = g_new0 (ZifMdPrimarySqlCache, 1);
+	md->priv->package_cache->hash = g_hash_table_new (g_direct_hash, g_direct_equal);
+	md->priv->package_cache->refcount = 1;
+	g_mutex_init (&md->priv->package_cache->mutex);
+	g_rec_mutex_init (&md->priv->mutex);
 }
 
 /**
@@ -471,17 +471,17 @@ zif_md_primary_xml_parser_text (GMarkupParseContext *context, const gchar *text,
 			goto out;
 		}
 		if (primary_xml->priv->section_package == ZIF_MD_PRIMARY_XML_SECTION_PACKAGE_GROUP) {
-			string = zif_string_new (text);
+			string = zif_string_new_intern (text);
 			zif_package_set_category (primary_xml->priv->package_temp, string);
 			goto out;
 		}
 		if (primary_xml->priv->section_package == ZIF_MD_PRIMARY_XML_SECTION_PACKAGE_SOURCERPM) {
-			string = zif_string_new (text);
+			string = zif_string_new_intern (text);
 			zif_package_set_source_filename (primary_xml->priv->package_temp, string);
 			goto out;
 		}
 		if (primary_xml->priv->section_package == ZIF_MD_PRIMARY_XML_SECTION_PACKAGE_LICENCE) {
-			string = zif_string_new (text);
+			string = zif_string_new_intern (text);
 			zif_package_set_license (primary_xml->priv->package_temp, string);
 			goto out;
 		}
@@ -568,8 +568,12 @@ out:
 }
 
 typedef gboolean (*ZifPackageFilterFunc)		(ZifPackage		*package,
-							 gpointer		 user_data,
-							 ZifStrCompareFunc	 compare_func);
+							 gpointer		 user_data);
+
+typedef struct {
+	GPtrArray		*matchers;
+	GPtrArray		*matchers_noarch;
+} ZifMdPrimaryXmlResolveData;
 
 /**
  * zif_md_primary_xml_filter:
@@ -578,7 +582,6 @@ static GPtrArray *
 zif_md_primary_xml_filter (ZifMd *md,
 			   ZifPackageFilterFunc filter_func,
 			   gpointer user_data,
-			   ZifStrCompareFunc compare_func,
 			   ZifState *state,
 			   GError **error)
 {
@@ -630,7 +633,7 @@ zif_md_primary_xml_filter (ZifMd *md,
 	packages = md_primary->priv->array;
 	for (i = 0; i < packages->len; i++) {
 		package = g_ptr_array_index (packages, i);
-		if (filter_func (package, user_data, compare_func))
+		if (filter_func (package, user_data))
 			g_ptr_array_add (array, g_object_ref (package));
 	}
 
@@ -647,50 +650,11 @@ out:
  **/
 static gboolean
 zif_md_primary_xml_resolve_name_cb (ZifPackage *package,
-				    gpointer user_data,
-				    ZifStrCompareFunc compare_func)
-{
-	guint i;
-	const gchar *value;
-	gchar **search = (gchar **) user_data;
-	value = zif_package_get_name (package);
-	for (i = 0; search[i] != NULL; i++) {
-		if (compare_func (value, search[i]))
-			return TRUE;
-	}
-	return FALSE;
-}
-
-/**
- * zif_md_primary_xml_resolve_name_arch_kill_arch:
- **/
-static gboolean
-zif_md_primary_xml_resolve_name_arch_kill_arch (ZifPackage *package,
-						gpointer user_data,
-						ZifStrCompareFunc compare_func)
+				    gpointer user_data)
 {
-	guint i;
-	gboolean ret = FALSE;
-	const gchar *value;
-	gchar *tmp;
-	gchar **search = g_strdupv (user_data);
-
-	/* we don't use this code path for non-noarch packages as it
-	 * means copying the search GStrv each time */
-	for (i = 0; search[i] != NULL; i++) {
-		tmp = strrchr (search[i], '.');
-		if (tmp != NULL)
-			*tmp = '\0';
-	}
-	value = zif_package_get_name (package);
-	for (i = 0; search[i] != NULL; i++) {
-		if (compare_func (value, search[i])) {
-			ret = TRUE;
-			break;
-		}
-	}
-	g_strfreev (search);
-	return ret;
+	ZifMdPrimaryXmlResolveData *data = (ZifMdPrimaryXmlResolveData *) user_data;
+	return zif_str_matcher_array_match (data->matchers,
+					    zif_package_get_name (package));
 }
 
 /**
@@ -698,27 +662,19 @@ zif_md_primary_xml_resolve_name_arch_kill_arch (ZifPackage *package,
  **/
 static gboolean
 zif_md_primary_xml_resolve_name_arch_cb (ZifPackage *package,
-					 gpointer user_data,
-					 ZifStrCompareFunc compare_func)
+					 gpointer user_data)
 {
-	guint i;
 	const gchar *value;
-	gchar **search = (gchar **) user_data;
+	ZifMdPrimaryXmlResolveData *data = (ZifMdPrimaryXmlResolveData *) user_data;
 
-	/* a noarch package has to be handled specially */
+	/* a noarch package matches the search terms without the arch */
 	value = zif_package_get_arch (package);
 	if (g_strcmp0 (value, "noarch") == 0) {
-		return zif_md_primary_xml_resolve_name_arch_kill_arch (package,
-								       user_data,
-								       compare_func);
-	}
-
-	value = zif_package_get_name_arch (package);
-	for (i = 0; search[i] != NULL; i++) {
-		if (compare_func (value, search[i]))
-			return TRUE;
+		return zif_str_matcher_array_match (data->matchers_noarch,
+						    zif_package_get_name (package));
 	}
-	return FALSE;
+	return zif_str_matcher_array_match (data->matchers,
+					    zif_package_get_name_arch (package));
 }
 
 /**
@@ -726,18 +682,11 @@ zif_md_primary_xml_resolve_name_arch_cb (ZifPackage *package,
  **/
 static gboolean
 zif_md_primary_xml_resolve_name_version_cb (ZifPackage *package,
-					    gpointer user_data,
-					    ZifStrCompareFunc compare_func)
+					    gpointer user_data)
 {
-	guint i;
-	const gchar *value;
-	gchar **search = (gchar **) user_data;
-	value = zif_package_get_name_version (package);
-	for (i = 0; search[i] != NULL; i++) {
-		if (compare_func (value, search[i]))
-			return TRUE;
-	}
-	return FALSE;
+	ZifMdPrimaryXmlResolveData *data = (ZifMdPrimaryXmlResolveData *) user_data;
+	return zif_str_matcher_array_match (data->matchers,
+					    zif_package_get_name_version (package));
 }
 
 /**
@@ -745,18 +694,11 @@ zif_md_primary_xml_resolve_name_version_cb (ZifPackage *package,
  **/
 static gboolean
 zif_md_primary_xml_resolve_name_version_arch_cb (ZifPackage *package,
-						 gpointer user_data,
-						 ZifStrCompareFunc compare_func)
+						 gpointer user_data)
 {
-	guint i;
-	const gchar *value;
-	gchar **search = (gchar **) user_data;
-	value = zif_package_get_name_version_arch (package);
-	for (i = 0; search[i] != NULL; i++) {
-		if (compare_func (value, search[i]))
-			return TRUE;
-	}
-	return FALSE;
+	ZifMdPrimaryXmlResolveData *data = (ZifMdPrimaryXmlResolveData *) user_data;
+	return zif_str_matcher_array_match (data->matchers,
+					    zif_package_get_name_version_arch (package));
 }
 
 /**
@@ -770,13 +712,16 @@ zif_md_primary_xml_resolve (ZifMd *md,
 			    GError **error)
 {
 	gboolean ret;
+	gchar **search_noarch = NULL;
+	gchar *tmp_str;
 	GPtrArray *array = NULL;
-	GPtrArray *array_tmp;
+	GPtrArray *array_tmp = NULL;
 	GPtrArray *tmp;
 	guint cnt = 0;
 	guint i;
+	ZifMdPrimaryXmlResolveData data = { NULL, NULL };
 	ZifState *state_local;
-	ZifStrCompareFunc compare_func;
+	ZifStrMatcherKind kind;
 
 	g_return_val_if_fail (zif_state_valid (state), NULL);
 	g_return_val_if_fail (flags != 0, NULL);
@@ -788,13 +733,27 @@ zif_md_primary_xml_resolve (ZifMd *md,
 	cnt += ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION_ARCH) > 0);
 	zif_state_set_number_steps (state, cnt);
 
-	/* allow globbing (slow) or a regular expressions (much slower) */
+	/* allow globbing or a regular expressions, compiled just once */
 	if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_REGEX) > 0)
-		compare_func = zif_str_compare_regex;
+		kind = ZIF_STR_MATCHER_KIND_REGEX;
 	else if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_GLOB) > 0)
-		compare_func = zif_str_compare_glob;
+		kind = ZIF_STR_MATCHER_KIND_GLOB;
 	else
-		compare_func = zif_str_compare_equal;
+		kind = ZIF_STR_MATCHER_KIND_EQUAL;
+	data.matchers = zif_str_matcher_array_new (search, kind, error);
+	if (data.matchers == NULL)
+		goto out;
+
+	/* noarch packages are matched without the arch suffix */
+	search_noarch = g_strdupv (search);
+	for (i = 0; search_noarch[i] != NULL; i++) {
+		tmp_str = strrchr (search_noarch[i], '.');
+		if (tmp_str != NULL)
+			*tmp_str = '\0';
+	}
+	data.matchers_noarch = zif_str_matcher_array_new (search_noarch, kind, error);
+	if (data.matchers_noarch == NULL)
+		goto out;
 
 	array_tmp = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 
@@ -803,8 +762,7 @@ zif_md_primary_xml_resolve (ZifMd *md,
 		state_local = zif_state_get_child (state);
 		tmp = zif_md_primary_xml_filter (md,
 						 zif_md_primary_xml_resolve_name_cb,
-						 (gpointer) search,
-						 compare_func,
+						 &data,
 						 state_local,
 						 error);
 		if (tmp == NULL)
@@ -824,8 +782,7 @@ zif_md_primary_xml_resolve (ZifMd *md,
 		state_local = zif_state_get_child (state);
 		tmp = zif_md_primary_xml_filter (md,
 						 zif_md_primary_xml_resolve_name_arch_cb,
-						 (gpointer) search,
-						 compare_func,
+						 &data,
 						 state_local,
 						 error);
 		if (tmp == NULL)
@@ -845,8 +802,7 @@ zif_md_primary_xml_resolve (ZifMd *md,
 		state_local = zif_state_get_child (state);
 		tmp = zif_md_primary_xml_filter (md,
 						 zif_md_primary_xml_resolve_name_version_cb,
-						 (gpointer) search,
-						 compare_func,
+						 &data,
 						 state_local,
 						 error);
 		if (tmp == NULL)
@@ -866,8 +822,7 @@ zif_md_primary_xml_resolve (ZifMd *md,
 		state_local = zif_state_get_child (state);
 		tmp = zif_md_primary_xml_filter (md,
 						 zif_md_primary_xml_resolve_name_version_arch_cb,
-						 (gpointer) search,
-						 compare_func,
+						 &data,
 						 state_local,
 						 error);
 		if (tmp == NULL)
@@ -885,7 +840,13 @@ zif_md_primary_xml_resolve (ZifMd *md,
 	/* success */
 	array = g_ptr_array_ref (array_tmp);
 out:
-	g_ptr_array_unref (array_tmp);
+	if (array_tmp != NULL)
+		g_ptr_array_unref (array_tmp);
+	if (data.matchers != NULL)
+		g_ptr_array_unref (data.matchers);
+	if (data.matchers_noarch != NULL)
+		g_ptr_array_unref (data.matchers_noarch);
+	g_strfreev (search_noarch);
 	return array;
 }
 
@@ -894,8 +855,7 @@ out:
  **/
 static gboolean
 zif_md_primary_xml_search_name_cb (ZifPackage *package,
-				   gpointer user_data,
-				   ZifStrCompareFunc compare_func)
+				   gpointer user_data)
 {
 	guint i;
 	const gchar *value;
@@ -918,7 +878,6 @@ zif_md_primary_xml_search_name (ZifMd *md, gchar **search, ZifState *state, GErr
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_search_name_cb,
 					  (gpointer) search,
-					  NULL,
 					  state, error);
 }
 
@@ -927,8 +886,7 @@ zif_md_primary_xml_search_name (ZifMd *md, gchar **search, ZifState *state, GErr
  **/
 static gboolean
 zif_md_primary_xml_search_details_cb (ZifPackage *package,
-				      gpointer user_data,
-				      ZifStrCompareFunc compare_func)
+				      gpointer user_data)
 {
 	guint i;
 	gboolean ret = FALSE;
@@ -982,7 +940,6 @@ zif_md_primary_xml_search_details (ZifMd *md, gchar **search, ZifState *state, G
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_search_details_cb,
 					  (gpointer) search,
-					  NULL,
 					  state,
 					  error);
 }
@@ -992,8 +949,7 @@ zif_md_primary_xml_search_details (ZifMd *md, gchar **search, ZifState *state, G
  **/
 static gboolean
 zif_md_primary_xml_search_group_cb (ZifPackage *package,
-				    gpointer user_data,
-				    ZifStrCompareFunc compare_func)
+				    gpointer user_data)
 {
 	guint i;
 	gboolean ret = FALSE;
@@ -1030,7 +986,6 @@ zif_md_primary_xml_search_group (ZifMd *md, gchar **search, ZifState *state, GEr
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_search_group_cb,
 					  (gpointer) search,
-					  NULL,
 					  state,
 					  error);
 }
@@ -1040,8 +995,7 @@ zif_md_primary_xml_search_group (ZifMd *md, gchar **search, ZifState *state, GEr
  **/
 static gboolean
 zif_md_primary_xml_search_pkgid_cb (ZifPackage *package,
-				    gpointer user_data,
-				    ZifStrCompareFunc compare_func)
+				    gpointer user_data)
 {
 	guint i;
 	const gchar *pkgid;
@@ -1064,7 +1018,6 @@ zif_md_primary_xml_search_pkgid (ZifMd *md, gchar **search, ZifState *state, GEr
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_search_pkgid_cb,
 					  (gpointer) search,
-					  NULL,
 					  state,
 					  error);
 }
@@ -1074,8 +1027,7 @@ zif_md_primary_xml_search_pkgid (ZifMd *md, gchar **search, ZifState *state, GEr
  **/
 static gboolean
 zif_md_primary_xml_what_provides_cb (ZifPackage *package,
-				     gpointer user_data,
-				     ZifStrCompareFunc compare_func)
+				     gpointer user_data)
 {
 	guint i, j;
 	gboolean ret = FALSE;
@@ -1117,8 +1069,7 @@ out:
  **/
 static gboolean
 zif_md_primary_xml_what_requires_cb (ZifPackage *package,
-				     gpointer user_data,
-				     ZifStrCompareFunc compare_func)
+				     gpointer user_data)
 {
 	guint i, j;
 	gboolean ret = FALSE;
@@ -1160,8 +1111,7 @@ out:
  **/
 static gboolean
 zif_md_primary_xml_what_obsoletes_cb (ZifPackage *package,
-				      gpointer user_data,
-				      ZifStrCompareFunc compare_func)
+				      gpointer user_data)
 {
 	guint i, j;
 	gboolean ret = FALSE;
@@ -1203,8 +1153,7 @@ out:
  **/
 static gboolean
 zif_md_primary_xml_what_conflicts_cb (ZifPackage *package,
-				      gpointer user_data,
-				      ZifStrCompareFunc compare_func)
+				      gpointer user_data)
 {
 	guint i, j;
 	gboolean ret = FALSE;
@@ -1252,7 +1201,6 @@ zif_md_primary_xml_what_provides (ZifMd *md, GPtrArray *depends,
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_what_provides_cb,
 					  (gpointer) depends,
-					  NULL,
 					  state,
 					  error);
 }
@@ -1268,7 +1216,6 @@ zif_md_primary_xml_what_requires (ZifMd *md, GPtrArray *depends,
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_what_requires_cb,
 					  (gpointer) depends,
-					  NULL,
 					  state,
 					  error);
 }
@@ -1284,7 +1231,6 @@ zif_md_primary_xml_what_obsoletes (ZifMd *md, GPtrArray *depends,
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_what_obsoletes_cb,
 					  (gpointer) depends,
-					  NULL,
 					  state,
 					  error);
 }
@@ -1300,7 +1246,6 @@ zif_md_primary_xml_what_conflicts (ZifMd *md, GPtrArray *depends,
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_what_conflicts_cb,
 					  (gpointer) depends,
-					  NULL,
 					  state,
 					  error);
 }
@@ -1310,8 +1255,7 @@ zif_md_primary_xml_what_conflicts (ZifMd *md, GPtrArray *depends,
  **/
 static gboolean
 zif_md_primary_xml_find_package_cb (ZifPackage *package,
-				    gpointer user_data,
-				    ZifStrCompareFunc compare_func)
+				    gpointer user_data)
 {
 	const gchar *value;
 	const gchar *search = (const gchar *) user_data;
@@ -1332,7 +1276,6 @@ zif_md_primary_xml_find_package (ZifMd *md,
 	return zif_md_primary_xml_filter (md,
 					  zif_md_primary_xml_find_package_cb,
 					  (gpointer) package_id,
-					  NULL,
 					  state,
 					  error);
 }
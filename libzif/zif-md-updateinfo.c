@@ -37,6 +37,7 @@
 #include "zif-config.h"
 #include "zif-md.h"
 #include "zif-md-updateinfo.h"
+#include "zif-object-array.h"
 #include "zif-package-private.h"
 #include "zif-state-private.h"
 #include "zif-string.h"
@@ -78,6 +79,8 @@ struct _ZifMdUpdateinfoPrivate
 	gboolean			 loaded;
 	ZifConfig			*config;
 	GPtrArray			*array_updates;		/* stored as ZifUpdate */
+	GHashTable			*hash_package_id;	/* package_id -> GPtrArray of ZifUpdate */
+	GHashTable			*hash_name_arch;	/* name.arch -> GPtrArray of ZifUpdate */
 	/* for parser */
 	ZifMdUpdateinfoSection		 section;
 	ZifMdUpdateinfoSectionGroup	 section_group;
@@ -366,6 +369,53 @@ out:
 	g_free (url);
 }
 
+/**
+ * zif_md_updateinfo_index_add:
+ **/
+static void
+zif_md_updateinfo_index_add (GHashTable *hash, const gchar *key, ZifUpdate *update)
+{
+	GPtrArray *array;
+
+	array = g_hash_table_lookup (hash, key);
+	if (array == NULL) {
+		array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		g_hash_table_insert (hash, g_strdup (key), array);
+	}
+
+	/* an update may list more than one arch of the same package */
+	if (array->len > 0 &&
+	    g_ptr_array_index (array, array->len - 1) == update)
+		return;
+	g_ptr_array_add (array, g_object_ref (update));
+}
+
+/**
+ * zif_md_updateinfo_index_update:
+ *
+ * Index the update by each of the packages it contains so lookups do
+ * not have to walk every update in the metadata.
+ **/
+static void
+zif_md_updateinfo_index_update (ZifMdUpdateinfo *md, ZifUpdate *update)
+{
+	GPtrArray *packages;
+	guint i;
+	ZifPackage *package;
+
+	packages = zif_update_get_packages (update);
+	for (i = 0; i < packages->len; i++) {
+		package = g_ptr_array_index (packages, i);
+		zif_md_updateinfo_index_add (md->priv->hash_package_id,
+					     zif_package_get_id (package),
+					     update);
+		zif_md_updateinfo_index_add (md->priv->hash_name_arch,
+					     zif_package_get_name_arch (package),
+					     update);
+	}
+	g_ptr_array_unref (packages);
+}
+
 /**
  * zif_md_updateinfo_parser_end_element:
  **/
@@ -396,7 +446,9 @@ zif_md_updateinfo_parser_end_element (GMarkupParseContext *context, const gchar
 			zif_md_updateinfo_add_vendor_info (updateinfo,
 							   updateinfo->priv->update_temp);
 
-			/* add to array */
+			/* add to array and indexes */
+			zif_md_updateinfo_index_update (updateinfo,
+							updateinfo->priv->update_temp);
 			g_ptr_array_add (updateinfo->priv->array_updates, updateinfo->priv->update_temp);
 			updateinfo->priv->update_temp = NULL;
 			goto out;
@@ -644,13 +696,8 @@ zif_md_updateinfo_get_detail_for_package (ZifMdUpdateinfo *md, const gchar *pack
 {
 	GPtrArray *array = NULL;
 	GPtrArray *array_tmp;
-	guint i;
-	guint j;
-	guint len;
 	gboolean ret;
 	GError *error_local = NULL;
-	ZifUpdate *update;
-	ZifPackage *package;
 
 	g_return_val_if_fail (ZIF_IS_MD_UPDATEINFO (md), NULL);
 	g_return_val_if_fail (package_id != NULL, NULL);
@@ -668,39 +715,138 @@ zif_md_updateinfo_get_detail_for_package (ZifMdUpdateinfo *md, const gchar *pack
 		}
 	}
 
-	/* get packages in this group */
-	len = md->priv->array_updates->len;
-	for (i = 0; i < len; i++) {
-		update = g_ptr_array_index (md->priv->array_updates, i);
+	/* get the updates that contain this package */
+	array_tmp = g_hash_table_lookup (md->priv->hash_package_id, package_id);
+	if (array_tmp == NULL) {
+		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_FAILED,
+			     "could not find package (%i in sack): %s",
+			     md->priv->array_updates->len, package_id);
+		goto out;
+	}
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	zif_object_array_add_array (array, array_tmp);
+out:
+	return array;
+}
 
-		/* have we matched on any entries */
-		ret = FALSE;
+/**
+ * zif_md_updateinfo_get_detail_for_name_arch:
+ * @md: A #ZifMdUpdateinfo
+ * @name_arch: The package name and arch, e.g. "hal.i386"
+ * @state: A %ZifState
+ * @error: A #GError, or %NULL
+ *
+ * Gets the list of update details that contain any version of the
+ * package name and arch.
+ *
+ * Return value: (element-type ZifUpdate) (transfer container): #GPtrArray of #ZifUpdate's
+ *
+ * Since: 0.3.7
+ **/
+GPtrArray *
+zif_md_updateinfo_get_detail_for_name_arch (ZifMdUpdateinfo *md, const gchar *name_arch,
+					    ZifState *state, GError **error)
+{
+	GPtrArray *array = NULL;
+	GPtrArray *array_tmp;
+	gboolean ret;
+	GError *error_local = NULL;
 
-		/* get the list of packages updated by this update */
-		array_tmp = zif_update_get_packages (update);
-		for (j = 0; j < array_tmp->len; j++) {
-			package = g_ptr_array_index (array_tmp, j);
-			if (g_strcmp0 (zif_package_get_id (package), package_id) == 0) {
-				ret = TRUE;
-				break;
-			}
-		}
+	g_return_val_if_fail (ZIF_IS_MD_UPDATEINFO (md), NULL);
+	g_return_val_if_fail (name_arch != NULL, NULL);
+	g_return_val_if_fail (zif_state_valid (state), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-		/* we found a package match */
-		if (ret) {
-			if (array == NULL)
-				array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-			g_ptr_array_add (array, g_object_ref (update));
+	/* if not already loaded, load */
+	if (!md->priv->loaded) {
+		ret = zif_md_load (ZIF_MD (md), state, &error_local);
+		if (!ret) {
+			g_propagate_prefixed_error (error,
+						    error_local,
+						    "failed to get load updateinfo: ");
+			goto out;
 		}
-		g_ptr_array_unref (array_tmp);
 	}
 
-	/* nothing found */
-	if (array == NULL) {
+	/* get the updates that contain this name.arch */
+	array_tmp = g_hash_table_lookup (md->priv->hash_name_arch, name_arch);
+	if (array_tmp == NULL) {
 		g_set_error (error, ZIF_MD_ERROR, ZIF_MD_ERROR_FAILED,
-			     "could not find package (%i in sack): %s", len, package_id);
+			     "could not find package (%i in sack): %s",
+			     md->priv->array_updates->len, name_arch);
+		goto out;
+	}
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	zif_object_array_add_array (array, array_tmp);
+out:
+	return array;
+}
+
+/**
+ * zif_md_updateinfo_get_detail_for_packages:
+ * @md: A #ZifMdUpdateinfo
+ * @packages: (element-type ZifPackage): The packages to look up
+ * @state: A %ZifState
+ * @error: A #GError, or %NULL
+ *
+ * Gets the update details for all of the packages in one call.
+ * Updates that contain more than one of the packages are only
+ * returned once, and packages that are not in any update are ignored.
+ *
+ * Return value: (element-type ZifUpdate) (transfer container): #GPtrArray of #ZifUpdate's
+ *
+ * Since: 0.3.7
+ **/
+GPtrArray *
+zif_md_updateinfo_get_detail_for_packages (ZifMdUpdateinfo *md, GPtrArray *packages,
+					   ZifState *state, GError **error)
+{
+	GHashTable *hash_seen = NULL;
+	GPtrArray *array = NULL;
+	GPtrArray *array_tmp;
+	gboolean ret;
+	GError *error_local = NULL;
+	guint i;
+	guint j;
+	ZifPackage *package;
+	ZifUpdate *update;
+
+	g_return_val_if_fail (ZIF_IS_MD_UPDATEINFO (md), NULL);
+	g_return_val_if_fail (packages != NULL, NULL);
+	g_return_val_if_fail (zif_state_valid (state), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* if not already loaded, load */
+	if (!md->priv->loaded) {
+		ret = zif_md_load (ZIF_MD (md), state, &error_local);
+		if (!ret) {
+			g_propagate_prefixed_error (error,
+						    error_local,
+						    "failed to get load updateinfo: ");
+			goto out;
+		}
+	}
+
+	/* get the updates for each package, without duplicates */
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	hash_seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; i < packages->len; i++) {
+		package = g_ptr_array_index (packages, i);
+		array_tmp = g_hash_table_lookup (md->priv->hash_package_id,
+						 zif_package_get_id (package));
+		if (array_tmp == NULL)
+			continue;
+		for (j = 0; j < array_tmp->len; j++) {
+			update = g_ptr_array_index (array_tmp, j);
+			if (g_hash_table_lookup (hash_seen, update) != NULL)
+				continue;
+			g_hash_table_insert (hash_seen, update, update);
+			g_ptr_array_add (array, g_object_ref (update));
+		}
 	}
 out:
+	if (hash_seen != NULL)
+		g_hash_table_unref (hash_seen);
 	return array;
 }
 
@@ -718,6 +864,8 @@ zif_md_updateinfo_finalize (GObject *object)
 
 	g_object_unref (md->priv->config);
 	g_ptr_array_unref (md->priv->array_updates);
+	g_hash_table_unref (md->priv->hash_package_id);
+	g_hash_table_unref (md->priv->hash_name_arch);
 
 	G_OBJECT_CLASS (zif_md_updateinfo_parent_class)->finalize (object);
 }
@@ -754,6 +902,10 @@ zif_md_updateinfo_init (ZifMdUpdateinfo *md)
 	md->priv->update_info_temp = NULL;
 	md->priv->package_temp = NULL;
 	md->priv->array_updates = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	md->priv->hash_package_id = g_hash_table_new_full (g_str_hash, g_str_equal,
+							   g_free, (GDestroyNotify) g_ptr_array_unref);
+	md->priv->hash_name_arch = g_hash_table_new_full (g_str_hash, g_str_equal,
+							  g_free, (GDestroyNotify) g_ptr_array_unref);
 }
 
 /**
@@ -69,6 +69,14 @@ GPtrArray	*zif_md_updateinfo_get_detail_for_package (ZifMdUpdateinfo	*md,
 							 const gchar		*package_id,
 							 ZifState		*state,
 							 GError			**error);
+GPtrArray	*zif_md_updateinfo_get_detail_for_name_arch (ZifMdUpdateinfo	*md,
+							 const gchar		*name_arch,
+							 ZifState		*state,
+							 GError			**error);
+GPtrArray	*zif_md_updateinfo_get_detail_for_packages (ZifMdUpdateinfo	*md,
+							 GPtrArray		*packages,
+							 ZifState		*state,
+							 GError			**error);
 
 G_END_DECLS
 
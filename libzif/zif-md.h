@@ -54,6 +54,10 @@ struct _ZifMd
 	ZifMdPrivate		*priv;
 };
 
+typedef void	 (*ZifMdFileFunc)		(const gchar		*pkgid,
+						 const gchar		*filename,
+						 gpointer		 user_data);
+
 struct _ZifMdClass
 {
 	GObjectClass				 parent_class;
@@ -120,6 +124,11 @@ struct _ZifMdClass
 						 ZifPackage		*package,
 						 ZifState		*state,
 						 GError			**error);
+	gboolean	 (*foreach_file)	(ZifMd			*md,
+						 ZifMdFileFunc		 func,
+						 gpointer		 user_data,
+						 ZifState		*state,
+						 GError			**error);
 	GPtrArray	*(*get_provides)	(ZifMd			*md,
 						 ZifPackage		*package,
 						 ZifState		*state,
@@ -290,6 +299,11 @@ GPtrArray	*zif_md_get_files			(ZifMd		*md,
 							 ZifPackage	*package,
 							 ZifState	*state,
 							 GError		**error);
+gboolean	 zif_md_foreach_file			(ZifMd		*md,
+							 ZifMdFileFunc	 func,
+							 gpointer	 user_data,
+							 ZifState	*state,
+							 GError		**error);
 GPtrArray	*zif_md_get_requires			(ZifMd		*md,
 							 ZifPackage	*package,
 							 ZifState	*state,
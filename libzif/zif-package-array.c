@@ -31,6 +31,7 @@
 #include <glib.h>
 #include <string.h>
 
+#include "zif-config.h"
 #include "zif-package-array-private.h"
 #include "zif-package-remote.h"
 #include "zif-utils.h"
@@ -217,6 +218,323 @@ zif_package_array_percentage_changed_cb (ZifState *state,
 					percentage);
 }
 
+typedef struct {
+	GMutex			 mutex;
+	GCond			 cond;
+	const gchar		*directory;
+	GHashTable		*stores;
+	guint			 in_flight;
+} ZifPackageArrayDownloadHelper;
+
+typedef struct {
+	ZifPackage		*package;
+	ZifStoreRemote		*store;
+	ZifState		*state;
+	GError			*error;
+	gboolean		 ret;
+	gboolean		 started;
+	gboolean		 finished;
+	gboolean		 reaped;
+	guint			 percentage;
+	guint			 percentage_sent;
+	ZifPackageArrayDownloadHelper *helper;
+} ZifPackageArrayDownloadItem;
+
+/**
+ * zif_package_array_download_item_free:
+ **/
+static void
+zif_package_array_download_item_free (ZifPackageArrayDownloadItem *item)
+{
+	g_object_unref (item->package);
+	g_object_unref (item->state);
+	if (item->store != NULL)
+		g_object_unref (item->store);
+	if (item->error != NULL)
+		g_error_free (item->error);
+	g_free (item);
+}
+
+/**
+ * zif_package_array_download_lock_cb:
+ *
+ * The lock is held by the thread that started the download.
+ **/
+static gboolean
+zif_package_array_download_lock_cb (ZifState *state,
+				    ZifLock *lock,
+				    ZifLockType lock_type,
+				    GError **error,
+				    gpointer user_data)
+{
+	return TRUE;
+}
+
+/**
+ * zif_package_array_download_percentage_cb:
+ *
+ * This is called in the download thread.
+ **/
+static void
+zif_package_array_download_percentage_cb (ZifState *state,
+					  guint percentage,
+					  ZifPackageArrayDownloadItem *item)
+{
+	g_mutex_lock (&item->helper->mutex);
+	item->percentage = percentage;
+	g_cond_signal (&item->helper->cond);
+	g_mutex_unlock (&item->helper->mutex);
+}
+
+/**
+ * zif_package_array_download_thread_cb:
+ **/
+static gpointer
+zif_package_array_download_thread_cb (gpointer user_data)
+{
+	gboolean ret;
+	GError *error_local = NULL;
+	ZifPackageArrayDownloadItem *item = (ZifPackageArrayDownloadItem *) user_data;
+
+	ret = zif_package_remote_download (ZIF_PACKAGE_REMOTE (item->package),
+					   item->helper->directory,
+					   item->state,
+					   &error_local);
+
+	/* tell the scheduler */
+	g_mutex_lock (&item->helper->mutex);
+	item->ret = ret;
+	item->error = error_local;
+	item->percentage = 100;
+	item->finished = TRUE;
+	g_cond_signal (&item->helper->cond);
+	g_mutex_unlock (&item->helper->mutex);
+	return NULL;
+}
+
+/**
+ * zif_package_array_download_parallel:
+ *
+ * Downloads the packages in threads, so that waiting for one server
+ * can be overlapped with downloading from the others.
+ *
+ * The packages are started in order, with at most @max_parallel running
+ * at once, and only @max_per_store of those from the same
+ * #ZifStoreRemote. The filename and size are looked up here first, as
+ * the metadata cannot be queried from more than one thread.
+ **/
+static gboolean
+zif_package_array_download_parallel (GPtrArray *packages,
+				     const gchar *directory,
+				     guint max_parallel,
+				     guint max_per_store,
+				     ZifState *state,
+				     GError **error)
+{
+	gboolean ret;
+	gboolean stop = FALSE;
+	GError *error_local = NULL;
+	GPtrArray *items = NULL;
+	GThread *thread;
+	guint i;
+	guint in_flight_store;
+	guint percentage;
+	guint reaped = 0;
+	ZifPackage *package;
+	ZifPackageArrayDownloadHelper helper;
+	ZifPackageArrayDownloadItem *item;
+	ZifState *state_local;
+	ZifState *state_loop;
+
+	/* the threads all share this lock, which is only needed if the
+	 * metadata has to be reloaded after a failed download */
+	ret = zif_state_take_lock_full (state,
+					ZIF_LOCK_TYPE_METADATA,
+					ZIF_LOCK_MODE_PROCESS,
+					ZIF_LOCK_ACCESS_SHARED,
+					error);
+	if (!ret)
+		return FALSE;
+
+	/* setup steps */
+	ret = zif_state_set_steps (state,
+				   error,
+				   5, /* get filename and size */
+				   95, /* download */
+				   -1);
+	if (!ret)
+		return FALSE;
+
+	g_mutex_init (&helper.mutex);
+	g_cond_init (&helper.cond);
+	helper.directory = directory;
+	helper.in_flight = 0;
+	helper.stores = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	/* get the data we need from the metadata */
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) zif_package_array_download_item_free);
+	state_local = zif_state_get_child (state);
+	zif_state_set_number_steps (state_local, packages->len * 2);
+	for (i = 0; i < packages->len; i++) {
+		package = g_ptr_array_index (packages, i);
+		state_loop = zif_state_get_child (state_local);
+		if (zif_package_get_filename (package, state_loop, &error_local) == NULL) {
+			ret = FALSE;
+			g_propagate_prefixed_error (error, error_local,
+						    "cannot download %s: ",
+						    zif_package_get_printable (package));
+			goto out;
+		}
+		ret = zif_state_done (state_local, error);
+		if (!ret)
+			goto out;
+		state_loop = zif_state_get_child (state_local);
+		if (zif_package_get_size (package, state_loop, &error_local) == 0) {
+			ret = FALSE;
+			g_propagate_prefixed_error (error, error_local,
+						    "cannot download %s: ",
+						    zif_package_get_printable (package));
+			goto out;
+		}
+		ret = zif_state_done (state_local, error);
+		if (!ret)
+			goto out;
+
+		/* each package gets its own progress, which we add up here */
+		item = g_new0 (ZifPackageArrayDownloadItem, 1);
+		item->helper = &helper;
+		item->package = g_object_ref (package);
+		item->store = zif_package_remote_get_store_remote (ZIF_PACKAGE_REMOTE (package));
+		item->state = zif_state_new ();
+		zif_state_set_cancellable (item->state,
+					   zif_state_get_cancellable (state));
+		zif_state_set_lock_handler (item->state,
+					    zif_package_array_download_lock_cb,
+					    NULL);
+		g_signal_connect (item->state, "percentage-changed",
+				  G_CALLBACK (zif_package_array_download_percentage_cb),
+				  item);
+		g_ptr_array_add (items, item);
+	}
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	state_local = zif_state_get_child (state);
+	zif_state_action_start (state_local, ZIF_STATE_ACTION_DOWNLOADING, NULL);
+	g_mutex_lock (&helper.mutex);
+	while (reaped < items->len) {
+
+		/* deal with any that have completed */
+		for (i = 0; i < items->len; i++) {
+			item = g_ptr_array_index (items, i);
+			if (!item->finished || item->reaped)
+				continue;
+			item->reaped = TRUE;
+			reaped++;
+			helper.in_flight--;
+			in_flight_store = GPOINTER_TO_UINT (g_hash_table_lookup (helper.stores, item->store));
+			g_hash_table_insert (helper.stores,
+					     item->store,
+					     GUINT_TO_POINTER (in_flight_store - 1));
+			if (item->ret)
+				continue;
+
+			/* don't start any more, but let the others finish */
+			if (error_local == NULL) {
+				g_set_error (&error_local,
+					     item->error->domain,
+					     item->error->code,
+					     "cannot download %s: %s",
+					     zif_package_get_printable (item->package),
+					     item->error->message);
+			}
+			stop = TRUE;
+		}
+
+		/* start as many as we are allowed */
+		for (i = 0; i < items->len && !stop; i++) {
+			item = g_ptr_array_index (items, i);
+			if (item->started)
+				continue;
+			if (helper.in_flight >= max_parallel)
+				break;
+			in_flight_store = GPOINTER_TO_UINT (g_hash_table_lookup (helper.stores, item->store));
+			if (in_flight_store >= max_per_store)
+				continue;
+			g_debug ("downloading %s",
+				 zif_package_get_id (item->package));
+			g_hash_table_insert (helper.stores,
+					     item->store,
+					     GUINT_TO_POINTER (in_flight_store + 1));
+			helper.in_flight++;
+			item->started = TRUE;
+			thread = g_thread_new ("zif-download",
+					       zif_package_array_download_thread_cb,
+					       item);
+			g_thread_unref (thread);
+		}
+
+		/* anything that was never started is done with */
+		if (stop && helper.in_flight == 0)
+			break;
+
+		/* add up the progress, and tell the UI about each package */
+		percentage = 0;
+		for (i = 0; i < items->len; i++) {
+			item = g_ptr_array_index (items, i);
+			percentage += item->percentage;
+		}
+		percentage /= items->len;
+		g_mutex_unlock (&helper.mutex);
+		for (i = 0; i < items->len; i++) {
+			item = g_ptr_array_index (items, i);
+			if (!item->started ||
+			    item->percentage == item->percentage_sent)
+				continue;
+			item->percentage_sent = item->percentage;
+			g_debug ("%s is DOWNLOADING @%i%%",
+				 zif_package_get_id_basic (item->package),
+				 item->percentage_sent);
+			zif_state_set_package_progress (state_local,
+							zif_package_get_id_basic (item->package),
+							ZIF_STATE_ACTION_DOWNLOADING,
+							item->percentage_sent);
+		}
+		if (percentage > zif_state_get_percentage (state_local))
+			zif_state_set_percentage (state_local, percentage);
+		g_mutex_lock (&helper.mutex);
+
+		/* wait for something to change */
+		if (reaped < items->len)
+			g_cond_wait (&helper.cond, &helper.mutex);
+	}
+	g_mutex_unlock (&helper.mutex);
+
+	/* the first fatal error */
+	if (error_local != NULL) {
+		g_propagate_error (error, error_local);
+		ret = FALSE;
+		goto out;
+	}
+
+	/* this section done */
+	ret = zif_state_finished (state_local, error);
+	if (!ret)
+		goto out;
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+out:
+	g_ptr_array_unref (items);
+	g_hash_table_unref (helper.stores);
+	g_mutex_clear (&helper.mutex);
+	g_cond_clear (&helper.cond);
+	return ret;
+}
+
 /**
  * zif_package_array_download:
  * @packages: array of %ZifPackage's
@@ -226,6 +544,9 @@ zif_package_array_percentage_changed_cb (ZifState *state,
  *
  * Downloads a list of packages.
  *
+ * If max_parallel_downloads is set in the config file then packages
+ * are downloaded at the same time.
+ *
  * Return value: %TRUE for success, %FALSE otherwise
  *
  * Since: 0.2.5
@@ -239,7 +560,10 @@ zif_package_array_download (GPtrArray *packages,
 	gboolean ret = TRUE;
 	GError *error_local = NULL;
 	guint i;
+	guint max_parallel;
+	guint max_per_store;
 	guint percentage_id;
+	ZifConfig *config;
 	ZifPackage *package;
 	ZifState *state_loop;
 
@@ -247,6 +571,24 @@ zif_package_array_download (GPtrArray *packages,
 	g_return_val_if_fail (state != NULL, FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+	/* download more than one at a time */
+	config = zif_config_new ();
+	max_parallel = zif_config_get_uint (config, "max_parallel_downloads", NULL);
+	max_per_store = zif_config_get_uint (config, "max_parallel_downloads_per_repo", NULL);
+	g_object_unref (config);
+	if (max_per_store == 0 || max_per_store == G_MAXUINT)
+		max_per_store = 1;
+	if (max_parallel > 1 && max_parallel != G_MAXUINT &&
+	    packages->len > 1) {
+		ret = zif_package_array_download_parallel (packages,
+							   directory,
+							   max_parallel,
+							   max_per_store,
+							   state,
+							   error);
+		goto out;
+	}
+
 	zif_state_set_number_steps (state, packages->len);
 	for (i = 0; i < packages->len; i++) {
 		package = g_ptr_array_index (packages, i);
@@ -40,6 +40,7 @@
 #include "zif-groups.h"
 #include "zif-history.h"
 #include "zif-package-local.h"
+#include "zif-package-local-private.h"
 #include "zif-package-private.h"
 #include "zif-string.h"
 #include "zif-utils-private.h"
@@ -58,15 +59,22 @@ struct _ZifPackageLocalPrivate
 	ZifDb			*db;
 	ZifHistory		*history;
 	gchar			*key_id;
+	gchar			*rpmdb_prefix;
+	guint			 instance;
 };
 
 G_DEFINE_TYPE (ZifPackageLocal, zif_package_local, ZIF_TYPE_PACKAGE)
 
+/* one read-only rpmdb handle shared by all the lazily loaded packages */
+static GMutex zif_package_local_rpmdb_mutex;
+static rpmts zif_package_local_rpmdb_ts = NULL;
+static gchar *zif_package_local_rpmdb_prefix = NULL;
+
 /**
- * zif_get_header_string:
+ * zif_get_header_string_full:
  **/
 static ZifString *
-zif_get_header_string (Header header, rpmTag tag)
+zif_get_header_string_full (Header header, rpmTag tag, gboolean intern)
 {
 	gint retval;
 	ZifString *data = NULL;
@@ -77,13 +85,25 @@ zif_get_header_string (Header header, rpmTag tag)
 
 	if (retval != 1)
 		goto out;
-	data = zif_string_new (rpmtdGetString (td));
+	if (intern)
+		data = zif_string_new_intern (rpmtdGetString (td));
+	else
+		data = zif_string_new (rpmtdGetString (td));
 out:
 	rpmtdFreeData (td);
 	rpmtdFree (td);
 	return data;
 }
 
+/**
+ * zif_get_header_string:
+ **/
+static ZifString *
+zif_get_header_string (Header header, rpmTag tag)
+{
+	return zif_get_header_string_full (header, tag, FALSE);
+}
+
 /**
  * zif_get_header_key_id:
  **/
@@ -243,6 +263,170 @@ zif_package_local_get_depends_from_name_flags_version (GPtrArray *names, GPtrArr
 	return array;
 }
 
+/**
+ * zif_package_local_header_matches:
+ **/
+static gboolean
+zif_package_local_header_matches (ZifPackageLocal *pkg, Header header)
+{
+	const gchar *pkgid;
+	ZifString *tmp;
+	gboolean ret;
+
+	tmp = zif_get_header_string (header, RPMTAG_SHA1HEADER);
+	if (tmp == NULL)
+		return FALSE;
+	pkgid = zif_package_get_pkgid (ZIF_PACKAGE (pkg));
+	ret = g_strcmp0 (zif_string_get_value (tmp), pkgid) == 0;
+	zif_string_unref (tmp);
+	return ret;
+}
+
+/**
+ * zif_package_local_load_header:
+ *
+ * Packages created from the rpmdb snapshot only know where their header
+ * is, so read it the first time something other than the depends is
+ * needed. The instance is only a hint, as the rpmdb may have been
+ * rebuilt, so the header is always checked against the pkgid.
+ **/
+static Header
+zif_package_local_load_header (ZifPackageLocal *pkg)
+{
+	const gchar *pkgid;
+	gint rc;
+	Header header;
+	rpmdbMatchIterator mi;
+
+	/* already loaded, or a real local file */
+	if (pkg->priv->header != NULL || pkg->priv->rpmdb_prefix == NULL)
+		return pkg->priv->header;
+
+	g_mutex_lock (&zif_package_local_rpmdb_mutex);
+
+	/* open the rpmdb, or reopen it if the prefix has changed */
+	if (g_strcmp0 (zif_package_local_rpmdb_prefix,
+		       pkg->priv->rpmdb_prefix) != 0) {
+		if (zif_package_local_rpmdb_ts != NULL)
+			rpmtsFree (zif_package_local_rpmdb_ts);
+		g_free (zif_package_local_rpmdb_prefix);
+		zif_package_local_rpmdb_prefix = NULL;
+		zif_package_local_rpmdb_ts = rpmtsCreate ();
+		rpmtsSetVSFlags (zif_package_local_rpmdb_ts, RPMVSF_NOHDRCHK);
+		rc = rpmtsSetRootDir (zif_package_local_rpmdb_ts,
+				      pkg->priv->rpmdb_prefix);
+		if (rc < 0) {
+			g_warning ("failed to set root (%s)",
+				   pkg->priv->rpmdb_prefix);
+			rpmtsFree (zif_package_local_rpmdb_ts);
+			zif_package_local_rpmdb_ts = NULL;
+			goto out;
+		}
+		zif_package_local_rpmdb_prefix = g_strdup (pkg->priv->rpmdb_prefix);
+	}
+
+	/* try the instance first, as that's a direct lookup */
+	if (pkg->priv->instance != 0) {
+		mi = rpmtsInitIterator (zif_package_local_rpmdb_ts,
+					RPMDBI_PACKAGES,
+					&pkg->priv->instance,
+					sizeof (pkg->priv->instance));
+		if (mi != NULL) {
+			header = rpmdbNextIterator (mi);
+			if (header != NULL &&
+			    zif_package_local_header_matches (pkg, header))
+				pkg->priv->header = headerLink (header);
+			rpmdbFreeIterator (mi);
+		}
+		if (pkg->priv->header != NULL)
+			goto out;
+	}
+
+	/* fall back to the pkgid index */
+	pkgid = zif_package_get_pkgid (ZIF_PACKAGE (pkg));
+	g_debug ("instance %i is stale for %s, looking up %s",
+		 pkg->priv->instance,
+		 zif_package_get_printable (ZIF_PACKAGE (pkg)),
+		 pkgid);
+	mi = rpmtsInitIterator (zif_package_local_rpmdb_ts,
+				RPMTAG_SHA1HEADER,
+				pkgid, 0);
+	if (mi != NULL) {
+		header = rpmdbNextIterator (mi);
+		if (header != NULL) {
+			pkg->priv->header = headerLink (header);
+			pkg->priv->instance = headerGetInstance (header);
+		}
+		rpmdbFreeIterator (mi);
+	}
+out:
+	g_mutex_unlock (&zif_package_local_rpmdb_mutex);
+	return pkg->priv->header;
+}
+
+/**
+ * zif_package_local_close_rpmdb:
+ *
+ * Closes the rpmdb handle used to read headers on demand, which is
+ * needed when the rpmdb is about to change.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_package_local_close_rpmdb (void)
+{
+	g_mutex_lock (&zif_package_local_rpmdb_mutex);
+	if (zif_package_local_rpmdb_ts != NULL) {
+		rpmtsFree (zif_package_local_rpmdb_ts);
+		zif_package_local_rpmdb_ts = NULL;
+	}
+	g_free (zif_package_local_rpmdb_prefix);
+	zif_package_local_rpmdb_prefix = NULL;
+	g_mutex_unlock (&zif_package_local_rpmdb_mutex);
+}
+
+/**
+ * zif_package_local_set_rpmdb:
+ * @pkg: A #ZifPackageLocal
+ * @prefix: The install root of the rpmdb, e.g. "/"
+ * @instance: The rpmdb instance of the header, or 0 for unknown
+ *
+ * Sets where the header can be read from when it is first needed,
+ * rather than keeping the header of every installed package in memory.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_package_local_set_rpmdb (ZifPackageLocal *pkg,
+			     const gchar *prefix,
+			     guint instance)
+{
+	g_return_if_fail (ZIF_IS_PACKAGE_LOCAL (pkg));
+	g_return_if_fail (prefix != NULL);
+	g_free (pkg->priv->rpmdb_prefix);
+	pkg->priv->rpmdb_prefix = g_strdup (prefix);
+	pkg->priv->instance = instance;
+}
+
+/**
+ * zif_package_local_get_instance:
+ * @pkg: A #ZifPackageLocal
+ *
+ * Gets the rpmdb instance of the package header.
+ *
+ * Return value: The instance, or 0 if the package is not from the rpmdb
+ *
+ * Since: 0.3.7
+ **/
+guint
+zif_package_local_get_instance (ZifPackageLocal *pkg)
+{
+	g_return_val_if_fail (ZIF_IS_PACKAGE_LOCAL (pkg), 0);
+	if (pkg->priv->instance == 0 && pkg->priv->header != NULL)
+		return headerGetInstance (pkg->priv->header);
+	return pkg->priv->instance;
+}
+
 /*
  * zif_package_local_ensure_data:
  */
@@ -267,7 +451,7 @@ zif_package_local_ensure_data (ZifPackage *pkg,
 	GPtrArray *names;
 	GPtrArray *versions;
 	gboolean ret = FALSE;
-	Header header = ZIF_PACKAGE_LOCAL(pkg)->priv->header;
+	Header header = zif_package_local_load_header (ZIF_PACKAGE_LOCAL (pkg));
 
 	g_return_val_if_fail (zif_state_valid (state), FALSE);
 
@@ -335,7 +519,7 @@ zif_package_local_ensure_data (ZifPackage *pkg,
 
 	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_LICENCE) {
 		/* license */
-		tmp = zif_get_header_string (header, RPMTAG_LICENSE);
+		tmp = zif_get_header_string_full (header, RPMTAG_LICENSE, TRUE);
 		zif_package_set_license (pkg, tmp);
 		zif_string_unref (tmp);
 
@@ -369,14 +553,14 @@ zif_package_local_ensure_data (ZifPackage *pkg,
 
 	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_CATEGORY) {
 		/* category */
-		tmp = zif_get_header_string (header, RPMTAG_GROUP);
+		tmp = zif_get_header_string_full (header, RPMTAG_GROUP, TRUE);
 		zif_package_set_category (pkg, tmp);
 		zif_string_unref (tmp);
 
 	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_SOURCE_FILENAME) {
 
 		/* source rpm */
-		tmp = zif_get_header_string (header, RPMTAG_SOURCERPM);
+		tmp = zif_get_header_string_full (header, RPMTAG_SOURCERPM, TRUE);
 		zif_package_set_source_filename (pkg, tmp);
 		zif_string_unref (tmp);
 
@@ -392,7 +576,7 @@ zif_package_local_ensure_data (ZifPackage *pkg,
 		if (group == NULL)
 			goto out;
 
-		tmp = zif_string_new (group);
+		tmp = zif_string_new_intern (group);
 		zif_package_set_group (pkg, tmp);
 		zif_string_unref (tmp);
 
@@ -496,7 +680,7 @@ gpointer
 zif_package_local_get_header (ZifPackageLocal *pkg)
 {
 	g_return_val_if_fail (ZIF_IS_PACKAGE_LOCAL (pkg), NULL);
-	return pkg->priv->header;
+	return zif_package_local_load_header (pkg);
 }
 
 /**
@@ -728,6 +912,10 @@ zif_package_local_get_key_id (ZifPackageLocal *pkg)
 	if (pkg->priv->key_id != NULL)
 		goto out;
 
+	/* no header available */
+	if (zif_package_local_load_header (pkg) == NULL)
+		goto out;
+
 	/* try RSA first */
 	pkg->priv->key_id = zif_get_header_key_id (pkg->priv->header,
 						   RPMTAG_RSAHEADER);
@@ -758,6 +946,7 @@ zif_package_local_finalize (GObject *object)
 	pkg = ZIF_PACKAGE_LOCAL (object);
 
 	g_free (pkg->priv->key_id);
+	g_free (pkg->priv->rpmdb_prefix);
 	g_object_unref (pkg->priv->groups);
 	g_object_unref (pkg->priv->db);
 	g_object_unref (pkg->priv->history);
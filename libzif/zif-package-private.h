@@ -87,6 +87,13 @@ void			 zif_package_set_conflicts	(ZifPackage	*package,
 							 GPtrArray	*conflicts);
 void			 zif_package_set_time_file	(ZifPackage	*package,
 							 guint64	 time_file);
+GArray			*zif_package_get_depend_entries	(ZifPackage	*package,
+							 ZifPackageEnsureType type,
+							 ZifState	*state,
+							 GError		**error);
+void			 zif_package_set_depend_entries	(ZifPackage	*package,
+							 ZifPackageEnsureType type,
+							 GArray		*entries);
 
 G_END_DECLS
 
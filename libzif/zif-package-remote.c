@@ -120,11 +120,11 @@ zif_package_remote_set_from_repo (ZifPackageRemote *pkg, guint length, gchar **t
 			zif_package_set_url (ZIF_PACKAGE (pkg), string);
 			zif_string_unref (string);
 		} else if (g_strcmp0 (type[i], "rpm_license") == 0) {
-			string = zif_string_new (data[i]);
+			string = zif_string_new_intern (data[i]);
 			zif_package_set_license (ZIF_PACKAGE (pkg), string);
 			zif_string_unref (string);
 		} else if (g_strcmp0 (type[i], "rpm_group") == 0) {
-			string = zif_string_new (data[i]);
+			string = zif_string_new_intern (data[i]);
 			zif_package_set_category (ZIF_PACKAGE (pkg), string);
 			zif_string_unref (string);
 		} else if (g_strcmp0 (type[i], "size_package") == 0) {
@@ -138,7 +138,7 @@ zif_package_remote_set_from_repo (ZifPackageRemote *pkg, guint length, gchar **t
 			zif_package_set_location_href (ZIF_PACKAGE (pkg), string);
 			zif_string_unref (string);
 		} else if (g_strcmp0 (type[i], "rpm_sourcerpm") == 0) {
-			string = zif_string_new (data[i]);
+			string = zif_string_new_intern (data[i]);
 			zif_package_set_source_filename (ZIF_PACKAGE (pkg), string);
 			zif_string_unref (string);
 		} else if (g_strcmp0 (type[i], "time_file") == 0) {
@@ -854,7 +854,7 @@ zif_package_remote_ensure_data (ZifPackage *pkg,
 		if (group == NULL)
 			goto out;
 
-		tmp = zif_string_new (group);
+		tmp = zif_string_new_intern (group);
 		zif_package_set_group (pkg, tmp);
 	} else {
 		g_set_error (error,
@@ -37,17 +37,18 @@
 #include "zif-config.h"
 #include "zif-depend-private.h"
 #include "zif-legal.h"
-#include "zif-object-array.h"
 #include "zif-package-private.h"
 #include "zif-repos.h"
 #include "zif-string.h"
 #include "zif-utils.h"
+#include "zif-utils-private.h"
 
 #define ZIF_PACKAGE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ZIF_TYPE_PACKAGE, ZifPackagePrivate))
 
 struct _ZifPackagePrivate
 {
 	gchar			**package_id_split;
+	ZifEvr			*evr;
 	gchar			*package_id;
 	gchar			*package_id_basic;
 	gchar			*printable;
@@ -69,19 +70,12 @@ struct _ZifPackagePrivate
 	guint64			 size;
 	guint64			 time_file;
 	GPtrArray		*files;
-	GPtrArray		*requires;
-	GPtrArray		*provides;
+	GArray			*requires;	/* of ZifDependEntry */
+	GArray			*provides;	/* of ZifDependEntry */
+	GHashTable		*provides_files;
 	gboolean		 provides_set;
-	GPtrArray		*obsoletes;
-	GPtrArray		*conflicts;
-	GHashTable		*requires_hash;
-	GHashTable		*provides_hash;
-	GHashTable		*obsoletes_hash;
-	GHashTable		*conflicts_hash;
-	gboolean		 any_file_requires;
-	gboolean		 any_file_provides;
-	gboolean		 any_file_obsoletes;
-	gboolean		 any_file_conflicts;
+	GArray			*obsoletes;	/* of ZifDependEntry */
+	GArray			*conflicts;	/* of ZifDependEntry */
 	gboolean		 installed;
 	ZifPackageTrustKind	 trust_kind;
 	ZifPackageCompareMode	 compare_mode;
@@ -244,9 +238,9 @@ zif_package_compare_full (ZifPackage *a,
 
 	/* do a version compare */
 	if ((flags & ZIF_PACKAGE_COMPARE_FLAG_CHECK_VERSION) > 0) {
-		val = zif_compare_evr_full (splita[ZIF_PACKAGE_ID_VERSION],
-					    splitb[ZIF_PACKAGE_ID_VERSION],
-					    a->priv->compare_mode);
+		val = zif_evr_compare (a->priv->evr,
+				       b->priv->evr,
+				       a->priv->compare_mode);
 		if (val != 0)
 			goto out;
 	}
@@ -311,6 +305,117 @@ zif_package_is_compatible_arch (ZifPackage *a, ZifPackage *b)
 	return zif_arch_is_native (archa, archb);
 }
 
+/**
+ * zif_package_depends_new:
+ **/
+static GArray *
+zif_package_depends_new (guint reserved_size)
+{
+	return zif_depend_entry_array_new (reserved_size);
+}
+
+/**
+ * zif_package_depends_add:
+ **/
+static void
+zif_package_depends_add (GArray **array, ZifDepend *depend)
+{
+	ZifDependEntry entry;
+
+	if (*array == NULL)
+		*array = zif_package_depends_new (1);
+	zif_depend_entry_init_from_depend (&entry, depend);
+	g_array_append_val (*array, entry);
+}
+
+/**
+ * zif_package_depends_add_array:
+ **/
+static void
+zif_package_depends_add_array (GArray **array, GPtrArray *depends)
+{
+	guint i;
+	ZifDependEntry entry;
+
+	if (*array == NULL)
+		*array = zif_package_depends_new (depends->len);
+	for (i = 0; i < depends->len; i++) {
+		zif_depend_entry_init_from_depend (&entry, g_ptr_array_index (depends, i));
+		g_array_append_val (*array, entry);
+	}
+}
+
+/**
+ * zif_package_depends_to_objects:
+ *
+ * The depends are only turned into objects when something asks
+ * for them, and the objects are not kept by the package.
+ **/
+static GPtrArray *
+zif_package_depends_to_objects (GArray *array)
+{
+	GPtrArray *depends;
+	guint i;
+
+	depends = g_ptr_array_new_full (array != NULL ? array->len : 0,
+					(GDestroyNotify) g_object_unref);
+	if (array == NULL)
+		return depends;
+	for (i = 0; i < array->len; i++) {
+		g_ptr_array_add (depends,
+				 zif_depend_new_from_entry (&g_array_index (array, ZifDependEntry, i)));
+	}
+	return depends;
+}
+
+/**
+ * zif_package_depends_find:
+ *
+ * As the names are interned this is just a pointer compare for each
+ * depend, and only the ones with the right name check the version.
+ **/
+static ZifDepend *
+zif_package_depends_find (GArray *array, ZifDepend *depend)
+{
+	guint i;
+	ZifDependEntry *entry;
+	ZifString *name;
+
+	name = zif_depend_get_name_str (depend);
+	if (name == NULL || array == NULL)
+		return NULL;
+
+	for (i = 0; i < array->len; i++) {
+		entry = &g_array_index (array, ZifDependEntry, i);
+		if (entry->name != name)
+			continue;
+		if (zif_depend_entry_satisfies (entry, depend))
+			return zif_depend_new_from_entry (entry);
+	}
+	return NULL;
+}
+
+/**
+ * zif_package_print_depends:
+ **/
+static void
+zif_package_print_depends (const gchar *title, GArray *array)
+{
+	guint i;
+	ZifDependEntry *entry;
+
+	if (array == NULL)
+		return;
+	g_print ("%s:\n", title);
+	for (i = 0; i < array->len; i++) {
+		entry = &g_array_index (array, ZifDependEntry, i);
+		g_print ("\t[%s %s %s]\n",
+			 zif_depend_entry_get_name (entry),
+			 zif_depend_flag_to_string (entry->flag),
+			 entry->version != NULL ? zif_depend_entry_get_version (entry) : "");
+	}
+}
+
 /**
  * zif_package_print:
  * @package: A #ZifPackage
@@ -323,8 +428,6 @@ void
 zif_package_print (ZifPackage *package)
 {
 	guint i;
-	const gchar *text;
-	ZifDepend *depend;
 	GPtrArray *array;
 
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
@@ -367,42 +470,10 @@ zif_package_print (ZifPackage *package)
 		for (i = 0; i < array->len; i++)
 			g_print ("\t%s\n", (const gchar *) g_ptr_array_index (array, i));
 	}
-	if (package->priv->requires != NULL) {
-		g_print ("requires:\n");
-		array = package->priv->requires;
-		for (i = 0; i < array->len; i++) {
-			depend = g_ptr_array_index (array, i);
-			text = zif_depend_get_description (depend);
-			g_print ("\t%s\n", text);
-		}
-	}
-	if (package->priv->provides != NULL) {
-		g_print ("provides:\n");
-		array = package->priv->provides;
-		for (i = 0; i < array->len; i++) {
-			depend = g_ptr_array_index (array, i);
-			text = zif_depend_get_description (depend);
-			g_print ("\t%s\n", text);
-		}
-	}
-	if (package->priv->obsoletes != NULL) {
-		g_print ("obsoletes:\n");
-		array = package->priv->obsoletes;
-		for (i = 0; i < array->len; i++) {
-			depend = g_ptr_array_index (array, i);
-			text = zif_depend_get_description (depend);
-			g_print ("\t%s\n", text);
-		}
-	}
-	if (package->priv->conflicts != NULL) {
-		g_print ("conflicts:\n");
-		array = package->priv->conflicts;
-		for (i = 0; i < array->len; i++) {
-			depend = g_ptr_array_index (array, i);
-			text = zif_depend_get_description (depend);
-			g_print ("\t%s\n", text);
-		}
-	}
+	zif_package_print_depends ("requires", package->priv->requires);
+	zif_package_print_depends ("provides", package->priv->provides);
+	zif_package_print_depends ("obsoletes", package->priv->obsoletes);
+	zif_package_print_depends ("conflicts", package->priv->conflicts);
 }
 
 /**
@@ -595,6 +666,9 @@ out:
  *
  * Gets the package dependency that satisfies the supplied dependency.
  *
+ * The file list is only loaded if @depend is a file path that is not
+ * explicitly provided by the package.
+ *
  * Return value: %TRUE if the package was searched.
  * Use @satisfies == %NULL to detect a missing dependency.
  *
@@ -608,9 +682,7 @@ zif_package_provides (ZifPackage *package,
 		      GError **error)
 {
 	gboolean ret = TRUE;
-	guint i;
-	ZifDepend *depend_tmp;
-	const gchar *depend_id;
+	const gchar *name;
 
 	g_return_val_if_fail (package != NULL, FALSE);
 	g_return_val_if_fail (depend != NULL, FALSE);
@@ -618,6 +690,9 @@ zif_package_provides (ZifPackage *package,
 	g_return_val_if_fail (state != NULL, FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+	/* set to unfound */
+	*satisfies = NULL;
+
 	/* this is quicker than just getting an array we don't use */
 	if (!package->priv->provides_set) {
 		ret = zif_package_ensure_data (package,
@@ -627,6 +702,15 @@ zif_package_provides (ZifPackage *package,
 		if (!ret)
 			goto out;
 	}
+
+	/* sonames and virtual provides can never be satisfied by
+	 * a file, so don't load the file list for them */
+	*satisfies = zif_package_depends_find (package->priv->provides, depend);
+	name = zif_depend_get_name (depend);
+	if (*satisfies != NULL || name[0] != '/')
+		goto out;
+
+	/* this is a file depend, so try the file list */
 	if (package->priv->files == NULL) {
 		ret = zif_package_ensure_data (package,
 					       ZIF_PACKAGE_ENSURE_TYPE_FILES,
@@ -635,49 +719,12 @@ zif_package_provides (ZifPackage *package,
 		if (!ret)
 			goto out;
 	}
-
-	/* this is a file depend, but we know there are none so don't
-	 * even try to lookup using either hash */
-	if (zif_depend_get_name (depend)[0] == '/' &&
-	    !package->priv->any_file_provides) {
-		ret = TRUE;
-		*satisfies = NULL;
-		goto out;
-	}
-
-	/* search in the 'any' cache first */
-	if (zif_depend_get_flag (depend) == ZIF_DEPEND_FLAG_ANY) {
-		depend_id = zif_depend_get_name (depend);
-		ret = g_hash_table_lookup_extended (package->priv->provides_hash,
-						    depend_id,
-						    NULL,
-						    (void **) &depend_tmp);
-		if (ret) {
-			/* object is in the cache */
-			*satisfies = g_object_ref (depend_tmp);
-		} else {
-			/* object is not in the cache, but we already added all entries */
-			ret = TRUE;
-			*satisfies = NULL;
-		}
-		goto out;
+	if (package->priv->provides_files != NULL &&
+	    g_hash_table_lookup (package->priv->provides_files, name) != NULL) {
+		*satisfies = zif_depend_new ();
+		zif_depend_set_flag (*satisfies, ZIF_DEPEND_FLAG_ANY);
+		zif_depend_set_name (*satisfies, name);
 	}
-
-	/* set to unfound */
-	*satisfies = NULL;
-
-	/* find what we're looking for */
-	for (i = 0; i < package->priv->provides->len; i++) {
-		depend_tmp = g_ptr_array_index (package->priv->provides, i);
-		ret = zif_depend_satisfies (depend_tmp, depend);
-		if (ret) {
-			*satisfies = g_object_ref (depend_tmp);
-			break;
-		}
-	}
-
-	/* success either way */
-	ret = TRUE;
 out:
 	return ret;
 }
@@ -705,9 +752,9 @@ zif_package_requires (ZifPackage *package,
 		      GError **error)
 {
 	gboolean ret = TRUE;
-	guint i;
-	ZifDepend *depend_tmp;
-	const gchar *depend_id;
+
+	/* set to unfound */
+	*satisfies = NULL;
 
 	/* this is quicker than just getting an array we don't use */
 	if (package->priv->requires == NULL) {
@@ -719,50 +766,13 @@ zif_package_requires (ZifPackage *package,
 			goto out;
 	}
 
-	/* this is a file depend, but we know there are none so don't
-	 * even try to lookup using either hash */
-	if (zif_depend_get_name (depend)[0] == '/' &&
-	    !package->priv->any_file_requires) {
-		ret = TRUE;
-		*satisfies = NULL;
-		goto out;
-	}
-
-	/* search in the 'any' cache first */
-	if (zif_depend_get_flag (depend) == ZIF_DEPEND_FLAG_ANY) {
-		depend_id = zif_depend_get_name (depend);
-		ret = g_hash_table_lookup_extended (package->priv->requires_hash,
-						    depend_id,
-						    NULL,
-						    (void **) &depend_tmp);
-		if (ret) {
-			/* object is in the cache */
-			*satisfies = g_object_ref (depend_tmp);
-		} else {
-			/* object is not in the cache, but we already added all entries */
-			ret = TRUE;
-			*satisfies = NULL;
-		}
-		goto out;
-	}
-
-	/* set to unfound */
-	*satisfies = NULL;
-
 	/* find what we're looking for */
-	for (i = 0; i < package->priv->requires->len; i++) {
-		depend_tmp = g_ptr_array_index (package->priv->requires, i);
-		if (zif_depend_satisfies (depend_tmp, depend)) {
-			g_debug ("%s satisfied by %s",
-				 zif_depend_get_description (depend_tmp),
-				 zif_package_get_id (package));
-			*satisfies = g_object_ref (depend_tmp);
-			break;
-		}
+	*satisfies = zif_package_depends_find (package->priv->requires, depend);
+	if (*satisfies != NULL) {
+		g_debug ("%s satisfied by %s",
+			 zif_depend_get_description (*satisfies),
+			 zif_package_get_id (package));
 	}
-
-	/* success either way */
-	ret = TRUE;
 out:
 	return ret;
 }
@@ -790,9 +800,9 @@ zif_package_conflicts (ZifPackage *package,
 		       GError **error)
 {
 	gboolean ret = TRUE;
-	guint i;
-	ZifDepend *depend_tmp;
-	const gchar *depend_id;
+
+	/* set to unfound */
+	*satisfies = NULL;
 
 	/* this is quicker than just getting an array we don't use */
 	if (package->priv->conflicts == NULL) {
@@ -804,45 +814,8 @@ zif_package_conflicts (ZifPackage *package,
 			goto out;
 	}
 
-	/* this is a file depend, but we know there are none so don't
-	 * even try to lookup using either hash */
-	if (zif_depend_get_name (depend)[0] == '/' &&
-	    !package->priv->any_file_conflicts) {
-		ret = TRUE;
-		*satisfies = NULL;
-		goto out;
-	}
-
-	/* search in the 'any' cache first */
-	if (zif_depend_get_flag (depend) == ZIF_DEPEND_FLAG_ANY) {
-		depend_id = zif_depend_get_name (depend);
-		ret = g_hash_table_lookup_extended (package->priv->conflicts_hash,
-						    depend_id,
-						    NULL,
-						    (void **) &depend_tmp);
-		if (ret) {
-			/* object is in the cache */
-			*satisfies = g_object_ref (depend_tmp);
-		} else {
-			/* object is not in the cache, but we already added all entries */
-			ret = TRUE;
-			*satisfies = NULL;
-		}
-		goto out;
-	}
-
 	/* find what we're looking for */
-	for (i = 0; i < package->priv->conflicts->len; i++) {
-		depend_tmp = g_ptr_array_index (package->priv->conflicts, i);
-		ret = zif_depend_satisfies (depend_tmp, depend);
-		if (ret) {
-			*satisfies = g_object_ref (depend_tmp);
-			break;
-		}
-	}
-
-	/* success either way */
-	ret = TRUE;
+	*satisfies = zif_package_depends_find (package->priv->conflicts, depend);
 out:
 	return ret;
 }
@@ -870,9 +843,9 @@ zif_package_obsoletes (ZifPackage *package,
 		       GError **error)
 {
 	gboolean ret = TRUE;
-	guint i;
-	ZifDepend *depend_tmp;
-	const gchar *depend_id;
+
+	/* set to unfound */
+	*satisfies = NULL;
 
 	/* this is quicker than just getting an array we don't use */
 	if (package->priv->obsoletes == NULL) {
@@ -884,49 +857,8 @@ zif_package_obsoletes (ZifPackage *package,
 			goto out;
 	}
 
-	/* this is a file depend, but we know there are none so don't
-	 * even try to lookup using either hash */
-	if (zif_depend_get_name (depend)[0] == '/' &&
-	    !package->priv->any_file_obsoletes) {
-		ret = TRUE;
-		*satisfies = NULL;
-		goto out;
-	}
-
-	/* search in the 'any' cache first */
-	if (zif_depend_get_flag (depend) == ZIF_DEPEND_FLAG_ANY) {
-		depend_id = zif_depend_get_name (depend);
-		ret = g_hash_table_lookup_extended (package->priv->obsoletes_hash,
-						    depend_id,
-						    NULL,
-						    (void **) &depend_tmp);
-		if (ret) {
-			/* object is in the cache */
-			*satisfies = g_object_ref (depend_tmp);
-		} else {
-			/* object is not in the cache, but we already
-			 * added all entries */
-			ret = TRUE;
-			*satisfies = NULL;
-		}
-		goto out;
-	}
-
-	/* set to unfound */
-	*satisfies = NULL;
-
 	/* find what we're looking for */
-	for (i = 0; i < package->priv->obsoletes->len; i++) {
-		depend_tmp = g_ptr_array_index (package->priv->obsoletes, i);
-		ret = zif_depend_satisfies (depend_tmp, depend);
-		if (ret) {
-			*satisfies = g_object_ref (depend_tmp);
-			break;
-		}
-	}
-
-	/* success either way */
-	ret = TRUE;
+	*satisfies = zif_package_depends_find (package->priv->obsoletes, depend);
 out:
 	return ret;
 }
@@ -1790,8 +1722,8 @@ zif_package_get_requires (ZifPackage *package, ZifState *state, GError **error)
 			return NULL;
 	}
 
-	/* return refcounted */
-	return g_ptr_array_ref (package->priv->requires);
+	/* create the objects on demand */
+	return zif_package_depends_to_objects (package->priv->requires);
 }
 
 /**
@@ -1810,8 +1742,12 @@ zif_package_get_requires (ZifPackage *package, ZifState *state, GError **error)
 GPtrArray *
 zif_package_get_provides (ZifPackage *package, ZifState *state, GError **error)
 {
+	const gchar *filename;
 	gboolean ret;
 	GError *error_local = NULL;
+	GHashTableIter iter;
+	GPtrArray *array;
+	ZifDepend *depend;
 
 	g_return_val_if_fail (ZIF_IS_PACKAGE (package), NULL);
 	g_return_val_if_fail (package->priv->package_id_split != NULL, NULL);
@@ -1845,8 +1781,127 @@ zif_package_get_provides (ZifPackage *package, ZifState *state, GError **error)
 		}
 	}
 
-	/* return refcounted */
-	return g_ptr_array_ref (package->priv->provides);
+	/* create the objects on demand */
+	array = zif_package_depends_to_objects (package->priv->provides);
+
+	/* the files are kept separately as they're only needed for
+	 * file depends, see zif_package_provides() */
+	if (package->priv->provides_files == NULL)
+		return array;
+	g_hash_table_iter_init (&iter, package->priv->provides_files);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &filename, NULL)) {
+		depend = zif_depend_new ();
+		zif_depend_set_flag (depend, ZIF_DEPEND_FLAG_ANY);
+		zif_depend_set_name (depend, filename);
+		g_ptr_array_add (array, depend);
+	}
+	return array;
+}
+
+/**
+ * zif_package_get_depend_entries:
+ * @package: A #ZifPackage
+ * @type: The kind of depend, e.g. %ZIF_PACKAGE_ENSURE_TYPE_REQUIRES
+ * @state: A #ZifState to use for progress reporting
+ * @error: A #GError, or %NULL
+ *
+ * Gets the compact depends of the package without creating any
+ * objects. For %ZIF_PACKAGE_ENSURE_TYPE_PROVIDES the file list is not
+ * included or loaded, although explicit file provides are.
+ *
+ * Return value: (element-type ZifDependEntry) (transfer full): an array of depends
+ *
+ * Since: 0.3.7
+ **/
+GArray *
+zif_package_get_depend_entries (ZifPackage *package,
+				ZifPackageEnsureType type,
+				ZifState *state,
+				GError **error)
+{
+	gboolean ret;
+	gboolean loaded;
+	GArray **array;
+
+	g_return_val_if_fail (ZIF_IS_PACKAGE (package), NULL);
+	g_return_val_if_fail (zif_state_valid (state), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* get the right array */
+	if (type == ZIF_PACKAGE_ENSURE_TYPE_REQUIRES) {
+		array = &package->priv->requires;
+		loaded = *array != NULL;
+	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_PROVIDES) {
+		array = &package->priv->provides;
+		loaded = package->priv->provides_set;
+	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES) {
+		array = &package->priv->obsoletes;
+		loaded = *array != NULL;
+	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS) {
+		array = &package->priv->conflicts;
+		loaded = *array != NULL;
+	} else {
+		g_assert_not_reached ();
+	}
+
+	/* not exists */
+	if (!loaded) {
+		ret = zif_package_ensure_data (package, type, state, error);
+		if (!ret)
+			return NULL;
+	}
+
+	/* nothing was set */
+	if (*array == NULL)
+		return zif_package_depends_new (0);
+	return g_array_ref (*array);
+}
+
+/**
+ * zif_package_set_depend_entries:
+ * @package: A #ZifPackage
+ * @type: The kind of depend, e.g. %ZIF_PACKAGE_ENSURE_TYPE_REQUIRES
+ * @entries: (element-type ZifDependEntry): an array of depends
+ *
+ * Sets the depends of the package from compact depends, which is
+ * much quicker than creating objects for zif_package_set_requires().
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_package_set_depend_entries (ZifPackage *package,
+				ZifPackageEnsureType type,
+				GArray *entries)
+{
+	GArray **array;
+	guint i;
+	ZifDependEntry entry;
+
+	g_return_if_fail (ZIF_IS_PACKAGE (package));
+	g_return_if_fail (entries != NULL);
+
+	/* get the right array */
+	if (type == ZIF_PACKAGE_ENSURE_TYPE_REQUIRES) {
+		array = &package->priv->requires;
+	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_PROVIDES) {
+		array = &package->priv->provides;
+		g_return_if_fail (!package->priv->provides_set);
+		package->priv->provides_set = TRUE;
+	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES) {
+		array = &package->priv->obsoletes;
+	} else if (type == ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS) {
+		array = &package->priv->conflicts;
+	} else {
+		g_assert_not_reached ();
+	}
+
+	/* add to the array, not replace */
+	if (*array == NULL)
+		*array = zif_package_depends_new (entries->len);
+	for (i = 0; i < entries->len; i++) {
+		zif_depend_entry_copy (&entry, &g_array_index (entries, ZifDependEntry, i));
+		g_array_append_val (*array, entry);
+	}
 }
 
 /**
@@ -1882,8 +1937,8 @@ zif_package_get_obsoletes (ZifPackage *package, ZifState *state, GError **error)
 			return NULL;
 	}
 
-	/* return refcounted */
-	return g_ptr_array_ref (package->priv->obsoletes);
+	/* create the objects on demand */
+	return zif_package_depends_to_objects (package->priv->obsoletes);
 }
 
 /**
@@ -1919,8 +1974,8 @@ zif_package_get_conflicts (ZifPackage *package, ZifState *state, GError **error)
 			return NULL;
 	}
 
-	/* return refcounted */
-	return g_ptr_array_ref (package->priv->conflicts);
+	/* create the objects on demand */
+	return zif_package_depends_to_objects (package->priv->conflicts);
 }
 
 /**
@@ -2043,6 +2098,9 @@ zif_package_set_id (ZifPackage *package, const gchar *package_id, GError **error
 	}
 	package->priv->package_id = g_strdup (package_id);
 	package->priv->package_id_split = zif_package_id_split (package_id);
+
+	/* split the version now, as packages get compared a lot */
+	package->priv->evr = zif_evr_new (package->priv->package_id_split[ZIF_PACKAGE_ID_VERSION]);
 	return TRUE;
 }
 
@@ -2305,27 +2363,14 @@ zif_package_set_size (ZifPackage *package, guint64 size)
 static void
 zif_package_add_files_internal (ZifPackage *package, const gchar *filename)
 {
-	ZifDepend *depend_tmp;
-	ZifString *string;
-
-	depend_tmp = zif_depend_new ();
-	zif_depend_set_flag (depend_tmp, ZIF_DEPEND_FLAG_ANY);
-
-	/* add this as a static string, as we know that the files
-	 * cannot be ripped from under us, and it'll save a few
-	 * thousand allocatons per package created */
-	string = zif_string_new_static (filename);
-	zif_depend_set_name_str (depend_tmp, string);
-	zif_string_unref (string);
-
-	g_hash_table_insert (package->priv->provides_hash,
+	/* we know that the files cannot be ripped from under us, so
+	 * just keep the pointer and save a few thousand allocations
+	 * per package created */
+	if (package->priv->provides_files == NULL)
+		package->priv->provides_files = g_hash_table_new (g_str_hash, g_str_equal);
+	g_hash_table_insert (package->priv->provides_files,
 			     (gpointer) filename,
-			     g_object_ref (depend_tmp));
-	g_ptr_array_add (package->priv->provides,
-			 g_object_ref (depend_tmp));
-	package->priv->any_file_provides = TRUE;
-
-	g_object_unref (depend_tmp);
+			     (gpointer) filename);
 }
 
 /**
@@ -2427,23 +2472,6 @@ zif_package_set_provides_files (ZifPackage *package,
 	g_object_unref (config);
 }
 
-/**
- * zif_package_add_require_internal:
- **/
-static void
-zif_package_add_require_internal (ZifPackage *package, ZifDepend *depend)
-{
-	const gchar *name_tmp;
-	name_tmp = zif_depend_get_name (depend);
-	g_hash_table_insert (package->priv->requires_hash,
-			     (gpointer) name_tmp,
-			     g_object_ref (depend));
-
-	/* this is a file depend */
-	if (name_tmp[0] == '/')
-		package->priv->any_file_requires = TRUE;
-}
-
 /**
  * zif_package_add_require:
  * @package: A #ZifPackage
@@ -2458,13 +2486,7 @@ zif_package_add_require (ZifPackage *package, ZifDepend *depend)
 {
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
 	g_return_if_fail (depend != NULL);
-
-	/* create if not already exists */
-	if (package->priv->requires == NULL)
-		package->priv->requires = zif_object_array_new ();
-
-	zif_package_add_require_internal (package, depend);
-	zif_object_array_add (package->priv->requires, depend);
+	zif_package_depends_add (&package->priv->requires, depend);
 }
 
 /**
@@ -2479,38 +2501,10 @@ zif_package_add_require (ZifPackage *package, ZifDepend *depend)
 void
 zif_package_set_requires (ZifPackage *package, GPtrArray *requires)
 {
-	guint i;
-	ZifDepend *depend_tmp;
-
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
 	g_return_if_fail (requires != NULL);
 	g_return_if_fail (package->priv->requires == NULL);
-
-	/* add items to 'any' cache */
-	for (i = 0; i < requires->len; i++) {
-		depend_tmp = g_ptr_array_index (requires, i);
-		zif_package_add_require_internal (package, depend_tmp);
-	}
-
-	package->priv->requires = g_ptr_array_ref (requires);
-}
-
-/**
- * zif_package_add_provide_internal:
- **/
-static void
-zif_package_add_provide_internal (ZifPackage *package, ZifDepend *depend)
-{
-	const gchar *name_tmp;
-
-	name_tmp = zif_depend_get_name (depend);
-	g_hash_table_insert (package->priv->provides_hash,
-			     (gpointer) name_tmp,
-			     g_object_ref (depend));
-
-	/* this is a file depend */
-	if (name_tmp[0] == '/')
-		package->priv->any_file_provides = TRUE;
+	zif_package_depends_add_array (&package->priv->requires, requires);
 }
 
 /**
@@ -2527,13 +2521,7 @@ zif_package_add_provide (ZifPackage *package, ZifDepend *depend)
 {
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
 	g_return_if_fail (depend != NULL);
-
-	/* create if not already exists */
-	if (package->priv->provides == NULL)
-		package->priv->provides = zif_object_array_new ();
-
-	zif_package_add_provide_internal (package, depend);
-	zif_object_array_add (package->priv->provides, depend);
+	zif_package_depends_add (&package->priv->provides, depend);
 }
 
 /**
@@ -2548,45 +2536,16 @@ zif_package_add_provide (ZifPackage *package, ZifDepend *depend)
 void
 zif_package_set_provides (ZifPackage *package, GPtrArray *provides)
 {
-	guint i;
-	ZifDepend *depend_tmp;
-
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
 	g_return_if_fail (provides != NULL);
 	g_return_if_fail (!package->priv->provides_set);
 
-	/* track this as a bool, as the array is already created */
+	/* track this as a bool, as zif_package_add_provide() may
+	 * have already created the array */
 	package->priv->provides_set = TRUE;
 
-	/* add items to 'any' cache */
-	for (i = 0; i < provides->len; i++) {
-		depend_tmp = g_ptr_array_index (provides, i);
-		zif_package_add_provide_internal (package, depend_tmp);
-	}
-
 	/* add to the array, not replace */
-	for (i = 0; i < provides->len; i++) {
-		depend_tmp = g_ptr_array_index (provides, i);
-		g_ptr_array_add (package->priv->provides,
-				 g_object_ref (depend_tmp));
-	}
-}
-
-/**
- * zif_package_add_obsolete_internal:
- **/
-static void
-zif_package_add_obsolete_internal (ZifPackage *package, ZifDepend *depend)
-{
-	const gchar *name_tmp;
-	name_tmp = zif_depend_get_name (depend);
-	g_hash_table_insert (package->priv->obsoletes_hash,
-			     (gpointer) name_tmp,
-			     g_object_ref (depend));
-
-	/* this is a file depend */
-	if (name_tmp[0] == '/')
-		package->priv->any_file_obsoletes = TRUE;
+	zif_package_depends_add_array (&package->priv->provides, provides);
 }
 
 /**
@@ -2603,13 +2562,7 @@ zif_package_add_obsolete (ZifPackage *package, ZifDepend *depend)
 {
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
 	g_return_if_fail (depend != NULL);
-
-	/* create if not already exists */
-	if (package->priv->obsoletes == NULL)
-		package->priv->obsoletes = zif_object_array_new ();
-
-	zif_package_add_obsolete_internal (package, depend);
-	zif_object_array_add (package->priv->obsoletes, depend);
+	zif_package_depends_add (&package->priv->obsoletes, depend);
 }
 
 /**
@@ -2624,37 +2577,10 @@ zif_package_add_obsolete (ZifPackage *package, ZifDepend *depend)
 void
 zif_package_set_obsoletes (ZifPackage *package, GPtrArray *obsoletes)
 {
-	guint i;
-	ZifDepend *depend_tmp;
-
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
 	g_return_if_fail (obsoletes != NULL);
 	g_return_if_fail (package->priv->obsoletes == NULL);
-
-	/* add items to 'any' cache */
-	for (i = 0; i < obsoletes->len; i++) {
-		depend_tmp = g_ptr_array_index (obsoletes, i);
-		zif_package_add_obsolete_internal (package, depend_tmp);
-	}
-
-	package->priv->obsoletes = g_ptr_array_ref (obsoletes);
-}
-
-/**
- * zif_package_add_conflict_internal:
- **/
-static void
-zif_package_add_conflict_internal (ZifPackage *package, ZifDepend *depend)
-{
-	const gchar *name_tmp;
-	name_tmp = zif_depend_get_name (depend);
-	g_hash_table_insert (package->priv->conflicts_hash,
-			     (gpointer) name_tmp,
-			     g_object_ref (depend));
-
-	/* this is a file depend */
-	if (name_tmp[0] == '/')
-		package->priv->any_file_conflicts = TRUE;
+	zif_package_depends_add_array (&package->priv->obsoletes, obsoletes);
 }
 
 /**
@@ -2671,13 +2597,7 @@ zif_package_add_conflict (ZifPackage *package, ZifDepend *depend)
 {
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
 	g_return_if_fail (depend != NULL);
-
-	/* create if not already exists */
-	if (package->priv->conflicts == NULL)
-		package->priv->conflicts = zif_object_array_new ();
-
-	zif_package_add_conflict_internal (package, depend);
-	zif_object_array_add (package->priv->conflicts, depend);
+	zif_package_depends_add (&package->priv->conflicts, depend);
 }
 
 /**
@@ -2692,20 +2612,10 @@ zif_package_add_conflict (ZifPackage *package, ZifDepend *depend)
 void
 zif_package_set_conflicts (ZifPackage *package, GPtrArray *conflicts)
 {
-	guint i;
-	ZifDepend *depend_tmp;
-
 	g_return_if_fail (ZIF_IS_PACKAGE (package));
 	g_return_if_fail (conflicts != NULL);
 	g_return_if_fail (package->priv->conflicts == NULL);
-
-	/* add items to 'any' cache */
-	for (i = 0; i < conflicts->len; i++) {
-		depend_tmp = g_ptr_array_index (conflicts, i);
-		zif_package_add_conflict_internal (package, depend_tmp);
-	}
-
-	package->priv->conflicts = g_ptr_array_ref (conflicts);
+	zif_package_depends_add_array (&package->priv->conflicts, conflicts);
 }
 
 /**
@@ -2731,6 +2641,8 @@ zif_package_finalize (GObject *object)
 	g_free (package->priv->package_id);
 	g_free (package->priv->package_id_basic);
 	g_strfreev (package->priv->package_id_split);
+	if (package->priv->evr != NULL)
+		zif_evr_unref (package->priv->evr);
 	if (package->priv->summary != NULL)
 		zif_string_unref (package->priv->summary);
 	if (package->priv->description != NULL)
@@ -2752,17 +2664,15 @@ zif_package_finalize (GObject *object)
 	if (package->priv->files != NULL)
 		g_ptr_array_unref (package->priv->files);
 	if (package->priv->requires != NULL)
-		g_ptr_array_unref (package->priv->requires);
+		g_array_unref (package->priv->requires);
 	if (package->priv->provides != NULL)
-		g_ptr_array_unref (package->priv->provides);
+		g_array_unref (package->priv->provides);
+	if (package->priv->provides_files != NULL)
+		g_hash_table_unref (package->priv->provides_files);
 	if (package->priv->obsoletes != NULL)
-		g_ptr_array_unref (package->priv->obsoletes);
+		g_array_unref (package->priv->obsoletes);
 	if (package->priv->conflicts != NULL)
-		g_ptr_array_unref (package->priv->conflicts);
-	g_hash_table_destroy (package->priv->requires_hash);
-	g_hash_table_destroy (package->priv->provides_hash);
-	g_hash_table_destroy (package->priv->obsoletes_hash);
-	g_hash_table_destroy (package->priv->conflicts_hash);
+		g_array_unref (package->priv->conflicts);
 
 	G_OBJECT_CLASS (zif_package_parent_class)->finalize (object);
 }
@@ -2788,30 +2698,6 @@ zif_package_init (ZifPackage *package)
 
 	/* version compare by default */
 	package->priv->compare_mode = ZIF_PACKAGE_COMPARE_MODE_VERSION;
-
-	/* we have to create this now to allow us to call
-	 * zif_package_set_files() before zif_package_set_provides() */
-	package->priv->provides = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-
-	/* this provides a O(1) lookup for the provide name, which
-	 * may seem odd, but it's required for the ZIF_DEPEND_FLAG_ANY
-	 * check, and 'any' happens 99.5% of the time in reality */
-	package->priv->requires_hash = g_hash_table_new_full (g_str_hash,
-							      g_str_equal,
-							      NULL,
-							      (GDestroyNotify) g_object_unref);
-	package->priv->provides_hash = g_hash_table_new_full (g_str_hash,
-							      g_str_equal,
-							      NULL,
-							      (GDestroyNotify) g_object_unref);
-	package->priv->obsoletes_hash = g_hash_table_new_full (g_str_hash,
-							       g_str_equal,
-							       NULL,
-							       (GDestroyNotify) g_object_unref);
-	package->priv->conflicts_hash = g_hash_table_new_full (g_str_hash,
-							       g_str_equal,
-							       NULL,
-							       (GDestroyNotify) g_object_unref);
 }
 
 /**
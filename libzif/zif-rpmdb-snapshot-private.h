@@ -0,0 +1,75 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#if !defined (__ZIF_H_INSIDE__) && !defined (ZIF_COMPILATION)
+#error "Only <zif.h> can be included directly."
+#endif
+
+#ifndef __ZIF_RPMDB_SNAPSHOT_PRIVATE_H
+#define __ZIF_RPMDB_SNAPSHOT_PRIVATE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+	ZIF_RPMDB_SNAPSHOT_DEPEND_PROVIDES,
+	ZIF_RPMDB_SNAPSHOT_DEPEND_REQUIRES,
+	ZIF_RPMDB_SNAPSHOT_DEPEND_OBSOLETES,
+	ZIF_RPMDB_SNAPSHOT_DEPEND_CONFLICTS,
+	ZIF_RPMDB_SNAPSHOT_DEPEND_LAST
+} ZifRpmdbSnapshotDepend;
+
+typedef struct _ZifRpmdbSnapshot	ZifRpmdbSnapshot;
+
+ZifRpmdbSnapshot *zif_rpmdb_snapshot_new	(void);
+void		 zif_rpmdb_snapshot_free	(ZifRpmdbSnapshot *snapshot);
+void		 zif_rpmdb_snapshot_add_package	(ZifRpmdbSnapshot *snapshot,
+						 const gchar	*package_id,
+						 const gchar	*pkgid,
+						 guint		 instance);
+void		 zif_rpmdb_snapshot_add_depends	(ZifRpmdbSnapshot *snapshot,
+						 ZifRpmdbSnapshotDepend kind,
+						 GArray		*depends);
+void		 zif_rpmdb_snapshot_build	(ZifRpmdbSnapshot *snapshot,
+						 const gchar	*stamp);
+gboolean	 zif_rpmdb_snapshot_save	(ZifRpmdbSnapshot *snapshot,
+						 const gchar	*filename,
+						 GError		**error);
+gboolean	 zif_rpmdb_snapshot_load	(ZifRpmdbSnapshot *snapshot,
+						 const gchar	*filename,
+						 const gchar	*stamp,
+						 GError		**error);
+guint		 zif_rpmdb_snapshot_get_size	(ZifRpmdbSnapshot *snapshot);
+const gchar	*zif_rpmdb_snapshot_get_package_id (ZifRpmdbSnapshot *snapshot,
+						 guint		 idx);
+const gchar	*zif_rpmdb_snapshot_get_pkgid	(ZifRpmdbSnapshot *snapshot,
+						 guint		 idx);
+guint		 zif_rpmdb_snapshot_get_instance (ZifRpmdbSnapshot *snapshot,
+						 guint		 idx);
+GArray		*zif_rpmdb_snapshot_get_depends	(ZifRpmdbSnapshot *snapshot,
+						 guint		 idx,
+						 ZifRpmdbSnapshotDepend kind);
+
+G_END_DECLS
+
+#endif /* __ZIF_RPMDB_SNAPSHOT_PRIVATE_H */
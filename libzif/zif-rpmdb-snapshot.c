@@ -0,0 +1,641 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2011 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:zif-rpmdb-snapshot
+ * @short_description: A compact on-disk copy of the installed packages
+ *
+ * A #ZifRpmdbSnapshot holds the package-id, pkgid and the depends of
+ * every installed package, so that #ZifStoreLocal can be loaded without
+ * reading every header from the rpmdb and looking up the origin repo of
+ * each package.
+ *
+ * The snapshot is written when the rpmdb changes and is then memory
+ * mapped. It consists of a table of packages, each pointing at runs of
+ * depends in a shared table, and all the strings come last.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "zif-depend-private.h"
+#include "zif-rpmdb-snapshot-private.h"
+
+#define ZIF_RPMDB_SNAPSHOT_MAGIC	"ZIFRPMS1"
+
+/* all the offsets are into the string table, which comes last */
+typedef struct {
+	gchar			 magic[8];
+	guint32			 stamp;
+	guint32			 n_packages;
+	guint32			 n_depends;
+	guint32			 strings_size;
+	guint32			 checksum;	/* of everything after the header */
+	guint32			 reserved;
+} ZifRpmdbSnapshotHeader;
+
+typedef struct {
+	guint32			 package_id;
+	guint32			 pkgid;
+	guint32			 instance;
+	guint32			 depends_first[ZIF_RPMDB_SNAPSHOT_DEPEND_LAST];
+	guint32			 depends_n[ZIF_RPMDB_SNAPSHOT_DEPEND_LAST];
+} ZifRpmdbSnapshotPackage;
+
+typedef struct {
+	guint32			 name;
+	guint32			 version;
+	guint32			 flag;
+} ZifRpmdbSnapshotEntry;
+
+struct _ZifRpmdbSnapshot
+{
+	/* when building */
+	GString			*strings;
+	GHashTable		*strings_hash;	/* string -> offset + 1 */
+	GArray			*packages;	/* of ZifRpmdbSnapshotPackage */
+	GArray			*depends;	/* of ZifRpmdbSnapshotEntry */
+	/* when reading */
+	GMappedFile		*mapped;
+	gchar			*data_built;
+	const gchar		*data;
+	gsize			 len;
+	const ZifRpmdbSnapshotHeader *header;
+	const ZifRpmdbSnapshotPackage *index_packages;
+	const ZifRpmdbSnapshotEntry *index_depends;
+	const gchar		*index_strings;
+};
+
+/**
+ * zif_rpmdb_snapshot_new:
+ *
+ * Creates a new, empty, snapshot that packages can be added to.
+ *
+ * Return value: A new #ZifRpmdbSnapshot, free with zif_rpmdb_snapshot_free()
+ *
+ * Since: 0.3.7
+ **/
+ZifRpmdbSnapshot *
+zif_rpmdb_snapshot_new (void)
+{
+	ZifRpmdbSnapshot *snapshot;
+	snapshot = g_new0 (ZifRpmdbSnapshot, 1);
+	snapshot->strings = g_string_new (NULL);
+	snapshot->strings_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+							g_free, NULL);
+	snapshot->packages = g_array_new (FALSE, FALSE, sizeof (ZifRpmdbSnapshotPackage));
+	snapshot->depends = g_array_new (FALSE, FALSE, sizeof (ZifRpmdbSnapshotEntry));
+	return snapshot;
+}
+
+/**
+ * zif_rpmdb_snapshot_clear_build:
+ **/
+static void
+zif_rpmdb_snapshot_clear_build (ZifRpmdbSnapshot *snapshot)
+{
+	if (snapshot->strings != NULL) {
+		g_string_free (snapshot->strings, TRUE);
+		snapshot->strings = NULL;
+	}
+	if (snapshot->strings_hash != NULL) {
+		g_hash_table_unref (snapshot->strings_hash);
+		snapshot->strings_hash = NULL;
+	}
+	if (snapshot->packages != NULL) {
+		g_array_unref (snapshot->packages);
+		snapshot->packages = NULL;
+	}
+	if (snapshot->depends != NULL) {
+		g_array_unref (snapshot->depends);
+		snapshot->depends = NULL;
+	}
+}
+
+/**
+ * zif_rpmdb_snapshot_clear_data:
+ **/
+static void
+zif_rpmdb_snapshot_clear_data (ZifRpmdbSnapshot *snapshot)
+{
+	if (snapshot->mapped != NULL) {
+		g_mapped_file_unref (snapshot->mapped);
+		snapshot->mapped = NULL;
+	}
+	g_free (snapshot->data_built);
+	snapshot->data_built = NULL;
+	snapshot->data = NULL;
+	snapshot->len = 0;
+	snapshot->header = NULL;
+}
+
+/**
+ * zif_rpmdb_snapshot_free:
+ * @snapshot: A #ZifRpmdbSnapshot
+ *
+ * Frees the snapshot, unmapping the file if it was loaded.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_rpmdb_snapshot_free (ZifRpmdbSnapshot *snapshot)
+{
+	if (snapshot == NULL)
+		return;
+	zif_rpmdb_snapshot_clear_build (snapshot);
+	zif_rpmdb_snapshot_clear_data (snapshot);
+	g_free (snapshot);
+}
+
+/**
+ * zif_rpmdb_snapshot_add_string:
+ *
+ * Adds a string to the string table, only storing each value once.
+ **/
+static guint32
+zif_rpmdb_snapshot_add_string (ZifRpmdbSnapshot *snapshot, const gchar *value)
+{
+	gpointer offset;
+	guint32 offset_new;
+
+	if (value == NULL)
+		value = "";
+	offset = g_hash_table_lookup (snapshot->strings_hash, value);
+	if (offset != NULL)
+		return GPOINTER_TO_UINT (offset) - 1;
+	offset_new = snapshot->strings->len;
+	g_string_append_len (snapshot->strings, value, strlen (value) + 1);
+	g_hash_table_insert (snapshot->strings_hash, g_strdup (value),
+			     GUINT_TO_POINTER (offset_new + 1));
+	return offset_new;
+}
+
+/**
+ * zif_rpmdb_snapshot_add_package:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @package_id: The package-id, including the repo the package came from
+ * @pkgid: The SHA1 of the package header
+ * @instance: The rpmdb instance of the header
+ *
+ * Adds a package to the snapshot. This can only be used before
+ * zif_rpmdb_snapshot_build() is called.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_rpmdb_snapshot_add_package (ZifRpmdbSnapshot *snapshot,
+				const gchar *package_id,
+				const gchar *pkgid,
+				guint instance)
+{
+	ZifRpmdbSnapshotPackage package;
+
+	g_return_if_fail (snapshot != NULL);
+	g_return_if_fail (snapshot->packages != NULL);
+	g_return_if_fail (package_id != NULL);
+	g_return_if_fail (pkgid != NULL);
+
+	memset (&package, 0, sizeof (ZifRpmdbSnapshotPackage));
+	package.package_id = zif_rpmdb_snapshot_add_string (snapshot, package_id);
+	package.pkgid = zif_rpmdb_snapshot_add_string (snapshot, pkgid);
+	package.instance = instance;
+	g_array_append_val (snapshot->packages, package);
+}
+
+/**
+ * zif_rpmdb_snapshot_add_depends:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @kind: The kind of depends, e.g. %ZIF_RPMDB_SNAPSHOT_DEPEND_PROVIDES
+ * @depends: (element-type ZifDependEntry): The depends
+ *
+ * Sets the depends of the package that was added last.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_rpmdb_snapshot_add_depends (ZifRpmdbSnapshot *snapshot,
+				ZifRpmdbSnapshotDepend kind,
+				GArray *depends)
+{
+	const ZifDependEntry *depend;
+	guint i;
+	ZifRpmdbSnapshotEntry entry;
+	ZifRpmdbSnapshotPackage *package;
+
+	g_return_if_fail (snapshot != NULL);
+	g_return_if_fail (snapshot->packages != NULL);
+	g_return_if_fail (snapshot->packages->len > 0);
+	g_return_if_fail (kind < ZIF_RPMDB_SNAPSHOT_DEPEND_LAST);
+
+	package = &g_array_index (snapshot->packages,
+				  ZifRpmdbSnapshotPackage,
+				  snapshot->packages->len - 1);
+	package->depends_first[kind] = snapshot->depends->len;
+	package->depends_n[kind] = depends->len;
+	for (i = 0; i < depends->len; i++) {
+		depend = &g_array_index (depends, ZifDependEntry, i);
+		entry.name = zif_rpmdb_snapshot_add_string (snapshot,
+							    zif_depend_entry_get_name (depend));
+		entry.version = zif_rpmdb_snapshot_add_string (snapshot,
+							       depend->version != NULL ? zif_depend_entry_get_version (depend) : "");
+		entry.flag = depend->flag;
+		g_array_append_val (snapshot->depends, entry);
+	}
+}
+
+/**
+ * zif_rpmdb_snapshot_get_checksum:
+ *
+ * A FNV-1a hash, which is enough to catch a truncated or damaged
+ * file without slowing down the load.
+ **/
+static guint32
+zif_rpmdb_snapshot_get_checksum (const gchar *data, gsize len)
+{
+	gsize i;
+	guint32 hash = 2166136261u;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (guchar) data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * zif_rpmdb_snapshot_set_data:
+ *
+ * Points the tables at the serialized data, checking that every
+ * offset is in range so a corrupt file cannot cause a crash.
+ **/
+static gboolean
+zif_rpmdb_snapshot_set_data (ZifRpmdbSnapshot *snapshot,
+			     const gchar *data,
+			     gsize len,
+			     GError **error)
+{
+	const ZifRpmdbSnapshotHeader *header = (const ZifRpmdbSnapshotHeader *) data;
+	const ZifRpmdbSnapshotPackage *package;
+	const ZifRpmdbSnapshotEntry *entry;
+	guint64 len_expected;
+	guint i, j;
+
+	/* check the header */
+	if (data == NULL ||
+	    len < sizeof (ZifRpmdbSnapshotHeader) ||
+	    memcmp (header->magic, ZIF_RPMDB_SNAPSHOT_MAGIC, 8) != 0) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "rpmdb snapshot has an invalid header");
+		return FALSE;
+	}
+	len_expected = sizeof (ZifRpmdbSnapshotHeader);
+	len_expected += (guint64) header->n_packages * sizeof (ZifRpmdbSnapshotPackage);
+	len_expected += (guint64) header->n_depends * sizeof (ZifRpmdbSnapshotEntry);
+	len_expected += header->strings_size;
+	if (len_expected != len ||
+	    header->strings_size == 0 ||
+	    data[len - 1] != '\0' ||
+	    header->stamp >= header->strings_size ||
+	    header->checksum != zif_rpmdb_snapshot_get_checksum (data + sizeof (ZifRpmdbSnapshotHeader),
+								 len - sizeof (ZifRpmdbSnapshotHeader))) {
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				     "rpmdb snapshot is truncated or corrupt");
+		return FALSE;
+	}
+
+	/* get the tables */
+	snapshot->index_packages = (const ZifRpmdbSnapshotPackage *) (data + sizeof (ZifRpmdbSnapshotHeader));
+	snapshot->index_depends = (const ZifRpmdbSnapshotEntry *) (snapshot->index_packages + header->n_packages);
+	snapshot->index_strings = (const gchar *) (snapshot->index_depends + header->n_depends);
+
+	/* check the offsets */
+	for (i = 0; i < header->n_packages; i++) {
+		package = &snapshot->index_packages[i];
+		if (package->package_id >= header->strings_size ||
+		    package->pkgid >= header->strings_size)
+			goto corrupt;
+		for (j = 0; j < ZIF_RPMDB_SNAPSHOT_DEPEND_LAST; j++) {
+			if ((guint64) package->depends_first[j] +
+			    package->depends_n[j] > header->n_depends)
+				goto corrupt;
+		}
+	}
+	for (i = 0; i < header->n_depends; i++) {
+		entry = &snapshot->index_depends[i];
+		if (entry->name >= header->strings_size ||
+		    entry->version >= header->strings_size)
+			goto corrupt;
+	}
+
+	snapshot->data = data;
+	snapshot->len = len;
+	snapshot->header = header;
+	return TRUE;
+corrupt:
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "rpmdb snapshot has an invalid offset");
+	return FALSE;
+}
+
+/**
+ * zif_rpmdb_snapshot_build:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @stamp: A string that identifies the rpmdb the snapshot was built from
+ *
+ * Serializes the packages that have been added so that the snapshot
+ * can be read or saved. No more packages can be added after this.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_rpmdb_snapshot_build (ZifRpmdbSnapshot *snapshot, const gchar *stamp)
+{
+	gchar *data;
+	gsize len;
+	gsize len_tables;
+	ZifRpmdbSnapshotHeader *header;
+
+	g_return_if_fail (snapshot != NULL);
+	g_return_if_fail (snapshot->packages != NULL);
+	g_return_if_fail (stamp != NULL);
+
+	/* the stamp goes at the end of the string table */
+	len_tables = sizeof (ZifRpmdbSnapshotHeader) +
+		     snapshot->packages->len * sizeof (ZifRpmdbSnapshotPackage) +
+		     snapshot->depends->len * sizeof (ZifRpmdbSnapshotEntry);
+	len = len_tables + snapshot->strings->len + strlen (stamp) + 1;
+
+	/* write out the tables in one allocation */
+	data = g_malloc0 (len);
+	header = (ZifRpmdbSnapshotHeader *) data;
+	memcpy (header->magic, ZIF_RPMDB_SNAPSHOT_MAGIC, 8);
+	header->n_packages = snapshot->packages->len;
+	header->n_depends = snapshot->depends->len;
+	header->stamp = snapshot->strings->len;
+	header->strings_size = snapshot->strings->len + strlen (stamp) + 1;
+	memcpy (data + sizeof (ZifRpmdbSnapshotHeader),
+		snapshot->packages->data,
+		snapshot->packages->len * sizeof (ZifRpmdbSnapshotPackage));
+	memcpy (data + sizeof (ZifRpmdbSnapshotHeader) +
+		snapshot->packages->len * sizeof (ZifRpmdbSnapshotPackage),
+		snapshot->depends->data,
+		snapshot->depends->len * sizeof (ZifRpmdbSnapshotEntry));
+	memcpy (data + len_tables, snapshot->strings->str, snapshot->strings->len);
+	memcpy (data + len_tables + snapshot->strings->len, stamp, strlen (stamp) + 1);
+	header->checksum = zif_rpmdb_snapshot_get_checksum (data + sizeof (ZifRpmdbSnapshotHeader),
+							    len - sizeof (ZifRpmdbSnapshotHeader));
+	g_debug ("built rpmdb snapshot of %i packages with %i depends",
+		 header->n_packages, header->n_depends);
+
+	/* the build data is no longer needed */
+	zif_rpmdb_snapshot_clear_build (snapshot);
+	zif_rpmdb_snapshot_clear_data (snapshot);
+	snapshot->data_built = data;
+	zif_rpmdb_snapshot_set_data (snapshot, data, len, NULL);
+}
+
+/**
+ * zif_rpmdb_snapshot_save:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @filename: The file to write, e.g. "/var/cache/zif/installed/rpmdb.snapshot"
+ * @error: A #GError, or %NULL
+ *
+ * Saves a built snapshot to disk.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_rpmdb_snapshot_save (ZifRpmdbSnapshot *snapshot,
+			 const gchar *filename,
+			 GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *dirname;
+	gint rc;
+
+	g_return_val_if_fail (snapshot != NULL, FALSE);
+	g_return_val_if_fail (snapshot->header != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	/* ensure the cache directory exists */
+	dirname = g_path_get_dirname (filename);
+	rc = g_mkdir_with_parents (dirname, 0755);
+	if (rc < 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+			     "failed to create %s", dirname);
+		goto out;
+	}
+
+	/* this is atomic, so readers never see a partial snapshot */
+	ret = g_file_set_contents (filename, snapshot->data, snapshot->len, error);
+out:
+	g_free (dirname);
+	return ret;
+}
+
+/**
+ * zif_rpmdb_snapshot_load:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @filename: The file to map, e.g. "/var/cache/zif/installed/rpmdb.snapshot"
+ * @stamp: The stamp the snapshot must have been built with
+ * @error: A #GError, or %NULL
+ *
+ * Maps a snapshot that was previously saved. If the snapshot was built
+ * from a different rpmdb to @stamp it is rejected, and the error is set
+ * to %G_IO_ERROR_INVALID_DATA.
+ *
+ * Return value: %TRUE for success
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_rpmdb_snapshot_load (ZifRpmdbSnapshot *snapshot,
+			 const gchar *filename,
+			 const gchar *stamp,
+			 GError **error)
+{
+	gboolean ret;
+	GMappedFile *mapped;
+
+	g_return_val_if_fail (snapshot != NULL, FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+	g_return_val_if_fail (stamp != NULL, FALSE);
+
+	/* map the file */
+	zif_rpmdb_snapshot_clear_data (snapshot);
+	mapped = g_mapped_file_new (filename, FALSE, error);
+	if (mapped == NULL)
+		return FALSE;
+	ret = zif_rpmdb_snapshot_set_data (snapshot,
+					   g_mapped_file_get_contents (mapped),
+					   g_mapped_file_get_length (mapped),
+					   error);
+	if (!ret) {
+		g_mapped_file_unref (mapped);
+		return FALSE;
+	}
+
+	/* built from something else */
+	if (g_strcmp0 (snapshot->index_strings + snapshot->header->stamp, stamp) != 0) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+			     "rpmdb snapshot %s is out of date", filename);
+		zif_rpmdb_snapshot_clear_data (snapshot);
+		g_mapped_file_unref (mapped);
+		return FALSE;
+	}
+
+	/* the build data is no longer needed */
+	zif_rpmdb_snapshot_clear_build (snapshot);
+	snapshot->mapped = mapped;
+	return TRUE;
+}
+
+/**
+ * zif_rpmdb_snapshot_get_size:
+ * @snapshot: A #ZifRpmdbSnapshot
+ *
+ * Gets the number of packages in a built or loaded snapshot.
+ *
+ * Return value: The number of packages
+ *
+ * Since: 0.3.7
+ **/
+guint
+zif_rpmdb_snapshot_get_size (ZifRpmdbSnapshot *snapshot)
+{
+	g_return_val_if_fail (snapshot != NULL, 0);
+	g_return_val_if_fail (snapshot->header != NULL, 0);
+	return snapshot->header->n_packages;
+}
+
+/**
+ * zif_rpmdb_snapshot_get_package_id:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @idx: The package index, which must be less than zif_rpmdb_snapshot_get_size()
+ *
+ * Gets the package-id of a package in the snapshot.
+ *
+ * Return value: The package-id, which is owned by the snapshot
+ *
+ * Since: 0.3.7
+ **/
+const gchar *
+zif_rpmdb_snapshot_get_package_id (ZifRpmdbSnapshot *snapshot, guint idx)
+{
+	g_return_val_if_fail (snapshot != NULL, NULL);
+	g_return_val_if_fail (snapshot->header != NULL, NULL);
+	g_return_val_if_fail (idx < snapshot->header->n_packages, NULL);
+	return snapshot->index_strings + snapshot->index_packages[idx].package_id;
+}
+
+/**
+ * zif_rpmdb_snapshot_get_pkgid:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @idx: The package index, which must be less than zif_rpmdb_snapshot_get_size()
+ *
+ * Gets the SHA1 of the header of a package in the snapshot.
+ *
+ * Return value: The pkgid, which is owned by the snapshot
+ *
+ * Since: 0.3.7
+ **/
+const gchar *
+zif_rpmdb_snapshot_get_pkgid (ZifRpmdbSnapshot *snapshot, guint idx)
+{
+	g_return_val_if_fail (snapshot != NULL, NULL);
+	g_return_val_if_fail (snapshot->header != NULL, NULL);
+	g_return_val_if_fail (idx < snapshot->header->n_packages, NULL);
+	return snapshot->index_strings + snapshot->index_packages[idx].pkgid;
+}
+
+/**
+ * zif_rpmdb_snapshot_get_instance:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @idx: The package index, which must be less than zif_rpmdb_snapshot_get_size()
+ *
+ * Gets the rpmdb instance of a package in the snapshot, which can be
+ * used to get the full header if it is needed.
+ *
+ * Return value: The instance, or 0 for unknown
+ *
+ * Since: 0.3.7
+ **/
+guint
+zif_rpmdb_snapshot_get_instance (ZifRpmdbSnapshot *snapshot, guint idx)
+{
+	g_return_val_if_fail (snapshot != NULL, 0);
+	g_return_val_if_fail (snapshot->header != NULL, 0);
+	g_return_val_if_fail (idx < snapshot->header->n_packages, 0);
+	return snapshot->index_packages[idx].instance;
+}
+
+/**
+ * zif_rpmdb_snapshot_get_depends:
+ * @snapshot: A #ZifRpmdbSnapshot
+ * @idx: The package index, which must be less than zif_rpmdb_snapshot_get_size()
+ * @kind: The kind of depends, e.g. %ZIF_RPMDB_SNAPSHOT_DEPEND_PROVIDES
+ *
+ * Gets the depends of a package in the snapshot.
+ *
+ * Return value: (element-type ZifDependEntry) (transfer full): New depends
+ *
+ * Since: 0.3.7
+ **/
+GArray *
+zif_rpmdb_snapshot_get_depends (ZifRpmdbSnapshot *snapshot,
+				guint idx,
+				ZifRpmdbSnapshotDepend kind)
+{
+	const ZifRpmdbSnapshotEntry *entry;
+	const ZifRpmdbSnapshotPackage *package;
+	const gchar *version;
+	GArray *array;
+	guint i;
+	ZifDependEntry depend;
+
+	g_return_val_if_fail (snapshot != NULL, NULL);
+	g_return_val_if_fail (snapshot->header != NULL, NULL);
+	g_return_val_if_fail (idx < snapshot->header->n_packages, NULL);
+	g_return_val_if_fail (kind < ZIF_RPMDB_SNAPSHOT_DEPEND_LAST, NULL);
+
+	package = &snapshot->index_packages[idx];
+	array = zif_depend_entry_array_new (package->depends_n[kind]);
+	for (i = 0; i < package->depends_n[kind]; i++) {
+		entry = &snapshot->index_depends[package->depends_first[kind] + i];
+
+		/* depends without a version are saved as "" */
+		version = snapshot->index_strings + entry->version;
+		zif_depend_entry_init (&depend,
+				       snapshot->index_strings + entry->name,
+				       entry->flag,
+				       version[0] != '\0' ? version : NULL);
+		g_array_append_val (array, depend);
+	}
+	return array;
+}
@@ -21,10 +21,15 @@
 
 #include "config.h"
 
+#include <fcntl.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glib-object.h>
+#include <rpm/rpmlib.h>
+#include <string.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include <utime.h>
 
 #include "zif-category.h"
@@ -34,6 +39,7 @@
 #include "zif-depend.h"
 #include "zif-depend-private.h"
 #include "zif-download.h"
+#include "zif-file-index-private.h"
 #include "zif-groups.h"
 #include "zif.h"
 #include "zif-history.h"
@@ -61,6 +67,7 @@
 #include "zif-package-remote.h"
 #include "zif-release.h"
 #include "zif-repos.h"
+#include "zif-rpmdb-snapshot-private.h"
 #include "zif-state-private.h"
 #include "zif-store-array.h"
 #include "zif-store-directory.h"
@@ -70,7 +77,9 @@
 #include "zif-store-remote.h"
 #include "zif-store-rhn.h"
 #include "zif-string.h"
+#include "zif-string-private.h"
 #include "zif-transaction.h"
+#include "zif-transaction-private.h"
 #include "zif-update.h"
 #include "zif-update-info.h"
 #include "zif-utils-private.h"
@@ -320,6 +329,109 @@ zif_package_array_func (void)
 	g_ptr_array_unref (array);
 }
 
+static void
+zif_package_array_download_func (void)
+{
+	const gchar *filenames[] = { "clamav-filesystem-0.96.3-1400.fc14.noarch.rpm",
+				     "depend-0.1-1.fc13.noarch.rpm",
+				     "test-0.1-1.fc13.noarch.rpm",
+				     NULL };
+	const gchar *ids[] = { "clamav-filesystem;0.96.3-1400.fc14;noarch;corrupt-repomd",
+			       "depend;0.1-1.fc13;noarch;corrupt-repomd",
+			       "test;0.1-1.fc13;noarch;corrupt-repomd",
+			       NULL };
+	gboolean ret;
+	gchar *directory;
+	gchar *filename;
+	gchar *pidfile;
+	GError *error = NULL;
+	GPtrArray *array;
+	GStatBuf buf;
+	guint i;
+	ZifConfig *config;
+	ZifPackage *pkg;
+	ZifState *state;
+	ZifStoreRemote *store;
+	ZifString *string;
+
+	config = zif_config_new ();
+	filename = zif_test_get_data_file ("zif.conf");
+	ret = zif_config_set_filename (config, filename, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+	pidfile = g_build_filename (zif_tmpdir, "zif.lock", NULL);
+	ret = zif_config_set_string (config, "pidfile", pidfile, &error);
+	g_free (pidfile);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_boolean (config, "network", TRUE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* two from the same repo at once, so the third has to wait */
+	ret = zif_config_set_uint (config, "max_parallel_downloads", 3, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_uint (config, "max_parallel_downloads_per_repo", 2, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the repo baseurl is the test data directory */
+	state = zif_state_new ();
+	store = ZIF_STORE_REMOTE (zif_store_remote_new ());
+	filename = zif_test_get_data_file ("corrupt-repomd.repo");
+	ret = zif_store_remote_set_from_file (store, filename, "corrupt-repomd", state, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	array = zif_package_array_new ();
+	for (i = 0; ids[i] != NULL; i++) {
+		pkg = zif_package_remote_new ();
+		ret = zif_package_set_id (pkg, ids[i], &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		string = zif_string_new (filenames[i]);
+		zif_package_set_location_href (pkg, string);
+		zif_string_unref (string);
+		filename = zif_test_get_data_file (filenames[i]);
+		g_assert_cmpint (g_stat (filename, &buf), ==, 0);
+		zif_package_set_size (pkg, buf.st_size);
+		g_free (filename);
+		zif_package_remote_set_store_remote (ZIF_PACKAGE_REMOTE (pkg), store);
+		g_ptr_array_add (array, pkg);
+	}
+
+	/* download them all at the same time */
+	directory = g_build_filename (zif_tmpdir, "parallel", NULL);
+	zif_state_reset (state);
+	ret = zif_package_array_download (array, directory, state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	for (i = 0; filenames[i] != NULL; i++) {
+		filename = g_build_filename (directory, filenames[i], NULL);
+		g_assert (g_file_test (filename, G_FILE_TEST_EXISTS));
+		g_unlink (filename);
+		g_free (filename);
+	}
+	g_free (directory);
+
+	g_ptr_array_unref (array);
+	g_object_unref (store);
+	g_object_unref (state);
+	ret = zif_config_unset (config, "max_parallel_downloads", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_unset (config, "max_parallel_downloads_per_repo", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_unset (config, "network", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (config);
+}
+
 static void
 zif_release_func (void)
 {
@@ -496,7 +608,10 @@ zif_manifest_func (void)
 static void
 zif_transaction_func (void)
 {
+	ZifConfig *config;
+	ZifDepend *depend;
 	ZifTransaction *transaction;
+	ZifTransaction *transaction2;
 	ZifPackage *package;
 	ZifPackage *package2;
 	ZifStore *local;
@@ -590,6 +705,66 @@ zif_transaction_func (void)
 	ret = zif_transaction_prepare (transaction, state, &error);
 	g_assert_no_error (error);
 	g_assert (ret);
+	g_object_unref (transaction);
+
+	/* a package that cannot be installed is cancelled when skip-broken */
+	config = zif_config_new ();
+	filename = zif_test_get_data_file ("zif.conf");
+	ret = zif_config_set_filename (config, filename, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_boolean (config, "skip_broken", TRUE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	package = zif_package_meta_new ();
+	ret = zif_package_set_id (package, "broken;0.0.1;i386;data", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	depend = zif_depend_new ();
+	zif_depend_set_name (depend, "zif-self-test-not-provided");
+	zif_depend_set_flag (depend, ZIF_DEPEND_FLAG_ANY);
+	zif_package_add_require (package, depend);
+	g_object_unref (depend);
+	transaction = zif_transaction_new ();
+	zif_transaction_set_store_local (transaction, local);
+	zif_transaction_set_stores_remote (transaction, remotes);
+	ret = zif_transaction_add_install (transaction, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	zif_state_reset (state);
+	ret = zif_transaction_resolve (transaction, state, &error);
+	g_assert_error (error, ZIF_TRANSACTION_ERROR, ZIF_TRANSACTION_ERROR_NOTHING_TO_DO);
+	g_assert (!ret);
+	g_clear_error (&error);
+	packages = zif_transaction_get_install (transaction);
+	g_assert_cmpint (packages->len, ==, 0);
+	g_ptr_array_unref (packages);
+
+	/* the same package in another transaction is not cancelled */
+	transaction2 = zif_transaction_new ();
+	ret = zif_transaction_add_install (transaction2, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	packages = zif_transaction_get_install (transaction2);
+	g_assert_cmpint (packages->len, ==, 1);
+	g_ptr_array_unref (packages);
+	g_object_unref (transaction2);
+
+	/* and neither is it after a reset */
+	zif_transaction_reset (transaction);
+	ret = zif_transaction_add_install (transaction, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	packages = zif_transaction_get_install (transaction);
+	g_assert_cmpint (packages->len, ==, 1);
+	g_ptr_array_unref (packages);
+	g_object_unref (package);
+
+	ret = zif_config_unset (config, "skip_broken", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (config);
 
 	g_ptr_array_unref (remotes);
 	g_object_unref (state);
@@ -598,6 +773,213 @@ zif_transaction_func (void)
 	g_object_unref (transaction);
 }
 
+/**
+ * zif_transaction_test_package_new:
+ **/
+static ZifPackage *
+zif_transaction_test_package_new (const gchar *package_id, const gchar *require)
+{
+	gboolean ret;
+	GError *error = NULL;
+	ZifDepend *depend;
+	ZifPackage *package;
+
+	package = zif_package_meta_new ();
+	ret = zif_package_set_id (package, package_id, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	if (require != NULL) {
+		depend = zif_depend_new ();
+		zif_depend_set_name (depend, require);
+		zif_depend_set_flag (depend, ZIF_DEPEND_FLAG_ANY);
+		zif_package_add_require (package, depend);
+		g_object_unref (depend);
+	}
+	return package;
+}
+
+static void
+zif_transaction_provide_func (void)
+{
+	const gchar *ids[] = { "zsh;1.0-1;i386;meta",
+			       "fish;1.0-1;i386;meta",
+			       "bash;1.0-1;i386;meta",
+			       NULL };
+	const gchar *requires[] = { "libmissing", "libmissing", NULL };
+	gboolean ret;
+	gchar *filename;
+	GError *error = NULL;
+	GPtrArray *packages;
+	GPtrArray *remotes;
+	guint hits;
+	guint i;
+	guint prefetched;
+	guint searches;
+	ZifConfig *config;
+	ZifPackage *package;
+	ZifState *state;
+	ZifStore *local;
+	ZifStore *remote;
+	ZifTransaction *transaction;
+
+	config = zif_config_new ();
+	filename = zif_test_get_data_file ("zif.conf");
+	ret = zif_config_set_filename (config, filename, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_string (config, "archinfo", "i386", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_boolean (config, "skip_broken", TRUE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_boolean (config, "batch_depsolve", FALSE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* two packages need the same depend, which is not provided */
+	state = zif_state_new ();
+	transaction = zif_transaction_new ();
+	local = zif_store_meta_new ();
+	remote = zif_store_meta_new ();
+	remotes = zif_store_array_new ();
+	zif_store_array_add_store (remotes, remote);
+	for (i = 0; ids[i] != NULL; i++) {
+		package = zif_transaction_test_package_new (ids[i], requires[i]);
+		ret = zif_store_add_package (remote, package, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		ret = zif_transaction_add_install (transaction, package, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		g_object_unref (package);
+	}
+	zif_transaction_set_store_local (transaction, local);
+	zif_transaction_set_stores_remote (transaction, remotes);
+	ret = zif_transaction_resolve (transaction, state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	packages = zif_transaction_get_install (transaction);
+	g_assert_cmpint (packages->len, ==, 1);
+	g_ptr_array_unref (packages);
+
+	/* the remote stores were only searched once */
+	zif_transaction_get_provide_stats (transaction, &searches, &hits, &prefetched);
+	g_assert_cmpint (searches, ==, 1);
+	g_assert_cmpint (hits, ==, 1);
+	g_assert_cmpint (prefetched, ==, 0);
+
+	g_object_unref (transaction);
+	g_ptr_array_unref (remotes);
+	g_object_unref (remote);
+	g_object_unref (local);
+	g_object_unref (state);
+	ret = zif_config_unset (config, "archinfo", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_unset (config, "skip_broken", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_unset (config, "batch_depsolve", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (config);
+}
+
+static void
+zif_transaction_prefetch_func (void)
+{
+	gboolean ret;
+	gchar *filename;
+	GError *error = NULL;
+	GPtrArray *packages;
+	GPtrArray *remotes;
+	guint hits;
+	guint prefetched;
+	guint searches;
+	ZifConfig *config;
+	ZifDepend *depend;
+	ZifPackage *package;
+	ZifState *state;
+	ZifStore *local;
+	ZifStore *remote;
+	ZifStore *remote_empty;
+	ZifTransaction *transaction;
+
+	config = zif_config_new ();
+	filename = zif_test_get_data_file ("zif.conf");
+	ret = zif_config_set_filename (config, filename, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_string (config, "archinfo", "i386", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_boolean (config, "batch_depsolve", TRUE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* the first remote store has no packages at all */
+	state = zif_state_new ();
+	transaction = zif_transaction_new ();
+	local = zif_store_meta_new ();
+	remote_empty = zif_store_meta_new ();
+	remote = zif_store_meta_new ();
+	remotes = zif_store_array_new ();
+	zif_store_array_add_store (remotes, remote_empty);
+	zif_store_array_add_store (remotes, remote);
+
+	/* the second provides the depend */
+	package = zif_transaction_test_package_new ("hal-libs;1.0-1;i386;meta", NULL);
+	depend = zif_depend_new ();
+	zif_depend_set_name (depend, "libhal");
+	zif_depend_set_flag (depend, ZIF_DEPEND_FLAG_ANY);
+	zif_package_add_provide (package, depend);
+	g_object_unref (depend);
+	ret = zif_store_add_package (remote, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (package);
+	package = zif_transaction_test_package_new ("hal;1.0-1;i386;meta", "libhal");
+	ret = zif_store_add_package (remote, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_transaction_add_install (transaction, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (package);
+
+	zif_transaction_set_store_local (transaction, local);
+	zif_transaction_set_stores_remote (transaction, remotes);
+	ret = zif_transaction_resolve (transaction, state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	packages = zif_transaction_get_install (transaction);
+	g_assert_cmpint (packages->len, ==, 2);
+	g_ptr_array_unref (packages);
+
+	/* the empty store did not stop the prefetch */
+	zif_transaction_get_provide_stats (transaction, &searches, &hits, &prefetched);
+	g_assert_cmpint (prefetched, ==, 1);
+	g_assert_cmpint (searches, ==, 0);
+	g_assert_cmpint (hits, >=, 1);
+
+	g_object_unref (transaction);
+	g_ptr_array_unref (remotes);
+	g_object_unref (remote);
+	g_object_unref (remote_empty);
+	g_object_unref (local);
+	g_object_unref (state);
+	ret = zif_config_unset (config, "archinfo", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_unset (config, "batch_depsolve", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (config);
+}
+
 static void
 zif_changeset_func (void)
 {
@@ -782,6 +1164,7 @@ zif_db_func (void)
 	gchar *filename;
 	GError *error = NULL;
 	GPtrArray *array;
+	ZifConfig *config;
 	ZifDb *db;
 	ZifPackage *package;
 	ZifString *string;
@@ -833,6 +1216,12 @@ zif_db_func (void)
 	g_assert (array != NULL);
 	g_assert_cmpint (array->len, ==, 1);
 	g_ptr_array_unref (array);
+
+	/* remove a key that was never set */
+	ret = zif_db_remove (db, package, "reason", &error);
+	g_assert_error (error, ZIF_DB_ERROR, ZIF_DB_ERROR_FAILED);
+	g_assert (!ret);
+	g_clear_error (&error);
 	g_object_unref (package);
 
 	g_object_unref (db);
@@ -852,6 +1241,111 @@ zif_db_func (void)
 	g_ptr_array_unref (array);
 
 	g_object_unref (db);
+
+	/* use the database, which imports the directory written above */
+	config = zif_config_new ();
+	filename = zif_test_get_data_file ("zif.conf");
+	ret = zif_config_set_filename (config, filename, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+	filename = g_build_filename (zif_tmpdir, "yumdb.db", NULL);
+	ret = zif_config_set_string (config, "yumdb_backend", "sqlite", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_string (config, "yumdb_sqlite", filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_free (filename);
+	db = zif_db_new ();
+	ret = zif_db_set_root (db, zif_tmpdir, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	array = zif_db_get_packages (db, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 1);
+	g_ptr_array_unref (array);
+
+	/* create the same dummy package */
+	package = zif_package_remote_new ();
+	ret = zif_package_set_id (package, "PackageKit;0.1.2-14.fc13;i386;fedora", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	string = zif_string_new ("8acc1b3457e3a5115ca2ad40cf0b3c121d2ab82d");
+	zif_package_set_pkgid (package, string);
+	zif_string_unref (string);
+
+	/* read imported value */
+	data = zif_db_get_string (db, package, "from_repo", &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (data, ==, "fedora");
+	g_free (data);
+
+	/* write a batch */
+	ret = zif_db_begin (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_db_set_string (db, package, "reason", "user", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_db_set_string (db, package, "releasever", "13", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_db_commit (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	array = zif_db_get_keys (db, package, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 3);
+	g_ptr_array_unref (array);
+
+	/* abandon a batch */
+	ret = zif_db_begin (db, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_db_remove_all (db, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	zif_db_rollback (db);
+	data = zif_db_get_string (db, package, "reason", &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (data, ==, "user");
+	g_free (data);
+
+	/* remove one key, which fails the second time like the
+	 * directory backend */
+	ret = zif_db_remove (db, package, "releasever", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_db_remove (db, package, "releasever", &error);
+	g_assert_error (error, ZIF_DB_ERROR, ZIF_DB_ERROR_FAILED);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* remove everything */
+	ret = zif_db_remove_all (db, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	data = zif_db_get_string (db, package, "reason", &error);
+	g_assert_error (error, ZIF_DB_ERROR, ZIF_DB_ERROR_FAILED);
+	g_assert (data == NULL);
+	g_clear_error (&error);
+
+	g_object_unref (package);
+	g_object_unref (db);
+
+	/* do not use the database in other tests */
+	ret = zif_config_unset (config, "yumdb_backend", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_unset (config, "yumdb_sqlite", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (config);
 }
 
 static void
@@ -859,6 +1353,8 @@ zif_depend_func (void)
 {
 	ZifDepend *depend;
 	ZifDepend *need;
+	ZifDependEntry entry;
+	ZifString *string;
 	gboolean ret;
 	GError *error = NULL;
 	const gchar *keys1[] = { "name",
@@ -1042,6 +1538,40 @@ zif_depend_func (void)
 	g_assert_cmpstr (zif_depend_get_version (depend), ==, NULL);
 	g_assert_cmpint (zif_depend_get_flag (depend), ==, ZIF_DEPEND_FLAG_ANY);
 	g_object_unref (depend);
+
+	/* compact depends */
+	zif_depend_entry_init (&entry, "hal", ZIF_DEPEND_FLAG_EQUAL, "0.5.8-1.fc15");
+	g_assert_cmpstr (zif_depend_entry_get_name (&entry), ==, "hal");
+	g_assert_cmpstr (zif_depend_entry_get_version (&entry), ==, "0.5.8-1.fc15");
+	need = zif_depend_new ();
+	zif_depend_set_name (need, "hal");
+	zif_depend_set_flag (need, ZIF_DEPEND_FLAG_GREATER);
+	zif_depend_set_version (need, "0.5.7");
+	g_assert (zif_depend_get_name_str (need) == entry.name);
+	g_assert (zif_depend_entry_satisfies (&entry, need));
+	g_object_unref (need);
+	need = zif_depend_new ();
+	zif_depend_set_name (need, "hal");
+	zif_depend_set_flag (need, ZIF_DEPEND_FLAG_LESS);
+	zif_depend_set_version (need, "0.5.7");
+	g_assert (!zif_depend_entry_satisfies (&entry, need));
+	g_object_unref (need);
+
+	/* names set from a plain string are interned too */
+	string = zif_string_new ("hal");
+	need = zif_depend_new ();
+	zif_depend_set_name_str (need, string);
+	g_assert (zif_depend_get_name_str (need) != string);
+	g_assert (zif_depend_get_name_str (need) == entry.name);
+	zif_string_unref (string);
+	g_object_unref (need);
+
+	/* and back to an object, sharing the name */
+	depend = zif_depend_new_from_entry (&entry);
+	g_assert (zif_depend_get_name_str (depend) == entry.name);
+	g_assert_cmpstr (zif_depend_get_description (depend), ==, "[hal = 0.5.8-1.fc15]");
+	g_object_unref (depend);
+	zif_depend_entry_clear (&entry);
 }
 
 static guint _updates = 0;
@@ -1217,6 +1747,78 @@ out:
 	g_assert (config == NULL);
 }
 
+static void
+zif_file_index_func (void)
+{
+	const gchar *search_multiple[] = { "/usr/bin/zif", "/bin/sh", "/usr/bin/bash", NULL };
+	const gchar *search_partial[] = { "/usr/bin/zi", "/usr/bi/zif", "/usr/bin", NULL };
+	const gchar *search_single[] = { "/usr/share/doc/zif/README", NULL };
+	gboolean ret;
+	gchar *filename;
+	GError *error = NULL;
+	GPtrArray *array;
+	ZifFileIndex *index;
+
+	/* add some files from three packages */
+	index = zif_file_index_new ();
+	zif_file_index_add (index, "zif;0.3.6-1;i386;installed", "/usr/bin/zif");
+	zif_file_index_add (index, "zif;0.3.6-1;i386;installed", "/usr/share/doc/zif/README");
+	zif_file_index_add (index, "bash;4.2-1;i386;installed", "/bin/sh");
+	zif_file_index_add (index, "bash;4.2-1;i386;installed", "/usr/bin/bash");
+	zif_file_index_add (index, "zsh;4.3-1;i386;installed", "/bin/sh");
+	zif_file_index_add (index, "zsh;4.3-1;i386;installed", "/usr/share/doc/zsh/README");
+	zif_file_index_build (index, "stamp1");
+
+	/* the same package is only returned once */
+	array = zif_file_index_search (index, (gchar **) search_multiple);
+	g_assert_cmpint (array->len, ==, 3);
+	g_assert_cmpstr (g_ptr_array_index (array, 0), ==, "zif;0.3.6-1;i386;installed");
+	g_ptr_array_unref (array);
+
+	/* only full paths match */
+	array = zif_file_index_search (index, (gchar **) search_partial);
+	g_assert_cmpint (array->len, ==, 0);
+	g_ptr_array_unref (array);
+
+	/* save */
+	filename = g_build_filename (zif_tmpdir, "files.idx", NULL);
+	ret = zif_file_index_save (index, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	zif_file_index_free (index);
+
+	/* load with the wrong stamp */
+	index = zif_file_index_new ();
+	ret = zif_file_index_load (index, filename, "stamp2", &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* load with the right stamp */
+	ret = zif_file_index_load (index, filename, "stamp1", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	array = zif_file_index_search (index, (gchar **) search_single);
+	g_assert_cmpint (array->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (array, 0), ==, "zif;0.3.6-1;i386;installed");
+	g_ptr_array_unref (array);
+	zif_file_index_free (index);
+
+	/* a corrupt file is rejected */
+	ret = g_file_set_contents (filename, "ZIFFIDX1 not really", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	index = zif_file_index_new ();
+	ret = zif_file_index_load (index, filename, "stamp1", &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+	g_assert (!ret);
+	g_clear_error (&error);
+	zif_file_index_free (index);
+
+	g_unlink (filename);
+	g_free (filename);
+}
+
 static void
 zif_groups_func (void)
 {
@@ -1414,25 +2016,170 @@ zif_lock_func (void)
 	g_object_unref (lock);
 	g_object_unref (config);
 	g_assert (config == NULL);
-	g_free (pidfile);
-}
-
-static gpointer
-zif_self_test_lock_thread_one (gpointer data)
-{
-	GError *error = NULL;
-	guint lock_id;
-	ZifLock *lock = ZIF_LOCK (data);
-
-	g_usleep (G_USEC_PER_SEC / 100);
-	lock_id = zif_lock_take (lock,
-				 ZIF_LOCK_TYPE_REPO,
-				 ZIF_LOCK_MODE_PROCESS,
-				 &error);
-	g_assert_error (error, ZIF_LOCK_ERROR, ZIF_LOCK_ERROR_FAILED);
-	g_assert_cmpint (lock_id, ==, 0);
-	g_error_free (error);
-	return NULL;
+	g_free (pidfile);
+}
+
+static gpointer
+zif_self_test_lock_thread_one (gpointer data)
+{
+	GError *error = NULL;
+	guint lock_id;
+	ZifLock *lock = ZIF_LOCK (data);
+
+	g_usleep (G_USEC_PER_SEC / 100);
+	lock_id = zif_lock_take (lock,
+				 ZIF_LOCK_TYPE_REPO,
+				 ZIF_LOCK_MODE_PROCESS,
+				 &error);
+	g_assert_error (error, ZIF_LOCK_ERROR, ZIF_LOCK_ERROR_FAILED);
+	g_assert_cmpint (lock_id, ==, 0);
+	g_error_free (error);
+	return NULL;
+}
+
+static gpointer
+zif_self_test_lock_thread_shared (gpointer data)
+{
+	gboolean ret;
+	GError *error = NULL;
+	guint lock_id;
+	ZifLock *lock = ZIF_LOCK (data);
+
+	/* another reader is fine */
+	lock_id = zif_lock_take_full (lock,
+				      ZIF_LOCK_TYPE_METADATA,
+				      ZIF_LOCK_MODE_PROCESS,
+				      ZIF_LOCK_ACCESS_SHARED,
+				      0,
+				      &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (lock_id, >, 0);
+	ret = zif_lock_release (lock, lock_id, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* but a writer is not */
+	lock_id = zif_lock_take_full (lock,
+				      ZIF_LOCK_TYPE_METADATA,
+				      ZIF_LOCK_MODE_PROCESS,
+				      ZIF_LOCK_ACCESS_EXCLUSIVE,
+				      0,
+				      &error);
+	g_assert_error (error, ZIF_LOCK_ERROR, ZIF_LOCK_ERROR_FAILED);
+	g_assert_cmpint (lock_id, ==, 0);
+	g_clear_error (&error);
+
+	/* unless we wait for the reader to finish */
+	lock_id = zif_lock_take_full (lock,
+				      ZIF_LOCK_TYPE_METADATA,
+				      ZIF_LOCK_MODE_PROCESS,
+				      ZIF_LOCK_ACCESS_EXCLUSIVE,
+				      5000,
+				      &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (lock_id, >, 0);
+	ret = zif_lock_release (lock, lock_id, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	return NULL;
+}
+
+static void
+zif_lock_shared_func (void)
+{
+	gboolean ret;
+	gchar *filename;
+	gchar *pidfile;
+	GError *error = NULL;
+	GThread *thread;
+	guint lock_id1;
+	guint lock_id2;
+	ZifConfig *config;
+	ZifLock *lock;
+
+	config = zif_config_new ();
+	g_object_add_weak_pointer (G_OBJECT (config), (gpointer *) &config);
+	filename = zif_test_get_data_file ("zif.conf");
+	ret = zif_config_set_filename (config, filename, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* set this to somewhere we can write to */
+	pidfile = g_build_filename (zif_tmpdir, "zif.lock", NULL);
+	zif_config_set_string (config, "pidfile", pidfile, NULL);
+	g_free (pidfile);
+
+	/* take a shared lock twice */
+	lock = zif_lock_new ();
+	lock_id1 = zif_lock_take_full (lock,
+				       ZIF_LOCK_TYPE_METADATA,
+				       ZIF_LOCK_MODE_PROCESS,
+				       ZIF_LOCK_ACCESS_SHARED,
+				       0,
+				       &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (lock_id1, >, 0);
+	lock_id2 = zif_lock_take_full (lock,
+				       ZIF_LOCK_TYPE_METADATA,
+				       ZIF_LOCK_MODE_PROCESS,
+				       ZIF_LOCK_ACCESS_SHARED,
+				       0,
+				       &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (lock_id2, ==, lock_id1);
+	g_assert_cmpint (zif_lock_get_state (lock), ==, 1 << ZIF_LOCK_TYPE_METADATA);
+
+	/* cannot upgrade to exclusive */
+	lock_id2 = zif_lock_take (lock,
+				  ZIF_LOCK_TYPE_METADATA,
+				  ZIF_LOCK_MODE_PROCESS,
+				  &error);
+	g_assert_error (error, ZIF_LOCK_ERROR, ZIF_LOCK_ERROR_FAILED);
+	g_assert_cmpint (lock_id2, ==, 0);
+	g_clear_error (&error);
+
+	/* other threads can read, and wait to write */
+	thread = g_thread_new ("zif-lock-shared",
+			       zif_self_test_lock_thread_shared,
+			       lock);
+	g_usleep (G_USEC_PER_SEC / 2);
+
+	/* release both */
+	ret = zif_lock_release (lock, lock_id1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_lock_release (lock, lock_id1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_thread_join (thread);
+	g_assert_cmpint (zif_lock_get_state (lock), ==, 0);
+
+	/* an exclusive lock also allows a shared lock in this thread */
+	lock_id1 = zif_lock_take (lock,
+				  ZIF_LOCK_TYPE_METADATA,
+				  ZIF_LOCK_MODE_PROCESS,
+				  &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (lock_id1, >, 0);
+	lock_id2 = zif_lock_take_full (lock,
+				       ZIF_LOCK_TYPE_METADATA,
+				       ZIF_LOCK_MODE_PROCESS,
+				       ZIF_LOCK_ACCESS_SHARED,
+				       0,
+				       &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (lock_id2, ==, lock_id1);
+	ret = zif_lock_release (lock, lock_id1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_lock_release (lock, lock_id2, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	g_object_unref (lock);
+	g_object_unref (config);
+	g_assert (config == NULL);
 }
 
 static void
@@ -1490,6 +2237,133 @@ zif_lock_threads_func (void)
 	g_assert (config == NULL);
 }
 
+/* returns TRUE if a new process could lock the file with this access */
+static gboolean
+zif_self_test_lock_other_process (const gchar *filename, gshort lock_type)
+{
+	gint fd;
+	gint status = 0;
+	pid_t pid;
+	struct flock fl;
+
+	pid = fork ();
+	g_assert_cmpint (pid, >=, 0);
+	if (pid == 0) {
+		fd = open (filename, O_RDWR);
+		if (fd < 0)
+			_exit (0);
+		memset (&fl, 0, sizeof (fl));
+		fl.l_type = lock_type;
+		fl.l_whence = SEEK_SET;
+		_exit (fcntl (fd, F_SETLK, &fl) == 0 ? 0 : 1);
+	}
+	g_assert_cmpint (waitpid (pid, &status, 0), ==, pid);
+	g_assert (WIFEXITED (status));
+	return WEXITSTATUS (status) == 0;
+}
+
+/* returns TRUE if the file contains our pid, reading it from a new
+ * process as closing the file here would drop our fcntl() locks */
+static gboolean
+zif_self_test_lock_has_our_pid (const gchar *filename)
+{
+	gboolean ret;
+	gchar *contents = NULL;
+	gchar *pid_text;
+	gint status = 0;
+	pid_t pid;
+
+	pid = fork ();
+	g_assert_cmpint (pid, >=, 0);
+	if (pid == 0) {
+		pid_text = g_strdup_printf ("%i", getppid ());
+		ret = g_file_get_contents (filename, &contents, NULL, NULL);
+		_exit (ret && g_strcmp0 (contents, pid_text) == 0 ? 0 : 1);
+	}
+	g_assert_cmpint (waitpid (pid, &status, 0), ==, pid);
+	g_assert (WIFEXITED (status));
+	return WEXITSTATUS (status) == 0;
+}
+
+static void
+zif_lock_process_func (void)
+{
+	gboolean ret;
+	gchar *filename;
+	gchar *lock_filename;
+	gchar *pidfile;
+	GError *error = NULL;
+	guint lock_id1;
+	guint lock_id2;
+	ZifConfig *config;
+	ZifLock *lock;
+
+	config = zif_config_new ();
+	g_object_add_weak_pointer (G_OBJECT (config), (gpointer *) &config);
+	filename = zif_test_get_data_file ("zif.conf");
+	ret = zif_config_set_filename (config, filename, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* use one lock file for every type */
+	pidfile = g_build_filename (zif_tmpdir, "zif.lock", NULL);
+	zif_config_set_string (config, "pidfile", pidfile, NULL);
+	ret = zif_config_set_boolean (config, "lock_compat", TRUE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	lock_filename = g_strdup_printf ("%s.lock", pidfile);
+	g_free (pidfile);
+
+	/* another process cannot take the lock while we hold it */
+	lock = zif_lock_new ();
+	lock_id1 = zif_lock_take (lock,
+				  ZIF_LOCK_TYPE_RPMDB,
+				  ZIF_LOCK_MODE_PROCESS,
+				  &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (lock_id1, >, 0);
+	g_assert (!zif_self_test_lock_other_process (lock_filename, F_RDLCK));
+
+	/* take another type sharing the same file */
+	lock_id2 = zif_lock_take_full (lock,
+				       ZIF_LOCK_TYPE_METADATA,
+				       ZIF_LOCK_MODE_PROCESS,
+				       ZIF_LOCK_ACCESS_SHARED,
+				       0,
+				       &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (lock_id2, >, 0);
+	g_assert (!zif_self_test_lock_other_process (lock_filename, F_RDLCK));
+
+	/* releasing the exclusive type keeps the shared lock */
+	ret = zif_lock_release (lock, lock_id1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (g_file_test (lock_filename, G_FILE_TEST_EXISTS));
+	g_assert (!zif_self_test_lock_other_process (lock_filename, F_WRLCK));
+	g_assert (zif_self_test_lock_other_process (lock_filename, F_RDLCK));
+
+	/* tools that only read the pid still see the shared holder */
+	g_assert (zif_self_test_lock_has_our_pid (lock_filename));
+
+	/* releasing the last type unlocks and deletes the file */
+	ret = zif_lock_release (lock, lock_id2, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!g_file_test (lock_filename, G_FILE_TEST_EXISTS));
+	g_assert (zif_self_test_lock_other_process (lock_filename, F_WRLCK));
+
+	ret = zif_config_unset (config, "lock_compat", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	g_object_unref (lock);
+	g_object_unref (config);
+	g_assert (config == NULL);
+	g_free (lock_filename);
+}
+
 static void
 zif_md_func (void)
 {
@@ -1598,6 +2472,17 @@ zif_md_filelists_sql_func (void)
 	const gchar *pkgid;
 	ZifState *state;
 	const gchar *data[] = { "/usr/bin/gnome-power-manager", NULL };
+	const gchar *data_batch[] = { "/usr/bin/gnome-power-manager",
+				      "/usr/bin/gnome-power-bugreport.sh",
+				      "/usr/share/icons/hicolor/scalable/apps/gnome-brightness-applet.svg",
+				      "/usr/bin/missing",
+				      NULL };
+	const gchar *data_partial[] = { "/usr/bin/gnome-power", "/usr/bin/manager", NULL };
+	const gchar *data_multi[] = { "/usr/bin/zif",
+				      "/usr/lib/libzif.so.1",
+				      "/usr/sbin/zif",
+				      "/usr/bin/zi",
+				      NULL };
 	gchar *filename;
 
 	state = zif_state_new ();
@@ -1630,6 +2515,50 @@ zif_md_filelists_sql_func (void)
 	g_assert_cmpint (strlen (pkgid), ==, 64);
 	g_ptr_array_unref (array);
 
+	/* several files in one query, which are all in the same package */
+	zif_state_reset (state);
+	array = zif_md_search_file (md, (gchar**)data_batch, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 1);
+	g_ptr_array_unref (array);
+
+	/* only whole filenames match */
+	zif_state_reset (state);
+	array = zif_md_search_file (md, (gchar**)data_partial, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 0);
+	g_ptr_array_unref (array);
+	g_object_unref (md);
+
+	/* several files in one query, which are in different packages */
+	md = zif_md_filelists_sql_new ();
+	zif_md_set_id (md, "multi");
+	zif_md_set_checksum_type (md, G_CHECKSUM_SHA256);
+	zif_md_set_checksum (md, "4bc5ebf85d099d4eb0fb19e50390b015d1f1cbc53c9588992e767448e2ba6809");
+	zif_md_set_checksum_uncompressed (md, "6231c7775c13e60f5ba2ec71f201f1461cb557da998eaaeb5486af5c94aa40f6");
+	filename = zif_test_get_data_file ("filelists-multi.sqlite.bz2");
+	zif_md_set_filename (md, filename);
+	g_free (filename);
+	zif_state_reset (state);
+	ret = zif_md_load (md, state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	zif_state_reset (state);
+	array = zif_md_search_file (md, (gchar**)data_multi, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 3);
+	g_ptr_array_sort (array, (GCompareFunc) zif_indirect_strcmp);
+	g_assert_cmpstr (g_ptr_array_index (array, 0), ==,
+			 "1111111111111111111111111111111111111111111111111111111111111111");
+	g_assert_cmpstr (g_ptr_array_index (array, 1), ==,
+			 "2222222222222222222222222222222222222222222222222222222222222222");
+	g_assert_cmpstr (g_ptr_array_index (array, 2), ==,
+			 "3333333333333333333333333333333333333333333333333333333333333333");
+	g_ptr_array_unref (array);
+
 	g_object_unref (md);
 	g_object_unref (state);
 	g_assert (state == NULL);
@@ -1865,6 +2794,7 @@ zif_md_primary_sql_func (void)
 	gboolean ret;
 	GError *error = NULL;
 	GPtrArray *array;
+	GPtrArray *array_tmp;
 	ZifPackage *package;
 	ZifState *state;
 	ZifConfig *config;
@@ -1875,6 +2805,8 @@ zif_md_primary_sql_func (void)
 	const gchar *data_glob[] = { "gnome-*", NULL };
 	const gchar *data_noarch[] = { "perl-Log-Message-Simple.i686", NULL };
 	gchar *filename;
+	GPtrArray *depends;
+	ZifDepend *depend;
 
 	state = zif_state_new ();
 	g_object_add_weak_pointer (G_OBJECT (state), (gpointer *) &state);
@@ -1919,6 +2851,19 @@ zif_md_primary_sql_func (void)
 	zif_state_reset (state);
 	g_assert_cmpstr (zif_package_get_source_filename (package, state, NULL), ==,
 			 "gnome-power-manager-2.30.1-1.fc13.src.rpm");
+
+	/* resolving again gives us the same object */
+	zif_state_reset (state);
+	array_tmp = zif_md_resolve_full (md,
+					 (gchar**)data,
+					 ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH,
+					 state,
+					 &error);
+	g_assert_no_error (error);
+	g_assert (array_tmp != NULL);
+	g_assert_cmpint (array_tmp->len, ==, 1);
+	g_assert (g_ptr_array_index (array_tmp, 0) == package);
+	g_ptr_array_unref (array_tmp);
 	g_ptr_array_unref (array);
 
 	/* resolve a lot of items */
@@ -1965,6 +2910,29 @@ zif_md_primary_sql_func (void)
 	g_assert_cmpint (array->len, ==, 1);
 	g_ptr_array_unref (array);
 
+	/* what provides */
+	depends = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	depend = zif_depend_new ();
+	zif_depend_set_flag (depend, ZIF_DEPEND_FLAG_ANY);
+	zif_depend_set_name (depend, "gnome-power-manager(x86-32)");
+	g_ptr_array_add (depends, depend);
+	zif_state_reset (state);
+	array = zif_md_what_provides (md, depends, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 1);
+	g_ptr_array_unref (array);
+
+	/* what provides with a name that needs quoting */
+	zif_depend_set_name (depend, "gnome-power-manager'");
+	zif_state_reset (state);
+	array = zif_md_what_provides (md, depends, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 0);
+	g_ptr_array_unref (array);
+	g_ptr_array_unref (depends);
+
 	g_object_unref (state);
 	g_assert (state == NULL);
 	g_object_unref (md);
@@ -2166,9 +3134,18 @@ zif_md_updateinfo_func (void)
 	ZifMd *md;
 	GError *error = NULL;
 	GPtrArray *array;
+	GPtrArray *packages;
+	ZifPackage *package;
 	ZifState *state;
 	ZifUpdate *update;
+	gboolean ret;
 	gchar *filename;
+	guint i;
+	const gchar *package_ids[] = { "gnome-power-manager;2.30.1-1.fc13;i686;fedora",
+				       "gnome-power-manager;2.30.1-1.fc13;ppc;fedora",
+				       "lvm2;2.02.39-7.fc10;ppc;fedora",
+				       "hal;0.5.8-1.fc13;i386;fedora",
+				       NULL };
 
 	state = zif_state_new ();
 	g_object_add_weak_pointer (G_OBJECT (state), (gpointer *) &state);
@@ -2194,6 +3171,34 @@ zif_md_updateinfo_func (void)
 	g_assert_cmpstr (zif_update_get_id (update), ==, "FEDORA-2008-9969");
 	g_assert_cmpstr (zif_update_get_title (update), ==, "lvm2-2.02.39-7.fc10");
 	g_assert_cmpstr (zif_update_get_description (update), ==, "Fix an incorrect path that prevents the clvmd init script from working and include licence files with the sub-packages.");
+	g_ptr_array_unref (array);
+
+	/* any version of the package */
+	array = zif_md_updateinfo_get_detail_for_name_arch (ZIF_MD_UPDATEINFO (md), "device-mapper-libs.ppc64", state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 2);
+	g_ptr_array_unref (array);
+
+	/* lots of packages at once, sharing one update */
+	packages = zif_object_array_new ();
+	for (i = 0; package_ids[i] != NULL; i++) {
+		package = zif_package_new ();
+		ret = zif_package_set_id (package, package_ids[i], &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		zif_object_array_add (packages, package);
+		g_object_unref (package);
+	}
+	array = zif_md_updateinfo_get_detail_for_packages (ZIF_MD_UPDATEINFO (md), packages, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 2);
+	update = g_ptr_array_index (array, 0);
+	g_assert_cmpstr (zif_update_get_id (update), ==, "FEDORA-2010-9999");
+	update = g_ptr_array_index (array, 1);
+	g_assert_cmpstr (zif_update_get_id (update), ==, "FEDORA-2008-9969");
+	g_ptr_array_unref (packages);
 
 	g_ptr_array_unref (array);
 	g_object_unref (md);
@@ -2296,6 +3301,10 @@ zif_package_func (void)
 	gboolean ret;
 	gint retval;
 	GError *error = NULL;
+	GPtrArray *provides;
+	ZifDepend *depend;
+	ZifDepend *satisfies = NULL;
+	ZifState *state;
 
 	/* check compare */
 	a = zif_package_new ();
@@ -2363,6 +3372,54 @@ zif_package_func (void)
 	g_assert_cmpstr (zif_package_get_id (a), ==, "colord;0.0.1-1.fc15;i386;installed:fedora");
 	g_assert_cmpstr (zif_package_get_data (a), ==, "installed:fedora");
 	g_object_unref (a);
+
+	/* check provides do not need the file list, as a plain
+	 * package has no way of getting one */
+	a = zif_package_new ();
+	ret = zif_package_set_id (a, "colord;0.0.1-1.fc15;i386;fedora", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	provides = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_ptr_array_add (provides, zif_depend_new_from_values ("libcolord.so.1", ZIF_DEPEND_FLAG_ANY, ""));
+	g_ptr_array_add (provides, zif_depend_new_from_values ("/usr/bin/colormgr", ZIF_DEPEND_FLAG_ANY, ""));
+	zif_package_set_provides (a, provides);
+	g_ptr_array_unref (provides);
+	state = zif_state_new ();
+	depend = zif_depend_new_from_values ("libcolord.so.1", ZIF_DEPEND_FLAG_ANY, "");
+	ret = zif_package_provides (a, depend, &satisfies, state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (satisfies != NULL);
+	g_object_unref (satisfies);
+	g_object_unref (depend);
+	depend = zif_depend_new_from_values ("libcolord.so.2", ZIF_DEPEND_FLAG_ANY, "");
+	zif_state_reset (state);
+	ret = zif_package_provides (a, depend, &satisfies, state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (satisfies == NULL);
+	g_object_unref (depend);
+
+	/* explicit file provides are found without the file list */
+	depend = zif_depend_new_from_values ("/usr/bin/colormgr", ZIF_DEPEND_FLAG_ANY, "");
+	zif_state_reset (state);
+	ret = zif_package_provides (a, depend, &satisfies, state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (satisfies != NULL);
+	g_object_unref (satisfies);
+	g_object_unref (depend);
+
+	/* but other file depends need it */
+	depend = zif_depend_new_from_values ("/usr/bin/cd-create-profile", ZIF_DEPEND_FLAG_ANY, "");
+	zif_state_reset (state);
+	ret = zif_package_provides (a, depend, &satisfies, state, &error);
+	g_assert_error (error, ZIF_PACKAGE_ERROR, ZIF_PACKAGE_ERROR_FAILED);
+	g_assert (!ret);
+	g_clear_error (&error);
+	g_object_unref (depend);
+	g_object_unref (state);
+	g_object_unref (a);
 }
 
 static void
@@ -2743,6 +3800,99 @@ zif_repos_func (void)
 	g_assert (config == NULL);
 }
 
+static void
+zif_rpmdb_snapshot_func (void)
+{
+	gboolean ret;
+	gchar *filename;
+	GArray *depends;
+	GError *error = NULL;
+	ZifDependEntry *depend;
+	ZifDependEntry entry;
+	ZifRpmdbSnapshot *snapshot;
+
+	/* add two packages, one without any depends */
+	snapshot = zif_rpmdb_snapshot_new ();
+	zif_rpmdb_snapshot_add_package (snapshot,
+					"zif;0.3.6-1;i386;installed:fedora",
+					"a3a1a9d1dfe8c2b1f7c5e83a2e66ec0e9d2b2e55", 42);
+	depends = zif_depend_entry_array_new (2);
+	zif_depend_entry_init (&entry, "zif", ZIF_DEPEND_FLAG_EQUAL, "0.3.6-1");
+	g_array_append_val (depends, entry);
+	zif_depend_entry_init (&entry, "libzif.so.1", ZIF_DEPEND_FLAG_ANY, NULL);
+	g_array_append_val (depends, entry);
+	zif_rpmdb_snapshot_add_depends (snapshot, ZIF_RPMDB_SNAPSHOT_DEPEND_PROVIDES, depends);
+	g_array_unref (depends);
+	depends = zif_depend_entry_array_new (2);
+	zif_depend_entry_init (&entry, "rpm", ZIF_DEPEND_FLAG_GREATER, "4.9");
+	g_array_append_val (depends, entry);
+	zif_rpmdb_snapshot_add_depends (snapshot, ZIF_RPMDB_SNAPSHOT_DEPEND_REQUIRES, depends);
+	g_array_unref (depends);
+	zif_rpmdb_snapshot_add_package (snapshot,
+					"filesystem;2.4-1;i386;installed",
+					"0b0c37d2d8b0e5d6e1a2a9d3c8e7f6a5b4c3d2e1", 7);
+	zif_rpmdb_snapshot_build (snapshot, "stamp1");
+	g_assert_cmpint (zif_rpmdb_snapshot_get_size (snapshot), ==, 2);
+
+	/* save */
+	filename = g_build_filename (zif_tmpdir, "rpmdb.snapshot", NULL);
+	ret = zif_rpmdb_snapshot_save (snapshot, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	zif_rpmdb_snapshot_free (snapshot);
+
+	/* load with the wrong stamp */
+	snapshot = zif_rpmdb_snapshot_new ();
+	ret = zif_rpmdb_snapshot_load (snapshot, filename, "stamp2", &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+	g_assert (!ret);
+	g_clear_error (&error);
+
+	/* load with the right stamp */
+	ret = zif_rpmdb_snapshot_load (snapshot, filename, "stamp1", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (zif_rpmdb_snapshot_get_size (snapshot), ==, 2);
+	g_assert_cmpstr (zif_rpmdb_snapshot_get_package_id (snapshot, 0), ==, "zif;0.3.6-1;i386;installed:fedora");
+	g_assert_cmpstr (zif_rpmdb_snapshot_get_pkgid (snapshot, 0), ==, "a3a1a9d1dfe8c2b1f7c5e83a2e66ec0e9d2b2e55");
+	g_assert_cmpint (zif_rpmdb_snapshot_get_instance (snapshot, 0), ==, 42);
+	g_assert_cmpint (zif_rpmdb_snapshot_get_instance (snapshot, 1), ==, 7);
+
+	/* the depends are preserved */
+	depends = zif_rpmdb_snapshot_get_depends (snapshot, 0, ZIF_RPMDB_SNAPSHOT_DEPEND_PROVIDES);
+	g_assert_cmpint (depends->len, ==, 2);
+	depend = &g_array_index (depends, ZifDependEntry, 0);
+	g_assert_cmpstr (zif_depend_entry_get_name (depend), ==, "zif");
+	g_assert_cmpint (depend->flag, ==, ZIF_DEPEND_FLAG_EQUAL);
+	g_assert_cmpstr (zif_depend_entry_get_version (depend), ==, "0.3.6-1");
+	depend = &g_array_index (depends, ZifDependEntry, 1);
+	g_assert_cmpstr (zif_depend_entry_get_version (depend), ==, NULL);
+	g_array_unref (depends);
+	depends = zif_rpmdb_snapshot_get_depends (snapshot, 0, ZIF_RPMDB_SNAPSHOT_DEPEND_REQUIRES);
+	g_assert_cmpint (depends->len, ==, 1);
+	depend = &g_array_index (depends, ZifDependEntry, 0);
+	g_assert_cmpstr (zif_depend_entry_get_name (depend), ==, "rpm");
+	g_array_unref (depends);
+	depends = zif_rpmdb_snapshot_get_depends (snapshot, 1, ZIF_RPMDB_SNAPSHOT_DEPEND_PROVIDES);
+	g_assert_cmpint (depends->len, ==, 0);
+	g_array_unref (depends);
+	zif_rpmdb_snapshot_free (snapshot);
+
+	/* a corrupt file is rejected */
+	ret = g_file_set_contents (filename, "ZIFRPMS1 not really", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	snapshot = zif_rpmdb_snapshot_new ();
+	ret = zif_rpmdb_snapshot_load (snapshot, filename, "stamp1", &error);
+	g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+	g_assert (!ret);
+	g_clear_error (&error);
+	zif_rpmdb_snapshot_free (snapshot);
+
+	g_unlink (filename);
+	g_free (filename);
+}
+
 static guint _allow_cancel_updates = 0;
 static guint _action_updates = 0;
 static guint _package_progress_updates = 0;
@@ -3354,6 +4504,95 @@ zif_state_finished_func (void)
 	g_assert (state == NULL);
 }
 
+static guint _parallel_last_percent = 0;
+
+static void
+zif_state_parallel_percentage_changed_cb (ZifState *state, guint value, gpointer data)
+{
+	/* emitted from the worker threads, but never at the same time */
+	g_assert_cmpint (value, >=, _parallel_last_percent);
+	_parallel_last_percent = value;
+}
+
+static gpointer
+zif_self_test_state_parallel_thread (gpointer data)
+{
+	gboolean ret;
+	GError *error = NULL;
+	guint i;
+	ZifState *state = ZIF_STATE (data);
+
+	zif_state_set_number_steps (state, 50);
+	for (i = 0; i < 50; i++) {
+		ret = zif_state_done (state, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+	}
+	return NULL;
+}
+
+static void
+zif_state_parallel_func (void)
+{
+	gboolean ret;
+	GError *error = NULL;
+	GPtrArray *children;
+	GThread *threads[4];
+	guint i;
+	ZifState *child;
+	ZifState *state_local;
+	ZifState *state;
+
+	state = zif_state_new ();
+	g_object_add_weak_pointer (G_OBJECT (state), (gpointer *) &state);
+	g_signal_connect (state, "percentage-changed",
+			  G_CALLBACK (zif_state_parallel_percentage_changed_cb), NULL);
+	ret = zif_state_set_steps (state,
+				   &error,
+				   50,
+				   50,
+				   -1);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* run all the children at the same time */
+	state_local = zif_state_get_child (state);
+	children = zif_state_get_children (state_local, 4);
+	g_assert_cmpint (children->len, ==, 4);
+	for (i = 0; i < children->len; i++) {
+		threads[i] = g_thread_new ("zif-state-parallel",
+					   zif_self_test_state_parallel_thread,
+					   g_ptr_array_index (children, i));
+	}
+	for (i = 0; i < children->len; i++)
+		g_thread_join (threads[i]);
+	g_assert_cmpint (_parallel_last_percent, ==, 50);
+	g_ptr_array_unref (children);
+
+	/* this section done */
+	ret = zif_state_done (state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (_parallel_last_percent, ==, 50);
+
+	/* cancelling the parent cancels all of the children */
+	state_local = zif_state_get_child (state);
+	children = zif_state_get_children (state_local, 2);
+	g_cancellable_cancel (zif_state_get_cancellable (state));
+	for (i = 0; i < children->len; i++) {
+		child = g_ptr_array_index (children, i);
+		zif_state_set_number_steps (child, 2);
+		ret = zif_state_done (child, &error);
+		g_assert_error (error, ZIF_STATE_ERROR, ZIF_STATE_ERROR_CANCELLED);
+		g_assert (!ret);
+		g_clear_error (&error);
+	}
+	g_ptr_array_unref (children);
+
+	g_object_unref (state);
+	g_assert (state == NULL);
+}
+
 static void
 zif_state_locking_func (void)
 {
@@ -3701,6 +4940,8 @@ zif_store_meta_func (void)
 	ZifState *state;
 	const gchar *to_array[] = {NULL, NULL};
 	GPtrArray *array;
+	GPtrArray *depend_array;
+	ZifDepend *depend;
 
 	store = zif_store_meta_new ();
 	g_object_add_weak_pointer (G_OBJECT (store), (gpointer *) &store);
@@ -3736,6 +4977,29 @@ zif_store_meta_func (void)
 	g_assert_cmpint (array->len, ==, 1);
 	g_ptr_array_unref (array);
 
+	/* ensure we can find it using the name.arch index */
+	to_array[0] = "test.i386";
+	zif_state_reset (state);
+	array = zif_store_resolve_full (store, (gchar**) to_array,
+					ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH,
+					state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 1);
+	g_ptr_array_unref (array);
+
+	/* ensure we can still find it with a glob */
+	to_array[0] = "te*.i?86";
+	zif_state_reset (state);
+	array = zif_store_resolve_full (store, (gchar**) to_array,
+					ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH |
+					ZIF_STORE_RESOLVE_FLAG_USE_GLOB,
+					state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 1);
+	g_ptr_array_unref (array);
+
 	/* ensure we can find it */
 	zif_state_reset (state);
 	array = zif_store_get_packages (store, state, &error);
@@ -3744,11 +5008,33 @@ zif_store_meta_func (void)
 	g_assert_cmpint (array->len, ==, 1);
 	g_ptr_array_unref (array);
 
+	/* ensure we can find it using the provide index */
+	depend = zif_depend_new ();
+	zif_depend_set_flag (depend, ZIF_DEPEND_FLAG_ANY);
+	zif_depend_set_name (depend, "Test(Interface)");
+	depend_array = zif_object_array_new ();
+	zif_object_array_add (depend_array, depend);
+	zif_state_reset (state);
+	array = zif_store_what_provides (store, depend_array, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 1);
+	g_ptr_array_unref (array);
+
 	/* delete from array */
 	ret = zif_store_remove_package (store, pkg, &error);
 	g_assert_no_error (error);
 	g_assert (ret);
 
+	/* ensure the provide index was invalidated */
+	zif_state_reset (state);
+	array = zif_store_what_provides (store, depend_array, state, &error);
+	g_assert_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_ARRAY_IS_EMPTY);
+	g_assert (array == NULL);
+	g_clear_error (&error);
+	g_ptr_array_unref (depend_array);
+	g_object_unref (depend);
+
 	/* delete from array, again */
 	ret = zif_store_remove_package (store, pkg, &error);
 	g_assert_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED);
@@ -3763,6 +5049,399 @@ zif_store_meta_func (void)
 	g_assert (store == NULL);
 }
 
+/**
+ * zif_test_store_array_config_new:
+ *
+ * Sets up the config shared by the store array tests, where each
+ * remote store has its own copy of the fedora metadata.
+ **/
+static ZifConfig *
+zif_test_store_array_config_new (void)
+{
+	gboolean ret;
+	gchar *filename;
+	GError *error = NULL;
+	ZifConfig *config;
+
+	config = zif_config_new ();
+	filename = zif_test_get_data_file ("zif.conf");
+	ret = zif_config_set_filename (config, filename, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+	zif_config_set_uint (config, "metadata_expire", 0, NULL);
+	zif_config_set_uint (config, "mirrorlist_expire", 0, NULL);
+	filename = g_build_filename (zif_tmpdir, "zif.lock", NULL);
+	zif_config_set_string (config, "pidfile", filename, NULL);
+	g_free (filename);
+	filename = g_build_filename (zif_tmpdir, "stores", NULL);
+	zif_config_set_string (config, "cachedir", filename, NULL);
+	g_free (filename);
+	return config;
+}
+
+/**
+ * zif_test_store_array_remote_new:
+ *
+ * Creates a remote store from one of the test repo files, using a copy
+ * of the fedora metadata in the cachedir set by
+ * zif_test_store_array_config_new().
+ **/
+static ZifStore *
+zif_test_store_array_remote_new (const gchar *repo_filename,
+				 const gchar *id,
+				 ZifState *state)
+{
+	const gchar *tmp;
+	gboolean ret;
+	gchar *data;
+	gchar *directory;
+	gchar *filename;
+	gchar *source;
+	GDir *dir;
+	GError *error = NULL;
+	gsize len;
+	ZifStore *store;
+
+	/* copy the metadata */
+	source = zif_test_get_data_file ("fedora");
+	directory = g_build_filename (zif_tmpdir, "stores", id, NULL);
+	g_assert_cmpint (g_mkdir_with_parents (directory, 0700), ==, 0);
+	dir = g_dir_open (source, 0, &error);
+	g_assert_no_error (error);
+	g_assert (dir != NULL);
+	while ((tmp = g_dir_read_name (dir)) != NULL) {
+		filename = g_build_filename (source, tmp, NULL);
+		ret = g_file_get_contents (filename, &data, &len, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		g_free (filename);
+		filename = g_build_filename (directory, tmp, NULL);
+		ret = g_file_set_contents (filename, data, len, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		g_free (filename);
+		g_free (data);
+	}
+	g_dir_close (dir);
+	g_free (directory);
+	g_free (source);
+
+	store = zif_store_remote_new ();
+	filename = zif_test_get_data_file (repo_filename);
+	ret = zif_store_remote_set_from_file (ZIF_STORE_REMOTE (store),
+					      filename, id, state, &error);
+	g_free (filename);
+	g_assert_no_error (error);
+	g_assert (ret);
+	return store;
+}
+
+static void
+zif_store_array_updates_func (void)
+{
+	gboolean ret;
+	gchar *tmp;
+	GError *error = NULL;
+	GPtrArray *array;
+	GPtrArray *store_array;
+	GTimer *timer;
+	guint i;
+	ZifConfig *config;
+	ZifPackage *package;
+	ZifState *state;
+	ZifStore *store_installed;
+	ZifStore *store_meta;
+	ZifStore *store_remote;
+
+	config = zif_test_store_array_config_new ();
+	g_object_add_weak_pointer (G_OBJECT (config), (gpointer *) &config);
+
+	state = zif_state_new ();
+	g_object_add_weak_pointer (G_OBJECT (state), (gpointer *) &state);
+
+	/* use the fedora metadata as one of the remote stores */
+	store_remote = zif_test_store_array_remote_new ("repos/fedora.repo", "fedora", state);
+
+	/* an older gnome-power-manager is installed */
+	store_installed = zif_store_meta_new ();
+	zif_store_meta_set_is_local (ZIF_STORE_META (store_installed), TRUE);
+	package = zif_package_meta_new ();
+	ret = zif_package_set_id (package, "gnome-power-manager;2.30.0-1.fc13;i686;installed", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_store_add_package (store_installed, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (package);
+
+	/* add lots of installed packages that have two newer versions */
+	store_meta = zif_store_meta_new ();
+	for (i = 0; i < 3000; i++) {
+		tmp = g_strdup_printf ("test%04i;0.1-1.fc13;i686;installed", i);
+		package = zif_package_meta_new ();
+		zif_package_set_id (package, tmp, NULL);
+		zif_store_add_package (store_installed, package, NULL);
+		g_object_unref (package);
+		g_free (tmp);
+
+		tmp = g_strdup_printf ("test%04i;0.2-1.fc13;i686;meta", i);
+		package = zif_package_meta_new ();
+		zif_package_set_id (package, tmp, NULL);
+		zif_store_add_package (store_meta, package, NULL);
+		g_object_unref (package);
+		g_free (tmp);
+
+		tmp = g_strdup_printf ("test%04i;0.3-1.fc13;i686;meta", i);
+		package = zif_package_meta_new ();
+		zif_package_set_id (package, tmp, NULL);
+		zif_store_add_package (store_meta, package, NULL);
+		g_object_unref (package);
+		g_free (tmp);
+	}
+
+	store_array = zif_store_array_new ();
+	zif_store_array_add_store (store_array, store_remote);
+	zif_store_array_add_store (store_array, store_meta);
+
+	/* get the updates, which should be linear in the number of packages */
+	timer = g_timer_new ();
+	zif_state_reset (state);
+	array = zif_store_array_get_updates (store_array, store_installed, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 3001);
+	g_debug ("took %.0lf ms to get 3001 updates", 1000 * g_timer_elapsed (timer, NULL));
+	g_timer_destroy (timer);
+
+	/* only the newest version is offered */
+	for (i = 0; i < array->len; i++) {
+		package = g_ptr_array_index (array, i);
+		if (g_str_has_prefix (zif_package_get_name (package), "test"))
+			g_assert_cmpstr (zif_package_get_version (package), ==, "0.3-1.fc13");
+		else
+			g_assert_cmpstr (zif_package_get_id (package), ==,
+					 "gnome-power-manager;2.30.1-1.fc13;i686;fedora");
+	}
+	g_ptr_array_unref (array);
+
+	g_ptr_array_unref (store_array);
+	g_object_unref (store_meta);
+	g_object_unref (store_remote);
+	g_object_unref (store_installed);
+	g_object_unref (state);
+	g_assert (state == NULL);
+	g_object_unref (config);
+	g_assert (config == NULL);
+}
+
+static void
+zif_store_array_search_parallel_func (void)
+{
+	const gchar *data;
+	const gchar *search[] = { "gnome-power-manager", NULL };
+	gboolean ret;
+	GError *error = NULL;
+	GHashTable *hash;
+	GPtrArray *array;
+	GPtrArray *array_parallel;
+	GPtrArray *store_array;
+	guint i;
+	guint len_fedora = 0;
+	guint len_updates = 0;
+	ZifConfig *config;
+	ZifPackage *package;
+	ZifState *state;
+	ZifStore *store_meta;
+	ZifStore *store_remote;
+	ZifStore *store_updates;
+
+	config = zif_test_store_array_config_new ();
+	g_object_add_weak_pointer (G_OBJECT (config), (gpointer *) &config);
+
+	state = zif_state_new ();
+	g_object_add_weak_pointer (G_OBJECT (state), (gpointer *) &state);
+
+	/* two remote stores with the same packages, so that more than one
+	 * is searched at the same time */
+	store_remote = zif_test_store_array_remote_new ("repos/fedora.repo", "fedora", state);
+	store_updates = zif_test_store_array_remote_new ("repos/fedora-updates.repo", "updates", state);
+
+	store_meta = zif_store_meta_new ();
+	package = zif_package_meta_new ();
+	ret = zif_package_set_id (package, "gnome-power-manager;2.31.0-1.fc13;i686;meta", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_store_add_package (store_meta, package, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_object_unref (package);
+
+	store_array = zif_store_array_new ();
+	zif_store_array_add_store (store_array, store_remote);
+	zif_store_array_add_store (store_array, store_updates);
+	zif_store_array_add_store (store_array, store_meta);
+
+	/* search each store in turn */
+	ret = zif_config_set_uint (config, "max_parallel_search", 1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	zif_state_reset (state);
+	array = zif_store_array_search_name (store_array, (gchar **) search, state, &error);
+	g_assert_no_error (error);
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, >, 1);
+
+	/* search the stores at the same time */
+	ret = zif_config_unset (config, "max_parallel_search", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = zif_config_set_uint (config, "max_parallel_search", 4, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	zif_state_reset (state);
+	array_parallel = zif_store_array_search_name (store_array, (gchar **) search, state, &error);
+	g_assert_no_error (error);
+	g_assert (array_parallel != NULL);
+	g_assert_cmpint (zif_state_get_percentage (state), ==, 100);
+
+	/* the results are merged in the same order */
+	g_assert_cmpint (array_parallel->len, ==, array->len);
+	for (i = 0; i < array->len; i++) {
+		g_assert_cmpstr (zif_package_get_id (g_ptr_array_index (array_parallel, i)), ==,
+				 zif_package_get_id (g_ptr_array_index (array, i)));
+	}
+
+	/* each package is only returned once, with the stores in order */
+	hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < array_parallel->len; i++) {
+		package = g_ptr_array_index (array_parallel, i);
+		g_assert (g_hash_table_lookup (hash, zif_package_get_id (package)) == NULL);
+		g_hash_table_insert (hash,
+				     (gpointer) zif_package_get_id (package),
+				     package);
+		data = zif_package_get_data (package);
+		if (g_strcmp0 (data, "fedora") == 0) {
+			g_assert_cmpint (len_updates, ==, 0);
+			len_fedora++;
+		} else if (g_strcmp0 (data, "updates") == 0) {
+			len_updates++;
+		} else {
+			g_assert_cmpint (i, ==, array_parallel->len - 1);
+			g_assert_cmpstr (zif_package_get_id (package), ==,
+					 "gnome-power-manager;2.31.0-1.fc13;i686;meta");
+		}
+	}
+	g_assert_cmpint (len_fedora, >, 0);
+	g_assert_cmpint (len_updates, ==, len_fedora);
+	g_hash_table_unref (hash);
+	g_ptr_array_unref (array);
+	g_ptr_array_unref (array_parallel);
+
+	g_ptr_array_unref (store_array);
+	g_object_unref (store_meta);
+	g_object_unref (store_updates);
+	g_object_unref (store_remote);
+	g_object_unref (state);
+	g_assert (state == NULL);
+	g_object_unref (config);
+	g_assert (config == NULL);
+}
+
+static guint _refresh_errors = 0;
+
+static gboolean
+zif_store_array_refresh_error_cb (const GError *error, gpointer user_data)
+{
+	g_debug ("refresh error: %s", error->message);
+	_refresh_errors++;
+	return GPOINTER_TO_UINT (user_data);
+}
+
+static void
+zif_store_array_refresh_parallel_func (void)
+{
+	gboolean ret;
+	gchar *filename;
+	gchar *repo;
+	GError *error = NULL;
+	GPtrArray *store_array;
+	ZifConfig *config;
+	ZifState *state;
+	ZifStoreRemote *store1;
+	ZifStoreRemote *store2;
+
+	config = zif_test_store_array_config_new ();
+	g_object_add_weak_pointer (G_OBJECT (config), (gpointer *) &config);
+	g_assert (zif_config_set_boolean (config, "network", TRUE, NULL));
+	g_assert (zif_config_set_boolean (config, "skip_if_unavailable", FALSE, NULL));
+	g_assert (zif_config_set_uint (config, "max_parallel_refresh", 2, NULL));
+	g_assert (zif_config_set_uint (config, "max_parallel_refresh_per_host", 2, NULL));
+
+	state = zif_state_new ();
+	g_object_add_weak_pointer (G_OBJECT (state), (gpointer *) &state);
+
+	/* two stores that cannot be refreshed */
+	filename = g_build_filename (zif_tmpdir, "refresh-broken.repo", NULL);
+	repo = g_strdup_printf ("[broken1]\n"
+				"name=Broken 1\n"
+				"baseurl=file://%s/missing1\n"
+				"enabled=true\n"
+				"[broken2]\n"
+				"name=Broken 2\n"
+				"baseurl=file://%s/missing2\n"
+				"enabled=true\n",
+				zif_tmpdir, zif_tmpdir);
+	ret = g_file_set_contents (filename, repo, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_free (repo);
+	store1 = ZIF_STORE_REMOTE (zif_store_remote_new ());
+	ret = zif_store_remote_set_from_file (store1, filename, "broken1", state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	store2 = ZIF_STORE_REMOTE (zif_store_remote_new ());
+	ret = zif_store_remote_set_from_file (store2, filename, "broken2", state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_free (filename);
+	store_array = zif_store_array_new ();
+	zif_store_array_add_store (store_array, ZIF_STORE (store1));
+	zif_store_array_add_store (store_array, ZIF_STORE (store2));
+
+	/* the error handler refuses, so the refresh fails */
+	_refresh_errors = 0;
+	zif_state_set_error_handler (state,
+				     zif_store_array_refresh_error_cb,
+				     GUINT_TO_POINTER (FALSE));
+	zif_state_reset (state);
+	ret = zif_store_array_refresh (store_array, TRUE, state, &error);
+	g_assert_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED);
+	g_assert (!ret);
+	g_clear_error (&error);
+	g_assert_cmpint (_refresh_errors, >=, 1);
+
+	/* the error handler skips both stores */
+	_refresh_errors = 0;
+	zif_state_set_error_handler (state,
+				     zif_store_array_refresh_error_cb,
+				     GUINT_TO_POINTER (TRUE));
+	zif_state_reset (state);
+	ret = zif_store_array_refresh (store_array, TRUE, state, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (_refresh_errors, >=, 2);
+	g_assert_cmpint (zif_state_get_percentage (state), ==, 100);
+
+	g_ptr_array_unref (store_array);
+	g_object_unref (store1);
+	g_object_unref (store2);
+	g_object_unref (state);
+	g_assert (state == NULL);
+	g_object_unref (config);
+	g_assert (config == NULL);
+}
+
 static void
 zif_store_remote_func (void)
 {
@@ -4172,10 +5851,28 @@ zif_store_rhn_func (void)
 	g_assert (config == NULL);
 }
 
+static gpointer
+zif_string_thread_cb (gpointer user_data)
+{
+	guint i;
+	ZifString *string = (ZifString *) user_data;
+	for (i = 0; i < 100000; i++) {
+		zif_string_ref (string);
+		zif_string_unref (string);
+	}
+	return NULL;
+}
+
 static void
 zif_string_func (void)
 {
+	GThread *threads[4];
+	guint i;
+	guint hits, hits2;
+	guint lookups, lookups2;
+	guint size, size2;
 	ZifString *string;
+	ZifString *string2;
 	string = zif_string_new ("kernel");
 	g_assert_cmpstr (zif_string_get_value (string), ==, "kernel");
 	zif_string_ref (string);
@@ -4183,6 +5880,35 @@ zif_string_func (void)
 	g_assert_cmpstr (zif_string_get_value (string), ==, "kernel");
 	string = zif_string_unref (string);
 	g_assert (string == NULL);
+
+	/* interned strings with the same value are shared */
+	zif_string_get_pool_stats (&size, &lookups, &hits);
+	string = zif_string_new_intern ("zif-self-test-intern");
+	g_assert (zif_string_is_interned (string));
+	string2 = zif_string_new_intern ("zif-self-test-intern");
+	g_assert (string == string2);
+	zif_string_get_pool_stats (&size2, &lookups2, &hits2);
+	g_assert_cmpint (size2, ==, size + 1);
+	g_assert_cmpint (lookups2, ==, lookups + 2);
+	g_assert_cmpint (hits2, ==, hits + 1);
+
+	/* the pool is emptied when the last reference is dropped */
+	g_assert (zif_string_unref (string2) != NULL);
+	g_assert (zif_string_unref (string) == NULL);
+	zif_string_get_pool_stats (&size2, NULL, NULL);
+	g_assert_cmpint (size2, ==, size);
+
+	/* normal strings are never shared */
+	string = zif_string_new ("zif-self-test-intern");
+	g_assert (!zif_string_is_interned (string));
+
+	/* but can be used from many threads at once */
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		threads[i] = g_thread_new ("zif-string", zif_string_thread_cb, string);
+	for (i = 0; i < G_N_ELEMENTS (threads); i++)
+		g_thread_join (threads[i]);
+	g_assert_cmpstr (zif_string_get_value (string), ==, "zif-self-test-intern");
+	g_assert (zif_string_unref (string) == NULL);
 }
 
 static void
@@ -4207,6 +5933,102 @@ zif_update_info_func (void)
 	g_object_unref (update_info);
 }
 
+/**
+ * zif_vercmp_random_string:
+ **/
+static gchar *
+zif_vercmp_random_string (GRand *rand)
+{
+	static const gchar chars[] = "00019aaZz.-_~^+";
+	gchar *str;
+	guint i;
+	guint len;
+
+	len = g_rand_int_range (rand, 0, 9);
+	str = g_new0 (gchar, len + 1);
+	for (i = 0; i < len; i++)
+		str[i] = chars[g_rand_int_range (rand, 0, sizeof (chars) - 1)];
+	return str;
+}
+
+static void
+zif_vercmp_func (void)
+{
+	gchar *a;
+	gchar *b;
+	gint val;
+	gint val_rpm;
+	GRand *rand;
+	guint i;
+	ZifEvr *evr_a;
+	ZifEvr *evr_b;
+
+	/* the usual suspects */
+	g_assert_cmpint (zif_vercmp ("1.0", "1.0"), ==, 0);
+	g_assert_cmpint (zif_vercmp ("1.0", "1.1"), ==, -1);
+	g_assert_cmpint (zif_vercmp ("1.10", "1.9"), ==, 1);
+	g_assert_cmpint (zif_vercmp ("1.010", "1.10"), ==, 0);
+	g_assert_cmpint (zif_vercmp ("1.0a", "1.0"), ==, 1);
+	g_assert_cmpint (zif_vercmp ("1.0", "1.0a"), ==, -1);
+	g_assert_cmpint (zif_vercmp ("1a", "1.1"), ==, -1);
+	g_assert_cmpint (zif_vercmp ("2.0", "2_0"), ==, 0);
+	g_assert_cmpint (zif_vercmp ("fc15", "fc9"), ==, 1);
+	g_assert_cmpint (zif_vercmp ("abc", "abd"), ==, -1);
+
+	/* this has to be exactly what rpm does, whatever version is
+	 * installed, so compare it with random versions */
+	rand = g_rand_new_with_seed (0x7a1f);
+	for (i = 0; i < 100000; i++) {
+		a = zif_vercmp_random_string (rand);
+		b = zif_vercmp_random_string (rand);
+		val = zif_vercmp (a, b);
+		val_rpm = rpmvercmp (a, b);
+		if (val != val_rpm)
+			g_error ("'%s' vs '%s' was %i, rpm says %i", a, b, val, val_rpm);
+		g_free (a);
+		g_free (b);
+	}
+
+	/* pre-split versions are the same as splitting each time */
+	for (i = 0; i < 10000; i++) {
+		a = g_strdup_printf ("%s%i:%s-%s",
+				     g_rand_boolean (rand) ? "" : "0",
+				     g_rand_int_range (rand, 0, 2),
+				     "1.0",
+				     g_rand_boolean (rand) ? "1.fc15" : "2");
+		b = zif_vercmp_random_string (rand);
+		evr_a = zif_evr_new (a);
+		evr_b = zif_evr_new (b);
+		g_assert_cmpint (zif_evr_compare (evr_a, evr_b, ZIF_PACKAGE_COMPARE_MODE_VERSION), ==,
+				 zif_compare_evr_full (a, b, ZIF_PACKAGE_COMPARE_MODE_VERSION));
+		g_assert_cmpint (zif_evr_compare (evr_b, evr_a, ZIF_PACKAGE_COMPARE_MODE_DISTRO), ==,
+				 zif_compare_evr_full (b, a, ZIF_PACKAGE_COMPARE_MODE_DISTRO));
+		zif_evr_unref (evr_a);
+		zif_evr_unref (evr_b);
+		g_free (a);
+		g_free (b);
+	}
+	g_rand_free (rand);
+
+	/* interned versions are shared */
+	evr_a = zif_evr_intern ("1:2.3-4");
+	evr_b = zif_evr_intern ("1:2.3-4");
+	g_assert (evr_a == evr_b);
+	g_assert_cmpstr (evr_a->value, ==, "1:2.3-4");
+	g_assert_cmpstr (evr_a->epoch, ==, "1");
+	g_assert_cmpstr (evr_a->release, ==, "4");
+	zif_evr_unref (evr_a);
+	zif_evr_unref (evr_b);
+
+	/* and freed when the last reference is dropped */
+	evr_a = zif_evr_intern ("1");
+	g_assert_cmpint (zif_evr_compare (NULL, evr_a, ZIF_PACKAGE_COMPARE_MODE_VERSION), ==, -1);
+	evr_b = zif_evr_ref (evr_a);
+	zif_evr_unref (evr_a);
+	g_assert_cmpstr (evr_b->version, ==, "1");
+	zif_evr_unref (evr_b);
+}
+
 static void
 zif_utils_func (void)
 {
@@ -4233,6 +6055,7 @@ zif_utils_func (void)
 	guint i;
 	guint se;
 	ZifState *state;
+	ZifStrMatcher *matcher;
 
 	state = zif_state_new ();
 	g_object_add_weak_pointer (G_OBJECT (state), (gpointer *) &state);
@@ -4352,6 +6175,45 @@ zif_utils_func (void)
 	g_assert_cmpint (zif_time_string_to_seconds ("10h"), ==, 36000);
 	g_assert_cmpint (zif_time_string_to_seconds ("10d"), ==, 864000);
 
+	/* glob with a literal prefix */
+	matcher = zif_str_matcher_new ("python3-*", ZIF_STR_MATCHER_KIND_GLOB, &error);
+	g_assert_no_error (error);
+	g_assert (matcher != NULL);
+	g_assert_cmpstr (zif_str_matcher_get_prefix (matcher), ==, "python3-");
+	g_assert (!zif_str_matcher_is_literal (matcher));
+	g_assert (zif_str_matcher_match (matcher, "python3-dbus"));
+	g_assert (!zif_str_matcher_match (matcher, "python-dbus"));
+	zif_str_matcher_free (matcher);
+
+	/* glob without wildcards */
+	matcher = zif_str_matcher_new ("kernel", ZIF_STR_MATCHER_KIND_GLOB, &error);
+	g_assert_no_error (error);
+	g_assert (zif_str_matcher_is_literal (matcher));
+	g_assert (zif_str_matcher_match (matcher, "kernel"));
+	g_assert (!zif_str_matcher_match (matcher, "kernel-devel"));
+	zif_str_matcher_free (matcher);
+
+	/* anchored regular expression */
+	matcher = zif_str_matcher_new ("^gnome-p.*r$", ZIF_STR_MATCHER_KIND_REGEX, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (zif_str_matcher_get_prefix (matcher), ==, "gnome-p");
+	g_assert (zif_str_matcher_match (matcher, "gnome-power-manager"));
+	g_assert (!zif_str_matcher_match (matcher, "gnome-packagekit"));
+	zif_str_matcher_free (matcher);
+
+	/* the last literal character is optional */
+	matcher = zif_str_matcher_new ("^gtk2?-", ZIF_STR_MATCHER_KIND_REGEX, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (zif_str_matcher_get_prefix (matcher), ==, "gtk");
+	g_assert (zif_str_matcher_match (matcher, "gtk-doc"));
+	zif_str_matcher_free (matcher);
+
+	/* invalid regular expression */
+	matcher = zif_str_matcher_new ("gnome-(", ZIF_STR_MATCHER_KIND_REGEX, &error);
+	g_assert (error != NULL);
+	g_assert (matcher == NULL);
+	g_clear_error (&error);
+
 	/* get the time it takes to split a million strings */
 	timer = g_timer_new ();
 	for (i = 0; i < iterations; i++) {
@@ -4692,6 +6554,7 @@ main (int argc, char **argv)
 
 	/* tests go here */
 	g_test_add_func ("/zif/utils", zif_utils_func);
+	g_test_add_func ("/zif/vercmp", zif_vercmp_func);
 	g_test_add_func ("/zif/state", zif_state_func);
 	g_test_add_func ("/zif/state[child]", zif_state_child_func);
 	g_test_add_func ("/zif/state[parent-1-step]", zif_state_parent_one_step_proxy_func);
@@ -4702,17 +6565,21 @@ main (int argc, char **argv)
 	g_test_add_func ("/zif/state[speed]", zif_state_speed_func);
 	g_test_add_func ("/zif/state[locking]", zif_state_locking_func);
 	g_test_add_func ("/zif/state[finished]", zif_state_finished_func);
+	g_test_add_func ("/zif/state[parallel]", zif_state_parallel_func);
 	g_test_add_func ("/zif/changeset", zif_changeset_func);
 	g_test_add_func ("/zif/config", zif_config_func);
 	g_test_add_func ("/zif/config[changed]", zif_config_changed_func);
 	g_test_add_func ("/zif/db", zif_db_func);
 	g_test_add_func ("/zif/depend", zif_depend_func);
 	g_test_add_func ("/zif/download", zif_download_func);
+	g_test_add_func ("/zif/file-index", zif_file_index_func);
 	g_test_add_func ("/zif/groups", zif_groups_func);
 	g_test_add_func ("/zif/history", zif_history_func);
 	g_test_add_func ("/zif/legal", zif_legal_func);
 	g_test_add_func ("/zif/lock", zif_lock_func);
 	g_test_add_func ("/zif/lock[threads]", zif_lock_threads_func);
+	g_test_add_func ("/zif/lock[shared]", zif_lock_shared_func);
+	g_test_add_func ("/zif/lock[process]", zif_lock_process_func);
 	g_test_add_func ("/zif/manifest", zif_manifest_func);
 	g_test_add_func ("/zif/md", zif_md_func);
 	g_test_add_func ("/zif/md-comps", zif_md_comps_func);
@@ -4731,15 +6598,22 @@ main (int argc, char **argv)
 	g_test_add_func ("/zif/package-meta", zif_package_meta_func);
 	g_test_add_func ("/zif/package", zif_package_func);
 	g_test_add_func ("/zif/package-array", zif_package_array_func);
+	g_test_add_func ("/zif/package-array[download]", zif_package_array_download_func);
 	g_test_add_func ("/zif/release", zif_release_func);
 	g_test_add_func ("/zif/repos", zif_repos_func);
+	g_test_add_func ("/zif/rpmdb-snapshot", zif_rpmdb_snapshot_func);
 	g_test_add_func ("/zif/store-local", zif_store_local_func);
 	g_test_add_func ("/zif/store-meta", zif_store_meta_func);
+	g_test_add_func ("/zif/store-array[updates]", zif_store_array_updates_func);
+	g_test_add_func ("/zif/store-array[search-parallel]", zif_store_array_search_parallel_func);
+	g_test_add_func ("/zif/store-array[refresh-parallel]", zif_store_array_refresh_parallel_func);
 	g_test_add_func ("/zif/store-remote", zif_store_remote_func);
 	g_test_add_func ("/zif/store-directory", zif_store_directory_func);
 	g_test_add_func ("/zif/store-rhn", zif_store_rhn_func);
 	g_test_add_func ("/zif/string", zif_string_func);
 	g_test_add_func ("/zif/transaction", zif_transaction_func);
+	g_test_add_func ("/zif/transaction[prefetch]", zif_transaction_prefetch_func);
+	g_test_add_func ("/zif/transaction[provide]", zif_transaction_provide_func);
 	g_test_add_func ("/zif/update-info", zif_update_info_func);
 	g_test_add_func ("/zif/update", zif_update_func);
 
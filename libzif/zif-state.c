@@ -83,6 +83,7 @@
 #include <signal.h>
 #include <rpm/rpmsq.h>
 
+#include "zif-config.h"
 #include "zif-utils.h"
 #include "zif-state-private.h"
 
@@ -125,6 +126,12 @@ struct _ZifStatePrivate
 	ZifState		*parent;
 	GPtrArray		*lock_ids;
 	ZifLock			*lock;
+	GMutex			 parallel_mutex;
+	GPtrArray		*parallel_children;
+	gint			*parallel_percentage;
+	guint64			*parallel_speed;
+	guint			 parallel_index;
+	gboolean		 parallel_child;
 };
 
 enum {
@@ -285,7 +292,7 @@ zif_state_set_lock_handler (ZifState *state,
  * @lock_mode: A #ZifLockMode, e.g. %ZIF_LOCK_MODE_PROCESS
  * @error: A #GError
  *
- * Takes a lock of a specified type.
+ * Takes an exclusive lock of a specified type.
  * The lock is automatically free'd when the ZifState has been completed.
  *
  * You can call zif_state_take_lock() multiple times with different or
@@ -300,16 +307,63 @@ zif_state_take_lock (ZifState *state,
 		     ZifLockType lock_type,
 		     ZifLockMode lock_mode,
 		     GError **error)
+{
+	return zif_state_take_lock_full (state,
+					 lock_type,
+					 lock_mode,
+					 ZIF_LOCK_ACCESS_EXCLUSIVE,
+					 error);
+}
+
+/**
+ * zif_state_take_lock_full:
+ * @state: A #ZifState
+ * @lock_type: A #ZifLockType, e.g. %ZIF_LOCK_TYPE_METADATA
+ * @lock_mode: A #ZifLockMode, e.g. %ZIF_LOCK_MODE_PROCESS
+ * @lock_access: A #ZifLockAccess, e.g. %ZIF_LOCK_ACCESS_SHARED
+ * @error: A #GError
+ *
+ * Takes a lock of a specified type, waiting for up to "lock_retries"
+ * times "lock_delay" ms if it is held by something else.
+ * The lock is automatically free'd when the ZifState has been completed.
+ *
+ * Return value: %FALSE if the lock is fatal, %TRUE otherwise
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_state_take_lock_full (ZifState *state,
+			  ZifLockType lock_type,
+			  ZifLockMode lock_mode,
+			  ZifLockAccess lock_access,
+			  GError **error)
 {
 	gboolean ret = TRUE;
+	guint lock_delay;
 	guint lock_id = 0;
+	guint lock_retries;
+	guint timeout;
+	ZifConfig *config;
 
 	/* no custom handler */
 	if (state->priv->lock_handler_cb == NULL) {
-		lock_id = zif_lock_take (state->priv->lock,
-					 lock_type,
-					 lock_mode,
-					 error);
+
+		/* wait as long as the retries would, not waiting is
+		 * the default if either is not set */
+		config = zif_config_new ();
+		lock_retries = zif_config_get_uint (config, "lock_retries", NULL);
+		lock_delay = zif_config_get_uint (config, "lock_delay", NULL);
+		timeout = 0;
+		if (lock_retries != G_MAXUINT && lock_delay != G_MAXUINT)
+			timeout = lock_retries * lock_delay;
+		g_object_unref (config);
+
+		lock_id = zif_lock_take_full (state->priv->lock,
+					      lock_type,
+					      lock_mode,
+					      lock_access,
+					      timeout,
+					      error);
 		if (lock_id == 0)
 			ret = FALSE;
 	} else {
@@ -567,6 +621,9 @@ zif_state_set_percentage (ZifState *state, guint percentage)
 			zif_state_print_parent_chain (state, 0);
 			g_critical ("percentage should not go down from %i to %i on %p!",
 				    state->priv->last_percentage, percentage, state);
+		} else {
+			g_warning ("percentage should not go down from %i to %i on %p",
+				   state->priv->last_percentage, percentage, state);
 		}
 		goto out;
 	}
@@ -993,6 +1050,30 @@ zif_state_child_package_progress_changed_cb (ZifState *child,
 		       package_id, action, progress);
 }
 
+/**
+ * zif_state_clear_parallel_children:
+ **/
+static void
+zif_state_clear_parallel_children (ZifState *state)
+{
+	guint i;
+	ZifState *child;
+
+	if (state->priv->parallel_children == NULL)
+		return;
+	for (i = 0; i < state->priv->parallel_children->len; i++) {
+		child = g_ptr_array_index (state->priv->parallel_children, i);
+		g_signal_handlers_disconnect_by_data (child, state);
+		child->priv->parent = NULL;
+	}
+	g_ptr_array_unref (state->priv->parallel_children);
+	g_free (state->priv->parallel_percentage);
+	g_free (state->priv->parallel_speed);
+	state->priv->parallel_children = NULL;
+	state->priv->parallel_percentage = NULL;
+	state->priv->parallel_speed = NULL;
+}
+
 /**
  * zif_state_reset:
  * @state: A #ZifState
@@ -1063,6 +1144,9 @@ zif_state_reset (ZifState *state)
 		state->priv->child = NULL;
 	}
 
+	/* disconnect and unref any parallel children */
+	zif_state_clear_parallel_children (state);
+
 	/* no more locks */
 	zif_state_release_locks (state);
 
@@ -1200,6 +1284,9 @@ zif_state_get_child (ZifState *state)
 	zif_state_set_enable_profile (child,
 				      state->priv->enable_profile);
 
+	/* anything below a parallel child is also run from a worker thread */
+	child->priv->parallel_child = state->priv->parallel_child;
+
 	/* set the mainloop clearing */
 	zif_state_set_process_event_sources (child,
 				         state->priv->process_event_sources);
@@ -1207,6 +1294,160 @@ out:
 	return child;
 }
 
+/**
+ * zif_state_parallel_percentage_changed_cb:
+ **/
+static void
+zif_state_parallel_percentage_changed_cb (ZifState *child,
+					  guint percentage,
+					  ZifState *state)
+{
+	guint i;
+	guint len;
+	guint total = 0;
+
+	/* save this child's progress without blocking the other workers */
+	g_atomic_int_set (&state->priv->parallel_percentage[child->priv->parallel_index],
+			  (gint) percentage);
+
+	/* only one worker may emit up the parent chain at a time; a child
+	 * that was reset to retry makes the average drop, so ignore that */
+	g_mutex_lock (&state->priv->parallel_mutex);
+	len = state->priv->parallel_children->len;
+	for (i = 0; i < len; i++)
+		total += g_atomic_int_get (&state->priv->parallel_percentage[i]);
+	if (total / len > state->priv->last_percentage)
+		zif_state_set_percentage (state, total / len);
+	g_mutex_unlock (&state->priv->parallel_mutex);
+}
+
+/**
+ * zif_state_parallel_package_progress_changed_cb:
+ **/
+static void
+zif_state_parallel_package_progress_changed_cb (ZifState *child,
+						const gchar *package_id,
+						ZifStateAction action,
+						guint progress,
+						ZifState *state)
+{
+	g_mutex_lock (&state->priv->parallel_mutex);
+	g_signal_emit (state, signals [SIGNAL_PACKAGE_PROGRESS_CHANGED], 0,
+		       package_id, action, progress);
+	g_mutex_unlock (&state->priv->parallel_mutex);
+}
+
+/**
+ * zif_state_parallel_notify_speed_cb:
+ **/
+static void
+zif_state_parallel_notify_speed_cb (ZifState *child,
+				    GParamSpec *pspec,
+				    ZifState *state)
+{
+	guint i;
+	guint64 total = 0;
+
+	/* the children are running at the same time, so add them up */
+	g_mutex_lock (&state->priv->parallel_mutex);
+	state->priv->parallel_speed[child->priv->parallel_index] = zif_state_get_speed (child);
+	for (i = 0; i < state->priv->parallel_children->len; i++)
+		total += state->priv->parallel_speed[i];
+	zif_state_set_speed_internal (state, total);
+	g_mutex_unlock (&state->priv->parallel_mutex);
+}
+
+/**
+ * zif_state_get_children:
+ * @state: A #ZifState
+ * @number_children: The number of child states to create, which must be > 0
+ *
+ * Splits the state into @number_children independent child states that
+ * can each be driven from a different thread at the same time.
+ *
+ * The percentage of @state is the average of the children, and the
+ * speed is the sum of the children. Signals on @state are emitted from
+ * whichever worker thread made progress, but never from two threads at
+ * the same time. All the children share the #GCancellable of @state, so
+ * cancelling it stops every child at the next zif_state_done().
+ *
+ * Child states do not propagate "action-changed" or
+ * "allow-cancel-changed", and never process the main loop. @state
+ * itself should not be used while the children are in use, nor should
+ * it hold any locks. The children are owned by @state and are released
+ * when it is reset, so use zif_state_done() on the parent of @state as
+ * usual once all the worker threads have finished.
+ *
+ * Return value: (transfer container): An array of #ZifState children
+ *
+ * Since: 0.3.7
+ **/
+GPtrArray *
+zif_state_get_children (ZifState *state, guint number_children)
+{
+	GPtrArray *array;
+	guint i;
+	ZifState *child;
+
+	g_return_val_if_fail (ZIF_IS_STATE (state), NULL);
+	g_return_val_if_fail (number_children > 0, NULL);
+
+	/* set cancellable, creating if required */
+	if (state->priv->cancellable == NULL)
+		state->priv->cancellable = g_cancellable_new ();
+
+	/* remove any old children */
+	zif_state_clear_parallel_children (state);
+	state->priv->parallel_children = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	state->priv->parallel_percentage = g_new0 (gint, number_children);
+	state->priv->parallel_speed = g_new0 (guint64, number_children);
+
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (i = 0; i < number_children; i++) {
+		child = zif_state_new ();
+		child->priv->parallel_index = i;
+		child->priv->parallel_child = TRUE;
+		zif_state_set_report_progress (child, state->priv->report_progress);
+		zif_state_set_cancellable (child, state->priv->cancellable);
+		zif_state_set_enable_profile (child, state->priv->enable_profile);
+
+		/* each child is only a fraction of the parent */
+		zif_state_set_global_share (child,
+					    state->priv->global_share / number_children);
+
+		/* set the error handler if one exists on the child */
+		if (state->priv->error_handler_cb != NULL) {
+			zif_state_set_error_handler (child,
+						     state->priv->error_handler_cb,
+						     state->priv->error_handler_user_data);
+		}
+
+		/* set the lock handler if one exists on the child */
+		if (state->priv->lock_handler_cb != NULL) {
+			zif_state_set_lock_handler (child,
+						    state->priv->lock_handler_cb,
+						    state->priv->lock_handler_user_data);
+		}
+
+		/* connect up signals */
+		if (state->priv->report_progress) {
+			child->priv->parent = state; /* do not ref! */
+			g_signal_connect (child, "percentage-changed",
+					  G_CALLBACK (zif_state_parallel_percentage_changed_cb),
+					  state);
+			g_signal_connect (child, "package-progress-changed",
+					  G_CALLBACK (zif_state_parallel_package_progress_changed_cb),
+					  state);
+			g_signal_connect (child, "notify::speed",
+					  G_CALLBACK (zif_state_parallel_notify_speed_cb),
+					  state);
+		}
+		g_ptr_array_add (state->priv->parallel_children, child);
+		g_ptr_array_add (array, g_object_ref (child));
+	}
+	return array;
+}
+
 static gboolean
 zif_state_cancel_on_signal_cb (gpointer user_data)
 {
@@ -1463,6 +1704,9 @@ zif_state_show_profile (ZifState *state)
  * It's probably not a good idea to set @run to %TRUE when the calling
  * program has a mainloop, or unexpected things might happen.
  *
+ * This cannot be set on states returned by zif_state_get_children() or
+ * on their children, as they are run from worker threads.
+ *
  * Return value: %TRUE for success, %FALSE otherwise
  *
  * Since: 0.2.6
@@ -1471,6 +1715,12 @@ void
 zif_state_set_process_event_sources (ZifState *state, gboolean run)
 {
 	g_return_if_fail (ZIF_IS_STATE (state));
+
+	/* the default context belongs to the main thread */
+	if (run && state->priv->parallel_child) {
+		g_warning ("parallel child %p cannot process the main loop", state);
+		return;
+	}
 	state->priv->process_event_sources = run;
 }
 
@@ -1682,6 +1932,8 @@ zif_state_finalize (GObject *object)
 	g_free (state->priv->speed_data);
 	g_ptr_array_unref (state->priv->lock_ids);
 	g_object_unref (state->priv->lock);
+	zif_state_clear_parallel_children (state);
+	g_mutex_clear (&state->priv->parallel_mutex);
 
 	G_OBJECT_CLASS (zif_state_parent_class)->finalize (object);
 }
@@ -1808,6 +2060,7 @@ zif_state_init (ZifState *state)
 	state->priv->report_progress = TRUE;
 	state->priv->lock = zif_lock_new ();
 	state->priv->speed_data = g_new0 (guint64, ZIF_STATE_SPEED_SMOOTHING_ITEMS);
+	g_mutex_init (&state->priv->parallel_mutex);
 }
 
 /**
@@ -118,6 +118,8 @@ GType		 zif_state_get_type			(void);
 GQuark		 zif_state_error_quark			(void);
 ZifState	*zif_state_new				(void);
 ZifState	*zif_state_get_child			(ZifState		*state);
+GPtrArray	*zif_state_get_children			(ZifState		*state,
+							 guint			 number_children);
 
 /* percentage changed */
 void		 zif_state_set_report_progress		(ZifState		*state,
@@ -185,6 +187,11 @@ gboolean	 zif_state_take_lock			(ZifState		*state,
 							 ZifLockType		 lock_type,
 							 ZifLockMode		 lock_mode,
 							 GError			**error);
+gboolean	 zif_state_take_lock_full		(ZifState		*state,
+							 ZifLockType		 lock_type,
+							 ZifLockMode		 lock_mode,
+							 ZifLockAccess		 lock_access,
+							 GError			**error);
 
 G_END_DECLS
 
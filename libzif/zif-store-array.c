@@ -35,11 +35,13 @@
 #endif
 
 #include <glib.h>
+#include <string.h>
 
 #include "zif-config.h"
 #include "zif-state.h"
 #include "zif-store.h"
 #include "zif-store-local.h"
+#include "zif-store-remote.h"
 #include "zif-store-array.h"
 #include "zif-package.h"
 #include "zif-package-array.h"
@@ -289,6 +291,254 @@ out:
 	return ret;
 }
 
+/**
+ * zif_store_array_repos_search_store:
+ **/
+static GPtrArray *
+zif_store_array_repos_search_store (ZifStore *store,
+				    ZifRole role,
+				    gpointer search,
+				    guint flags,
+				    ZifState *state,
+				    GError **error)
+{
+	GPtrArray *part = NULL;
+
+	if (role == ZIF_ROLE_RESOLVE)
+		part = zif_store_resolve_full (store, (gchar**)search, flags, state, error);
+	else if (role == ZIF_ROLE_SEARCH_NAME)
+		part = zif_store_search_name (store, (gchar**)search, state, error);
+	else if (role == ZIF_ROLE_SEARCH_DETAILS)
+		part = zif_store_search_details (store, (gchar**)search, state, error);
+	else if (role == ZIF_ROLE_SEARCH_GROUP)
+		part = zif_store_search_group (store, (gchar**)search, state, error);
+	else if (role == ZIF_ROLE_SEARCH_CATEGORY)
+		part = zif_store_search_category (store, (gchar**)search, state, error);
+	else if (role == ZIF_ROLE_SEARCH_FILE)
+		part = zif_store_search_file (store, (gchar**)search, state, error);
+	else if (role == ZIF_ROLE_GET_PACKAGES)
+		part = zif_store_get_packages (store, state, error);
+	else if (role == ZIF_ROLE_WHAT_PROVIDES)
+		part = zif_store_what_provides (store, (GPtrArray*) search, state, error);
+	else if (role == ZIF_ROLE_WHAT_REQUIRES)
+		part = zif_store_what_requires (store, (GPtrArray*) search, state, error);
+	else if (role == ZIF_ROLE_WHAT_OBSOLETES)
+		part = zif_store_what_obsoletes (store, (GPtrArray*) search, state, error);
+	else if (role == ZIF_ROLE_WHAT_CONFLICTS)
+		part = zif_store_what_conflicts (store, (GPtrArray*) search, state, error);
+	else if (role == ZIF_ROLE_GET_CATEGORIES)
+		part = zif_store_get_categories (store, state, error);
+	else {
+		g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
+			     "internal error, no such role: %s", zif_role_to_string (role));
+	}
+	return part;
+}
+
+/**
+ * zif_store_array_repos_search_skip_error:
+ *
+ * Returns %TRUE if the store should just be ignored.
+ **/
+static gboolean
+zif_store_array_repos_search_skip_error (ZifStore *store,
+					 const GError *error,
+					 ZifState *state)
+{
+	/* the store get disabled whilst being used */
+	if (g_error_matches (error,
+			     ZIF_STORE_ERROR,
+			     ZIF_STORE_ERROR_NOT_ENABLED)) {
+		g_debug ("repo %s disabled whilst being used: %s",
+			 zif_store_get_id (store),
+			 error->message);
+		return TRUE;
+	}
+
+	/* do we need to skip this error */
+	return zif_state_error_handler (state, error);
+}
+
+typedef struct {
+	ZifStore		*store;
+	ZifState		*state;
+	ZifRole			 role;
+	gpointer		 search;
+	guint			 flags;
+	GPtrArray		*part;
+	GError			*error;
+} ZifStoreArraySearchItem;
+
+/**
+ * zif_store_array_repos_search_thread_cb:
+ *
+ * This is called in a thread from the pool.
+ **/
+static void
+zif_store_array_repos_search_thread_cb (gpointer data, gpointer user_data)
+{
+	ZifStoreArraySearchItem *item = (ZifStoreArraySearchItem *) data;
+	item->part = zif_store_array_repos_search_store (item->store,
+							 item->role,
+							 item->search,
+							 item->flags,
+							 item->state,
+							 &item->error);
+}
+
+/**
+ * zif_store_array_repos_search_lock_cb:
+ *
+ * The lock is held by the thread that started the search.
+ **/
+static gboolean
+zif_store_array_repos_search_lock_cb (ZifState *state,
+				      ZifLock *lock,
+				      ZifLockType lock_type,
+				      GError **error,
+				      gpointer user_data)
+{
+	return TRUE;
+}
+
+/**
+ * zif_store_array_repos_search_parallel:
+ *
+ * Queries each enabled remote store from a thread pool, as each one
+ * has its own database connection. Any other stores are queried in the
+ * calling thread while the pool is busy. The results are merged in the
+ * same order as @store_array, so the output is the same as doing each
+ * store in turn.
+ **/
+static GPtrArray *
+zif_store_array_repos_search_parallel (GPtrArray *store_array,
+				       ZifRole role,
+				       gpointer search,
+				       guint flags,
+				       guint max_parallel,
+				       ZifState *state,
+				       GError **error)
+{
+	gboolean ret;
+	GError *error_local = NULL;
+	GPtrArray *array = NULL;
+	GPtrArray *children = NULL;
+	GPtrArray *items = NULL;
+	GThreadPool *pool;
+	guint i, j;
+	ZifPackage *package;
+	ZifState *state_local;
+	ZifStoreArraySearchItem *item;
+
+	/* the children only ever get us to 95%, so that the lock is
+	 * released by this thread in the final zif_state_done() */
+	ret = zif_state_set_steps (state,
+				   error,
+				   95, /* search */
+				   5, /* merge */
+				   -1);
+	if (!ret)
+		goto out;
+
+	/* the threads all share this lock */
+	ret = zif_state_take_lock_full (state,
+					ZIF_LOCK_TYPE_METADATA,
+					ZIF_LOCK_MODE_PROCESS,
+					ZIF_LOCK_ACCESS_SHARED,
+					error);
+	if (!ret)
+		goto out;
+
+	/* each store gets its own progress */
+	state_local = zif_state_get_child (state);
+	children = zif_state_get_children (state_local, store_array->len);
+	items = g_ptr_array_new_with_free_func (g_free);
+	pool = g_thread_pool_new (zif_store_array_repos_search_thread_cb,
+				  NULL, max_parallel, FALSE, NULL);
+	for (i = 0; i < store_array->len; i++) {
+		item = g_new0 (ZifStoreArraySearchItem, 1);
+		item->store = g_ptr_array_index (store_array, i);
+		item->state = g_ptr_array_index (children, i);
+		item->role = role;
+		item->search = search;
+		item->flags = flags;
+		g_ptr_array_add (items, item);
+		if (!zif_store_get_enabled (item->store))
+			continue;
+		if (!ZIF_IS_STORE_REMOTE (item->store))
+			continue;
+		zif_state_set_lock_handler (item->state,
+					    zif_store_array_repos_search_lock_cb,
+					    NULL);
+		g_thread_pool_push (pool, item, NULL);
+	}
+
+	/* do the other stores while we wait, as librpm is not threadsafe */
+	for (i = 0; i < items->len; i++) {
+		item = g_ptr_array_index (items, i);
+		if (!zif_store_get_enabled (item->store))
+			continue;
+		if (ZIF_IS_STORE_REMOTE (item->store))
+			continue;
+		zif_store_array_repos_search_thread_cb (item, NULL);
+	}
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	/* merge in store order, failing on the first fatal error */
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (i = 0; i < items->len; i++) {
+		item = g_ptr_array_index (items, i);
+		if (item->part == NULL) {
+			if (item->error == NULL)
+				continue;
+			if (error_local == NULL &&
+			    !zif_store_array_repos_search_skip_error (item->store,
+								      item->error,
+								      state)) {
+				g_propagate_prefixed_error (&error_local,
+							    item->error,
+							    "failed to %s in %s: ",
+							    zif_role_to_string (role),
+							    zif_store_get_id (item->store));
+				item->error = NULL;
+				continue;
+			}
+			g_clear_error (&item->error);
+			continue;
+		}
+		for (j = 0; j < item->part->len; j++) {
+			package = g_ptr_array_index (item->part, j);
+			g_ptr_array_add (array, g_object_ref (package));
+		}
+		g_ptr_array_unref (item->part);
+	}
+	if (error_local != NULL) {
+		g_propagate_error (error, error_local);
+		g_ptr_array_unref (array);
+		array = NULL;
+		goto out;
+	}
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret) {
+		g_ptr_array_unref (array);
+		array = NULL;
+		goto out;
+	}
+out:
+	if (children != NULL)
+		g_ptr_array_unref (children);
+	if (items != NULL)
+		g_ptr_array_unref (items);
+	return array;
+}
+
 /**
  * zif_store_array_repos_search:
  **/
@@ -302,9 +552,11 @@ zif_store_array_repos_search (GPtrArray *store_array,
 {
 	gboolean ret;
 	guint i, j;
+	guint max_parallel;
 	GPtrArray *array = NULL;
 	GPtrArray *array_results = NULL;
 	GPtrArray *part;
+	ZifConfig *config;
 	ZifStore *store;
 	ZifPackage *package;
 	GError *error_local = NULL;
@@ -319,6 +571,28 @@ zif_store_array_repos_search (GPtrArray *store_array,
 		goto out;
 	}
 
+	/* query more than one store at a time, but not for the roles
+	 * that use the shared comps data */
+	config = zif_config_new ();
+	max_parallel = zif_config_get_uint (config, "max_parallel_search", NULL);
+	g_object_unref (config);
+	if (max_parallel > 1 && max_parallel != G_MAXUINT &&
+	    store_array->len > 1 &&
+	    role != ZIF_ROLE_SEARCH_GROUP &&
+	    role != ZIF_ROLE_SEARCH_CATEGORY &&
+	    role != ZIF_ROLE_GET_CATEGORIES) {
+		array = zif_store_array_repos_search_parallel (store_array,
+							       role,
+							       search,
+							       flags,
+							       max_parallel,
+							       state,
+							       error);
+		if (array == NULL)
+			goto out;
+		goto filter;
+	}
+
 	/* set number of stores */
 	zif_state_set_number_steps (state, store_array->len);
 
@@ -335,54 +609,16 @@ zif_store_array_repos_search (GPtrArray *store_array,
 		state_local = zif_state_get_child (state);
 
 		/* get results for this store */
-		if (role == ZIF_ROLE_RESOLVE)
-			part = zif_store_resolve_full (store, (gchar**)search, flags, state_local, &error_local);
-		else if (role == ZIF_ROLE_SEARCH_NAME)
-			part = zif_store_search_name (store, (gchar**)search, state_local, &error_local);
-		else if (role == ZIF_ROLE_SEARCH_DETAILS)
-			part = zif_store_search_details (store, (gchar**)search, state_local, &error_local);
-		else if (role == ZIF_ROLE_SEARCH_GROUP)
-			part = zif_store_search_group (store, (gchar**)search, state_local, &error_local);
-		else if (role == ZIF_ROLE_SEARCH_CATEGORY)
-			part = zif_store_search_category (store, (gchar**)search, state_local, &error_local);
-		else if (role == ZIF_ROLE_SEARCH_FILE)
-			part = zif_store_search_file (store, (gchar**)search, state_local, &error_local);
-		else if (role == ZIF_ROLE_GET_PACKAGES)
-			part = zif_store_get_packages (store, state_local, &error_local);
-		else if (role == ZIF_ROLE_WHAT_PROVIDES)
-			part = zif_store_what_provides (store, (GPtrArray*) search, state_local, &error_local);
-		else if (role == ZIF_ROLE_WHAT_REQUIRES)
-			part = zif_store_what_requires (store, (GPtrArray*) search, state_local, &error_local);
-		else if (role == ZIF_ROLE_WHAT_OBSOLETES)
-			part = zif_store_what_obsoletes (store, (GPtrArray*) search, state_local, &error_local);
-		else if (role == ZIF_ROLE_WHAT_CONFLICTS)
-			part = zif_store_what_conflicts (store, (GPtrArray*) search, state_local, &error_local);
-		else if (role == ZIF_ROLE_GET_CATEGORIES)
-			part = zif_store_get_categories (store, state_local, &error_local);
-		else {
-			g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
-				     "internal error, no such role: %s", zif_role_to_string (role));
-			goto out;
-		}
+		part = zif_store_array_repos_search_store (store,
+							   role,
+							   search,
+							   flags,
+							   state_local,
+							   &error_local);
 		if (part == NULL) {
-
-			/* the store get disabled whilst being used */
-			if (g_error_matches (error_local,
-					     ZIF_STORE_ERROR,
-					     ZIF_STORE_ERROR_NOT_ENABLED)) {
-				g_debug ("repo %s disabled whilst being used: %s",
-					 zif_store_get_id (store),
-					 error_local->message);
-				g_clear_error (&error_local);
-				ret = zif_state_finished (state_local, error);
-				if (!ret)
-					goto out;
-				goto skip_error;
-			}
-
-			/* do we need to skip this error */
-			ret = zif_state_error_handler (state, error_local);
-			if (ret) {
+			if (zif_store_array_repos_search_skip_error (store,
+								     error_local,
+								     state)) {
 				g_clear_error (&error_local);
 				ret = zif_state_finished (state_local, error);
 				if (!ret)
@@ -408,7 +644,7 @@ skip_error:
 		if (!ret)
 			goto out;
 	}
-
+filter:
 	/* we're done */
 	zif_package_array_filter_duplicates (array);
 	array_results = g_ptr_array_ref (array);
@@ -562,6 +798,297 @@ out:
 	return ret;
 }
 
+typedef struct {
+	GMutex			 mutex;
+	GCond			 cond;
+	gboolean		 force;
+} ZifStoreArrayRefreshHelper;
+
+typedef struct {
+	ZifStore		*store;
+	ZifState		*state;
+	gchar			*host;
+	GError			*error;
+	gboolean		 ret;
+	gboolean		 started;
+	gboolean		 finished;
+	gboolean		 reaped;
+	ZifStoreArrayRefreshHelper *helper;
+} ZifStoreArrayRefreshItem;
+
+/**
+ * zif_store_array_refresh_item_free:
+ **/
+static void
+zif_store_array_refresh_item_free (ZifStoreArrayRefreshItem *item)
+{
+	g_object_unref (item->store);
+	g_free (item->host);
+	if (item->error != NULL)
+		g_error_free (item->error);
+	g_free (item);
+}
+
+/**
+ * zif_store_array_refresh_get_host:
+ *
+ * Gets the server that will be contacted first when refreshing, so we
+ * don't hammer one mirror with lots of requests at the same time.
+ **/
+static gchar *
+zif_store_array_refresh_get_host (ZifStore *store)
+{
+	const gchar *keys[] = { "mirrorlist", "metalink", "baseurl", NULL };
+	gchar *host = NULL;
+	gchar *tmp;
+	gchar *uri = NULL;
+	guint i;
+
+	if (!ZIF_IS_STORE_REMOTE (store))
+		goto out;
+	for (i = 0; keys[i] != NULL && uri == NULL; i++) {
+		uri = zif_store_remote_get_string (ZIF_STORE_REMOTE (store),
+						   keys[i],
+						   NULL);
+	}
+	if (uri == NULL)
+		goto out;
+
+	/* just get the host part of scheme://host/path */
+	tmp = g_strstr_len (uri, -1, "://");
+	if (tmp == NULL)
+		goto out;
+	host = g_strdup (tmp + 3);
+	tmp = strchr (host, '/');
+	if (tmp != NULL)
+		*tmp = '\0';
+out:
+	g_free (uri);
+	if (host == NULL)
+		host = g_strdup ("");
+	return host;
+}
+
+/**
+ * zif_store_array_refresh_lock_cb:
+ *
+ * The lock is held by the thread that started the refresh.
+ **/
+static gboolean
+zif_store_array_refresh_lock_cb (ZifState *state,
+				 ZifLock *lock,
+				 ZifLockType lock_type,
+				 GError **error,
+				 gpointer user_data)
+{
+	return TRUE;
+}
+
+/**
+ * zif_store_array_refresh_thread_cb:
+ *
+ * This is called in a thread from the pool.
+ **/
+static void
+zif_store_array_refresh_thread_cb (gpointer data, gpointer user_data)
+{
+	gboolean ret;
+	GError *error_local = NULL;
+	ZifStoreArrayRefreshItem *item = (ZifStoreArrayRefreshItem *) data;
+
+	ret = zif_store_refresh (item->store,
+				 item->helper->force,
+				 item->state,
+				 &error_local);
+
+	/* tell the scheduler */
+	g_mutex_lock (&item->helper->mutex);
+	item->ret = ret;
+	item->error = error_local;
+	item->finished = TRUE;
+	g_cond_signal (&item->helper->cond);
+	g_mutex_unlock (&item->helper->mutex);
+}
+
+/**
+ * zif_store_array_refresh_parallel:
+ *
+ * Refreshes the stores from a thread pool, so that the time spent
+ * waiting for one server and decompressing the metadata can be
+ * overlapped with the other stores.
+ *
+ * The stores are started in order, with at most @max_parallel running
+ * at once, and only @max_per_host of those contacting the same server.
+ **/
+static gboolean
+zif_store_array_refresh_parallel (GPtrArray *store_array,
+				  gboolean force,
+				  guint max_parallel,
+				  guint max_per_host,
+				  ZifState *state,
+				  GError **error)
+{
+	gboolean ret;
+	gboolean stop = FALSE;
+	GError *error_local = NULL;
+	GError *error_tmp;
+	GHashTable *hosts;
+	GPtrArray *children;
+	GPtrArray *items;
+	GThreadPool *pool;
+	guint i;
+	guint in_flight = 0;
+	guint in_flight_host;
+	guint reaped = 0;
+	ZifState *state_local;
+	ZifStoreArrayRefreshHelper helper;
+	ZifStoreArrayRefreshItem *item;
+
+	/* the children only ever get us to 95%, so that the lock is
+	 * released by this thread in the final zif_state_finished() */
+	ret = zif_state_set_steps (state,
+				   error,
+				   95, /* refresh */
+				   5, /* finish */
+				   -1);
+	if (!ret)
+		return FALSE;
+
+	/* the threads all share this lock */
+	ret = zif_state_take_lock (state,
+				   ZIF_LOCK_TYPE_METADATA,
+				   ZIF_LOCK_MODE_PROCESS,
+				   error);
+	if (!ret)
+		return FALSE;
+
+	g_mutex_init (&helper.mutex);
+	g_cond_init (&helper.cond);
+	helper.force = force;
+
+	/* each store gets its own progress */
+	state_local = zif_state_get_child (state);
+	children = zif_state_get_children (state_local, store_array->len);
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) zif_store_array_refresh_item_free);
+	for (i = 0; i < store_array->len; i++) {
+		item = g_new0 (ZifStoreArrayRefreshItem, 1);
+		item->helper = &helper;
+		item->store = g_object_ref (g_ptr_array_index (store_array, i));
+		item->host = zif_store_array_refresh_get_host (item->store);
+		item->state = g_ptr_array_index (children, i);
+		zif_state_set_lock_handler (item->state,
+					    zif_store_array_refresh_lock_cb,
+					    NULL);
+		g_ptr_array_add (items, item);
+	}
+	hosts = g_hash_table_new (g_str_hash, g_str_equal);
+	pool = g_thread_pool_new (zif_store_array_refresh_thread_cb,
+				  NULL, max_parallel, FALSE, NULL);
+
+	g_mutex_lock (&helper.mutex);
+	while (reaped < items->len) {
+
+		/* deal with any that have completed */
+		for (i = 0; i < items->len; i++) {
+			item = g_ptr_array_index (items, i);
+			if (!item->finished || item->reaped)
+				continue;
+			item->reaped = TRUE;
+			reaped++;
+			in_flight--;
+			in_flight_host = GPOINTER_TO_UINT (g_hash_table_lookup (hosts, item->host));
+			g_hash_table_insert (hosts,
+					     item->host,
+					     GUINT_TO_POINTER (in_flight_host - 1));
+			if (item->ret)
+				continue;
+
+			/* the store get disabled whilst being used */
+			if (g_error_matches (item->error,
+					     ZIF_STORE_ERROR,
+					     ZIF_STORE_ERROR_NOT_ENABLED)) {
+				g_debug ("repo %s disabled whilst being used: %s",
+					 zif_store_get_id (item->store),
+					 item->error->message);
+				continue;
+			}
+
+			/* do we need to skip this error, which is not asked
+			 * with the lock held as the handler can block */
+			error_tmp = g_error_copy (item->error);
+			g_mutex_unlock (&helper.mutex);
+			ret = zif_state_error_handler (state, error_tmp);
+			g_mutex_lock (&helper.mutex);
+			if (ret) {
+				g_error_free (error_tmp);
+				continue;
+			}
+
+			/* don't start any more, but let the others finish */
+			if (error_local == NULL) {
+				g_set_error (&error_local,
+					     ZIF_STORE_ERROR,
+					     ZIF_STORE_ERROR_FAILED,
+					     "failed to refresh %s: %s",
+					     zif_store_get_id (item->store),
+					     error_tmp->message);
+			}
+			g_error_free (error_tmp);
+			stop = TRUE;
+		}
+
+		/* start as many as we are allowed */
+		for (i = 0; i < items->len && !stop; i++) {
+			item = g_ptr_array_index (items, i);
+			if (item->started)
+				continue;
+			if (in_flight >= max_parallel)
+				break;
+			in_flight_host = GPOINTER_TO_UINT (g_hash_table_lookup (hosts, item->host));
+			if (in_flight_host >= max_per_host)
+				continue;
+			g_debug ("refreshing %s from %s",
+				 zif_store_get_id (item->store),
+				 item->host);
+			g_hash_table_insert (hosts,
+					     item->host,
+					     GUINT_TO_POINTER (in_flight_host + 1));
+			in_flight++;
+			item->started = TRUE;
+			g_thread_pool_push (pool, item, NULL);
+		}
+
+		/* anything that was never started is done with */
+		if (stop && in_flight == 0)
+			break;
+
+		/* wait for something to finish */
+		if (reaped < items->len)
+			g_cond_wait (&helper.cond, &helper.mutex);
+	}
+	g_mutex_unlock (&helper.mutex);
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	/* the first fatal error */
+	if (error_local != NULL) {
+		g_propagate_error (error, error_local);
+		ret = FALSE;
+		goto out;
+	}
+
+	/* this section done, skipping the stores that failed */
+	ret = zif_state_finished (state, error);
+	if (!ret)
+		goto out;
+out:
+	g_hash_table_unref (hosts);
+	g_ptr_array_unref (items);
+	g_ptr_array_unref (children);
+	g_mutex_clear (&helper.mutex);
+	g_cond_clear (&helper.cond);
+	return ret;
+}
+
 /**
  * zif_store_array_refresh:
  * @store_array: (element-type ZifStore): An array of #ZifStores
@@ -571,6 +1098,9 @@ out:
  *
  * Refreshes the #ZifStoreRemote objects by downloading new data
  *
+ * If max_parallel_refresh is set in the config file then several
+ * stores are refreshed at the same time.
+ *
  * Return value: %TRUE for success, %FALSE otherwise
  *
  * Since: 0.1.0
@@ -580,6 +1110,9 @@ zif_store_array_refresh (GPtrArray *store_array, gboolean force,
 			 ZifState *state, GError **error)
 {
 	guint i;
+	guint max_parallel;
+	guint max_per_host;
+	ZifConfig *config;
 	ZifStore *store;
 	gboolean ret = TRUE;
 	GError *error_local = NULL;
@@ -594,6 +1127,24 @@ zif_store_array_refresh (GPtrArray *store_array, gboolean force,
 		goto out;
 	}
 
+	/* refresh more than one at a time */
+	config = zif_config_new ();
+	max_parallel = zif_config_get_uint (config, "max_parallel_refresh", NULL);
+	max_per_host = zif_config_get_uint (config, "max_parallel_refresh_per_host", NULL);
+	g_object_unref (config);
+	if (max_per_host == 0 || max_per_host == G_MAXUINT)
+		max_per_host = 1;
+	if (max_parallel > 1 && max_parallel != G_MAXUINT &&
+	    store_array->len > 1) {
+		ret = zif_store_array_refresh_parallel (store_array,
+							force,
+							max_parallel,
+							max_per_host,
+							state,
+							error);
+		goto out;
+	}
+
 	/* create a chain of states */
 	zif_state_set_number_steps (state, store_array->len);
 
@@ -628,7 +1179,7 @@ zif_store_array_refresh (GPtrArray *store_array, gboolean force,
 				goto skip_error;
 			}
 			g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
-				     "failed to clean %s: %s", zif_store_get_id (store), error_local->message);
+				     "failed to refresh %s: %s", zif_store_get_id (store), error_local->message);
 			g_error_free (error_local);
 			goto out;
 		}
@@ -1095,6 +1646,7 @@ zif_store_array_get_updates (GPtrArray *store_array,
 	gchar *archinfo = NULL;
 	gchar **search = NULL;
 	gint val;
+	GHashTable *hash_newest = NULL;
 	GPtrArray *array_installed = NULL;
 	GPtrArray *array_obsoletes = NULL;
 	GPtrArray *depend_array = NULL;
@@ -1114,10 +1666,10 @@ zif_store_array_get_updates (GPtrArray *store_array,
 				   error,
 				   1,	/* get local packages */
 				   1,	/* filter newest */
-				   20,	/* resolve local list to remote */
-				   3,	/* filter the updates to the newest */
-				   55,	/* find any updates for installed set */
-				   18,	/* find anything installed that is obsoleted */
+				   45,	/* resolve local list to remote */
+				   3,	/* build the newest-available map */
+				   2,	/* find any updates for installed set */
+				   46,	/* find anything installed that is obsoleted */
 				   1,	/* filter obsoletes by arch */
 				   1,	/* filter any duplicate updates */
 				   -1);
@@ -1169,58 +1721,65 @@ zif_store_array_get_updates (GPtrArray *store_array,
 	if (!ret)
 		goto out;
 
-	/* some repos contain lots of versions of one package */
-	zif_package_array_filter_newest (updates);
+	/* some repos contain lots of versions of one package, so build a
+	 * name.arch to newest-available map in one pass */
+	hash_newest = g_hash_table_new_full (g_str_hash, g_str_equal,
+					     NULL, (GDestroyNotify) g_object_unref);
+	for (j = 0; j < updates->len; j++) {
+		update = ZIF_PACKAGE (g_ptr_array_index (updates, j));
+		package = g_hash_table_lookup (hash_newest,
+					       zif_package_get_name_arch (update));
+		if (package != NULL) {
+			val = zif_package_compare_full (update,
+							package,
+							ZIF_PACKAGE_COMPARE_FLAG_CHECK_VERSION);
+			if (val <= 0)
+				continue;
+		}
+		g_hash_table_replace (hash_newest,
+				      (gpointer) zif_package_get_name_arch (update),
+				      g_object_ref (update));
+	}
 
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
 		goto out;
 
-	/* find each one in a remote repo */
+	/* find each one in the map */
 	updates_available = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	for (i = 0; i < array_installed->len; i++) {
 		package = ZIF_PACKAGE (g_ptr_array_index (array_installed, i));
 
-		/* find updates */
-		for (j = 0; j < updates->len; j++) {
-			update = ZIF_PACKAGE (g_ptr_array_index (updates, j));
-
-			/* correct package name and arch */
-			val = zif_package_compare_full (update,
-							package,
-							ZIF_PACKAGE_COMPARE_FLAG_CHECK_NAME |
-							ZIF_PACKAGE_COMPARE_FLAG_CHECK_ARCH);
-			if (val != 0)
-				continue;
-
-			/* newer? */
-			val = zif_package_compare_full (update,
-							package,
-							ZIF_PACKAGE_COMPARE_FLAG_CHECK_VERSION);
-			if (val == 0)
-				continue;
-
-			/* arch okay, add to list */
-			if (val > 0) {
-				g_debug ("*** update %s from %s.%s to %s.%s",
-					 zif_package_get_name (package),
-					 zif_package_get_version (package),
-					 zif_package_get_arch (package),
-					 zif_package_get_version (update),
-					 zif_package_get_arch (update));
-				g_ptr_array_add (updates_available,
-						 g_object_ref (update));
-
-				/* ensure the remote package knows about
-				 * the installed version so we can
-				 * calculate the delta */
-				if (ZIF_IS_PACKAGE_REMOTE (update)) {
-					zif_package_remote_set_installed (ZIF_PACKAGE_REMOTE (update),
-									  package);
-				}
-				break;
-			}
+		/* correct package name and arch */
+		update = g_hash_table_lookup (hash_newest,
+					      zif_package_get_name_arch (package));
+		if (update == NULL)
+			continue;
+
+		/* newer? */
+		val = zif_package_compare_full (update,
+						package,
+						ZIF_PACKAGE_COMPARE_FLAG_CHECK_VERSION);
+		if (val <= 0)
+			continue;
+
+		/* arch okay, add to list */
+		g_debug ("*** update %s from %s.%s to %s.%s",
+			 zif_package_get_name (package),
+			 zif_package_get_version (package),
+			 zif_package_get_arch (package),
+			 zif_package_get_version (update),
+			 zif_package_get_arch (update));
+		g_ptr_array_add (updates_available,
+				 g_object_ref (update));
+
+		/* ensure the remote package knows about
+		 * the installed version so we can
+		 * calculate the delta */
+		if (ZIF_IS_PACKAGE_REMOTE (update)) {
+			zif_package_remote_set_installed (ZIF_PACKAGE_REMOTE (update),
+							  package);
 		}
 	}
 
@@ -1287,6 +1846,8 @@ zif_store_array_get_updates (GPtrArray *store_array,
 out:
 	g_free (archinfo);
 	g_strfreev (search);
+	if (hash_newest != NULL)
+		g_hash_table_unref (hash_newest);
 	if (config != NULL)
 		g_object_unref (config);
 	if (depend_array != NULL)
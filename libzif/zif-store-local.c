@@ -41,10 +41,13 @@
 #include <fcntl.h>
 
 #include "zif-config.h"
+#include "zif-file-index-private.h"
 #include "zif-history.h"
 #include "zif-monitor.h"
 #include "zif-package-local.h"
+#include "zif-package-local-private.h"
 #include "zif-package-private.h"
+#include "zif-rpmdb-snapshot-private.h"
 #include "zif-state-private.h"
 #include "zif-store-local.h"
 #include "zif-store-meta.h"
@@ -57,6 +60,7 @@ struct _ZifStoreLocalPrivate
 	gchar			*prefix;
 	ZifMonitor		*monitor;
 	ZifConfig		*config;
+	ZifFileIndex		*file_index;
 	guint			 monitor_changed_id;
 };
 
@@ -133,6 +137,8 @@ zif_store_local_set_prefix (ZifStoreLocal *store, const gchar *prefix, GError **
 	/* empty cache */
 	g_debug ("abandoning cache");
 	zif_store_unload (ZIF_STORE (store), NULL);
+	zif_file_index_free (store->priv->file_index);
+	store->priv->file_index = NULL;
 
 	/* setup watch */
 	filename = g_build_filename (prefix_real, "var", "lib", "rpm", "Packages", NULL);
@@ -308,6 +314,166 @@ out:
 	return ret;
 }
 
+/**
+ * zif_store_local_get_cache_filename:
+ **/
+static gchar *
+zif_store_local_get_cache_filename (ZifStoreLocal *store,
+				    const gchar *basename,
+				    GError **error)
+{
+	gchar *cache_dir = NULL;
+	gchar *cache_dir_expanded = NULL;
+	gchar *filename = NULL;
+
+	cache_dir = zif_config_get_string (store->priv->config, "cachedir", error);
+	if (cache_dir == NULL)
+		goto out;
+	cache_dir_expanded = zif_config_expand_substitutions (store->priv->config,
+							      cache_dir,
+							      error);
+	if (cache_dir_expanded == NULL)
+		goto out;
+	filename = g_build_filename (cache_dir_expanded, "installed", basename, NULL);
+out:
+	g_free (cache_dir);
+	g_free (cache_dir_expanded);
+	return filename;
+}
+
+/* the package depends for each ZifRpmdbSnapshotDepend */
+static const ZifPackageEnsureType zif_store_local_snapshot_types[] = {
+	ZIF_PACKAGE_ENSURE_TYPE_PROVIDES,
+	ZIF_PACKAGE_ENSURE_TYPE_REQUIRES,
+	ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES,
+	ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS };
+
+/**
+ * zif_store_local_load_snapshot:
+ *
+ * Adds the installed packages from the rpmdb snapshot, without reading
+ * any headers or looking up where the packages were installed from.
+ **/
+static gboolean
+zif_store_local_load_snapshot (ZifStoreLocal *store,
+			       const gchar *filename,
+			       const gchar *stamp,
+			       ZifPackageCompareMode compare_mode,
+			       GError **error)
+{
+	gboolean ret;
+	GArray *depends;
+	GPtrArray *packages;
+	guint i;
+	guint kind;
+	guint len;
+	ZifPackage *package;
+	ZifRpmdbSnapshot *snapshot;
+	ZifString *pkgid;
+
+	snapshot = zif_rpmdb_snapshot_new ();
+	packages = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	ret = zif_rpmdb_snapshot_load (snapshot, filename, stamp, error);
+	if (!ret)
+		goto out;
+
+	len = zif_rpmdb_snapshot_get_size (snapshot);
+	for (i = 0; i < len; i++) {
+		package = zif_package_local_new ();
+		g_ptr_array_add (packages, package);
+		zif_package_set_installed (package, TRUE);
+		zif_package_set_compare_mode (package, compare_mode);
+		ret = zif_package_set_id (package,
+					  zif_rpmdb_snapshot_get_package_id (snapshot, i),
+					  error);
+		if (!ret)
+			goto out;
+		pkgid = zif_string_new (zif_rpmdb_snapshot_get_pkgid (snapshot, i));
+		zif_package_set_pkgid (package, pkgid);
+		zif_string_unref (pkgid);
+
+		/* the depends are needed by the depsolver, so set them now */
+		for (kind = 0; kind < ZIF_RPMDB_SNAPSHOT_DEPEND_LAST; kind++) {
+			depends = zif_rpmdb_snapshot_get_depends (snapshot, i, kind);
+			zif_package_set_depend_entries (package,
+							zif_store_local_snapshot_types[kind],
+							depends);
+			g_array_unref (depends);
+		}
+
+		/* everything else is read from the header when required */
+		zif_package_local_set_rpmdb (ZIF_PACKAGE_LOCAL (package),
+					     store->priv->prefix,
+					     zif_rpmdb_snapshot_get_instance (snapshot, i));
+	}
+
+	/* only add when every package is valid */
+	ret = zif_store_add_packages (ZIF_STORE (store), packages, error);
+	if (!ret)
+		goto out;
+	g_debug ("added %i packages from rpmdb snapshot", len);
+out:
+	g_ptr_array_unref (packages);
+	zif_rpmdb_snapshot_free (snapshot);
+	return ret;
+}
+
+/**
+ * zif_store_local_save_snapshot:
+ *
+ * Saves the packages that were read from the rpmdb so the next load
+ * can be done from the snapshot. Failing to do this is not fatal.
+ **/
+static void
+zif_store_local_save_snapshot (ZifStoreLocal *store,
+			       GPtrArray *packages,
+			       const gchar *filename,
+			       const gchar *stamp)
+{
+	gboolean ret;
+	GArray *depends;
+	GError *error = NULL;
+	guint i;
+	guint kind;
+	ZifPackage *package;
+	ZifRpmdbSnapshot *snapshot;
+	ZifState *state_tmp;
+
+	snapshot = zif_rpmdb_snapshot_new ();
+	state_tmp = zif_state_new ();
+	for (i = 0; i < packages->len; i++) {
+		package = g_ptr_array_index (packages, i);
+		zif_rpmdb_snapshot_add_package (snapshot,
+						zif_package_get_id (package),
+						zif_package_get_pkgid (package),
+						zif_package_local_get_instance (ZIF_PACKAGE_LOCAL (package)));
+
+		/* the file lists are not saved */
+		for (kind = 0; kind < ZIF_RPMDB_SNAPSHOT_DEPEND_LAST; kind++) {
+			zif_state_reset (state_tmp);
+			depends = zif_package_get_depend_entries (package,
+								  zif_store_local_snapshot_types[kind],
+								  state_tmp,
+								  &error);
+			if (depends == NULL)
+				goto out;
+			zif_rpmdb_snapshot_add_depends (snapshot, kind, depends);
+			g_array_unref (depends);
+		}
+	}
+	zif_rpmdb_snapshot_build (snapshot, stamp);
+	ret = zif_rpmdb_snapshot_save (snapshot, filename, &error);
+	if (!ret)
+		goto out;
+out:
+	if (error != NULL) {
+		g_debug ("failed to save rpmdb snapshot: %s", error->message);
+		g_error_free (error);
+	}
+	zif_rpmdb_snapshot_free (snapshot);
+	g_object_unref (state_tmp);
+}
+
 /**
  * zif_store_local_load:
  **/
@@ -317,7 +483,12 @@ zif_store_local_load (ZifStore *store, ZifState *state, GError **error)
 	gboolean ret = TRUE;
 	gboolean use_installed_history;
 	gboolean yumdb_allow_read;
+	gchar *rpmdb = NULL;
+	gchar *snapshot_filename = NULL;
+	gchar *stamp = NULL;
+	gchar *stamp_rpmdb = NULL;
 	GError *error_local = NULL;
+	GPtrArray *packages = NULL;
 	gint rc;
 	guint existing_releasever;
 	Header header;
@@ -389,6 +560,11 @@ zif_store_local_load (ZifStore *store, ZifState *state, GError **error)
 		g_debug ("not using yumdb lookup as disabled");
 	}
 
+	/* lookup in history database */
+	use_installed_history = zif_config_get_boolean (local->priv->config,
+							"use_installed_history",
+							NULL);
+
 	/* get the compare mode */
 	compare_mode = zif_config_get_enum (local->priv->config,
 					    "pkg_compare_mode",
@@ -399,6 +575,37 @@ zif_store_local_load (ZifStore *store, ZifState *state, GError **error)
 		goto out;
 	}
 
+	/* the snapshot is only valid for the rpmdb it was built from, and
+	 * the repo ids depend on where the origin was looked up */
+	rpmdb = g_build_filename (local->priv->prefix, "var", "lib", "rpm", "Packages", NULL);
+	stamp_rpmdb = zif_file_index_get_stamp (rpmdb, &error_local);
+	if (stamp_rpmdb == NULL) {
+		g_debug ("not using rpmdb snapshot: %s", error_local->message);
+		g_clear_error (&error_local);
+	} else {
+		stamp = g_strdup_printf ("%s:yumdb=%i:history=%i",
+					 stamp_rpmdb,
+					 yumdb_allow_read,
+					 use_installed_history);
+		snapshot_filename = zif_store_local_get_cache_filename (local,
+									"rpmdb.snapshot",
+									&error_local);
+		if (snapshot_filename == NULL) {
+			g_debug ("not using rpmdb snapshot: %s", error_local->message);
+			g_clear_error (&error_local);
+		} else {
+			ret = zif_store_local_load_snapshot (local,
+							     snapshot_filename,
+							     stamp,
+							     compare_mode,
+							     &error_local);
+			if (ret)
+				goto added;
+			g_debug ("reading rpmdb: %s", error_local->message);
+			g_clear_error (&error_local);
+		}
+	}
+
 	/* get list */
 	ts = rpmtsCreate ();
 	rpmtsSetVSFlags (ts, RPMVSF_NOHDRCHK);
@@ -422,12 +629,14 @@ zif_store_local_load (ZifStore *store, ZifState *state, GError **error)
 	zif_state_cancel_on_signal (state, SIGINT);
 
 	/* add each package from the rpmdb */
+	packages = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	do {
 		header = rpmdbNextIterator (mi);
 		if (header == NULL)
 			break;
 		package = zif_package_local_new ();
 		zif_package_set_installed (package, TRUE);
+		zif_package_set_compare_mode (package, compare_mode);
 		ret = zif_package_local_set_from_header (ZIF_PACKAGE_LOCAL (package),
 							 header,
 							 flags,
@@ -449,10 +658,8 @@ zif_store_local_load (ZifStore *store, ZifState *state, GError **error)
 				goto out;
 			}
 		} else {
-			zif_package_set_compare_mode (package,
-						      compare_mode);
 			zif_store_add_package (store, package, NULL);
-			g_object_unref (package);
+			g_ptr_array_add (packages, package);
 		}
 
 		/* check cancelled */
@@ -462,9 +669,6 @@ zif_store_local_load (ZifStore *store, ZifState *state, GError **error)
 	} while (TRUE);
 
 	/* lookup in history database */
-	use_installed_history = zif_config_get_boolean (local->priv->config,
-							"use_installed_history",
-							NULL);
 	if (use_installed_history) {
 		g_debug ("using history lookup");
 
@@ -492,6 +696,10 @@ zif_store_local_load (ZifStore *store, ZifState *state, GError **error)
 		g_debug ("not using history lookup as disabled");
 	}
 
+	/* the repo ids are now known, so the next load can skip all this */
+	if (snapshot_filename != NULL)
+		zif_store_local_save_snapshot (local, packages, snapshot_filename, stamp);
+added:
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
@@ -516,6 +724,12 @@ zif_store_local_load (ZifStore *store, ZifState *state, GError **error)
 	if (!ret)
 		goto out;
 out:
+	g_free (rpmdb);
+	g_free (snapshot_filename);
+	g_free (stamp);
+	g_free (stamp_rpmdb);
+	if (packages != NULL)
+		g_ptr_array_unref (packages);
 	if (history != NULL)
 		g_object_unref (history);
 	if (mi != NULL)
@@ -529,6 +743,221 @@ out:
 	return ret;
 }
 
+/**
+ * zif_store_local_ensure_file_index:
+ *
+ * Maps the file index for the rpmdb, building it from the headers of
+ * the installed packages the first time it is used after a change.
+ **/
+static gboolean
+zif_store_local_ensure_file_index (ZifStoreLocal *store,
+				   GPtrArray *packages,
+				   ZifState *state,
+				   GError **error)
+{
+	const gchar *package_id;
+	gboolean ret = TRUE;
+	gchar *filename = NULL;
+	gchar *rpmdb = NULL;
+	gchar *stamp = NULL;
+	GError *error_local = NULL;
+	GPtrArray *files;
+	guint i, j;
+	ZifFileIndex *index = NULL;
+	ZifPackage *package;
+	ZifState *state_local;
+	ZifState *state_loop;
+
+	/* already loaded */
+	if (store->priv->file_index != NULL) {
+		ret = zif_state_finished (state, error);
+		goto out;
+	}
+
+	/* the index is only valid for the rpmdb it was built from */
+	rpmdb = g_build_filename (store->priv->prefix, "var", "lib", "rpm", "Packages", NULL);
+	stamp = zif_file_index_get_stamp (rpmdb, error);
+	if (stamp == NULL) {
+		ret = FALSE;
+		goto out;
+	}
+
+	/* try to map the saved copy */
+	index = zif_file_index_new ();
+	filename = zif_store_local_get_cache_filename (store, "files.idx", &error_local);
+	if (filename == NULL) {
+		g_debug ("not saving file index: %s", error_local->message);
+		g_clear_error (&error_local);
+	} else {
+		ret = zif_file_index_load (index, filename, stamp, &error_local);
+		if (ret) {
+			store->priv->file_index = index;
+			index = NULL;
+			ret = zif_state_finished (state, error);
+			goto out;
+		}
+		g_debug ("rebuilding file index: %s", error_local->message);
+		g_clear_error (&error_local);
+	}
+
+	/* setup state */
+	ret = zif_state_set_steps (state,
+				   error,
+				   95, /* get files */
+				   5, /* save */
+				   -1);
+	if (!ret)
+		goto out;
+
+	/* add the files of every installed package */
+	state_local = zif_state_get_child (state);
+	zif_state_set_number_steps (state_local, packages->len);
+	for (i = 0; i < packages->len; i++) {
+		package = g_ptr_array_index (packages, i);
+		package_id = zif_package_get_id (package);
+		state_loop = zif_state_get_child (state_local);
+		files = zif_package_get_files (package, state_loop, &error_local);
+		if (files == NULL) {
+			g_set_error (error,
+				     ZIF_STORE_ERROR,
+				     ZIF_STORE_ERROR_FAILED,
+				     "failed to get file lists: %s",
+				     error_local->message);
+			g_error_free (error_local);
+			ret = FALSE;
+			goto out;
+		}
+		for (j = 0; j < files->len; j++)
+			zif_file_index_add (index, package_id, g_ptr_array_index (files, j));
+		g_ptr_array_unref (files);
+
+		/* this section done */
+		ret = zif_state_done (state_local, error);
+		if (!ret)
+			goto out;
+	}
+	zif_file_index_build (index, stamp);
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	/* the built index can still be used if the cache is read-only */
+	if (filename != NULL) {
+		ret = zif_file_index_save (index, filename, &error_local);
+		if (!ret) {
+			g_debug ("failed to save file index: %s", error_local->message);
+			g_clear_error (&error_local);
+		}
+	}
+	store->priv->file_index = index;
+	index = NULL;
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+out:
+	zif_file_index_free (index);
+	g_free (filename);
+	g_free (rpmdb);
+	g_free (stamp);
+	return ret;
+}
+
+/**
+ * zif_store_local_search_file:
+ **/
+static GPtrArray *
+zif_store_local_search_file (ZifStore *store,
+			     gchar **search,
+			     ZifState *state,
+			     GError **error)
+{
+	gboolean ret;
+	GHashTable *hash = NULL;
+	GPtrArray *array = NULL;
+	GPtrArray *ids = NULL;
+	GPtrArray *packages = NULL;
+	guint i;
+	ZifPackage *package;
+	ZifState *state_local;
+	ZifStoreLocal *local = ZIF_STORE_LOCAL (store);
+
+	g_return_val_if_fail (ZIF_IS_STORE_LOCAL (store), NULL);
+
+	/* setup steps */
+	ret = zif_state_set_steps (state,
+				   error,
+				   40, /* get packages */
+				   55, /* ensure index */
+				   5, /* search */
+				   -1);
+	if (!ret)
+		goto out;
+
+	/* get all the installed packages */
+	state_local = zif_state_get_child (state);
+	packages = zif_store_get_packages (store, state_local, error);
+	if (packages == NULL)
+		goto out;
+	if (packages->len == 0) {
+		g_set_error_literal (error,
+				     ZIF_STORE_ERROR,
+				     ZIF_STORE_ERROR_ARRAY_IS_EMPTY,
+				     "no packages in local sack");
+		goto out;
+	}
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	/* map or build the index */
+	state_local = zif_state_get_child (state);
+	ret = zif_store_local_ensure_file_index (local, packages, state_local, error);
+	if (!ret)
+		goto out;
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	/* convert the package-ids back to packages */
+	ids = zif_file_index_search (local->priv->file_index, search);
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	if (ids->len > 0) {
+		hash = g_hash_table_new (g_str_hash, g_str_equal);
+		for (i = 0; i < packages->len; i++) {
+			package = g_ptr_array_index (packages, i);
+			g_hash_table_insert (hash,
+					     (gpointer) zif_package_get_id (package),
+					     package);
+		}
+		for (i = 0; i < ids->len; i++) {
+			package = g_hash_table_lookup (hash, g_ptr_array_index (ids, i));
+			if (package != NULL)
+				g_ptr_array_add (array, g_object_ref (package));
+		}
+	}
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+out:
+	if (hash != NULL)
+		g_hash_table_unref (hash);
+	if (ids != NULL)
+		g_ptr_array_unref (ids);
+	if (packages != NULL)
+		g_ptr_array_unref (packages);
+	return array;
+}
+
 /**
  * zif_store_local_get_id:
  **/
@@ -545,8 +974,12 @@ zif_store_local_get_id (ZifStore *store)
 static void
 zif_store_local_file_monitor_cb (ZifMonitor *monitor, ZifStore *store)
 {
+	ZifStoreLocal *local = ZIF_STORE_LOCAL (store);
 	g_debug ("rpmdb changed");
+	zif_package_local_close_rpmdb ();
 	zif_store_unload (store, NULL);
+	zif_file_index_free (local->priv->file_index);
+	local->priv->file_index = NULL;
 }
 
 /**
@@ -565,6 +998,7 @@ zif_store_local_finalize (GObject *object)
 	g_object_unref (store->priv->monitor);
 	g_object_unref (store->priv->config);
 	g_free (store->priv->prefix);
+	zif_file_index_free (store->priv->file_index);
 
 	G_OBJECT_CLASS (zif_store_local_parent_class)->finalize (object);
 }
@@ -582,6 +1016,7 @@ zif_store_local_class_init (ZifStoreLocalClass *klass)
 	/* map */
 	store_class->load = zif_store_local_load;
 	store_class->get_id = zif_store_local_get_id;
+	store_class->search_file = zif_store_local_search_file;
 
 	g_type_class_add_private (klass, sizeof (ZifStoreLocalPrivate));
 }
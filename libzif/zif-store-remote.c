@@ -39,6 +39,7 @@
 #include "zif-category.h"
 #include "zif-config.h"
 #include "zif-download-private.h"
+#include "zif-file-index-private.h"
 #include "zif-groups.h"
 #include "zif-lock.h"
 #include "zif-md-comps.h"
@@ -110,6 +111,8 @@ struct _ZifStoreRemotePrivate
 	ZifMedia		*media;
 	ZifGroups		*groups;
 	GPtrArray		*packages;
+	ZifFileIndex		*file_index;
+	GMutex			 download_mutex;	/* for reloading the metadata */
 	ZifMdKind		 parser_type;
 	/* temp data for the xml parser */
 	ZifStoreRemoteParserSection parser_section;
@@ -190,6 +193,170 @@ zif_store_remote_get_filelists (ZifStoreRemote *store, GError **error)
 	return NULL;
 }
 
+/**
+ * zif_store_remote_get_file_index_stamp:
+ *
+ * The index is only valid for the filelists it was built from.
+ **/
+static gchar *
+zif_store_remote_get_file_index_stamp (ZifStoreRemote *store, GError **error)
+{
+	const gchar *filename;
+	ZifMd *filelists;
+
+	filelists = zif_store_remote_get_filelists (store, error);
+	if (filelists == NULL)
+		return NULL;
+	filename = zif_md_get_filename_uncompressed (filelists);
+	if (filename == NULL) {
+		g_set_error (error,
+			     ZIF_STORE_ERROR,
+			     ZIF_STORE_ERROR_FAILED,
+			     "remote store %s has no uncompressed filelists",
+			     store->priv->id);
+		return NULL;
+	}
+	return zif_file_index_get_stamp (filename, error);
+}
+
+/**
+ * zif_store_remote_load_file_index:
+ *
+ * Maps the file index that was built when the store was refreshed.
+ **/
+static gboolean
+zif_store_remote_load_file_index (ZifStoreRemote *store)
+{
+	gboolean ret = FALSE;
+	gchar *filename = NULL;
+	gchar *stamp = NULL;
+	GError *error = NULL;
+	ZifFileIndex *index = NULL;
+
+	/* already loaded */
+	if (store->priv->file_index != NULL)
+		return TRUE;
+	if (store->priv->directory == NULL)
+		return FALSE;
+
+	/* get the data the index has to match */
+	stamp = zif_store_remote_get_file_index_stamp (store, NULL);
+	if (stamp == NULL)
+		goto out;
+
+	/* map the file */
+	index = zif_file_index_new ();
+	filename = g_build_filename (store->priv->directory, "files.idx", NULL);
+	ret = zif_file_index_load (index, filename, stamp, &error);
+	if (!ret) {
+		g_debug ("not using file index: %s", error->message);
+		g_error_free (error);
+		goto out;
+	}
+	store->priv->file_index = index;
+	index = NULL;
+out:
+	zif_file_index_free (index);
+	g_free (filename);
+	g_free (stamp);
+	return ret;
+}
+
+/**
+ * zif_store_remote_file_index_add_cb:
+ **/
+static void
+zif_store_remote_file_index_add_cb (const gchar *pkgid,
+				    const gchar *filename,
+				    gpointer user_data)
+{
+	zif_file_index_add ((ZifFileIndex *) user_data, pkgid, filename);
+}
+
+/**
+ * zif_store_remote_build_file_index:
+ *
+ * Builds the file index from the filelists and saves it in the cache,
+ * unless the saved copy was already built from the same filelists.
+ **/
+static gboolean
+zif_store_remote_build_file_index (ZifStoreRemote *store,
+				   ZifState *state,
+				   GError **error)
+{
+	gboolean ret = FALSE;
+	gchar *filename = NULL;
+	gchar *stamp = NULL;
+	ZifFileIndex *index = NULL;
+	ZifMd *filelists;
+	ZifState *state_local;
+
+	/* the filelists may have changed */
+	zif_file_index_free (store->priv->file_index);
+	store->priv->file_index = NULL;
+
+	/* up to date */
+	ret = zif_store_remote_load_file_index (store);
+	if (ret) {
+		ret = zif_state_finished (state, error);
+		goto out;
+	}
+
+	/* setup state */
+	ret = zif_state_set_steps (state,
+				   error,
+				   90, /* get files */
+				   10, /* save */
+				   -1);
+	if (!ret)
+		goto out;
+
+	/* add every file */
+	stamp = zif_store_remote_get_file_index_stamp (store, error);
+	if (stamp == NULL) {
+		ret = FALSE;
+		goto out;
+	}
+	filelists = zif_store_remote_get_filelists (store, error);
+	if (filelists == NULL) {
+		ret = FALSE;
+		goto out;
+	}
+	index = zif_file_index_new ();
+	state_local = zif_state_get_child (state);
+	ret = zif_md_foreach_file (filelists,
+				   zif_store_remote_file_index_add_cb,
+				   index,
+				   state_local,
+				   error);
+	if (!ret)
+		goto out;
+	zif_file_index_build (index, stamp);
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	/* save */
+	filename = g_build_filename (store->priv->directory, "files.idx", NULL);
+	ret = zif_file_index_save (index, filename, error);
+	if (!ret)
+		goto out;
+	store->priv->file_index = index;
+	index = NULL;
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+out:
+	zif_file_index_free (index);
+	g_free (filename);
+	g_free (stamp);
+	return ret;
+}
+
 /**
  * zif_store_remote_get_md_from_type:
  * @store: A #ZifStoreRemote
@@ -536,6 +703,10 @@ zif_store_remote_download_full (ZifStoreRemote *store,
 
 repomd_confirm:
 
+	/* packages from this store can be downloaded in more than one
+	 * thread, but only one of them loads the metadata */
+	g_mutex_lock (&store->priv->download_mutex);
+
 	/* setup state */
 	if (store->priv->loaded_metadata) {
 		zif_state_set_number_steps (state, 1);
@@ -545,8 +716,10 @@ repomd_confirm:
 					   5, /* load */
 					   95, /* download */
 					   -1);
-		if (!ret)
+		if (!ret) {
+			g_mutex_unlock (&store->priv->download_mutex);
 			goto out;
+		}
 	}
 
 	/* if not already loaded, load */
@@ -554,6 +727,7 @@ repomd_confirm:
 		state_local = zif_state_get_child (state);
 		ret = zif_store_remote_load_metadata (store, state_local, &error_local);
 		if (!ret) {
+			g_mutex_unlock (&store->priv->download_mutex);
 			g_set_error (error, error_local->domain, error_local->code,
 				     "failed to load metadata: %s", error_local->message);
 			g_error_free (error_local);
@@ -562,9 +736,12 @@ repomd_confirm:
 
 		/* this section done */
 		ret = zif_state_done (state, error);
-		if (!ret)
+		if (!ret) {
+			g_mutex_unlock (&store->priv->download_mutex);
 			goto out;
+		}
 	}
+	g_mutex_unlock (&store->priv->download_mutex);
 
 	/* we need at least one baseurl */
 	if (zif_download_location_get_size (store->priv->download) == 0) {
@@ -606,12 +783,15 @@ repomd_confirm:
 	}
 
 	/* we failed to get the metadata from any source, so try to refresh the repomd.xml */
+	g_mutex_lock (&store->priv->download_mutex);
 	if (!ret && store->priv->download_retries > 1) {
 
 		/* we might go backwards */
 		ret = zif_state_reset (state);
-		if (!ret)
+		if (!ret) {
+			g_mutex_unlock (&store->priv->download_mutex);
 			goto out;
+		}
 
 		/* delete invalid repomd */
 		store->priv->loaded_metadata = FALSE;
@@ -621,8 +801,10 @@ repomd_confirm:
 		store->priv->download_retries--;
 		g_debug ("confirming repomd.xml as repodata file does not exist");
 
+		g_mutex_unlock (&store->priv->download_mutex);
 		goto repomd_confirm;
 	}
+	g_mutex_unlock (&store->priv->download_mutex);
 
 	/* nothing */
 	if (!ret) {
@@ -849,16 +1031,16 @@ zif_store_remote_get_update_detail (ZifStoreRemote *store, const gchar *package_
 	if (store->priv->loaded_metadata) {
 		ret = zif_state_set_steps (state,
 					   error,
-					   30, /* get detail for package */
 					   20, /* find package */
+					   30, /* get detail for package */
 					   50, /* add changeset */
 					   -1);
 	} else {
 		ret = zif_state_set_steps (state,
 					   error,
 					   50, /* load metadata */
-					   10, /* get detail for package */
 					   10, /* find package */
+					   10, /* get detail for package */
 					   30, /* add changeset */
 					   -1);
 	}
@@ -882,10 +1064,38 @@ zif_store_remote_get_update_detail (ZifStoreRemote *store, const gchar *package_
 			goto out;
 	}
 
-	/* actually get the data */
+	/* get ZifPackage for package-id */
+	md = zif_store_remote_get_primary (store, error);
+	if (md == NULL)
+		goto out;
 	state_local = zif_state_get_child (state);
-	array = zif_md_updateinfo_get_detail_for_package (ZIF_MD_UPDATEINFO (store->priv->md_updateinfo), package_id,
-							  state_local, &error_local);
+	packages = zif_md_find_package (md, package_id, state_local, &error_local);
+	if (packages == NULL) {
+		g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
+			     "cannot find package in primary repo: %s", error_local->message);
+		g_error_free (error_local);
+		goto out;
+	}
+
+	/* fatal */
+	if (packages->len == 0) {
+		g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
+			     "cannot find package in primary repo: %s", package_id);
+		goto out;
+	}
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	/* actually get the data, using the indexed lookup for all the
+	 * packages in primary with this package_id at once */
+	state_local = zif_state_get_child (state);
+	array = zif_md_updateinfo_get_detail_for_packages (ZIF_MD_UPDATEINFO (store->priv->md_updateinfo),
+							   packages,
+							   state_local,
+							   &error_local);
 	if (array == NULL) {
 		/* ignore the case where we try to get updatinfo on repos
 		 * such as fedora, which do not have updateinfo */
@@ -919,6 +1129,14 @@ zif_store_remote_get_update_detail (ZifStoreRemote *store, const gchar *package_
 			goto out;
 		}
 	}
+	if (array->len == 0) {
+		g_set_error (error,
+			     ZIF_STORE_ERROR,
+			     ZIF_STORE_ERROR_FAILED,
+			     "failed to find any details in updateinfo (but in primary): %s",
+			     package_id);
+		goto out;
+	}
 	if (array->len != 1) {
 		/* FIXME: is this valid? */
 		g_set_error (error,
@@ -929,31 +1147,6 @@ zif_store_remote_get_update_detail (ZifStoreRemote *store, const gchar *package_
 		goto out;
 	}
 
-	/* this section done */
-	ret = zif_state_done (state, error);
-	if (!ret)
-		goto out;
-
-	/* get ZifPackage for package-id */
-	md = zif_store_remote_get_primary (store, error);
-	if (md == NULL)
-		goto out;
-	state_local = zif_state_get_child (state);
-	packages = zif_md_find_package (md, package_id, state_local, &error_local);
-	if (packages == NULL) {
-		g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
-			     "cannot find package in primary repo: %s", error_local->message);
-		g_error_free (error_local);
-		goto out;
-	}
-
-	/* fatal */
-	if (packages->len == 0) {
-		g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
-			     "cannot find package in primary repo: %s", package_id);
-		goto out;
-	}
-
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
@@ -1652,6 +1845,15 @@ zif_store_remote_load_metadata (ZifStoreRemote *store, ZifState *state, GError *
 	if (store->priv->loaded_metadata)
 		goto out;
 
+	/* other readers are fine, but not a refresh */
+	ret = zif_state_take_lock_full (state,
+					ZIF_LOCK_TYPE_METADATA,
+					ZIF_LOCK_MODE_PROCESS,
+					ZIF_LOCK_ACCESS_SHARED,
+					error);
+	if (!ret)
+		goto out;
+
 	/* does repomd.xml exist */
 	file_exists = g_file_test (store->priv->repomd_filename,
 				   G_FILE_TEST_EXISTS);
@@ -1967,7 +2169,8 @@ zif_store_remote_refresh (ZifStore *store, gboolean force, ZifState *state, GErr
 				   error,
 				   15, /* download repomd */
 				   5, /* load metadata */
-				   80, /* refresh each metadata */
+				   75, /* refresh each metadata */
+				   5, /* build file index */
 				   -1);
 	if (!ret)
 		goto out;
@@ -2084,6 +2287,20 @@ skip:
 			goto out;
 	}
 
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	/* searching still works without the index, just slower */
+	state_local = zif_state_get_child (state);
+	ret = zif_store_remote_build_file_index (remote, state_local, &error_local);
+	if (!ret) {
+		g_debug ("failed to build file index for %s: %s",
+			 remote->priv->id, error_local->message);
+		g_clear_error (&error_local);
+	}
+
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
@@ -3759,10 +3976,11 @@ zif_store_remote_what_provides (ZifStore *store, GPtrArray *depends,
 	if (!ret)
 		goto out;
 
-	/* get provides from filelists for SQL */
+	/* get provides from filelists for SQL or when indexed */
 	filelists = zif_store_remote_get_filelists (remote, NULL);
 	if (filelists != NULL &&
-	    ZIF_IS_MD_FILELISTS_SQL (filelists)) {
+	    (ZIF_IS_MD_FILELISTS_SQL (filelists) ||
+	     zif_store_remote_load_file_index (remote))) {
 		/* convert the depends that look like file paths into a GStrv */
 		search = g_new0 (gchar *, depends->len + 1);
 		for (i = 0; i < depends->len; i++) {
@@ -4022,54 +4240,36 @@ zif_store_remote_convert_pkgids_to_packages (ZifMd *primary,
 					     ZifState *state,
 					     GError **error)
 {
-	const gchar *pkgid;
-	const gchar *to_array[] = { NULL, NULL };
-	gboolean ret;
+	gchar **search;
 	GError *error_local = NULL;
-	GPtrArray *array = NULL;
-	GPtrArray *array_tmp;
-	GPtrArray *tmp;
+	GPtrArray *array;
 	guint i;
-	ZifState *state_local;
 
-	/* setup state */
-	zif_state_set_number_steps (state, pkgids->len);
-
-	array_tmp = zif_object_array_new ();
-	for (i = 0; i < pkgids->len; i++) {
-		pkgid = g_ptr_array_index (pkgids, i);
-
-		/* get the results (should just be one) */
-		to_array[0] = pkgid;
-		state_local = zif_state_get_child (state);
-		tmp = zif_md_search_pkgid (primary,
-					   (gchar **) to_array,
-					   state_local,
-					   &error_local);
-		if (tmp == NULL) {
-			g_set_error (error,
-				     ZIF_STORE_ERROR,
-				     ZIF_STORE_ERROR_FAILED_TO_FIND,
-				     "failed to resolve pkgId to package: %s",
-				     error_local->message);
-			g_error_free (error_local);
-			goto out;
-		}
-
-		/* add to main array */
-		zif_object_array_add_array (array_tmp, tmp);
-		g_ptr_array_unref (tmp);
+	/* nothing to do */
+	if (pkgids->len == 0) {
+		zif_state_finished (state, NULL);
+		return zif_object_array_new ();
+	}
 
-		/* this section done */
-		ret = zif_state_done (state, error);
-		if (!ret)
-			goto out;
+	/* get the results for all the pkgIds in one query */
+	search = g_new0 (gchar *, pkgids->len + 1);
+	for (i = 0; i < pkgids->len; i++)
+		search[i] = g_ptr_array_index (pkgids, i);
+	array = zif_md_search_pkgid (primary,
+				     search,
+				     state,
+				     &error_local);
+	if (array == NULL) {
+		g_set_error (error,
+			     ZIF_STORE_ERROR,
+			     ZIF_STORE_ERROR_FAILED_TO_FIND,
+			     "failed to resolve pkgId to package: %s",
+			     error_local->message);
+		g_error_free (error_local);
 	}
 
-	/* success */
-	array = g_ptr_array_ref (array_tmp);
-out:
-	g_ptr_array_unref (array_tmp);
+	/* the strings are owned by the pkgids array */
+	g_free (search);
 	return array;
 }
 
@@ -4081,7 +4281,7 @@ zif_store_remote_search_file (ZifStore *store, gchar **search, ZifState *state,
 {
 	gboolean ret;
 	GError *error_local = NULL;
-	GPtrArray *pkgids;
+	GPtrArray *pkgids = NULL;
 	GPtrArray *array = NULL;
 	ZifState *state_local;
 	ZifStoreRemote *remote = ZIF_STORE_REMOTE (store);
@@ -4129,18 +4329,23 @@ zif_store_remote_search_file (ZifStore *store, gchar **search, ZifState *state,
 			goto out;
 	}
 
-	/* gets a list of pkgId's that match this file */
-	state_local = zif_state_get_child (state);
-	filelists = zif_store_remote_get_filelists (remote, error);
-	if (filelists == NULL)
-		goto out;
-	pkgids = zif_md_search_file (filelists,
-				     search, state_local, &error_local);
-	if (pkgids == NULL) {
-		g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
-			     "failed to load get list of pkgids: %s", error_local->message);
-		g_error_free (error_local);
-		goto out;
+	/* gets a list of pkgId's that match this file, using the index
+	 * built at refresh time so the filelists do not have to be read */
+	if (zif_store_remote_load_file_index (remote)) {
+		pkgids = zif_file_index_search (remote->priv->file_index, search);
+	} else {
+		state_local = zif_state_get_child (state);
+		filelists = zif_store_remote_get_filelists (remote, error);
+		if (filelists == NULL)
+			goto out;
+		pkgids = zif_md_search_file (filelists,
+					     search, state_local, &error_local);
+		if (pkgids == NULL) {
+			g_set_error (error, ZIF_STORE_ERROR, ZIF_STORE_ERROR_FAILED,
+				     "failed to load get list of pkgids: %s", error_local->message);
+			g_error_free (error_local);
+			goto out;
+		}
 	}
 
 	/* this section done */
@@ -4167,6 +4372,8 @@ zif_store_remote_search_file (ZifStore *store, gchar **search, ZifState *state,
 	if (!ret)
 		goto out;
 out:
+	if (pkgids != NULL)
+		g_ptr_array_unref (pkgids);
 	return array;
 }
 
@@ -4493,6 +4700,8 @@ zif_store_remote_file_monitor_cb (ZifMonitor *monitor, ZifStoreRemote *store)
 	store->priv->mirrorlist = NULL;
 	store->priv->metalink = NULL;
 	store->priv->pubkey = NULL;
+	zif_file_index_free (store->priv->file_index);
+	store->priv->file_index = NULL;
 
 	g_debug ("store file changed");
 }
@@ -4520,6 +4729,7 @@ zif_store_remote_finalize (GObject *object)
 	g_free (store->priv->cache_dir);
 	g_free (store->priv->repomd_filename);
 	g_free (store->priv->directory);
+	zif_file_index_free (store->priv->file_index);
 
 	if (store->priv->file != NULL)
 		g_key_file_free (store->priv->file);
@@ -4540,6 +4750,7 @@ zif_store_remote_finalize (GObject *object)
 	g_object_unref (store->priv->media);
 	g_object_unref (store->priv->groups);
 	g_object_unref (store->priv->download);
+	g_mutex_clear (&store->priv->download_mutex);
 
 	G_OBJECT_CLASS (zif_store_remote_parent_class)->finalize (object);
 }
@@ -4595,6 +4806,7 @@ zif_store_remote_init (ZifStoreRemote *store)
 	store->priv->media = zif_media_new ();
 	store->priv->groups = zif_groups_new ();
 	store->priv->download = zif_download_new ();
+	g_mutex_init (&store->priv->download_mutex);
 	store->priv->md_filelists_sql = zif_md_filelists_sql_new ();
 	store->priv->md_filelists_xml = zif_md_filelists_xml_new ();
 	store->priv->md_other_sql = zif_md_other_sql_new ();
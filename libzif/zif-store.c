@@ -36,18 +36,34 @@
 #include <glib.h>
 #include <rpm/rpmlib.h>
 
+#include "zif-depend-private.h"
 #include "zif-object-array.h"
 #include "zif-package-array-private.h"
 #include "zif-package.h"
+#include "zif-package-private.h"
 #include "zif-store.h"
 #include "zif-utils-private.h"
 
 #define ZIF_STORE_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), ZIF_TYPE_STORE, ZifStorePrivate))
 
+typedef struct {
+	GHashTable		*hash;
+	GPtrArray		*sorted;
+	ZifStoreResolveFlags	 flag;
+} ZifStoreResolveIndex;
+
 struct _ZifStorePrivate
 {
 	GPtrArray		*packages;
 	GHashTable		*package_id_hash;
+	GHashTable		*provides_index;
+	GHashTable		*requires_index;
+	GHashTable		*obsoletes_index;
+	GHashTable		*conflicts_index;
+	ZifStoreResolveIndex	*name_index;
+	ZifStoreResolveIndex	*name_arch_index;
+	ZifStoreResolveIndex	*name_version_index;
+	ZifStoreResolveIndex	*name_version_arch_index;
 	gboolean		 is_local;
 	gboolean		 loaded;
 	gboolean		 enabled;
@@ -78,6 +94,60 @@ zif_store_error_quark (void)
 	return quark;
 }
 
+/**
+ * zif_store_resolve_index_free:
+ **/
+static void
+zif_store_resolve_index_free (ZifStoreResolveIndex *index)
+{
+	g_hash_table_unref (index->hash);
+	if (index->sorted != NULL)
+		g_ptr_array_unref (index->sorted);
+	g_free (index);
+}
+
+/**
+ * zif_store_invalidate_indexes:
+ **/
+static void
+zif_store_invalidate_indexes (ZifStore *store)
+{
+	ZifStorePrivate *priv = store->priv;
+
+	if (priv->provides_index != NULL) {
+		g_hash_table_unref (priv->provides_index);
+		priv->provides_index = NULL;
+	}
+	if (priv->requires_index != NULL) {
+		g_hash_table_unref (priv->requires_index);
+		priv->requires_index = NULL;
+	}
+	if (priv->obsoletes_index != NULL) {
+		g_hash_table_unref (priv->obsoletes_index);
+		priv->obsoletes_index = NULL;
+	}
+	if (priv->conflicts_index != NULL) {
+		g_hash_table_unref (priv->conflicts_index);
+		priv->conflicts_index = NULL;
+	}
+	if (priv->name_index != NULL) {
+		zif_store_resolve_index_free (priv->name_index);
+		priv->name_index = NULL;
+	}
+	if (priv->name_arch_index != NULL) {
+		zif_store_resolve_index_free (priv->name_arch_index);
+		priv->name_arch_index = NULL;
+	}
+	if (priv->name_version_index != NULL) {
+		zif_store_resolve_index_free (priv->name_version_index);
+		priv->name_version_index = NULL;
+	}
+	if (priv->name_version_arch_index != NULL) {
+		zif_store_resolve_index_free (priv->name_version_arch_index);
+		priv->name_version_arch_index = NULL;
+	}
+}
+
 /**
  * zif_store_add_package:
  * @store: A #ZifStore
@@ -121,6 +191,7 @@ zif_store_add_package (ZifStore *store,
 	g_hash_table_insert (store->priv->package_id_hash,
 			     g_strdup (key),
 			     package);
+	zif_store_invalidate_indexes (store);
 out:
 	return ret;
 }
@@ -199,6 +270,7 @@ zif_store_remove_package (ZifStore *store,
 	}
 
 	/* just remove */
+	zif_store_invalidate_indexes (store);
 	g_ptr_array_remove (store->priv->packages, package_tmp);
 	g_hash_table_remove (store->priv->package_id_hash, key);
 out:
@@ -270,6 +342,7 @@ zif_store_load (ZifStore *store, ZifState *state, GError **error)
 	}
 
 	/* ensure any previous store is cleared */
+	zif_store_invalidate_indexes (store);
 	g_ptr_array_set_size (store->priv->packages, 0);
 	g_hash_table_remove_all (store->priv->package_id_hash);
 
@@ -1008,6 +1081,180 @@ zif_store_has_search_arch_suffix (const gchar *search)
 	return FALSE;
 }
 
+/**
+ * zif_store_get_resolve_key:
+ **/
+static const gchar *
+zif_store_get_resolve_key (ZifPackage *package, ZifStoreResolveFlags flag)
+{
+	switch (flag) {
+	case ZIF_STORE_RESOLVE_FLAG_USE_NAME:
+		return zif_package_get_name (package);
+	case ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH:
+		return zif_package_get_name_arch (package);
+	case ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION:
+		return zif_package_get_name_version (package);
+	case ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION_ARCH:
+		return zif_package_get_name_version_arch (package);
+	default:
+		g_assert_not_reached ();
+	}
+	return NULL;
+}
+
+/**
+ * zif_store_ensure_resolve_index:
+ *
+ * The index maps the name, name.arch, name-version or
+ * name-version.arch of each package to an array of the packages that
+ * have that key, so that exact resolves do not have to compare every
+ * package in the store.
+ *
+ * Like the depend index, neither the keys nor the packages are owned
+ * by the index.
+ **/
+static ZifStoreResolveIndex *
+zif_store_ensure_resolve_index (ZifStore *store, ZifStoreResolveFlags flag)
+{
+	const gchar *key;
+	GPtrArray *bucket;
+	guint i;
+	ZifPackage *package;
+	ZifStoreResolveIndex **index = NULL;
+
+	switch (flag) {
+	case ZIF_STORE_RESOLVE_FLAG_USE_NAME:
+		index = &store->priv->name_index;
+		break;
+	case ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH:
+		index = &store->priv->name_arch_index;
+		break;
+	case ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION:
+		index = &store->priv->name_version_index;
+		break;
+	case ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION_ARCH:
+		index = &store->priv->name_version_arch_index;
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+
+	/* already built */
+	if (*index != NULL)
+		return *index;
+
+	*index = g_new0 (ZifStoreResolveIndex, 1);
+	(*index)->flag = flag;
+	(*index)->hash = g_hash_table_new_full (g_str_hash,
+					       g_str_equal,
+					       NULL,
+					       (GDestroyNotify) g_ptr_array_unref);
+	for (i = 0; i < store->priv->packages->len; i++) {
+		package = g_ptr_array_index (store->priv->packages, i);
+		key = zif_store_get_resolve_key (package, flag);
+		bucket = g_hash_table_lookup ((*index)->hash, key);
+		if (bucket == NULL) {
+			bucket = g_ptr_array_new ();
+			g_hash_table_insert ((*index)->hash, (gpointer) key, bucket);
+		}
+		g_ptr_array_add (bucket, package);
+	}
+	return *index;
+}
+
+/**
+ * zif_store_resolve_index_sort_cb:
+ **/
+static gint
+zif_store_resolve_index_sort_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	ZifStoreResolveFlags flag = GPOINTER_TO_UINT (user_data);
+	return strcmp (zif_store_get_resolve_key (*((ZifPackage **) a), flag),
+		       zif_store_get_resolve_key (*((ZifPackage **) b), flag));
+}
+
+/**
+ * zif_store_resolve_index_get_sorted:
+ *
+ * The packages sorted by key are only needed for patterns, so this is
+ * only built the first time a glob or regular expression is used.
+ **/
+static GPtrArray *
+zif_store_resolve_index_get_sorted (ZifStore *store, ZifStoreResolveIndex *index)
+{
+	if (index->sorted != NULL)
+		return index->sorted;
+	index->sorted = g_ptr_array_sized_new (store->priv->packages->len);
+	g_ptr_array_set_size (index->sorted, store->priv->packages->len);
+	memcpy (index->sorted->pdata,
+		store->priv->packages->pdata,
+		store->priv->packages->len * sizeof (gpointer));
+	g_ptr_array_sort_with_data (index->sorted,
+				    zif_store_resolve_index_sort_cb,
+				    GUINT_TO_POINTER (index->flag));
+	return index->sorted;
+}
+
+/**
+ * zif_store_resolve_index_match:
+ *
+ * Adds the packages that match @matcher. Exact matches are a hash
+ * lookup, and patterns with a literal prefix only have to check the
+ * packages with keys starting with that prefix.
+ **/
+static void
+zif_store_resolve_index_match (ZifStore *store,
+			       ZifStoreResolveIndex *index,
+			       ZifStrMatcher *matcher,
+			       GPtrArray *array)
+{
+	const gchar *key;
+	const gchar *prefix;
+	GPtrArray *bucket;
+	GPtrArray *sorted;
+	gsize prefix_len;
+	guint i;
+	guint lower = 0;
+	guint upper;
+	guint mid;
+	ZifPackage *package;
+
+	/* exact match */
+	prefix = zif_str_matcher_get_prefix (matcher);
+	if (zif_str_matcher_is_literal (matcher)) {
+		bucket = g_hash_table_lookup (index->hash, prefix);
+		if (bucket == NULL)
+			return;
+		for (i = 0; i < bucket->len; i++)
+			g_ptr_array_add (array, g_object_ref (g_ptr_array_index (bucket, i)));
+		return;
+	}
+
+	/* find the first key that is not before the prefix */
+	sorted = zif_store_resolve_index_get_sorted (store, index);
+	prefix_len = strlen (prefix);
+	upper = sorted->len;
+	while (prefix_len > 0 && lower < upper) {
+		mid = (lower + upper) / 2;
+		key = zif_store_get_resolve_key (g_ptr_array_index (sorted, mid),
+						 index->flag);
+		if (strcmp (key, prefix) < 0)
+			lower = mid + 1;
+		else
+			upper = mid;
+	}
+
+	/* check each key until the prefix no longer matches */
+	for (i = lower; i < sorted->len; i++) {
+		package = g_ptr_array_index (sorted, i);
+		key = zif_store_get_resolve_key (package, index->flag);
+		if (strncmp (key, prefix, prefix_len) != 0)
+			break;
+		if (zif_str_matcher_match (matcher, key))
+			g_ptr_array_add (array, g_object_ref (package));
+	}
+}
+
 /**
  * zif_store_resolve_full_try:
  **/
@@ -1019,15 +1266,23 @@ zif_store_resolve_full_try (ZifStore *store,
 			    GError **error)
 {
 	const gchar *tmp;
+	const ZifStoreResolveFlags types[] = {
+		ZIF_STORE_RESOLVE_FLAG_USE_NAME,
+		ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH,
+		ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION,
+		ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION_ARCH,
+		0 };
 	gboolean ret;
 	gchar **search_native = NULL;
 	GError *error_local = NULL;
 	GPtrArray *array = NULL;
+	GPtrArray *array_tmp = NULL;
+	GPtrArray *matchers = NULL;
 	guint i, j;
-	ZifPackage *package;
 	ZifState *state_local = NULL;
-	ZifStrCompareFunc compare_func;
 	ZifStoreClass *klass = ZIF_STORE_GET_CLASS (store);
+	ZifStoreResolveIndex *index;
+	ZifStrMatcherKind kind;
 
 	g_return_val_if_fail (klass != NULL, NULL);
 
@@ -1108,73 +1363,46 @@ zif_store_resolve_full_try (ZifStore *store,
 		goto out;
 	}
 
-	/* setup state with the correct number of steps */
-	state_local = zif_state_get_child (state);
-	zif_state_set_number_steps (state_local, store->priv->packages->len);
-
-	/* allow globbing (slow) or a regular expressions (much slower) */
+	/* allow globbing or a regular expressions, compiled just once */
 	if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_REGEX) > 0)
-		compare_func = zif_str_compare_regex;
+		kind = ZIF_STR_MATCHER_KIND_REGEX;
 	else if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_GLOB) > 0)
-		compare_func = zif_str_compare_glob;
+		kind = ZIF_STR_MATCHER_KIND_GLOB;
 	else
-		compare_func = zif_str_compare_equal;
-
-	/* iterate list */
-	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-	for (i = 0; i < store->priv->packages->len; i++) {
-		package = g_ptr_array_index (store->priv->packages, i);
-
-		/* name */
-		if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME) > 0) {
-			tmp = zif_package_get_name (package);
-			for (j = 0; search_native[j] != NULL; j++) {
-				if (compare_func (tmp, search_native[j]))
-					g_ptr_array_add (array, g_object_ref (package));
-			}
-		}
-
-		/* name.arch */
-		if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME_ARCH) > 0) {
-			tmp = zif_package_get_name_arch (package);
-			for (j = 0; search_native[j] != NULL; j++) {
-				if (compare_func (tmp, search_native[j]))
-					g_ptr_array_add (array, g_object_ref (package));
-			}
-		}
-
-		/* name-version */
-		if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION) > 0) {
-			tmp = zif_package_get_name_version (package);
-			for (j = 0; search_native[j] != NULL; j++) {
-				if (compare_func (tmp, search_native[j]))
-					g_ptr_array_add (array, g_object_ref (package));
-			}
-		}
+		kind = ZIF_STR_MATCHER_KIND_EQUAL;
+	matchers = zif_str_matcher_array_new (search_native, kind, error);
+	if (matchers == NULL)
+		goto out;
 
-		/* name-version.arch */
-		if ((flags & ZIF_STORE_RESOLVE_FLAG_USE_NAME_VERSION_ARCH) > 0) {
-			tmp = zif_package_get_name_version_arch (package);
-			for (j = 0; search_native[j] != NULL; j++) {
-				if (compare_func (tmp, search_native[j]))
-					g_ptr_array_add (array, g_object_ref (package));
-			}
+	/* name, name.arch, name-version and name-version.arch */
+	array_tmp = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (i = 0; types[i] != 0; i++) {
+		if ((flags & types[i]) == 0)
+			continue;
+		index = zif_store_ensure_resolve_index (store, types[i]);
+		for (j = 0; j < matchers->len; j++) {
+			zif_store_resolve_index_match (store,
+						       index,
+						       g_ptr_array_index (matchers, j),
+						       array_tmp);
 		}
-
-		/* this section done */
-		ret = zif_state_done (state_local, error);
-		if (!ret)
-			goto out;
 	}
 
 	/* ensure we don't have duplicate packages */
-	zif_package_array_filter_duplicates (array);
+	zif_package_array_filter_duplicates (array_tmp);
 
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
 		goto out;
+
+	/* success */
+	array = g_ptr_array_ref (array_tmp);
 out:
+	if (array_tmp != NULL)
+		g_ptr_array_unref (array_tmp);
+	if (matchers != NULL)
+		g_ptr_array_unref (matchers);
 	g_strfreev (search_native);
 	return array;
 }
@@ -1383,6 +1611,117 @@ out:
 	return package_store;
 }
 
+/**
+ * zif_store_get_depend_index:
+ **/
+static GHashTable **
+zif_store_get_depend_index (ZifStore *store, ZifPackageEnsureType type)
+{
+	switch (type) {
+	case ZIF_PACKAGE_ENSURE_TYPE_PROVIDES:
+		return &store->priv->provides_index;
+	case ZIF_PACKAGE_ENSURE_TYPE_REQUIRES:
+		return &store->priv->requires_index;
+	case ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS:
+		return &store->priv->conflicts_index;
+	case ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES:
+		return &store->priv->obsoletes_index;
+	default:
+		g_assert_not_reached ();
+	}
+	return NULL;
+}
+
+/**
+ * zif_store_ensure_depend_index:
+ *
+ * The index maps a depend name to an array of the packages that have
+ * at least one depend of @type with that name, so that the depend
+ * version checks only have to be done on the packages that can match.
+ *
+ * The keys are interned depend names, so they are hashed by pointer.
+ * The packages are not owned by the index, as they are kept alive by
+ * the packages array and the index is invalidated whenever a package
+ * is added or removed.
+ **/
+static GHashTable *
+zif_store_ensure_depend_index (ZifStore *store,
+			       ZifPackageEnsureType type,
+			       ZifState *state,
+			       GError **error)
+{
+	gboolean ret;
+	GHashTable **index;
+	GHashTable *hash;
+	GArray *depends;
+	GPtrArray *bucket;
+	guint i, j;
+	ZifDependEntry *entry;
+	ZifPackage *package;
+	ZifState *state_local;
+	ZifString *name;
+
+	/* already built */
+	index = zif_store_get_depend_index (store, type);
+	if (*index != NULL)
+		return *index;
+
+	/* setup steps */
+	hash = g_hash_table_new_full (g_direct_hash,
+				      g_direct_equal,
+				      (GDestroyNotify) zif_string_unref,
+				      (GDestroyNotify) g_ptr_array_unref);
+	if (store->priv->packages->len > 0)
+		zif_state_set_number_steps (state, store->priv->packages->len);
+
+	/* add each depend name */
+	for (i = 0; i < store->priv->packages->len; i++) {
+		package = g_ptr_array_index (store->priv->packages, i);
+		state_local = zif_state_get_child (state);
+
+		/* file lists are searched separately for provides */
+		depends = zif_package_get_depend_entries (package,
+							  type,
+							  state_local,
+							  error);
+		if (depends == NULL) {
+			g_hash_table_unref (hash);
+			return NULL;
+		}
+		for (j = 0; j < depends->len; j++) {
+			entry = &g_array_index (depends, ZifDependEntry, j);
+			name = entry->name;
+			bucket = g_hash_table_lookup (hash, name);
+			if (bucket == NULL) {
+				bucket = g_ptr_array_new ();
+				g_hash_table_insert (hash, zif_string_ref (name), bucket);
+			}
+
+			/* packages can have more than one depend with the
+			 * same name, e.g. 'foo >= 1.0' and 'foo < 2.0' */
+			if (bucket->len > 0 &&
+			    g_ptr_array_index (bucket, bucket->len - 1) == package)
+				continue;
+			g_ptr_array_add (bucket, package);
+		}
+		g_array_unref (depends);
+
+		/* this section done */
+		ret = zif_state_done (state, error);
+		if (!ret) {
+			g_hash_table_unref (hash);
+			return NULL;
+		}
+	}
+
+	g_debug ("built %s index with %i names for %i packages",
+		 zif_package_ensure_type_to_string (type),
+		 g_hash_table_size (hash),
+		 store->priv->packages->len);
+	*index = hash;
+	return hash;
+}
+
 /**
  * zif_store_what_depends:
  **/
@@ -1393,10 +1732,14 @@ zif_store_what_depends (ZifStore *store,
 			ZifState *state,
 			GError **error)
 {
+	gchar **search = NULL;
 	GPtrArray *array = NULL;
 	GPtrArray *array_tmp = NULL;
+	GPtrArray *bucket;
 	GPtrArray *depends_tmp;
+	GHashTable *index;
 	guint i;
+	guint idx = 0;
 	ZifDepend *depend_tmp;
 	GError *error_local = NULL;
 	gboolean ret;
@@ -1408,16 +1751,21 @@ zif_store_what_depends (ZifStore *store,
 
 	/* setup steps */
 	if (store->priv->loaded) {
-		zif_state_set_number_steps (state, 1);
+		ret = zif_state_set_steps (state,
+					   error,
+					   90, /* index */
+					   10, /* search */
+					   -1);
 	} else {
 		ret = zif_state_set_steps (state,
 					   error,
 					   80, /* load */
-					   20, /* search */
+					   15, /* index */
+					   5, /* search */
 					   -1);
-		if (!ret)
-			goto out;
 	}
+	if (!ret)
+		goto out;
 
 	/* if not already loaded, load */
 	if (!store->priv->loaded) {
@@ -1448,31 +1796,47 @@ zif_store_what_depends (ZifStore *store,
 		goto out;
 	}
 
-	/* just use the helper function */
+	/* build the index if the packages have changed */
+	state_local = zif_state_get_child (state);
+	index = zif_store_ensure_depend_index (store, type, state_local, error);
+	if (index == NULL)
+		goto out;
+
+	/* this section done */
+	ret = zif_state_done (state, error);
+	if (!ret)
+		goto out;
+
+	/* just use the helper function on the packages with a
+	 * depend of the right name, rather than all of them */
 	state_local = zif_state_get_child (state);
 	array_tmp = zif_object_array_new ();
 	for (i = 0; i < depends->len; i++) {
 		depend_tmp = g_ptr_array_index (depends, i);
+		bucket = g_hash_table_lookup (index,
+					      zif_depend_get_name_str (depend_tmp));
+		if (bucket == NULL)
+			continue;
 		if (type == ZIF_PACKAGE_ENSURE_TYPE_PROVIDES) {
-			ret = zif_package_array_provide (store->priv->packages,
+			ret = zif_package_array_provide (bucket,
 							 depend_tmp, NULL,
 							 &depends_tmp,
 							 state_local,
 							 error);
 		} else if (type == ZIF_PACKAGE_ENSURE_TYPE_REQUIRES) {
-			ret = zif_package_array_require (store->priv->packages,
+			ret = zif_package_array_require (bucket,
 							 depend_tmp, NULL,
 							 &depends_tmp,
 							 state_local,
 							 error);
 		} else if (type == ZIF_PACKAGE_ENSURE_TYPE_CONFLICTS) {
-			ret = zif_package_array_conflict (store->priv->packages,
+			ret = zif_package_array_conflict (bucket,
 							  depend_tmp, NULL,
 							  &depends_tmp,
 							  state_local,
 							  error);
 		} else if (type == ZIF_PACKAGE_ENSURE_TYPE_OBSOLETES) {
-			ret = zif_package_array_obsolete (store->priv->packages,
+			ret = zif_package_array_obsolete (bucket,
 							  depend_tmp, NULL,
 							  &depends_tmp,
 							  state_local,
@@ -1488,6 +1852,31 @@ zif_store_what_depends (ZifStore *store,
 		g_ptr_array_unref (depends_tmp);
 	}
 
+	/* only now look at file lists, and only for file depends */
+	if (type == ZIF_PACKAGE_ENSURE_TYPE_PROVIDES) {
+		search = g_new0 (gchar *, depends->len + 1);
+		for (i = 0; i < depends->len; i++) {
+			depend_tmp = g_ptr_array_index (depends, i);
+			if (zif_depend_get_flag (depend_tmp) != ZIF_DEPEND_FLAG_ANY)
+				continue;
+			if (zif_depend_get_name (depend_tmp)[0] != '/')
+				continue;
+			search[idx++] = g_strdup (zif_depend_get_name (depend_tmp));
+		}
+		if (idx > 0) {
+			zif_state_reset (state_local);
+			depends_tmp = zif_store_search_file (store,
+							     search,
+							     state_local,
+							     error);
+			if (depends_tmp == NULL)
+				goto out;
+			zif_object_array_add_array (array_tmp, depends_tmp);
+			g_ptr_array_unref (depends_tmp);
+			zif_package_array_filter_duplicates (array_tmp);
+		}
+	}
+
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
@@ -1496,6 +1885,7 @@ zif_store_what_depends (ZifStore *store,
 	/* success */
 	array = g_ptr_array_ref (array_tmp);
 out:
+	g_strfreev (search);
 	if (array_tmp != NULL)
 		g_ptr_array_unref (array_tmp);
 	return array;
@@ -2037,6 +2427,7 @@ zif_store_finalize (GObject *object)
 	store = ZIF_STORE (object);
 	g_ptr_array_unref (store->priv->packages);
 	g_hash_table_destroy (store->priv->package_id_hash);
+	zif_store_invalidate_indexes (store);
 
 	G_OBJECT_CLASS (zif_store_parent_class)->finalize (object);
 }
@@ -25,6 +25,13 @@
  *
  * To avoid frequent malloc/free, we use reference counted strings to
  * optimise many of the zif internals.
+ *
+ * Strings that are repeated in many packages, for instance the license
+ * or the depend names, can be interned with zif_string_new_intern() so
+ * that only one copy is kept and equal strings have the same pointer.
+ *
+ * The reference count is atomic, as packages and their strings are
+ * shared between the threads that load and search stores.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -35,14 +42,31 @@
 
 #include "zif-utils.h"
 #include "zif-string.h"
+#include "zif-string-private.h"
+#include "zif-utils-private.h"
 
 /* private structure */
 typedef struct {
 	gchar		*value;
-	guint		 count;
+	gint		 count;
 	gboolean	 is_static;
+	gboolean	 is_interned;
+	guint		 shard;
 } ZifStringInternal;
 
+/* the pool is split so that threads loading different stores do not
+ * all wait on the same lock */
+#define ZIF_STRING_POOL_SHARDS		16
+
+typedef struct {
+	GMutex		 mutex;
+	GHashTable	*hash;
+	guint		 lookups;
+	guint		 hits;
+} ZifStringPoolShard;
+
+static ZifStringPoolShard zif_string_pool[ZIF_STRING_POOL_SHARDS];
+
 /**
  * zif_string_new: (skip)
  * @value: string to copy
@@ -61,6 +85,7 @@ zif_string_new (const gchar *value)
 	string->count = 1;
 	string->value = g_strdup (value);
 	string->is_static = FALSE;
+	string->is_interned = FALSE;
 	return (ZifString *) string;
 }
 
@@ -83,6 +108,7 @@ zif_string_new_value (gchar *value)
 	string->count = 1;
 	string->value = value;
 	string->is_static = FALSE;
+	string->is_interned = FALSE;
 	return (ZifString *) string;
 }
 
@@ -106,9 +132,139 @@ zif_string_new_static (const gchar *value)
 	string->count = 1;
 	string->value = (gchar*) value;
 	string->is_static = TRUE;
+	string->is_interned = FALSE;
+	return (ZifString *) string;
+}
+
+/**
+ * zif_string_new_intern: (skip)
+ * @value: string to copy
+ *
+ * Gets a referenced counted string from the shared pool, creating it
+ * if no other interned string has the same value. Interned strings
+ * with the same value always have the same pointer.
+ *
+ * Interned strings can be shared between threads.
+ *
+ * Return value: Interned string
+ *
+ * Since: 0.3.7
+ **/
+ZifString *
+zif_string_new_intern (const gchar *value)
+{
+	guint shard;
+	ZifStringInternal *string;
+	ZifStringPoolShard *pool;
+
+	g_return_val_if_fail (value != NULL, NULL);
+
+	shard = g_str_hash (value) % ZIF_STRING_POOL_SHARDS;
+	pool = &zif_string_pool[shard];
+	g_mutex_lock (&pool->mutex);
+	if (pool->hash == NULL)
+		pool->hash = g_hash_table_new (g_str_hash, g_str_equal);
+	pool->lookups++;
+
+	/* already exists */
+	string = g_hash_table_lookup (pool->hash, value);
+	if (string != NULL) {
+		pool->hits++;
+		g_atomic_int_inc (&string->count);
+		goto out;
+	}
+
+	/* add to the pool, which does not hold a reference */
+	string = g_slice_new (ZifStringInternal);
+	string->count = 1;
+	string->value = g_strdup (value);
+	string->is_static = FALSE;
+	string->is_interned = TRUE;
+	string->shard = shard;
+	g_hash_table_insert (pool->hash, string->value, string);
+out:
+	g_mutex_unlock (&pool->mutex);
 	return (ZifString *) string;
 }
 
+/**
+ * zif_string_is_interned: (skip)
+ * @string: A #ZifString
+ *
+ * Gets if the string was created with zif_string_new_intern(). If two
+ * interned strings have different pointers then the values are
+ * different too.
+ *
+ * Return value: %TRUE if the string is from the shared pool
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_string_is_interned (ZifString *string)
+{
+	ZifStringInternal *internal = (ZifStringInternal *) string;
+	g_return_val_if_fail (internal != NULL, FALSE);
+	return internal->is_interned;
+}
+
+/**
+ * zif_string_get_pool_stats: (skip)
+ * @size: (out) (allow-none): The number of strings in the pool
+ * @lookups: (out) (allow-none): The number of calls to zif_string_new_intern()
+ * @hits: (out) (allow-none): The number of calls that found an existing string
+ *
+ * Gets debugging information about the shared string pool, where the
+ * hit rate is @hits divided by @lookups.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_string_get_pool_stats (guint *size, guint *lookups, guint *hits)
+{
+	guint i;
+	guint size_tmp = 0;
+	guint lookups_tmp = 0;
+	guint hits_tmp = 0;
+	ZifStringPoolShard *pool;
+
+	for (i = 0; i < ZIF_STRING_POOL_SHARDS; i++) {
+		pool = &zif_string_pool[i];
+		g_mutex_lock (&pool->mutex);
+		if (pool->hash != NULL)
+			size_tmp += g_hash_table_size (pool->hash);
+		lookups_tmp += pool->lookups;
+		hits_tmp += pool->hits;
+		g_mutex_unlock (&pool->mutex);
+	}
+	if (size != NULL)
+		*size = size_tmp;
+	if (lookups != NULL)
+		*lookups = lookups_tmp;
+	if (hits != NULL)
+		*hits = hits_tmp;
+}
+
+/**
+ * zif_string_unref_interned:
+ *
+ * The pool lock is held when the last reference is dropped so that
+ * zif_string_new_intern() cannot return a string that is being freed.
+ **/
+static ZifString *
+zif_string_unref_interned (ZifStringInternal *internal)
+{
+	ZifStringPoolShard *pool;
+
+	pool = &zif_string_pool[internal->shard];
+	if (!zif_atomic_dec_and_lock (&internal->count, &pool->mutex))
+		return (ZifString *) internal;
+	g_hash_table_remove (pool->hash, internal->value);
+	g_mutex_unlock (&pool->mutex);
+	g_free (internal->value);
+	g_slice_free (ZifStringInternal, internal);
+	return NULL;
+}
+
 /**
  * zif_string_ref: (skip)
  * @string: A #ZifString
@@ -124,7 +280,7 @@ zif_string_ref (ZifString *string)
 {
 	ZifStringInternal *internal = (ZifStringInternal *) string;
 	g_return_val_if_fail (internal != NULL, NULL);
-	internal->count++;
+	g_atomic_int_inc (&internal->count);
 	return string;
 }
 
@@ -144,13 +300,13 @@ zif_string_unref (ZifString *string)
 {
 	ZifStringInternal *internal = (ZifStringInternal *) string;
 	g_return_val_if_fail (internal != NULL, NULL);
-	internal->count--;
-	if (internal->count == 0) {
-		if (!internal->is_static)
-			g_free (internal->value);
-		g_slice_free (ZifStringInternal, internal);
-		internal = NULL;
-	}
-	return (ZifString *) internal;
+	if (internal->is_interned)
+		return zif_string_unref_interned (internal);
+	if (!g_atomic_int_dec_and_test (&internal->count))
+		return string;
+	if (!internal->is_static)
+		g_free (internal->value);
+	g_slice_free (ZifStringInternal, internal);
+	return NULL;
 }
 
@@ -34,6 +34,10 @@ G_BEGIN_DECLS
 
 gboolean	 zif_transaction_write_history		(ZifTransaction	*transaction,
 							 GError		**error);
+void		 zif_transaction_get_provide_stats	(ZifTransaction	*transaction,
+							 guint		*searches,
+							 guint		*hits,
+							 guint		*prefetched);
 
 G_END_DECLS
 
@@ -90,6 +90,15 @@ struct _ZifTransactionPrivate
 	GHashTable		*install_hash;	/* of ZifTransactionItem */
 	GHashTable		*update_hash;	/* of ZifTransactionItem */
 	GHashTable		*remove_hash;	/* of ZifTransactionItem */
+	GQueue			*install_pending; /* of ZifPackage */
+	GQueue			*update_pending; /* of ZifPackage */
+	GQueue			*remove_pending; /* of ZifPackage */
+	GHashTable		*provide_remote_hash; /* of GPtrArray */
+	GHashTable		*provide_best_hash; /* of ZifPackage */
+	guint			 provide_remote_searches;
+	guint			 provide_remote_hits;
+	guint			 provide_prefetched;
+	guint			 serial;
 	ZifStore		*store_local;
 	ZifConfig		*config;
 	ZifDb			*db;
@@ -110,16 +119,20 @@ typedef struct {
 	gboolean		 unresolved_dependencies;
 	ZifStore		*post_resolve_package_array;
 	guint			 resolve_count;
+	guint			 items_done;
 	gboolean		 skip_broken;
+	gboolean		 batch_depsolve;
 } ZifTransactionResolve;
 
 G_DEFINE_TYPE (ZifTransaction, zif_transaction, G_TYPE_OBJECT)
 
 typedef struct {
 	ZifPackage		*package;
+	guint			 serial;	/* of the transaction */
 	GPtrArray		*related_packages; /* of ZifPackage */
 	gboolean		 resolved;
 	gboolean		 cancelled;
+	gboolean		 prefetched;
 	ZifTransactionReason	 reason;
 } ZifTransactionItem;
 
@@ -542,8 +555,10 @@ zif_transaction_get_array_for_reason (ZifTransaction *transaction,
  * zif_transaction_add_to_array:
  **/
 static gboolean
-zif_transaction_add_to_array (GPtrArray *array,
+zif_transaction_add_to_array (ZifTransaction *transaction,
+			      GPtrArray *array,
 			      GHashTable *hash,
+			      GQueue *pending,
 			      ZifPackage *package,
 			      GPtrArray *related_packages,
 			      ZifTransactionReason reason)
@@ -560,6 +575,15 @@ zif_transaction_add_to_array (GPtrArray *array,
 
 	/* create new item */
 	item = zif_transaction_package_get_item (package);
+
+	/* the package may be shared with a transaction that is gone or
+	 * was reset, so do not use what was depsolved there */
+	if (item->serial != transaction->priv->serial) {
+		item->serial = transaction->priv->serial;
+		item->cancelled = FALSE;
+		item->prefetched = FALSE;
+		g_ptr_array_set_size (item->related_packages, 0);
+	}
 	item->reason = reason;
 	item->resolved = FALSE;
 	g_ptr_array_add (array, g_object_ref (package));
@@ -580,6 +604,9 @@ zif_transaction_add_to_array (GPtrArray *array,
 			     g_strdup (zif_package_get_id (package)),
 			     item);
 
+	/* the depsolver only has to look at this once */
+	g_queue_push_tail (pending, g_object_ref (package));
+
 	/* success */
 	ret = TRUE;
 out:
@@ -671,8 +698,10 @@ zif_transaction_add_install_internal (ZifTransaction *transaction,
 		goto out;
 
 	/* add to install */
-	ret = zif_transaction_add_to_array (transaction->priv->install,
+	ret = zif_transaction_add_to_array (transaction,
+					    transaction->priv->install,
 					    transaction->priv->install_hash,
+					    transaction->priv->install_pending,
 					    package,
 					    related_packages,
 					    reason);
@@ -811,8 +840,10 @@ zif_transaction_add_update_internal (ZifTransaction *transaction,
 		goto out;
 
 	/* add to update */
-	ret = zif_transaction_add_to_array (transaction->priv->update,
+	ret = zif_transaction_add_to_array (transaction,
+					    transaction->priv->update,
 					    transaction->priv->update_hash,
+					    transaction->priv->update_pending,
 					    package,
 					    related_packages,
 					    reason);
@@ -973,8 +1004,10 @@ zif_transaction_add_remove_internal (ZifTransaction *transaction,
 	}
 
 	/* add to remove */
-	ret = zif_transaction_add_to_array (transaction->priv->remove,
+	ret = zif_transaction_add_to_array (transaction,
+					    transaction->priv->remove,
 					    transaction->priv->remove_hash,
+					    transaction->priv->remove_pending,
 					    package,
 					    related_packages,
 					    reason);
@@ -1032,6 +1065,9 @@ typedef struct {
 	gchar		*archinfo;
 	ZifDepend	*best_depend;
 	ZifPackage	*package_reason;
+	const gchar	*name_common;
+	const gchar	*srpm_common;
+	gboolean	 reason_independent;
 } ZifTransactionProvideData;
 
 /**
@@ -1145,6 +1181,17 @@ zif_transaction_filter_get_score (ZifTransaction *transaction,
 	if (g_strcmp0 (srpm_tmp, provide_data->srpm_reason) == 0)
 		*score += 20;
 
+	/* if all the candidates have the same name and source package then
+	 * the srpm and name scores are the same for each of them and only
+	 * the arch of the reason package can change the result */
+	if (provide_data->name_common == NULL) {
+		provide_data->name_common = zif_package_get_name (package);
+		provide_data->srpm_common = srpm_tmp;
+	} else if (g_strcmp0 (provide_data->name_common, zif_package_get_name (package)) != 0 ||
+		   g_strcmp0 (provide_data->srpm_common, srpm_tmp) != 0) {
+		provide_data->reason_independent = FALSE;
+	}
+
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
@@ -1203,6 +1250,9 @@ out:
  * 3c) Filter by less new deps to install
  * 4) Filter by shorter name
  * 5) Filter by highest alphabetically wins
+ *
+ * If @reason_independent is set to %TRUE then the same package would
+ * be chosen for any package_reason of the same arch.
  **/
 static gboolean
 zif_transaction_filter_best_provide (ZifTransaction *transaction,
@@ -1210,6 +1260,7 @@ zif_transaction_filter_best_provide (ZifTransaction *transaction,
 				     ZifPackage *package_reason,
 				     ZifDepend *depend,
 				     ZifPackage **package_dep,
+				     gboolean *reason_independent,
 				     ZifState *state,
 				     GError **error)
 {
@@ -1238,6 +1289,7 @@ zif_transaction_filter_best_provide (ZifTransaction *transaction,
 	/* create struct for convenience */
 	provide_data = g_new0 (ZifTransactionProvideData, 1);
 	provide_data->package_reason = g_object_ref (package_reason);
+	provide_data->reason_independent = TRUE;
 
 	/* get the best depend for the results */
 	state_local = zif_state_get_child (state);
@@ -1299,6 +1351,8 @@ zif_transaction_filter_best_provide (ZifTransaction *transaction,
 		if (!ret)
 			goto out;
 		*package_dep = g_object_ref (g_ptr_array_index (array, 0));
+		if (reason_independent != NULL)
+			*reason_independent = TRUE;
 		goto out;
 	}
 
@@ -1383,6 +1437,8 @@ zif_transaction_filter_best_provide (ZifTransaction *transaction,
 		g_error_free (error_local);
 		goto out;
 	}
+	if (reason_independent != NULL)
+		*reason_independent = provide_data->reason_independent;
 out:
 	g_free (scores);
 	if (array_best != NULL)
@@ -1500,6 +1556,7 @@ zif_transaction_get_package_provide_from_local (ZifTransaction *transaction,
 							   package_reason,
 							   depend,
 							   package,
+							   NULL,
 							   state_local,
 							   error);
 		if (!ret)
@@ -1649,15 +1706,33 @@ zif_transaction_get_package_provide_from_remote (ZifTransaction *transaction,
 						 ZifState *state,
 						 GError **error)
 {
+	gboolean reason_independent = FALSE;
 	gboolean ret;
+	gchar *best_key = NULL;
 	GError *error_local = NULL;
 	GPtrArray *array = NULL;
 	GPtrArray *array_tmp;
 	GPtrArray *depend_array = NULL;
 	guint i;
+	ZifPackage *package_tmp;
 	ZifState *state_local;
 	ZifState *state_loop;
 	ZifStore *store;
+	ZifTransactionPrivate *priv = transaction->priv;
+
+	/* we've already chosen a provide for this */
+	best_key = g_strdup_printf ("%s|%s",
+				    zif_depend_get_description (depend),
+				    zif_package_get_arch (package_reason));
+	package_tmp = g_hash_table_lookup (priv->provide_best_hash, best_key);
+	if (package_tmp != NULL) {
+		g_debug ("using cached provide %s for %s",
+			 zif_package_get_id (package_tmp),
+			 best_key);
+		*package = g_object_ref (package_tmp);
+		ret = zif_state_finished (state, error);
+		goto out;
+	}
 
 	/* setup states */
 	ret = zif_state_set_steps (state,
@@ -1668,19 +1743,33 @@ zif_transaction_get_package_provide_from_remote (ZifTransaction *transaction,
 	if (!ret)
 		goto out;
 
+	/* we've already searched the remote stores for this */
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	array_tmp = g_hash_table_lookup (priv->provide_remote_hash,
+					 zif_depend_get_description (depend));
+	if (array_tmp != NULL) {
+		priv->provide_remote_hits++;
+		zif_object_array_add_array (array, array_tmp);
+		state_local = zif_state_get_child (state);
+		ret = zif_state_finished (state_local, error);
+		if (!ret)
+			goto out;
+		goto skip_search;
+	}
+
 	/* add to array for searching */
+	priv->provide_remote_searches++;
 	depend_array = zif_object_array_new ();
 	zif_object_array_add (depend_array, depend);
 
 	/* set steps */
 	state_local = zif_state_get_child (state);
 	zif_state_set_number_steps (state_local,
-				    transaction->priv->stores_remote->len);
+				    priv->stores_remote->len);
 
 	/* find the depend in the store array */
-	array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-	for (i = 0; i < transaction->priv->stores_remote->len; i++) {
-		store = g_ptr_array_index (transaction->priv->stores_remote, i);
+	for (i = 0; i < priv->stores_remote->len; i++) {
+		store = g_ptr_array_index (priv->stores_remote, i);
 
 		/* check if the store is still enabled */
 		if (!zif_store_get_enabled (store)) {
@@ -1736,14 +1825,22 @@ zif_transaction_get_package_provide_from_remote (ZifTransaction *transaction,
 			goto out;
 	}
 
+	/* filter */
+	zif_package_array_filter_duplicates (array);
+
+	/* save a copy, as the filtering modifies the array */
+	array_tmp = zif_object_array_new ();
+	zif_object_array_add_array (array_tmp, array);
+	g_hash_table_insert (priv->provide_remote_hash,
+			     g_strdup (zif_depend_get_description (depend)),
+			     array_tmp);
+skip_search:
+
 	/* done */
 	ret = zif_state_done (state, error);
 	if (!ret)
 		goto out;
 
-	/* filter */
-	zif_package_array_filter_duplicates (array);
-
 	/* success, but found nothing */
 	g_debug ("found %i provides for %s",
 		 array->len,
@@ -1760,11 +1857,20 @@ zif_transaction_get_package_provide_from_remote (ZifTransaction *transaction,
 						   package_reason,
 						   depend,
 						   package,
+						   &reason_independent,
 						   state_local,
 						   error);
 	if (!ret)
 		goto out;
 
+	/* any package of this arch asking for this would get the same */
+	if (reason_independent) {
+		g_hash_table_insert (priv->provide_best_hash,
+				     best_key,
+				     g_object_ref (*package));
+		best_key = NULL;
+	}
+
 	/* done */
 	ret = zif_state_done (state, error);
 	if (!ret)
@@ -1773,6 +1879,7 @@ zif_transaction_get_package_provide_from_remote (ZifTransaction *transaction,
 	/* success */
 	ret = TRUE;
 out:
+	g_free (best_key);
 	if (depend_array != NULL)
 		g_ptr_array_unref (depend_array);
 	if (array != NULL)
@@ -3299,6 +3406,9 @@ zif_transaction_resolve_wind_back_failure (ZifTransaction *transaction, ZifTrans
 		 zif_package_get_id (item->package));
 	item->cancelled = TRUE;
 
+	/* a cached provide may have been one of the things we cancelled */
+	g_hash_table_remove_all (transaction->priv->provide_best_hash);
+
 	/* remove the things we just added to the install queue too */
 	zif_transaction_resolve_wind_back_failure_package (transaction,
 							   item->package);
@@ -3309,55 +3419,27 @@ zif_transaction_resolve_wind_back_failure (ZifTransaction *transaction, ZifTrans
 	}
 }
 
-/**
- * zif_transaction_get_array_resolved:
- **/
-static guint
-zif_transaction_get_array_resolved (GPtrArray *array)
-{
-	guint i;
-	guint resolved_items = 0;
-	ZifPackage *package_tmp;
-	ZifTransactionItem *item;
-
-	/* count each transaction that's been processed or ignored */
-	for (i = 0; i < array->len; i++) {
-		package_tmp = g_ptr_array_index (array, i);
-		item = zif_transaction_package_get_item (package_tmp);
-		if (item->resolved ||
-		    item->cancelled) {
-			resolved_items++;
-			continue;
-		}
-	}
-	return resolved_items;
-}
-
 /**
  * zif_transaction_set_progress:
  **/
 static void
-zif_transaction_set_progress (ZifTransaction *transaction, ZifState *state)
+zif_transaction_set_progress (ZifTransactionResolve *data, ZifState *state)
 {
 	guint max_items;
 	guint percentage = 100;
-	guint resolved_items;
+	ZifTransactionPrivate *priv = data->transaction->priv;
 
 	/* update implies install *and* remove */
-	max_items = transaction->priv->install->len +
-		    (2 * transaction->priv->update->len)+
-		    transaction->priv->remove->len;
-
-	/* calculate how many we've already processed */
-	resolved_items = zif_transaction_get_array_resolved (transaction->priv->install);
-	resolved_items += zif_transaction_get_array_resolved (transaction->priv->remove);
-	resolved_items += 2 * zif_transaction_get_array_resolved (transaction->priv->update);
+	max_items = data->items_done +
+		    g_queue_get_length (priv->install_pending) +
+		    (2 * g_queue_get_length (priv->update_pending)) +
+		    g_queue_get_length (priv->remove_pending);
 
 	/* calculate using a rough metric */
 	if (max_items > 0)
-		percentage = resolved_items * 100 / max_items;
+		percentage = data->items_done * 100 / max_items;
 	g_debug ("progress is %i/%i (%i%%)",
-		 resolved_items, max_items, percentage);
+		 data->items_done, max_items, percentage);
 
 	/* only set if the percentage is going to go up */
 	if (zif_state_get_percentage (state) < percentage)
@@ -3395,6 +3477,72 @@ zif_transaction_item_sort_cb (ZifPackage **a, ZifPackage **b)
 			  zif_package_get_name (*b));
 }
 
+/**
+ * zif_transaction_pending_clear:
+ **/
+static void
+zif_transaction_pending_clear (GQueue *pending)
+{
+	g_queue_foreach (pending, (GFunc) g_object_unref, NULL);
+	g_queue_clear (pending);
+}
+
+/**
+ * zif_transaction_pending_seed:
+ *
+ * Adds anything that has not yet been depsolved, in the order it was
+ * added to the transaction.
+ **/
+static void
+zif_transaction_pending_seed (GQueue *pending, GPtrArray *array)
+{
+	guint i;
+	ZifPackage *package_tmp;
+	ZifTransactionItem *item;
+
+	zif_transaction_pending_clear (pending);
+	for (i = 0; i < array->len; i++) {
+		package_tmp = g_ptr_array_index (array, i);
+		item = zif_transaction_package_get_item (package_tmp);
+		if (item->resolved || item->cancelled)
+			continue;
+		item->prefetched = FALSE;
+		g_queue_push_tail (pending, g_object_ref (package_tmp));
+	}
+}
+
+/**
+ * zif_transaction_pending_pop:
+ *
+ * Installs always go first, as resolving an update or remove may add
+ * more packages to be installed.
+ *
+ * Return value: the next package to depsolve, which must be unreffed.
+ **/
+static ZifPackage *
+zif_transaction_pending_pop (ZifTransactionPrivate *priv, ZifStateAction *action)
+{
+	ZifPackage *package;
+
+	package = g_queue_pop_head (priv->install_pending);
+	if (package != NULL) {
+		*action = ZIF_STATE_ACTION_DEPSOLVING_INSTALL;
+		goto out;
+	}
+	package = g_queue_pop_head (priv->update_pending);
+	if (package != NULL) {
+		*action = ZIF_STATE_ACTION_DEPSOLVING_UPDATE;
+		goto out;
+	}
+	package = g_queue_pop_head (priv->remove_pending);
+	if (package != NULL) {
+		*action = ZIF_STATE_ACTION_DEPSOLVING_REMOVE;
+		goto out;
+	}
+out:
+	return package;
+}
+
 /**
  * zif_transaction_setup_post_resolve_package_array:
  *
@@ -3462,185 +3610,313 @@ out:
 }
 
 /**
- * zif_transaction_resolve_loop:
+ * zif_transaction_prefetch_add_requires:
  **/
-static gboolean
-zif_transaction_resolve_loop (ZifTransactionResolve *data, ZifState *state, GError **error)
+static void
+zif_transaction_prefetch_add_requires (ZifTransactionResolve *data,
+				       ZifPackage *package,
+				       GHashTable *depends_hash,
+				       GPtrArray *depends)
 {
-	gboolean ret = FALSE;
+	const gchar *description;
+	const gchar *name;
 	GError *error_local = NULL;
+	GPtrArray *requires;
 	guint i;
-	ZifPackage *package_tmp;
+	ZifDepend *depend;
 	ZifTransactionItem *item;
 	ZifTransactionPrivate *priv = data->transaction->priv;
 
-	/* reset here */
-	data->resolve_count++;
-	data->unresolved_dependencies = FALSE;
+	item = zif_transaction_package_get_item (package);
+	if (item->prefetched || item->resolved || item->cancelled)
+		return;
+	item->prefetched = TRUE;
 
-	/* for each package set to be installed */
-	g_debug ("starting INSTALL on loop %i", data->resolve_count);
-	for (i = 0; i < priv->install->len; i++) {
-		package_tmp = g_ptr_array_index (priv->install, i);
-		item = zif_transaction_package_get_item (package_tmp);
-		if (item->resolved)
+	/* get requires of the package, any error is reported when
+	 * the item itself gets resolved */
+	zif_state_reset (data->state);
+	requires = zif_package_get_requires (package, data->state, &error_local);
+	if (requires == NULL) {
+		g_debug ("failed to get requires to prefetch: %s",
+			 error_local->message);
+		g_error_free (error_local);
+		return;
+	}
+	for (i = 0; i < requires->len; i++) {
+		depend = g_ptr_array_index (requires, i);
+
+		/* file depends need the filelists, and rpmlib depends are
+		 * never in the remote stores, so leave these to be
+		 * resolved one at a time if they are not installed */
+		name = zif_depend_get_name (depend);
+		if (name[0] == '/' || g_str_has_prefix (name, "rpmlib("))
 			continue;
-		if (item->cancelled)
+
+		/* already searched, or going to be */
+		description = zif_depend_get_description (depend);
+		if (g_hash_table_lookup (priv->provide_remote_hash, description) != NULL)
 			continue;
+		if (g_hash_table_lookup (depends_hash, description) != NULL)
+			continue;
+		g_hash_table_insert (depends_hash,
+				     (gpointer) description,
+				     depend);
+		g_ptr_array_add (depends, g_object_ref (depend));
+	}
+	g_ptr_array_unref (requires);
+}
 
-		/* set action */
-		zif_state_action_start (state,
-					ZIF_STATE_ACTION_DEPSOLVING_INSTALL,
-					zif_package_get_id (item->package));
+/**
+ * zif_transaction_prefetch_provides:
+ *
+ * Gets the requires of every install item in this round and searches
+ * for all of them with one query per remote store, saving the results
+ * so that the provides do not have to be searched for one at a time.
+ **/
+static void
+zif_transaction_prefetch_provides (ZifTransactionResolve *data,
+				   ZifPackage *package)
+{
+	GError *error_local = NULL;
+	GHashTable *depends_hash;
+	GList *l;
+	GPtrArray *array = NULL;
+	GPtrArray *array_depend = NULL;
+	GPtrArray *array_tmp;
+	GPtrArray *depends;
+	guint i;
+	ZifDepend *depend;
+	ZifStore *store;
+	ZifStore *store_results = NULL;
+	ZifTransactionPrivate *priv = data->transaction->priv;
 
-		/* resolve this item */
-		ret = zif_transaction_resolve_install_item (data, item, &error_local);
-		if (!ret) {
-			g_assert (error_local != NULL);
-			/* special error code */
-			if (error_local->code == ZIF_TRANSACTION_ERROR_NOTHING_TO_DO) {
-				g_debug ("REMOVE %s as nothing to do: %s",
-					 zif_package_get_id (item->package),
+	/* get all the requires we've not seen before */
+	depends = zif_object_array_new ();
+	depends_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	zif_transaction_prefetch_add_requires (data,
+					       package,
+					       depends_hash,
+					       depends);
+	for (l = priv->install_pending->head; l != NULL; l = l->next) {
+		zif_transaction_prefetch_add_requires (data,
+						       l->data,
+						       depends_hash,
+						       depends);
+	}
+	if (depends->len == 0)
+		goto out;
+
+	/* search each store just once */
+	array = zif_object_array_new ();
+	for (i = 0; i < priv->stores_remote->len; i++) {
+		store = g_ptr_array_index (priv->stores_remote, i);
+		if (!zif_store_get_enabled (store))
+			continue;
+		zif_state_reset (data->state);
+		array_tmp = zif_store_what_provides (store,
+						     depends,
+						     data->state,
+						     &error_local);
+		if (array_tmp == NULL) {
+			/* an empty or disabled store just has nothing
+			 * to add, so carry on with the others */
+			if (g_error_matches (error_local,
+					     ZIF_STORE_ERROR,
+					     ZIF_STORE_ERROR_ARRAY_IS_EMPTY) ||
+			    g_error_matches (error_local,
+					     ZIF_STORE_ERROR,
+					     ZIF_STORE_ERROR_NOT_ENABLED)) {
+				g_debug ("ignoring %s when prefetching provides: %s",
+					 zif_store_get_id (store),
 					 error_local->message);
-				g_ptr_array_remove (priv->install,
-						    package_tmp);
-				data->unresolved_dependencies = TRUE;
 				g_clear_error (&error_local);
-				break;
+				continue;
 			}
-			if (data->skip_broken) {
-				g_debug ("ignoring install error as we're skip-broken: %s",
+
+			/* the depends will get searched for one at a time
+			 * and any error will get handled there */
+			g_debug ("failed to prefetch provides from %s: %s",
+				 zif_store_get_id (store),
+				 error_local->message);
+			g_clear_error (&error_local);
+			goto out;
+		}
+		zif_object_array_add_array (array, array_tmp);
+		g_ptr_array_unref (array_tmp);
+	}
+	zif_package_array_filter_duplicates (array);
+	g_debug ("prefetched %i provides for %i depends",
+		 array->len, depends->len);
+
+	/* put the results in a store so we can split them up quickly */
+	store_results = zif_store_meta_new ();
+	zif_store_add_packages (store_results, array, NULL);
+	array_depend = zif_object_array_new ();
+	for (i = 0; i < depends->len; i++) {
+		depend = g_ptr_array_index (depends, i);
+		g_ptr_array_set_size (array_depend, 0);
+		g_ptr_array_add (array_depend, g_object_ref (depend));
+		array_tmp = NULL;
+		if (array->len > 0) {
+			zif_state_reset (data->state);
+			array_tmp = zif_store_what_provides (store_results,
+							     array_depend,
+							     data->state,
+							     &error_local);
+			if (array_tmp == NULL) {
+				g_debug ("failed to split prefetched provides: %s",
 					 error_local->message);
-				zif_transaction_resolve_wind_back_failure (data->transaction,
-									   item);
 				g_clear_error (&error_local);
-				break;
+				goto out;
 			}
-			g_propagate_error (error, error_local);
-			goto out;
+		} else {
+			array_tmp = zif_object_array_new ();
 		}
-
-		/* this item is done */
-		item->resolved = TRUE;
-		data->unresolved_dependencies = TRUE;
-
-		/* set the approximate progress if possible */
-		zif_transaction_set_progress (data->transaction, state);
-		goto out;
+		g_hash_table_insert (priv->provide_remote_hash,
+				     g_strdup (zif_depend_get_description (depend)),
+				     array_tmp);
+		priv->provide_prefetched++;
 	}
+out:
+	if (store_results != NULL)
+		g_object_unref (store_results);
+	if (array_depend != NULL)
+		g_ptr_array_unref (array_depend);
+	if (array != NULL)
+		g_ptr_array_unref (array);
+	g_hash_table_unref (depends_hash);
+	g_ptr_array_unref (depends);
+}
 
-	/* for each package set to be updated */
-	g_debug ("starting UPDATE on loop %i", data->resolve_count);
-	for (i = 0; i < priv->update->len; i++) {
-		package_tmp = g_ptr_array_index (priv->update, i);
-		item = zif_transaction_package_get_item (package_tmp);
-		if (item->resolved)
-			continue;
-		if (item->cancelled)
-			continue;
-
-		/* set action */
-		zif_state_action_start (state,
-					ZIF_STATE_ACTION_DEPSOLVING_UPDATE,
-					zif_package_get_id (item->package));
+/**
+ * zif_transaction_resolve_item:
+ **/
+static gboolean
+zif_transaction_resolve_item (ZifTransactionResolve *data,
+			      ZifTransactionItem *item,
+			      ZifStateAction action,
+			      ZifState *state,
+			      GError **error)
+{
+	gboolean ret = FALSE;
+	GError *error_local = NULL;
+	GPtrArray *array = NULL;
+	ZifTransactionPrivate *priv = data->transaction->priv;
 
-		/* resolve this item */
+	/* set action */
+	zif_state_action_start (state,
+				action,
+				zif_package_get_id (item->package));
+
+	/* resolve this item */
+	switch (action) {
+	case ZIF_STATE_ACTION_DEPSOLVING_INSTALL:
+		array = priv->install;
+		ret = zif_transaction_resolve_install_item (data,
+							    item,
+							    &error_local);
+		break;
+	case ZIF_STATE_ACTION_DEPSOLVING_UPDATE:
+		array = priv->update;
 		ret = zif_transaction_resolve_update_item (data,
 							   item,
 							   &error_local);
-		if (!ret) {
-			g_assert (error_local != NULL);
-			/* special error code */
-			if (error_local->code == ZIF_TRANSACTION_ERROR_NOTHING_TO_DO) {
-				g_debug ("REMOVE %s as nothing to do: %s",
-					 zif_package_get_id (item->package),
-					 error_local->message);
-				g_ptr_array_remove (priv->update,
-						    package_tmp);
-				data->unresolved_dependencies = TRUE;
-				g_clear_error (&error_local);
-				break;
-			}
-			if (data->skip_broken) {
-				g_debug ("ignoring update error as we're skip-broken: %s",
-					 error_local->message);
-				zif_transaction_resolve_wind_back_failure (data->transaction,
-									   item);
-				g_ptr_array_remove (priv->update,
-						    package_tmp);
-				data->unresolved_dependencies = TRUE;
-				g_clear_error (&error_local);
-				break;
-			}
-			g_propagate_error (error, error_local);
+		break;
+	case ZIF_STATE_ACTION_DEPSOLVING_REMOVE:
+		array = priv->remove;
+		ret = zif_transaction_resolve_remove_item (data,
+							   item,
+							   &error_local);
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+	if (!ret) {
+		g_assert (error_local != NULL);
+		/* special error code */
+		if (error_local->code == ZIF_TRANSACTION_ERROR_NOTHING_TO_DO) {
+			g_debug ("REMOVE %s as nothing to do: %s",
+				 zif_package_get_id (item->package),
+				 error_local->message);
+			g_ptr_array_remove (array, item->package);
+			g_clear_error (&error_local);
+			ret = TRUE;
 			goto out;
 		}
-
-		/* this item is done */
-		g_ptr_array_remove (priv->update, package_tmp);
-		data->unresolved_dependencies = TRUE;
-
-		/* set the approximate progress if possible */
-		zif_transaction_set_progress (data->transaction, state);
+		if (data->skip_broken) {
+			g_debug ("ignoring %s error as we're skip-broken: %s",
+				 zif_state_action_to_string (action),
+				 error_local->message);
+			zif_transaction_resolve_wind_back_failure (data->transaction,
+								   item);
+			if (action != ZIF_STATE_ACTION_DEPSOLVING_INSTALL)
+				g_ptr_array_remove (array, item->package);
+			g_clear_error (&error_local);
+			ret = TRUE;
+			goto out;
+		}
+		g_propagate_error (error, error_local);
 		goto out;
 	}
 
-	/* for each package set to be removed */
-	g_debug ("starting REMOVE on loop %i", data->resolve_count);
-	for (i = 0; i < priv->remove->len; i++) {
-		package_tmp = g_ptr_array_index (priv->remove, i);
-		item = zif_transaction_package_get_item (package_tmp);
-		if (item->resolved) {
-			g_debug ("%s already resolved", zif_package_get_id (package_tmp));
-		}
-		if (item->resolved)
-			continue;
-		if (item->cancelled)
-			continue;
+	/* this item is done, updates are replaced by an install and remove */
+	if (action == ZIF_STATE_ACTION_DEPSOLVING_UPDATE) {
+		g_ptr_array_remove (array, item->package);
+		data->items_done += 2;
+	} else {
+		item->resolved = TRUE;
+		data->items_done++;
+	}
+out:
+	return ret;
+}
 
-		/* set action */
-		zif_state_action_start (state,
-					ZIF_STATE_ACTION_DEPSOLVING_REMOVE,
-					zif_package_get_id (item->package));
+/**
+ * zif_transaction_resolve_loop:
+ *
+ * Each package is pushed onto a pending queue when it is added to the
+ * transaction, so we only visit it once rather than rescanning all the
+ * arrays each time one item is resolved. The queues are only seeded
+ * from the arrays again when another loop is needed.
+ **/
+static gboolean
+zif_transaction_resolve_loop (ZifTransactionResolve *data, ZifState *state, GError **error)
+{
+	gboolean ret = FALSE;
+	GError *error_local = NULL;
+	guint i;
+	ZifPackage *package_tmp;
+	ZifStateAction action;
+	ZifTransactionItem *item;
+	ZifTransactionPrivate *priv = data->transaction->priv;
 
-		/* resolve this item */
-		ret = zif_transaction_resolve_remove_item (data,
-							   item,
-							   &error_local);
-		if (!ret) {
-			g_assert (error_local != NULL);
-			/* special error code */
-			if (error_local->code == ZIF_TRANSACTION_ERROR_NOTHING_TO_DO) {
-				g_debug ("REMOVE %s as nothing to do",
-					 zif_package_get_id (item->package));
-				g_ptr_array_remove (priv->remove,
-						    package_tmp);
-				data->unresolved_dependencies = TRUE;
-				g_clear_error (&error_local);
-				break;
-			}
-			if (data->skip_broken) {
-				g_debug ("ignoring remove error as we're skip-broken: %s",
-					 error_local->message);
-				zif_transaction_resolve_wind_back_failure (data->transaction,
-									   item);
-				g_ptr_array_remove (priv->remove,
-						    package_tmp);
-				data->unresolved_dependencies = TRUE;
-				g_clear_error (&error_local);
-				break;
-			}
-			g_propagate_error (error, error_local);
-			goto out;
+	/* reset here */
+	data->resolve_count++;
+	data->unresolved_dependencies = FALSE;
+
+	/* resolve everything that is waiting */
+	g_debug ("starting INSTALL, UPDATE and REMOVE on loop %i",
+		 data->resolve_count);
+	while ((package_tmp = zif_transaction_pending_pop (priv, &action)) != NULL) {
+		item = zif_transaction_package_get_item (package_tmp);
+		if (item->resolved || item->cancelled) {
+			g_object_unref (package_tmp);
+			continue;
 		}
 
-		/* this item is done */
-		item->resolved = TRUE;
-		data->unresolved_dependencies = TRUE;
+		/* search for the requires of this round all at once */
+		if (data->batch_depsolve &&
+		    action == ZIF_STATE_ACTION_DEPSOLVING_INSTALL &&
+		    !item->prefetched) {
+			zif_transaction_prefetch_provides (data, package_tmp);
+		}
+		ret = zif_transaction_resolve_item (data, item, action, state, error);
+		g_object_unref (package_tmp);
+		if (!ret)
+			goto out;
 
 		/* set the approximate progress if possible */
-		zif_transaction_set_progress (data->transaction, state);
-		goto out;
+		zif_transaction_set_progress (data, state);
 	}
 
 	/* check conflicts */
@@ -3675,6 +3951,21 @@ zif_transaction_resolve_loop (ZifTransactionResolve *data, ZifState *state, GErr
 		}
 	}
 
+	/* anything added when checking conflicts needs resolving too */
+	if (!g_queue_is_empty (priv->install_pending) ||
+	    !g_queue_is_empty (priv->update_pending) ||
+	    !g_queue_is_empty (priv->remove_pending))
+		data->unresolved_dependencies = TRUE;
+
+	/* the conflicts pass or a skip-broken wind back may have changed
+	 * items that were already popped, so queue everything that is
+	 * still not resolved, just like rescanning the arrays would */
+	if (data->unresolved_dependencies) {
+		zif_transaction_pending_seed (priv->install_pending, priv->install);
+		zif_transaction_pending_seed (priv->update_pending, priv->update);
+		zif_transaction_pending_seed (priv->remove_pending, priv->remove);
+	}
+
 	/* success */
 	ret = TRUE;
 out:
@@ -4235,6 +4526,9 @@ zif_transaction_resolve (ZifTransaction *transaction, ZifState *state, GError **
 	data->skip_broken = zif_config_get_boolean (priv->config,
 						    "skip_broken",
 						    NULL);
+	data->batch_depsolve = zif_config_get_boolean (priv->config,
+						       "batch_depsolve",
+						       NULL);
 
 	/*in background mode, perform the depsolving more slowly */
 	background = zif_config_get_boolean (priv->config,
@@ -4246,6 +4540,18 @@ zif_transaction_resolve (ZifTransaction *transaction, ZifState *state, GError **
 	if (!ret)
 		goto out;
 
+	/* the remote stores may have changed since the last resolve */
+	g_hash_table_remove_all (priv->provide_remote_hash);
+	g_hash_table_remove_all (priv->provide_best_hash);
+	priv->provide_remote_searches = 0;
+	priv->provide_remote_hits = 0;
+	priv->provide_prefetched = 0;
+
+	/* anything left from a previous resolve has to be done again */
+	zif_transaction_pending_seed (priv->install_pending, priv->install);
+	zif_transaction_pending_seed (priv->update_pending, priv->update);
+	zif_transaction_pending_seed (priv->remove_pending, priv->remove);
+
 	/* loop until all resolved */
 	do {
 		ret = zif_transaction_resolve_loop (data, state, error);
@@ -5686,6 +5992,11 @@ zif_transaction_write_yumdb (ZifTransaction *transaction,
 	if (!ret)
 		goto out;
 
+	/* write all the entries in one batch */
+	ret = zif_db_begin (transaction->priv->db, error);
+	if (!ret)
+		goto out;
+
 	/* remove all the old entries */
 	state_local = zif_state_get_child (state);
 	if (transaction->priv->remove->len > 0)
@@ -5732,11 +6043,18 @@ zif_transaction_write_yumdb (ZifTransaction *transaction,
 			goto out;
 	}
 
+	/* write the batch */
+	ret = zif_db_commit (transaction->priv->db, error);
+	if (!ret)
+		goto out;
+
 	/* this section done */
 	ret = zif_state_done (state, error);
 	if (!ret)
 		goto out;
 out:
+	if (!ret)
+		zif_db_rollback (transaction->priv->db);
 	return ret;
 }
 
@@ -5940,6 +6258,33 @@ out:
 	return ret;
 }
 
+/**
+ * zif_transaction_get_provide_stats: (skip)
+ * @transaction: A #ZifTransaction
+ * @searches: (out) (allow-none): The number of depends searched for in the remote stores one at a time
+ * @hits: (out) (allow-none): The number of remote provide lookups that were already known
+ * @prefetched: (out) (allow-none): The number of depends searched for in a batch
+ *
+ * Gets debugging information about the remote provide lookups in the
+ * last resolve.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_transaction_get_provide_stats (ZifTransaction *transaction,
+				   guint *searches,
+				   guint *hits,
+				   guint *prefetched)
+{
+	g_return_if_fail (ZIF_IS_TRANSACTION (transaction));
+	if (searches != NULL)
+		*searches = transaction->priv->provide_remote_searches;
+	if (hits != NULL)
+		*hits = transaction->priv->provide_remote_hits;
+	if (prefetched != NULL)
+		*prefetched = transaction->priv->provide_prefetched;
+}
+
 /**
  * zif_transaction_write_history:
  * @transaction: A #ZifTransaction
@@ -6577,6 +6922,42 @@ zif_transaction_get_state (ZifTransaction *transaction)
 	return transaction->priv->state;
 }
 
+/**
+ * zif_transaction_serial_next:
+ *
+ * Each transaction, and each reset of it, gets a new serial so that
+ * an item left on a shared package is never mistaken for a new one.
+ **/
+static guint
+zif_transaction_serial_next (void)
+{
+	static gint serial = 0;
+	return (guint) g_atomic_int_add (&serial, 1) + 1;
+}
+
+/**
+ * zif_transaction_array_clear:
+ *
+ * The items are attached to the packages, which may be shared with
+ * other transactions, so only the items this transaction owns are
+ * dropped.
+ **/
+static void
+zif_transaction_array_clear (ZifTransaction *transaction, GPtrArray *array)
+{
+	guint i;
+	ZifPackage *package;
+	ZifTransactionItem *item;
+
+	for (i = 0; i < array->len; i++) {
+		package = g_ptr_array_index (array, i);
+		item = g_object_get_data (G_OBJECT (package), "ZifTransaction");
+		if (item != NULL && item->serial == transaction->priv->serial)
+			g_object_set_data (G_OBJECT (package), "ZifTransaction", NULL);
+	}
+	g_ptr_array_set_size (array, 0);
+}
+
 /**
  * zif_transaction_reset:
  * @transaction: A #ZifTransaction
@@ -6590,12 +6971,18 @@ void
 zif_transaction_reset (ZifTransaction *transaction)
 {
 	g_return_if_fail (ZIF_IS_TRANSACTION (transaction));
-	g_ptr_array_set_size (transaction->priv->install, 0);
-	g_ptr_array_set_size (transaction->priv->update, 0);
-	g_ptr_array_set_size (transaction->priv->remove, 0);
 	g_hash_table_remove_all (transaction->priv->install_hash);
 	g_hash_table_remove_all (transaction->priv->update_hash);
 	g_hash_table_remove_all (transaction->priv->remove_hash);
+	zif_transaction_array_clear (transaction, transaction->priv->install);
+	zif_transaction_array_clear (transaction, transaction->priv->update);
+	zif_transaction_array_clear (transaction, transaction->priv->remove);
+	transaction->priv->serial = zif_transaction_serial_next ();
+	zif_transaction_pending_clear (transaction->priv->install_pending);
+	zif_transaction_pending_clear (transaction->priv->update_pending);
+	zif_transaction_pending_clear (transaction->priv->remove_pending);
+	g_hash_table_remove_all (transaction->priv->provide_remote_hash);
+	g_hash_table_remove_all (transaction->priv->provide_best_hash);
 	transaction->priv->state = ZIF_TRANSACTION_STATE_CLEAN;
 	g_free (transaction->priv->script_stdout);
 	transaction->priv->script_stdout = NULL;
@@ -6617,12 +7004,23 @@ zif_transaction_finalize (GObject *object)
 	g_object_unref (transaction->priv->db);
 	g_object_unref (transaction->priv->history);
 	g_object_unref (transaction->priv->config);
+	zif_transaction_array_clear (transaction, transaction->priv->install);
+	zif_transaction_array_clear (transaction, transaction->priv->update);
+	zif_transaction_array_clear (transaction, transaction->priv->remove);
 	g_ptr_array_unref (transaction->priv->install);
 	g_ptr_array_unref (transaction->priv->update);
 	g_ptr_array_unref (transaction->priv->remove);
 	g_hash_table_destroy (transaction->priv->install_hash);
 	g_hash_table_destroy (transaction->priv->update_hash);
 	g_hash_table_destroy (transaction->priv->remove_hash);
+	zif_transaction_pending_clear (transaction->priv->install_pending);
+	zif_transaction_pending_clear (transaction->priv->update_pending);
+	zif_transaction_pending_clear (transaction->priv->remove_pending);
+	g_queue_free (transaction->priv->install_pending);
+	g_queue_free (transaction->priv->update_pending);
+	g_queue_free (transaction->priv->remove_pending);
+	g_hash_table_unref (transaction->priv->provide_remote_hash);
+	g_hash_table_unref (transaction->priv->provide_best_hash);
 	if (transaction->priv->store_local != NULL)
 		g_object_unref (transaction->priv->store_local);
 	g_ptr_array_unref (transaction->priv->stores_remote);
@@ -6652,6 +7050,7 @@ zif_transaction_init (ZifTransaction *transaction)
 
 	/* make sure initialized */
 	zif_init ();
+	transaction->priv->serial = zif_transaction_serial_next ();
 
 	transaction->priv->config = zif_config_new ();
 	transaction->priv->db = zif_db_new ();
@@ -6670,6 +7069,17 @@ zif_transaction_init (ZifTransaction *transaction)
 	/* packages we want to remove */
 	transaction->priv->remove = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	transaction->priv->remove_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	/* packages that still need to be depsolved */
+	transaction->priv->install_pending = g_queue_new ();
+	transaction->priv->update_pending = g_queue_new ();
+	transaction->priv->remove_pending = g_queue_new ();
+
+	/* provides we've already searched for when depsolving */
+	transaction->priv->provide_remote_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+									 g_free, (GDestroyNotify) g_ptr_array_unref);
+	transaction->priv->provide_best_hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+								       g_free, (GDestroyNotify) g_object_unref);
 }
 
 /**
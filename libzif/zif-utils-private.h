@@ -29,6 +29,7 @@
 #include <gio/gio.h>
 #include <glib-object.h>
 
+#include "zif-string.h"
 #include "zif-utils.h"
 
 G_BEGIN_DECLS
@@ -37,20 +38,57 @@ gboolean	 zif_init			(void);
 GKeyFile	*zif_load_multiline_key_file	(const gchar	*filename,
 						 GError		**error);
 
-typedef gboolean (*ZifStrCompareFunc)		(const gchar	*a,
-						 const gchar	*b);
-gboolean	 zif_str_compare_regex		(const gchar	*a,
-						 const gchar	*b);
-gboolean	 zif_str_compare_glob		(const gchar	*a,
-						 const gchar	*b);
-gboolean	 zif_str_compare_equal		(const gchar	*a,
-						 const gchar	*b);
+typedef enum {
+	ZIF_STR_MATCHER_KIND_EQUAL,
+	ZIF_STR_MATCHER_KIND_GLOB,
+	ZIF_STR_MATCHER_KIND_REGEX,
+	ZIF_STR_MATCHER_KIND_LAST
+} ZifStrMatcherKind;
+
+typedef struct _ZifStrMatcher ZifStrMatcher;
+
+/* an [epoch:]version[-release] that has already been split */
+typedef struct {
+	const gchar	*value;
+	const gchar	*epoch;
+	const gchar	*version;
+	const gchar	*release;
+	const gchar	*distro;
+	ZifString	*string;	/* owns value, interned for zif_evr_intern() */
+	gint		 count;
+	gboolean	 is_interned;
+} ZifEvr;
+
+ZifStrMatcher	*zif_str_matcher_new		(const gchar	*pattern,
+						 ZifStrMatcherKind kind,
+						 GError		**error);
+void		 zif_str_matcher_free		(ZifStrMatcher	*matcher);
+gboolean	 zif_str_matcher_match		(ZifStrMatcher	*matcher,
+						 const gchar	*value);
+const gchar	*zif_str_matcher_get_prefix	(ZifStrMatcher	*matcher);
+gboolean	 zif_str_matcher_is_literal	(ZifStrMatcher	*matcher);
+GPtrArray	*zif_str_matcher_array_new	(gchar		**search,
+						 ZifStrMatcherKind kind,
+						 GError		**error);
+gboolean	 zif_str_matcher_array_match	(GPtrArray	*array,
+						 const gchar	*value);
 guint		 zif_string_replace		(GString	*string,
 						 const gchar	*search,
 						 const gchar	*replace);
 gboolean	 zif_ensure_parent_dir_exists	(const gchar	*filename,
 						 GCancellable	*cancellable,
 						 GError		**error);
+gboolean	 zif_atomic_dec_and_lock	(gint		*count,
+						 GMutex		*mutex);
+gint		 zif_vercmp			(const gchar	*a,
+						 const gchar	*b);
+ZifEvr		*zif_evr_new			(const gchar	*evr);
+ZifEvr		*zif_evr_intern			(const gchar	*evr);
+ZifEvr		*zif_evr_ref			(ZifEvr		*evr);
+void		 zif_evr_unref			(ZifEvr		*evr);
+gint		 zif_evr_compare		(const ZifEvr	*a,
+						 const ZifEvr	*b,
+						 ZifPackageCompareMode compare_mode);
 
 G_END_DECLS
 
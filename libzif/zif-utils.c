@@ -31,6 +31,8 @@
 #endif
 
 #include <glib.h>
+#include <string.h>
+#include <stdlib.h>
 #include <rpm/rpmlib.h>
 #include <rpm/rpmdb.h>
 #include <archive.h>
@@ -43,6 +45,7 @@
 
 #include "zif-utils-private.h"
 #include "zif-package.h"
+#include "zif-string-private.h"
 
 /**
  * zif_utils_gpg_check_signature:
@@ -574,6 +577,230 @@ zif_package_convert_evr (gchar *evr,
 					     NULL);
 }
 
+/* the segment separators that newer versions of rpmvercmp() know */
+#define ZIF_VERCMP_TILDE	(1 << 0)
+#define ZIF_VERCMP_CARET	(1 << 1)
+
+/**
+ * zif_vercmp_get_features_cb:
+ *
+ * The sorting rules of rpmvercmp() have changed between rpm versions,
+ * so ask the one we are linked against rather than guessing.
+ **/
+static gpointer
+zif_vercmp_get_features_cb (gpointer user_data)
+{
+	guint features = 0;
+	if (rpmvercmp ("1~", "1") < 0) {
+		features |= ZIF_VERCMP_TILDE;
+		if (rpmvercmp ("1^", "1") > 0)
+			features |= ZIF_VERCMP_CARET;
+	}
+	return GUINT_TO_POINTER (features);
+}
+
+/**
+ * zif_vercmp_get_features:
+ **/
+static guint
+zif_vercmp_get_features (void)
+{
+	static GOnce features_once = G_ONCE_INIT;
+	g_once (&features_once, zif_vercmp_get_features_cb, NULL);
+	return GPOINTER_TO_UINT (features_once.retval);
+}
+
+/**
+ * zif_vercmp_is_separator:
+ **/
+static inline gboolean
+zif_vercmp_is_separator (gchar c, guint features)
+{
+	if (c == '\0' || g_ascii_isalnum (c))
+		return FALSE;
+	if (c == '~' && (features & ZIF_VERCMP_TILDE) > 0)
+		return FALSE;
+	if (c == '^' && (features & ZIF_VERCMP_CARET) > 0)
+		return FALSE;
+	return TRUE;
+}
+
+/**
+ * zif_vercmp:
+ * @a: The first version segment
+ * @b: The second version segment
+ *
+ * Compares two version segments in exactly the same way as rpmvercmp(),
+ * but without copying the strings. Numeric segments are compared using
+ * the length once the leading zeros are skipped, so the digits only
+ * have to be compared when the numbers are the same size.
+ *
+ * Return value: 1 for a>b, 0 for a==b, -1 for b>a
+ *
+ * Since: 0.3.7
+ **/
+gint
+zif_vercmp (const gchar *a, const gchar *b)
+{
+	const gchar *one = a;
+	const gchar *two = b;
+	const gchar *end1;
+	const gchar *end2;
+	gboolean isnum;
+	gint rc;
+	gsize len1, len2;
+	guint features;
+
+	/* easy comparison to see if versions are identical */
+	if (strcmp (a, b) == 0)
+		return 0;
+
+	features = zif_vercmp_get_features ();
+	while ((features & ZIF_VERCMP_TILDE) > 0 ? (*one != '\0' || *two != '\0') :
+						    (*one != '\0' && *two != '\0')) {
+		while (zif_vercmp_is_separator (*one, features))
+			one++;
+		while (zif_vercmp_is_separator (*two, features))
+			two++;
+
+		/* the tilde sorts before everything else */
+		if ((features & ZIF_VERCMP_TILDE) > 0 &&
+		    (*one == '~' || *two == '~')) {
+			if (*one != '~')
+				return 1;
+			if (*two != '~')
+				return -1;
+			one++;
+			two++;
+			continue;
+		}
+
+		/* the caret sorts after the end, but before anything else */
+		if ((features & ZIF_VERCMP_CARET) > 0 &&
+		    (*one == '^' || *two == '^')) {
+			if (*one == '\0')
+				return -1;
+			if (*two == '\0')
+				return 1;
+			if (*one != '^')
+				return 1;
+			if (*two != '^')
+				return -1;
+			one++;
+			two++;
+			continue;
+		}
+
+		/* we ran to the end of either */
+		if (*one == '\0' || *two == '\0')
+			break;
+
+		/* grab first completely alpha or completely numeric segment */
+		end1 = one;
+		end2 = two;
+		isnum = g_ascii_isdigit (*one);
+		if (isnum) {
+			while (g_ascii_isdigit (*end1))
+				end1++;
+			while (g_ascii_isdigit (*end2))
+				end2++;
+		} else {
+			while (g_ascii_isalpha (*end1))
+				end1++;
+			while (g_ascii_isalpha (*end2))
+				end2++;
+		}
+
+		/* numeric segments are always newer than alpha segments */
+		if (end2 == two)
+			return isnum ? 1 : -1;
+
+		/* the longer number is bigger */
+		if (isnum) {
+			while (*one == '0')
+				one++;
+			while (*two == '0')
+				two++;
+			len1 = end1 - one;
+			len2 = end2 - two;
+			if (len1 > len2)
+				return 1;
+			if (len2 > len1)
+				return -1;
+		}
+
+		/* same as strcmp() on the segment */
+		len1 = end1 - one;
+		len2 = end2 - two;
+		rc = memcmp (one, two, MIN (len1, len2));
+		if (rc != 0)
+			return rc < 0 ? -1 : 1;
+		if (len1 != len2)
+			return len1 < len2 ? -1 : 1;
+
+		one = end1;
+		two = end2;
+	}
+
+	/* whichever version still has characters left over wins */
+	if (*one == '\0' && *two == '\0')
+		return 0;
+	return *one == '\0' ? -1 : 1;
+}
+
+/**
+ * zif_compare_evr_split:
+ **/
+static gint
+zif_compare_evr_split (const gchar *ae, const gchar *av,
+		       const gchar *ar, const gchar *ad,
+		       const gchar *be, const gchar *bv,
+		       const gchar *br, const gchar *bd,
+		       ZifPackageCompareMode compare_mode)
+{
+	gint val;
+
+	/* compare distro */
+	if (ad != NULL &&
+	    bd != NULL &&
+	    compare_mode == ZIF_PACKAGE_COMPARE_MODE_DISTRO) {
+		val = zif_vercmp (ad, bd);
+		if (val != 0)
+			return val;
+	}
+
+	/* compare epoch */
+	if (ae != NULL && be != NULL) {
+		val = zif_vercmp (ae, be);
+		if (val != 0)
+			return val;
+	} else if (ae != NULL && atoi (ae) > 0) {
+		return 1;
+	} else if (be != NULL && atoi (be) > 0) {
+		return -1;
+	}
+
+	/* compare version */
+	val = zif_vercmp (av, bv);
+	if (val != 0)
+		return val;
+
+	/* compare release */
+	if (ar != NULL && br != NULL) {
+		val = zif_vercmp (ar, br);
+		if (val != 0)
+			return val;
+	}
+
+	/* compare distro */
+	if (ad != NULL && bd != NULL) {
+		val = zif_vercmp (ad, bd);
+		if (val != 0)
+			return val;
+	}
+	return 0;
+}
+
 /**
  * zif_compare_evr_full:
  * @a: The first version string, or %NULL
@@ -617,49 +844,190 @@ zif_compare_evr_full (const gchar *a, const gchar *b,
 	/* split */
 	zif_package_convert_evr_full (a_tmp, &ae, &av, &ar, &ad);
 	zif_package_convert_evr_full (b_tmp, &be, &bv, &br, &bd);
+	val = zif_compare_evr_split (ae, av, ar, ad,
+				     be, bv, br, bd,
+				     compare_mode);
+out:
+	return val;
+}
 
-	/* compare distro */
-	if (ad != NULL &&
-	    bd != NULL &&
-	    compare_mode == ZIF_PACKAGE_COMPARE_MODE_DISTRO) {
-		val = rpmvercmp (ad, bd);
-		if (val != 0)
-			goto out;
-	}
+/**
+ * zif_evr_new_for_string:
+ *
+ * Splits the version in @string, taking ownership of the reference.
+ * Only the split copy is allocated, after the struct.
+ **/
+static ZifEvr *
+zif_evr_new_for_string (ZifString *string)
+{
+	gchar *split;
+	gsize len;
+	ZifEvr *parsed;
+
+	len = strlen (zif_string_get_value (string)) + 1;
+	parsed = g_malloc (sizeof (ZifEvr) + len);
+	parsed->string = string;
+	parsed->value = zif_string_get_value (string);
+	parsed->count = 1;
+	parsed->is_interned = zif_string_is_interned (string);
+	split = (gchar *) (parsed + 1);
+	memcpy (split, parsed->value, len);
+	zif_package_convert_evr_full (split,
+				      &parsed->epoch,
+				      &parsed->version,
+				      &parsed->release,
+				      &parsed->distro);
+	return parsed;
+}
 
-	/* compare epoch */
-	if (ae != NULL && be != NULL) {
-		val = rpmvercmp (ae, be);
-		if (val != 0)
-			goto out;
-	} else if (ae != NULL && atoi (ae) > 0) {
-		val = 1;
-		goto out;
-	} else if (be != NULL && atoi (be) > 0) {
-		val = -1;
-		goto out;
-	}
+/**
+ * zif_evr_new:
+ * @evr: An [epoch:]version[-release] string
+ *
+ * Splits the version once so that it can be compared many times
+ * using zif_evr_compare().
+ *
+ * Return value: A new #ZifEvr, free with zif_evr_unref()
+ *
+ * Since: 0.3.7
+ **/
+ZifEvr *
+zif_evr_new (const gchar *evr)
+{
+	g_return_val_if_fail (evr != NULL, NULL);
+	return zif_evr_new_for_string (zif_string_new (evr));
+}
 
-	/* compare version */
-	val = rpmvercmp (av, bv);
-	if (val != 0)
-		goto out;
+/* the interned versions, keyed by the interned #ZifString, which do not
+ * hold a reference */
+static GMutex zif_evr_intern_mutex;
+static GHashTable *zif_evr_intern_hash = NULL;
 
-	/* compare release */
-	if (ar != NULL && br != NULL) {
-		val = rpmvercmp (ar, br);
-		if (val != 0)
-			goto out;
+/**
+ * zif_evr_intern:
+ * @evr: An [epoch:]version[-release] string
+ *
+ * Gets a shared split version, creating it if no other interned
+ * version has the same value. This is useful for depend versions,
+ * where the same version is used by many packages.
+ *
+ * Interned versions can be shared between threads.
+ *
+ * Return value: A #ZifEvr, free with zif_evr_unref()
+ *
+ * Since: 0.3.7
+ **/
+ZifEvr *
+zif_evr_intern (const gchar *evr)
+{
+	ZifEvr *parsed;
+	ZifString *string;
+
+	g_return_val_if_fail (evr != NULL, NULL);
+
+	/* equal versions have the same interned string */
+	string = zif_string_new_intern (evr);
+
+	g_mutex_lock (&zif_evr_intern_mutex);
+	if (zif_evr_intern_hash == NULL)
+		zif_evr_intern_hash = g_hash_table_new (g_direct_hash, g_direct_equal);
+	parsed = g_hash_table_lookup (zif_evr_intern_hash, string);
+	if (parsed != NULL) {
+		g_atomic_int_inc (&parsed->count);
+		g_mutex_unlock (&zif_evr_intern_mutex);
+		zif_string_unref (string);
+		return parsed;
 	}
+	parsed = zif_evr_new_for_string (string);
+	g_hash_table_insert (zif_evr_intern_hash, string, parsed);
+	g_mutex_unlock (&zif_evr_intern_mutex);
+	return parsed;
+}
 
-	/* compare distro */
-	if (ad != NULL && bd != NULL) {
-		val = rpmvercmp (ad, bd);
-		if (val != 0)
-			goto out;
+/**
+ * zif_evr_ref:
+ * @evr: A #ZifEvr
+ *
+ * Increases the reference count on the version.
+ *
+ * Return value: @evr
+ *
+ * Since: 0.3.7
+ **/
+ZifEvr *
+zif_evr_ref (ZifEvr *evr)
+{
+	g_return_val_if_fail (evr != NULL, NULL);
+	g_atomic_int_inc (&evr->count);
+	return evr;
+}
+
+/**
+ * zif_evr_unref:
+ * @evr: A #ZifEvr
+ *
+ * Decreases the reference count on the version, and frees it when the
+ * last reference is dropped. The lock is held when the last reference
+ * to an interned version is dropped so that zif_evr_intern() cannot
+ * return a version that is being freed.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_evr_unref (ZifEvr *evr)
+{
+	g_return_if_fail (evr != NULL);
+
+	if (!evr->is_interned) {
+		if (g_atomic_int_dec_and_test (&evr->count))
+			goto free;
+		return;
 	}
-out:
-	return val;
+	if (!zif_atomic_dec_and_lock (&evr->count, &zif_evr_intern_mutex))
+		return;
+	g_hash_table_remove (zif_evr_intern_hash, evr->string);
+	g_mutex_unlock (&zif_evr_intern_mutex);
+free:
+	zif_string_unref (evr->string);
+	g_free (evr);
+}
+
+/**
+ * zif_evr_compare:
+ * @a: The first #ZifEvr, or %NULL
+ * @b: The second #ZifEvr, or %NULL
+ * @compare_mode: the way the versions are compared
+ *
+ * Compares two versions that have already been split, which gives the
+ * same result as zif_compare_evr_full() on the original strings.
+ *
+ * Return value: 1 for a>b, 0 for a==b, -1 for b>a
+ *
+ * Since: 0.3.7
+ **/
+gint
+zif_evr_compare (const ZifEvr *a, const ZifEvr *b,
+		 ZifPackageCompareMode compare_mode)
+{
+	/* the same version, which is common for interned versions */
+	if (a == b)
+		return 0;
+
+	/* deal with one evr being NULL and the other a value */
+	if (b == NULL)
+		return 1;
+	if (a == NULL)
+		return -1;
+
+	/* exactly the same, optimise */
+	if (strcmp (a->value, b->value) == 0)
+		return 0;
+
+	return zif_compare_evr_split (a->epoch, a->version,
+				      a->release, a->distro,
+				      b->epoch, b->version,
+				      b->release, b->distro,
+				      compare_mode);
 }
 
 /**
@@ -1405,55 +1773,259 @@ out:
 	return timeval;
 }
 
+struct _ZifStrMatcher {
+	ZifStrMatcherKind	 kind;
+	gchar			*pattern;
+	gchar			*prefix;
+	gsize			 prefix_len;
+	gboolean		 is_literal;
+	gboolean		 is_prefix_only;
+	GRegex			*regex;
+};
+
+/**
+ * zif_str_matcher_set_prefix_glob:
+ **/
+static void
+zif_str_matcher_set_prefix_glob (ZifStrMatcher *matcher)
+{
+	const gchar *tmp;
+
+	/* everything up to the first wildcard or escape */
+	tmp = strpbrk (matcher->pattern, "*?[\\");
+	if (tmp == NULL) {
+		matcher->prefix = g_strdup (matcher->pattern);
+		matcher->is_literal = TRUE;
+		return;
+	}
+	matcher->prefix = g_strndup (matcher->pattern, tmp - matcher->pattern);
+
+	/* "foo*" does not need fnmatch() at all */
+	if (g_strcmp0 (tmp, "*") == 0)
+		matcher->is_prefix_only = TRUE;
+}
+
+/**
+ * zif_str_matcher_set_prefix_regex:
+ **/
+static void
+zif_str_matcher_set_prefix_regex (ZifStrMatcher *matcher)
+{
+	const gchar *start;
+	const gchar *tmp;
+
+	/* only an anchored expression without alternatives has a prefix */
+	if (matcher->pattern[0] != '^' ||
+	    strchr (matcher->pattern, '|') != NULL) {
+		matcher->prefix = g_strdup ("");
+		return;
+	}
+
+	/* everything up to the first special character */
+	start = matcher->pattern + 1;
+	tmp = strpbrk (start, ".[]()*+?{}|\\^$");
+	if (tmp == NULL) {
+		matcher->prefix = g_strdup (start);
+		matcher->is_prefix_only = TRUE;
+		return;
+	}
+
+	/* "^foo$" is just a string compare */
+	if (tmp[0] == '$' && tmp[1] == '\0') {
+		matcher->prefix = g_strndup (start, tmp - start);
+		matcher->is_literal = TRUE;
+		return;
+	}
+
+	/* the last character is optional in "^foo*" or "^foo?" */
+	if (tmp > start && strchr ("*?{", tmp[0]) != NULL)
+		tmp--;
+	matcher->prefix = g_strndup (start, tmp - start);
+}
+
 /**
- * zif_str_compare_regex:
- * @a: The string
- * @b: The pattern to match
+ * zif_str_matcher_new:
+ * @pattern: The pattern to match, e.g. "python3-*"
+ * @kind: A #ZifStrMatcherKind, e.g. %ZIF_STR_MATCHER_KIND_GLOB
+ * @error: A #GError, or %NULL
  *
- * Compares one string against another
+ * Compiles a pattern once so that it can be matched against many
+ * strings. Any literal prefix is extracted so callers can narrow down
+ * the strings to check using an index.
  *
- * Return value: %TRUE for success
+ * Return value: A new #ZifStrMatcher, or %NULL for an invalid pattern
  *
- * Since: 0.2.4
+ * Since: 0.3.7
+ **/
+ZifStrMatcher *
+zif_str_matcher_new (const gchar *pattern,
+		     ZifStrMatcherKind kind,
+		     GError **error)
+{
+	ZifStrMatcher *matcher;
+
+	g_return_val_if_fail (pattern != NULL, NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	matcher = g_new0 (ZifStrMatcher, 1);
+	matcher->kind = kind;
+	matcher->pattern = g_strdup (pattern);
+	switch (kind) {
+	case ZIF_STR_MATCHER_KIND_GLOB:
+		zif_str_matcher_set_prefix_glob (matcher);
+		break;
+	case ZIF_STR_MATCHER_KIND_REGEX:
+		zif_str_matcher_set_prefix_regex (matcher);
+		if (matcher->is_literal || matcher->is_prefix_only)
+			break;
+		matcher->regex = g_regex_new (pattern,
+					      G_REGEX_OPTIMIZE,
+					      0,
+					      error);
+		if (matcher->regex == NULL) {
+			zif_str_matcher_free (matcher);
+			return NULL;
+		}
+		break;
+	default:
+		matcher->prefix = g_strdup (pattern);
+		matcher->is_literal = TRUE;
+		break;
+	}
+	matcher->prefix_len = strlen (matcher->prefix);
+	return matcher;
+}
+
+/**
+ * zif_str_matcher_free:
+ * @matcher: A #ZifStrMatcher
+ *
+ * Frees a matcher.
+ *
+ * Since: 0.3.7
+ **/
+void
+zif_str_matcher_free (ZifStrMatcher *matcher)
+{
+	if (matcher == NULL)
+		return;
+	if (matcher->regex != NULL)
+		g_regex_unref (matcher->regex);
+	g_free (matcher->pattern);
+	g_free (matcher->prefix);
+	g_free (matcher);
+}
+
+/**
+ * zif_str_matcher_match:
+ * @matcher: A #ZifStrMatcher
+ * @value: The string to check
+ *
+ * Matches a string against the compiled pattern.
+ *
+ * Return value: %TRUE if @value matches
+ *
+ * Since: 0.3.7
  **/
 gboolean
-zif_str_compare_regex (const gchar *a, const gchar *b)
+zif_str_matcher_match (ZifStrMatcher *matcher, const gchar *value)
 {
-	return g_regex_match_simple (b, a, G_REGEX_OPTIMIZE, 0);
+	if (matcher->is_literal)
+		return strcmp (value, matcher->prefix) == 0;
+	if (strncmp (value, matcher->prefix, matcher->prefix_len) != 0)
+		return FALSE;
+	if (matcher->is_prefix_only)
+		return TRUE;
+	if (matcher->kind == ZIF_STR_MATCHER_KIND_REGEX)
+		return g_regex_match (matcher->regex, value, 0, NULL);
+	return fnmatch (matcher->pattern, value, 0) == 0;
 }
 
 /**
- * zif_str_compare_glob:
- * @a: The string
- * @b: The pattern to match
+ * zif_str_matcher_get_prefix:
+ * @matcher: A #ZifStrMatcher
  *
- * Compares one string against another
+ * Gets the literal text that all matching strings have to start with.
  *
- * Return value: %TRUE for success
+ * Return value: The prefix, which may be ""
  *
- * Since: 0.2.4
+ * Since: 0.3.7
+ **/
+const gchar *
+zif_str_matcher_get_prefix (ZifStrMatcher *matcher)
+{
+	return matcher->prefix;
+}
+
+/**
+ * zif_str_matcher_is_literal:
+ * @matcher: A #ZifStrMatcher
+ *
+ * Gets if the pattern can only match the prefix exactly.
+ *
+ * Return value: %TRUE if a string compare is all that is required
+ *
+ * Since: 0.3.7
  **/
 gboolean
-zif_str_compare_glob (const gchar *a, const gchar *b)
+zif_str_matcher_is_literal (ZifStrMatcher *matcher)
+{
+	return matcher->is_literal;
+}
+
+/**
+ * zif_str_matcher_array_new:
+ * @search: The patterns to match
+ * @kind: A #ZifStrMatcherKind, e.g. %ZIF_STR_MATCHER_KIND_GLOB
+ * @error: A #GError, or %NULL
+ *
+ * Compiles each of the patterns in @search.
+ *
+ * Return value: An array of #ZifStrMatcher's, or %NULL for an invalid pattern
+ *
+ * Since: 0.3.7
+ **/
+GPtrArray *
+zif_str_matcher_array_new (gchar **search,
+			   ZifStrMatcherKind kind,
+			   GError **error)
 {
-	return fnmatch (b, a, 0) == 0;
+	GPtrArray *array;
+	guint i;
+	ZifStrMatcher *matcher;
+
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) zif_str_matcher_free);
+	for (i = 0; search[i] != NULL; i++) {
+		matcher = zif_str_matcher_new (search[i], kind, error);
+		if (matcher == NULL) {
+			g_ptr_array_unref (array);
+			return NULL;
+		}
+		g_ptr_array_add (array, matcher);
+	}
+	return array;
 }
 
 /**
- * zif_str_compare_equal:
- * @a: The string
- * @b: The pattern to match
+ * zif_str_matcher_array_match:
+ * @array: An array of #ZifStrMatcher's
+ * @value: The string to check
  *
- * Compares one string against another
+ * Matches a string against any of the compiled patterns.
  *
- * Return value: %TRUE for success
+ * Return value: %TRUE if @value matches any of the patterns
  *
- * Since: 0.2.4
+ * Since: 0.3.7
  **/
 gboolean
-zif_str_compare_equal (const gchar *a, const gchar *b)
+zif_str_matcher_array_match (GPtrArray *array, const gchar *value)
 {
-	return strcmp (a, b) == 0;
+	guint i;
+	for (i = 0; i < array->len; i++) {
+		if (zif_str_matcher_match (g_ptr_array_index (array, i), value))
+			return TRUE;
+	}
+	return FALSE;
 }
 
 /**
@@ -1695,3 +2267,43 @@ out:
 	g_object_unref (file);
 	return ret;
 }
+
+/**
+ * zif_atomic_dec_and_lock:
+ * @count: An atomic reference count
+ * @mutex: The lock of the table that can hand out new references
+ *
+ * Decreases the reference count, taking @mutex only if this could be
+ * the last reference. This is used for objects that are shared using a
+ * table that does not hold a reference, so that a lookup holding
+ * @mutex cannot return an object that is being freed.
+ *
+ * Return value: %TRUE if the last reference was dropped, in which case
+ * @mutex is held and the caller has to remove the object from the
+ * table and then unlock @mutex.
+ *
+ * Since: 0.3.7
+ **/
+gboolean
+zif_atomic_dec_and_lock (gint *count, GMutex *mutex)
+{
+	gint tmp;
+
+	/* not the last reference, so the table is not touched */
+	do {
+		tmp = g_atomic_int_get (count);
+		if (tmp <= 1)
+			break;
+	} while (!g_atomic_int_compare_and_exchange (count, tmp, tmp - 1));
+	if (tmp > 1)
+		return FALSE;
+
+	/* another thread may take a reference from the table until we
+	 * have the lock */
+	g_mutex_lock (mutex);
+	if (!g_atomic_int_dec_and_test (count)) {
+		g_mutex_unlock (mutex);
+		return FALSE;
+	}
+	return TRUE;
+}